@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decides at submit time whether a job may join the worker backlog. The wait
+// a new job would see is estimated from the work already admitted (in
+// megapixels) and the measured encode cost per megapixel; past a class's
+// limits the job is refused at once with a Retry-After hint instead of
+// waiting for room in job_queue.
+typedef enum {
+    FP_ADMIT_FREE = 0, // /api/compress and /api/jobs
+    FP_ADMIT_EXPERT,   // /api/expert/compress
+    FP_ADMIT_CLASS_COUNT,
+} fp_admit_class;
+
+typedef struct {
+    size_t max_jobs;      // admitted, unfinished jobs of this class
+    uint64_t max_wait_ms; // estimated queueing delay beyond which new jobs are refused
+} fp_admission_limits;
+
+#define FP_ADMISSION_FREE_MAX_JOBS 256
+#define FP_ADMISSION_FREE_MAX_WAIT_MS 5000
+#define FP_ADMISSION_EXPERT_MAX_JOBS 512
+#define FP_ADMISSION_EXPERT_MAX_WAIT_MS 30000
+#define FP_ADMISSION_DEFAULT_MS_PER_UNIT 250.0 // until a job has been measured
+#define FP_ADMISSION_MAX_RETRY_AFTER_S 120
+
+typedef struct fp_admission fp_admission;
+
+// limits may be NULL for the defaults; ms_per_unit seeds the cost estimate
+// (e.g. from the worker ETA table) and is refined as jobs complete.
+fp_admission *fp_admission_create(size_t worker_count, double ms_per_unit, const fp_admission_limits *limits);
+void fp_admission_destroy(fp_admission *admission);
+
+// Returns 0 when the job is admitted (release it once it is done), or -1 with
+// *retry_after_s set to when the backlog should have drained enough.
+int fp_admission_try_admit(fp_admission *admission, fp_admit_class cls, double work_units, unsigned *retry_after_s);
+
+// Gives back an admitted job. service_ms is its measured run time, or 0 when
+// it never ran; either way its units leave the backlog.
+void fp_admission_release(fp_admission *admission, fp_admit_class cls, double work_units, double service_ms);
+
+// The limits in effect for cls, defaults filled in.
+const fp_admission_limits *fp_admission_limits_for(const fp_admission *admission, fp_admit_class cls);
+
+// Current estimate of how long a newly admitted job would queue.
+uint64_t fp_admission_wait_ms(fp_admission *admission);
+
+// Admitted jobs not yet released, all classes.
+size_t fp_admission_jobs(fp_admission *admission);
+
+// Blocks until every admitted job has been released. A release is the last
+// thing its caller does with shared state, so the caller of this may then
+// tear that state down.
+void fp_admission_wait_idle(fp_admission *admission);
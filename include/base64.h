@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Standard (RFC 4648, padded) base64 encoding. The kernel is picked once at
+// startup from what the CPU supports; every kernel produces identical output.
+
+// Encoded length in characters, excluding any terminator.
+size_t fp_base64_encoded_len(size_t len);
+
+// Writes exactly fp_base64_encoded_len(len) characters to out (no terminator)
+// and returns that count.
+size_t fp_base64_encode_into(const uint8_t *data, size_t len, char *out);
+
+// Heap-allocated, NUL-terminated convenience wrapper; NULL on allocation failure.
+char *fp_base64_encode(const uint8_t *data, size_t len);
+
+// Name of the kernel fp_base64_encode_into dispatches to ("avx512vbmi",
+// "avx2", "ssse3" or "scalar").
+const char *fp_base64_kernel_name(void);
+
+// Kernels usable on this CPU, fastest first, for tests and benchmarks.
+typedef size_t (*fp_base64_kernel_fn)(const uint8_t *data, size_t len, char *out);
+
+typedef struct {
+    const char *name;
+    fp_base64_kernel_fn encode;
+} fp_base64_kernel;
+
+size_t fp_base64_kernels(fp_base64_kernel *out, size_t max);
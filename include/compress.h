@@ -6,22 +6,26 @@
 extern "C" {
 #endif
 
-typedef struct {
-    uint8_t *pixels; // RGBA
-    unsigned width;
-    unsigned height;
-} fp_rgba_image;
-
 typedef enum {
     FP_COMPRESS_OK = 0,
     FP_COMPRESS_DECODE_ERROR = 1,
     FP_COMPRESS_ENCODE_ERROR = 2,
-    FP_COMPRESS_UNSUPPORTED = 3
+    FP_COMPRESS_UNSUPPORTED = 3,
+    FP_COMPRESS_CANCELLED = 4 // the job's cancel token fired mid-encode
 } fp_compress_code;
 
 fp_compress_code fp_decode_png(const uint8_t *input, size_t size, fp_rgba_image *out_image);
 void fp_rgba_image_free(fp_rgba_image *image);
 
+// Progressive PNG decoder: feed the file in arbitrary pieces as they arrive
+// and collect the RGBA image once the last piece has been fed.
+typedef struct fp_png_stream fp_png_stream;
+
+fp_png_stream *fp_png_stream_create(void);
+fp_compress_code fp_png_stream_feed(fp_png_stream *stream, const uint8_t *data, size_t size);
+fp_compress_code fp_png_stream_finish(fp_png_stream *stream, fp_rgba_image *out_image);
+void fp_png_stream_destroy(fp_png_stream *stream);
+
 fp_compress_code fp_compress_png_level(const fp_rgba_image *image,
                                        int compression_level,
                                        const char *label,
@@ -32,12 +36,16 @@ fp_compress_code fp_compress_png_quantized(const fp_rgba_image *image,
                                            const char *label,
                                            fp_encoded_image *output);
 
+// cancel may be NULL. WebP polls it from libwebp's progress hook; libavif has
+// no abort callback, so AVIF only checks it around the encoder call.
 fp_compress_code fp_compress_webp(const fp_rgba_image *image,
                                   int quality,
+                                  const fp_cancel_token *cancel,
                                   fp_encoded_image *output);
 
 fp_compress_code fp_compress_avif(const fp_rgba_image *image,
                                   int quality,
+                                  const fp_cancel_token *cancel,
                                   fp_encoded_image *output);
 
 #ifdef __cplusplus
@@ -8,6 +8,42 @@
 #define FP_FILENAME_MAX 256
 
 struct fp_progress_channel;
+struct fp_output_store;
+struct fp_blob;
+struct fp_result;
+
+// Lets whoever waits for a job abandon it: cancelled when the client hangs
+// up, or expired once deadline_ms (CLOCK_MONOTONIC, 0 = none) passes. Workers
+// check it between stages and long-running encoders while they run.
+typedef struct fp_cancel_token fp_cancel_token;
+
+typedef enum {
+    FP_CANCEL_NONE = 0,
+    FP_CANCEL_ABANDONED,
+    FP_CANCEL_DEADLINE,
+} fp_cancel_reason;
+
+#define FP_RESULT_CANCELLED (-7) // fp_result.status of a job stopped by its token
+
+fp_cancel_token *fp_cancel_token_create(uint64_t deadline_ms);
+void fp_cancel_token_retain(fp_cancel_token *token);
+void fp_cancel_token_release(fp_cancel_token *token);
+void fp_cancel_token_cancel(fp_cancel_token *token);
+fp_cancel_reason fp_cancel_token_check(const fp_cancel_token *token); // FP_CANCEL_NONE for NULL
+
+// Scheduling class of a job; workers serve the classes by weight (see
+// scheduler.h). Zero-initialised jobs are FP_JOB_FREE.
+typedef enum {
+    FP_JOB_FREE = 0,    // POST /api/compress
+    FP_JOB_INTERACTIVE, // a retune the user is waiting on
+    FP_JOB_EXPERT,      // authenticated /api/expert/compress
+    FP_JOB_BULK,        // POST /api/jobs, fetched later
+    FP_JOB_CLASS_COUNT,
+} fp_job_class;
+
+// Runs on the worker thread once a job is done. Takes ownership of result,
+// which is NULL if the worker could not allocate one.
+typedef void (*fp_job_complete_fn)(struct fp_result *result, void *ctx);
 
 typedef struct {
     char format[8];
@@ -43,24 +79,38 @@ struct fp_encoded_image {
 
 typedef struct fp_encoded_image fp_encoded_image;
 
+typedef struct {
+    uint8_t *pixels; // RGBA
+    unsigned width;
+    unsigned height;
+} fp_rgba_image;
+
 typedef struct {
     uint64_t id;
     char filename[FP_FILENAME_MAX];
     uint8_t *data;
     size_t size;
+    struct fp_blob *data_owner; // when set, data is a slice of this shared buffer rather than owned
+    fp_rgba_image decoded; // set when the upload was decoded while streaming in; data is then NULL
     struct timespec enqueue_ts;
     struct fp_progress_channel *progress;
+    struct fp_output_store *output_store; // set for reference mode: outputs are parked there, not inlined
+    fp_cancel_token *cancel; // NULL when nothing can abandon the job
     char tune_format[8];
     char tune_label[32];
     int tune_direction;
     int is_expert;
+    fp_job_class job_class;
+    double predicted_ms; // expected run time, estimated before decoding; orders jobs within their class
     fp_requested_output requested_outputs[FP_MAX_OUTPUTS];
     size_t requested_output_count;
     fp_trim_options trim_options;
     fp_crop_options crop_options;
+    fp_job_complete_fn on_complete;
+    void *complete_ctx;
 } fp_job;
 
-typedef struct {
+typedef struct fp_result {
     uint64_t id;
     size_t input_size;
     fp_encoded_image outputs[FP_MAX_OUTPUTS];
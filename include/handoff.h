@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Listening-socket handover between the running process and its
+// replacement. The old process listens on a control socket; the new one
+// connects, receives every listening descriptor over SCM_RIGHTS, starts
+// accepting on them and then acknowledges with a single byte. Only after
+// the acknowledgement does the old process stop accepting and drain, so a
+// replacement that dies during startup leaves the old one serving.
+#define FP_HANDOFF_MAX_FDS 64
+
+// Binds the non-blocking control socket at path, replacing a stale one. The
+// socket file is made accessible to our user only.
+int fp_handoff_listen(const char *path);
+
+// True when the process at the other end of the AF_UNIX socket fd runs as
+// our effective uid; both sides check it before trusting the other.
+bool fp_handoff_peer_trusted(int fd);
+
+// Connects to a running process at path and takes its listening sockets.
+// Returns the control connection (pass it to fp_handoff_ack once serving),
+// or -1 with *count = 0 when nobody is listening there.
+int fp_handoff_request(const char *path, int *fds, size_t max_fds, size_t *count);
+void fp_handoff_ack(int control_fd);
+
+// The halves of the exchange, over an already connected AF_UNIX socket.
+int fp_handoff_send_fds(int fd, const int *fds, size_t count);
+int fp_handoff_recv_fds(int fd, int *fds, size_t max_fds, size_t *count);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FP_HTTP_MAX_HEADERS 64
+
+typedef enum {
+    FP_HTTP_PARSE_INCOMPLETE = 0,
+    FP_HTTP_PARSE_DONE,
+    FP_HTTP_PARSE_MALFORMED, // answer 400
+    FP_HTTP_PARSE_TOO_LARGE, // answer 431: head longer than max_len or too many fields
+} fp_http_parse_status;
+
+// A run of bytes in the buffer being parsed, kept as an offset so the buffer
+// may be reallocated while the head is still arriving.
+typedef struct {
+    size_t offset;
+    size_t len;
+} fp_http_span;
+
+typedef struct {
+    fp_http_span name;
+    fp_http_span value; // without surrounding whitespace
+} fp_http_header;
+
+// Resumable parser for an HTTP/1.x request head. Each feed only looks at
+// bytes that arrived since the previous one, and nothing is copied: the
+// request line and fields are recorded as spans into the caller's buffer.
+typedef struct {
+    int state;
+    size_t cursor;   // next byte to examine
+    size_t max_len;
+    size_t mark;     // start of the token being read
+    size_t value_end;
+    fp_http_span method;
+    fp_http_span target;
+    fp_http_span version;
+    fp_http_header headers[FP_HTTP_MAX_HEADERS];
+    size_t header_count;
+    size_t head_len; // bytes up to and including the blank line, once DONE
+} fp_http_parser;
+
+void fp_http_parser_init(fp_http_parser *parser, size_t max_len);
+
+// buf[0, len) is everything buffered so far for this request; buf may move
+// between calls but its earlier bytes must not change. Errors are sticky.
+fp_http_parse_status fp_http_parser_feed(fp_http_parser *parser, const char *buf, size_t len);
+
+// Case-insensitive comparison of a span with a lowercase literal.
+bool fp_http_span_equals(const char *buf, fp_http_span span, const char *literal);
+
+// Copies a span as a NUL-terminated string, truncating it to fit out.
+void fp_http_span_copy(const char *buf, fp_http_span span, char *out, size_t out_len);
+
+// Body length declared by a parsed head: 0 without a Content-Length field,
+// -1 when a value is not plain digits or repeated fields disagree (answer
+// 400; guessing would let a smuggled request desync a keep-alive stream).
+int fp_http_parser_content_length(const fp_http_parser *parser, const char *buf, size_t *length);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct fp_io_loop fp_io_loop;
+
+typedef void (*fp_io_handler)(fp_io_loop *loop, uint32_t events, void *ctx);
+typedef void (*fp_io_task_fn)(fp_io_loop *loop, void *arg);
+typedef void (*fp_io_tick_fn)(fp_io_loop *loop, uint64_t now_ms, void *ctx);
+
+// Registration record for one file descriptor. The owner embeds it in its own
+// state (e.g. a connection) and must keep it alive until fp_io_loop_remove.
+typedef struct {
+    int fd;
+    uint32_t events;
+    fp_io_handler handler;
+    void *ctx;
+} fp_io_watch;
+
+fp_io_loop *fp_io_loop_create(unsigned index, int tick_ms, fp_io_tick_fn tick, void *tick_ctx);
+int fp_io_loop_start(fp_io_loop *loop);
+void fp_io_loop_stop(fp_io_loop *loop);
+// Binds a started loop's thread to one CPU.
+int fp_io_loop_pin(fp_io_loop *loop, unsigned cpu);
+void fp_io_loop_destroy(fp_io_loop *loop);
+
+int fp_io_loop_add(fp_io_loop *loop, fp_io_watch *watch, uint32_t events);
+int fp_io_loop_modify(fp_io_loop *loop, fp_io_watch *watch, uint32_t events);
+void fp_io_loop_remove(fp_io_loop *loop, fp_io_watch *watch);
+
+// Task node for fp_io_loop_post_task. The poster embeds it in the state the
+// task works on, so queuing needs no allocation and cannot fail. A node must
+// not be posted again before its task has started running.
+typedef struct fp_io_task {
+    fp_io_task_fn fn;
+    void *arg;
+    bool embedded; // owned by the poster; the loop frees the others
+    struct fp_io_task *next;
+} fp_io_task;
+
+// Thread-safe: queues fn(loop, arg) to run on the loop thread and wakes it.
+int fp_io_loop_post(fp_io_loop *loop, fp_io_task_fn fn, void *arg);
+// Same, with a caller-provided node that stays valid until fn runs.
+void fp_io_loop_post_task(fp_io_loop *loop, fp_io_task *task, fp_io_task_fn fn, void *arg);
+
+unsigned fp_io_loop_index(const fp_io_loop *loop);
+// True when called from the loop's own thread.
+bool fp_io_loop_is_current(const fp_io_loop *loop);
+uint64_t fp_io_loop_now_ms(const fp_io_loop *loop);
+void fp_io_loop_set_userdata(fp_io_loop *loop, void *userdata);
+void *fp_io_loop_userdata(const fp_io_loop *loop);
+uint64_t fp_io_monotonic_ms(void);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ferret.h"
+
+#define FP_MULTIPART_BOUNDARY_MAX 70 // RFC 2046 limit
+#define FP_MULTIPART_MAX_HEADER (16 * 1024)
+
+// A form field or file. data points into the request body; nothing is copied.
+typedef struct {
+    char name[64];
+    char filename[FP_FILENAME_MAX];
+    char content_type[128];
+    const uint8_t *data;
+    size_t size;
+} fp_form_part;
+
+// Single-pass multipart/form-data scanner. Delimiters are located with
+// Boyer-Moore-Horspool, so large file parts are skipped in strides close to
+// the delimiter length. The body must sit in one buffer that does not move
+// while it is fed, so parsing can run as the body arrives.
+typedef struct {
+    uint8_t delimiter[FP_MULTIPART_BOUNDARY_MAX + 4]; // "\r\n--" boundary
+    size_t delimiter_len;
+    size_t skip[256];
+    int state;
+    size_t cursor;     // next offset to examine
+    size_t part_start; // start of the current part's headers, then of its data
+    fp_form_part current;
+    fp_form_part *parts;
+    size_t max_parts;
+    size_t count;
+} fp_multipart_parser;
+
+// Extracts the boundary parameter of a multipart Content-Type.
+int fp_multipart_boundary(const char *content_type, char *boundary, size_t boundary_len);
+
+int fp_multipart_init(fp_multipart_parser *parser, const char *boundary, fp_form_part *parts, size_t max_parts);
+
+// Scans body[0, len): the bytes received so far. Call again with a larger len
+// as more arrive. Parts without a name are skipped and parts beyond max_parts
+// are dropped. Returns -1 once the body is malformed.
+int fp_multipart_feed(fp_multipart_parser *parser, const uint8_t *body, size_t len);
+
+// Call after the whole body was fed; fails unless the closing delimiter was seen.
+int fp_multipart_finish(const fp_multipart_parser *parser, size_t *out_count);
+
+// One-shot parse of a complete body.
+int fp_multipart_parse(const uint8_t *body, size_t len, const char *boundary, fp_form_part *parts, size_t max_parts,
+                       size_t *out_count);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ferret.h"
+
+// Immutable, reference-counted byte buffer. Readers hold a reference for as
+// long as they borrow data (e.g. until a socket write completes).
+typedef struct fp_blob fp_blob;
+
+fp_blob *fp_blob_create(uint8_t *data, size_t size); // takes ownership of data
+void fp_blob_retain(fp_blob *blob);
+void fp_blob_release(fp_blob *blob);
+const uint8_t *fp_blob_data(const fp_blob *blob);
+size_t fp_blob_size(const fp_blob *blob);
+
+// Encoded outputs parked for download at /api/jobs/{id}/outputs/{n}. An entry
+// lives until it is taken or its TTL passes; the bytes themselves live until
+// the last blob reference is dropped.
+typedef struct fp_output_store fp_output_store;
+
+typedef struct {
+    char format[8];
+    char label[32];
+    char mime[32];
+    char extension[8];
+} fp_output_meta;
+
+#define FP_OUTPUT_STORE_DEFAULT_TTL_MS 120000ULL
+#define FP_OUTPUT_STORE_MAX_BYTES (512ULL * 1024ULL * 1024ULL)
+
+fp_output_store *fp_output_store_create(uint64_t ttl_ms, size_t max_bytes);
+void fp_output_store_destroy(fp_output_store *store);
+
+// Moves output->data into the store (output->data becomes NULL, size is kept).
+// Fails without touching output when the store is over its byte budget.
+int fp_output_store_put(fp_output_store *store, uint64_t job_id, size_t index, fp_encoded_image *output);
+
+// Removes the entry and returns its blob with a reference the caller must release.
+fp_blob *fp_output_store_take(fp_output_store *store, uint64_t job_id, size_t index, fp_output_meta *meta);
+
+void fp_output_store_drop_job(fp_output_store *store, uint64_t job_id);
+size_t fp_output_store_expire(fp_output_store *store);
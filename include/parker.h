@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// Futex parking for consumers of lock-free structures. A consumer takes a
+// key with fp_parker_prepare, checks its structure once more, then either
+// cancels or parks with the key; a producer calls fp_parker_wake after
+// publishing. A wake that lands between prepare and park makes the park
+// return at once, so no wake-up is lost.
+typedef struct {
+    _Atomic uint32_t seq;     // futex word, bumped by every wake
+    _Atomic uint32_t waiters; // consumers between prepare and the end of their park
+} fp_parker;
+
+void fp_parker_init(fp_parker *parker);
+uint32_t fp_parker_prepare(fp_parker *parker);
+void fp_parker_cancel(fp_parker *parker);
+// Sleeps until a wake or the CLOCK_MONOTONIC deadline (NULL waits forever).
+// Returns -1 with errno ETIMEDOUT once the deadline passed, 0 otherwise
+// (including spurious returns; the caller re-checks).
+int fp_parker_park(fp_parker *parker, uint32_t key, const struct timespec *deadline);
+// Wakes up to count parked consumers; cheap when nobody waits.
+void fp_parker_wake(fp_parker *parker, int count);
+// Fills deadline with now + timeout_ms on CLOCK_MONOTONIC.
+void fp_parker_deadline(struct timespec *deadline, int timeout_ms);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+// Recycles fixed-size allocations so hot paths skip malloc once warmed up.
+// Freed objects are kept on an intrusive free list up to max_cached and
+// handed out again by fp_pool_get; beyond that they go back to the allocator.
+// Not thread-safe: each I/O loop owns its pools and only touches them from
+// its own thread.
+typedef struct fp_pool fp_pool;
+
+fp_pool *fp_pool_create(size_t object_size, size_t max_cached);
+void fp_pool_destroy(fp_pool *pool); // frees cached objects; outstanding ones stay valid
+
+// Returns uninitialised memory of object_size bytes, or NULL when out of memory.
+void *fp_pool_get(fp_pool *pool);
+// object must come from fp_pool_get on this pool, or be NULL.
+void fp_pool_put(fp_pool *pool, void *object);
+
+size_t fp_pool_object_size(const fp_pool *pool);
+size_t fp_pool_cached(const fp_pool *pool);
@@ -11,16 +11,28 @@ typedef enum {
     FP_PROGRESS_EVENT_STATUS = 1,
 } fp_progress_event_type;
 
+// Per-channel backlog bound. Result events past either limit are dropped (and
+// counted) instead of queued; status events are always kept, and a single
+// oversized result is still accepted into an empty backlog. Consumers that
+// fall behind still get every output in the job's HTTP response.
+#define FP_PROGRESS_MAX_PENDING_EVENTS 16
+#define FP_PROGRESS_MAX_PENDING_BYTES (32 * 1024 * 1024)
+
 typedef struct fp_progress_event {
     fp_progress_event_type type;
     char event_name[16];
     char *payload;
+    size_t payload_len;
     struct fp_progress_event *next;
 } fp_progress_event;
 
 typedef struct fp_progress_channel fp_progress_channel;
 typedef struct fp_progress_registry fp_progress_registry;
 
+// Invoked with the channel lock held whenever an event is pushed or the channel
+// closes; implementations must only hand off work (e.g. post to an I/O loop).
+typedef void (*fp_progress_listener)(fp_progress_channel *channel, void *ctx);
+
 fp_progress_registry *fp_progress_registry_create(size_t capacity);
 void fp_progress_registry_destroy(fp_progress_registry *registry);
 
@@ -29,13 +41,19 @@ fp_progress_channel *fp_progress_acquire(fp_progress_registry *registry, uint64_
 void fp_progress_retain(fp_progress_channel *channel);
 void fp_progress_release(fp_progress_channel *channel);
 
+// With url set the event references the bytes (already moved to the output
+// store) instead of inlining them as base64.
 int fp_progress_emit_output(fp_progress_channel *channel,
                             const fp_encoded_image *output,
+                            const char *url,
                             size_t input_size,
                             double duration_ms,
                             double avg_duration_ms);
 int fp_progress_emit_status(fp_progress_channel *channel, const char *status, const char *message, double duration_ms, size_t input_size);
 void fp_progress_close(fp_progress_channel *channel);
 
-fp_progress_event *fp_progress_next_event(fp_progress_channel *channel, bool *is_open);
+void fp_progress_set_listener(fp_progress_channel *channel, fp_progress_listener listener, void *ctx);
+fp_progress_event *fp_progress_poll_event(fp_progress_channel *channel, bool *is_open);
+// Returns how many result events were dropped since the last call and resets the count.
+size_t fp_progress_take_dropped(fp_progress_channel *channel);
 void fp_progress_event_free(fp_progress_event *event);
@@ -1,22 +1,38 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdatomic.h>
+#include "parker.h"
 
 typedef struct {
     _Atomic size_t seq;
     void *data;
 } fp_queue_slot;
 
+#define FP_QUEUE_CACHE_LINE 64
+
+// head and tail sit on separate cache lines so consumers and producers do not
+// invalidate each other's line on every operation.
 typedef struct {
     size_t capacity;
     fp_queue_slot *slots;
-    _Atomic size_t head;
-    _Atomic size_t tail;
+    _Alignas(FP_QUEUE_CACHE_LINE) _Atomic size_t head;
+    _Alignas(FP_QUEUE_CACHE_LINE) _Atomic size_t tail;
+    _Alignas(FP_QUEUE_CACHE_LINE) fp_parker parker; // consumers blocked in fp_queue_pop_wait
+    atomic_bool closed;
 } fp_queue;
 
 fp_queue *fp_queue_create(size_t capacity);
 void fp_queue_destroy(fp_queue *queue);
 int fp_queue_push(fp_queue *queue, void *data);
 void *fp_queue_pop(fp_queue *queue);
+// Like fp_queue_pop, but when the queue is empty spins briefly and then
+// parks until a push wakes it (one consumer per push), timeout_ms passes
+// (< 0 waits indefinitely) or the queue is closed. Returns NULL on timeout
+// or once the queue is closed and empty.
+void *fp_queue_pop_wait(fp_queue *queue, int timeout_ms);
+// Wakes every parked consumer; later waits return NULL once the queue is empty.
+void fp_queue_close(fp_queue *queue);
 
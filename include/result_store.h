@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ferret.h"
+
+// Results of jobs submitted through POST /api/jobs. A job is reserved when it
+// is queued and completed by the worker; finished results stay readable until
+// their TTL passes or newer results push them out of the job/byte budget.
+typedef struct fp_result_store fp_result_store;
+
+// A finished result shared between the store and readers (e.g. a socket write
+// borrowing output bytes). fp_stored_result_get returns NULL when the worker
+// could not produce a result at all.
+typedef struct fp_stored_result fp_stored_result;
+
+// One-shot notification registered on a pending job; see fp_result_store_lookup.
+typedef struct fp_result_watch fp_result_watch;
+typedef void (*fp_result_watch_fn)(void *ctx);
+
+typedef enum {
+    FP_JOB_UNKNOWN = 0,
+    FP_JOB_PENDING,
+    FP_JOB_DONE,
+} fp_job_state;
+
+#define FP_RESULT_STORE_DEFAULT_TTL_MS 600000ULL
+#define FP_RESULT_STORE_DEFAULT_MAX_JOBS 4096
+#define FP_RESULT_STORE_MAX_BYTES (512ULL * 1024ULL * 1024ULL)
+
+fp_result_store *fp_result_store_create(size_t max_jobs, uint64_t ttl_ms, size_t max_bytes);
+void fp_result_store_destroy(fp_result_store *store);
+
+// Registers job_id as pending. Fails when the id is already known or every
+// slot holds a pending job (finished ones are evicted oldest first).
+int fp_result_store_reserve(fp_result_store *store, uint64_t job_id);
+
+// Forgets a pending job that never made it to a worker.
+void fp_result_store_cancel(fp_result_store *store, uint64_t job_id);
+
+// Stores the finished result (taking ownership; NULL is allowed) under the
+// upload's filename and fires the job's watches on the calling thread.
+void fp_result_store_complete(fp_result_store *store, uint64_t job_id, const char *filename, fp_result *result);
+
+// For FP_JOB_DONE, *out receives a reference the caller must release. For
+// FP_JOB_PENDING with fn set, fn(ctx) is registered to run once the job
+// completes and *watch_out identifies it for fp_result_store_unwatch.
+fp_job_state fp_result_store_lookup(fp_result_store *store,
+                                    uint64_t job_id,
+                                    fp_stored_result **out,
+                                    fp_result_watch_fn fn,
+                                    void *ctx,
+                                    fp_result_watch **watch_out);
+
+// Returns false if the watch already fired (its callback has run or is running).
+bool fp_result_store_unwatch(fp_result_store *store, fp_result_watch *watch);
+
+size_t fp_result_store_expire(fp_result_store *store);
+
+const fp_result *fp_stored_result_get(const fp_stored_result *stored);
+const char *fp_stored_result_filename(const fp_stored_result *stored);
+void fp_stored_result_retain(fp_stored_result *stored);
+void fp_stored_result_release(fp_stored_result *stored);
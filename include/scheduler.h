@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ferret.h"
+#include "parker.h"
+
+// Weighted shares of the workers per class while every class has work:
+// out of 15 dequeues, 8 go to interactive retunes, 4 to expert, 2 to free
+// and 1 to bulk jobs. An idle class's share goes to the others.
+#define FP_SCHED_WEIGHT_INTERACTIVE 8
+#define FP_SCHED_WEIGHT_EXPERT 4
+#define FP_SCHED_WEIGHT_FREE 2
+#define FP_SCHED_WEIGHT_BULK 1
+#define FP_SCHED_DEFAULT_AGING_MS 2000
+#define FP_SCHED_DEFAULT_SPJF_WINDOW_MS 5000
+
+// Dispatches jobs from one queue per fp_job_class. Workers pick the class by
+// a weighted round robin; a class that has waited longer than aging_ms since
+// it was last served goes first, so none starves. Within a class the job
+// with the shortest predicted run time (fp_job.predicted_ms) goes first, but
+// a job is only overtaken by jobs queued less than spjf_window_ms after it.
+//
+// The queues are split into lanes, one per worker, which pushes fill round
+// robin. The class to serve is picked over all lanes; a worker then takes a
+// job of that class from its own lane and steals one from the others only
+// when its own has none, so workers mostly stay off each other's cache lines.
+typedef struct fp_scheduler fp_scheduler;
+
+// capacity is per class, spread over the lanes; zero aging_ms /
+// spjf_window_ms take the defaults.
+fp_scheduler *fp_scheduler_create(size_t capacity, uint64_t aging_ms, uint64_t spjf_window_ms, size_t lanes);
+void fp_scheduler_destroy(fp_scheduler *scheduler);
+
+// Queues job in its job_class; -1 with EAGAIN when that class is full in every lane.
+int fp_scheduler_push(fp_scheduler *scheduler, fp_job *job);
+// Takes the next job for the worker owning lane, from another lane when its own
+// has none of the class due.
+fp_job *fp_scheduler_pop(fp_scheduler *scheduler, size_t lane);
+// Parks until a job arrives, timeout_ms passes (< 0 waits indefinitely) or
+// the scheduler is closed; NULL on timeout or once closed and empty.
+fp_job *fp_scheduler_pop_wait(fp_scheduler *scheduler, size_t lane, int timeout_ms);
+void fp_scheduler_close(fp_scheduler *scheduler);
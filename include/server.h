@@ -1,11 +1,36 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
-#include "queue.h"
+#include <stdint.h>
+#include "scheduler.h"
 #include "progress.h"
 #include "auth.h"
+#include "output_store.h"
+#include "result_store.h"
+#include "admission.h"
 
-int fp_server_run(const char *host, int port, size_t worker_count,
-                  fp_queue *job_queue, fp_queue *result_queue,
+typedef struct {
+    const char *host;
+    int port;
+    size_t worker_count;
+    size_t io_threads;             // epoll loops serving client connections
+    int listen_backlog;            // pending-connection queue per listener; 0 = SOMAXCONN
+    bool reuseport;                // one SO_REUSEPORT listener per I/O loop instead of a shared one
+    bool pin_io_threads;           // bind I/O loop i to CPU i (mod online CPUs)
+    const char *unix_socket;       // also serve HTTP on this AF_UNIX path; NULL or "" to skip
+    const char *handoff_socket;    // pass listeners to/take them from another process here; NULL or "" to skip
+    uint64_t drain_timeout_ms;     // after a handoff, exit at the latest this long later; 0 waits for all jobs
+    uint64_t idle_timeout_ms;      // close keep-alive/stalled connections after this long; 0 disables
+    unsigned max_requests_per_conn; // requests served before a keep-alive connection is closed; 0 = unlimited
+    bool static_cache;              // preload public/ into memory with gzip/brotli variants
+    fp_admission_limits admission[FP_ADMIT_CLASS_COUNT]; // per route class; zero fields take the defaults
+    double eta_ms_per_unit;         // seed for the admission cost estimate; 0 uses a built-in guess
+} fp_server_config;
+
+int fp_server_run(const fp_server_config *config,
+                  fp_scheduler *job_queue,
                   fp_progress_registry *progress_registry,
+                  fp_output_store *output_store,
+                  fp_result_store *result_store,
                   fp_auth_store *auth_store);
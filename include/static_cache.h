@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// One stored representation of an asset. encoding is NULL for the identity
+// body, otherwise the Content-Encoding token ("gzip", "br").
+typedef struct {
+    const char *encoding;
+    uint8_t *data;
+    size_t size;
+    char etag[32];
+} fp_static_variant;
+
+typedef struct {
+    char path[256]; // relative to the public root, e.g. "assets/logo.png"
+    const char *mime;
+    char last_modified[32];
+    fp_static_variant identity;
+    fp_static_variant gzip;   // size == 0 when not worth compressing
+    fp_static_variant brotli; // size == 0 when not worth compressing
+} fp_static_asset;
+
+typedef struct fp_static_cache fp_static_cache;
+
+// Reads every regular file under root (skipping dotfiles and files larger than
+// FP_STATIC_CACHE_MAX_FILE) and precompresses text assets. The cache is
+// immutable afterwards, so lookups need no locking and the variant buffers
+// stay valid until fp_static_cache_destroy.
+fp_static_cache *fp_static_cache_load(const char *root);
+void fp_static_cache_destroy(fp_static_cache *cache);
+const fp_static_asset *fp_static_cache_find(const fp_static_cache *cache, const char *path);
+size_t fp_static_cache_count(const fp_static_cache *cache);
+size_t fp_static_cache_bytes(const fp_static_cache *cache);
+
+// Picks the smallest variant the client's Accept-Encoding allows.
+const fp_static_variant *fp_static_pick_variant(const fp_static_asset *asset, const char *accept_encoding);
+
+// True when an If-None-Match header lists etag (or "*"); weak tags compare equal.
+bool fp_static_etag_matches(const char *if_none_match, const char *etag);
+
+const char *fp_static_mime_type(const char *path);
+void fp_static_format_http_date(time_t when, char *out, size_t out_len);
+
+#define FP_STATIC_CACHE_MAX_FILE (2 * 1024 * 1024)
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Long-lived threads that run the encode tasks of every job. Each submitter
+// (a job worker) owns a deque: it pushes its tasks there and, while waiting
+// for them, pops them back itself; pool threads steal from the other end of
+// any submitter's deque. Pool threads plus submitters are capped at the
+// online CPUs, so at most that many encodes run at once.
+typedef struct fp_task_pool fp_task_pool;
+
+typedef void (*fp_task_fn)(void *arg);
+
+// Counts the unfinished tasks one submitter waits for.
+typedef struct {
+    atomic_size_t pending;
+} fp_task_group;
+
+// Caller-owned; must stay valid until fp_task_pool_wait returns for its group.
+typedef struct {
+    fp_task_fn fn;
+    void *arg;
+    fp_task_group *group;
+} fp_task;
+
+// threads == 0 (or more than the budget) uses one per online CPU not taken by a
+// submitter, and at least one.
+fp_task_pool *fp_task_pool_create(size_t threads, size_t submitters);
+void fp_task_pool_destroy(fp_task_pool *pool); // queued tasks must have been waited for
+size_t fp_task_pool_threads(const fp_task_pool *pool);
+
+// Queues task on submitter's deque. Returns -1 when the deque is full; the
+// caller then runs the task itself.
+int fp_task_pool_submit(fp_task_pool *pool, size_t submitter, fp_task *task);
+// Runs the submitter's own queued tasks, then blocks until the pool threads
+// have finished the ones they stole.
+void fp_task_pool_wait(fp_task_pool *pool, size_t submitter, fp_task_group *group);
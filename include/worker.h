@@ -4,16 +4,29 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 #include "ferret.h"
-#include "queue.h"
+#include "scheduler.h"
 #include "progress.h"
+#include "task_pool.h"
 
 typedef struct {
-    fp_queue *job_queue;
-    fp_queue *result_queue;
+    fp_scheduler *job_queue;
     fp_progress_registry *progress_registry;
+    fp_task_pool *task_pool; // shared by all workers; each submits on deque `index`
+    size_t index;            // also the job_queue lane this worker serves first
     atomic_bool running;
     pthread_t thread;
 } fp_worker;
 
-fp_worker *fp_workers_create(size_t count, fp_queue *job_queue, fp_queue *result_queue, fp_progress_registry *progress_registry);
+// task_pool must have been created with at least count submitters, and
+// job_queue with count lanes.
+fp_worker *fp_workers_create(size_t count, fp_scheduler *job_queue, fp_progress_registry *progress_registry,
+                             fp_task_pool *task_pool);
+// Closes job_queue to wake idle workers, then joins them.
 void fp_workers_destroy(fp_worker *workers, size_t count);
+
+// Encode cost per megapixel of the slowest output format seen so far (outputs
+// are encoded in parallel, so it bounds a job's run time); 0 before any sample.
+double fp_worker_eta_ms_per_unit(void);
+// Predicted run time of job before it is decoded: work_units megapixels (from
+// the IHDR) times the learned per-megapixel cost of its slowest output.
+double fp_worker_predict_ms(const fp_job *job, double work_units);
@@ -419,6 +419,7 @@ async function upload(file, jobId) {
       headers: {
         'Content-Type': 'application/octet-stream',
         'X-Filename': file.name,
+        'X-Progress-Mode': 'reference',
         ...(jobId ? { 'X-Job-ID': String(jobId) } : {}),
       },
       body: payloadBuffer,
@@ -487,6 +488,7 @@ function subscribeToJob(jobId) {
   source.onopen = () => appendLog(`stream open for <span>#${jobId}</span>`);
   source.addEventListener('result', handleStreamResult);
   source.addEventListener('status', handleStreamStatus);
+  source.addEventListener('lagged', handleStreamLagged);
   source.onerror = () => {
     if (source.readyState === EventSource.CLOSED) {
       closeEventStream();
@@ -521,6 +523,12 @@ function handleStreamResult(event) {
   updateEtaStore(payload);
 }
 
+function handleStreamLagged(event) {
+  const payload = parseEventPayload(event);
+  const dropped = payload?.dropped || 0;
+  appendLog(`stream skipped <span>${dropped}</span> preview(s); results arrive with the response.`);
+}
+
 function handleStreamStatus(event) {
   const payload = parseEventPayload(event);
   if (!payload || payload.jobId !== currentJobContext?.jobId) {
@@ -809,16 +817,21 @@ function populateResultCard(result, baselineBytes, filename) {
   entry.meta.textContent = metaLine;
   entry.titleEl.title = formatResultTooltip(result, baselineBytes);
 
-  const dataUri = `data:${result.mime};base64,${result.data}`;
   entry.preview.classList.remove('loading');
   entry.previewStage.innerHTML = '';
   const img = document.createElement('img');
-  img.src = dataUri;
   img.alt = `${result.format} preview`;
   img.loading = 'lazy';
   entry.previewStage.appendChild(img);
 
-  entry.download.href = dataUri;
+  resolveResultSource(result)
+    .then((source) => {
+      img.src = source;
+      entry.download.href = source;
+    })
+    .catch((error) => {
+      appendLog(`error → ${error.message || error}`);
+    });
   entry.download.download = resolveDownloadName(filename, result.extension || result.format);
   entry.download.textContent = 'Download';
   entry.download.classList.remove('disabled');
@@ -858,6 +871,30 @@ function populateResultCard(result, baselineBytes, filename) {
   }
 }
 
+// Reference-mode results carry a one-shot download URL instead of base64 data;
+// the bytes are fetched once and shared by the stream event, the final
+// response and later reverts.
+const resultSources = new Map();
+
+function resolveResultSource(result) {
+  if (!result.url) {
+    return Promise.resolve(`data:${result.mime};base64,${result.data || ''}`);
+  }
+  if (!resultSources.has(result.url)) {
+    const pending = fetch(result.url)
+      .then((response) => {
+        if (!response.ok) {
+          throw new Error(`Output download failed (${response.status})`);
+        }
+        return response.blob();
+      })
+      .then((blob) => URL.createObjectURL(blob));
+    pending.catch(() => resultSources.delete(result.url));
+    resultSources.set(result.url, pending);
+  }
+  return resultSources.get(result.url);
+}
+
 function resolveDownloadName(filename, extension) {
   const base = filename ? filename.replace(/\.[^.]+$/, '') : 'compressed';
   const safeExtension = extension || 'img';
@@ -1054,6 +1091,7 @@ async function handleCompressionFeedback(direction, descriptor = {}) {
       headers: {
         'Content-Type': 'application/octet-stream',
         'X-Filename': originalFile.name,
+        'X-Progress-Mode': 'reference',
         'X-Job-ID': String(jobId),
         'X-Tune-Format': descriptor.format,
         ...(descriptor.label ? { 'X-Tune-Label': descriptor.label } : {}),
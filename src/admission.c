@@ -0,0 +1,154 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "admission.h"
+
+#define FP_ADMISSION_COST_WEIGHT 0.2 // EWMA weight of a new per-unit cost sample
+
+struct fp_admission {
+    pthread_mutex_t mutex;
+    pthread_cond_t idle; // signalled when the last admitted job is released
+    size_t worker_count;
+    double ms_per_unit;
+    double backlog_units; // admitted work not yet released, all classes
+    size_t backlog_jobs;
+    size_t jobs[FP_ADMIT_CLASS_COUNT];
+    fp_admission_limits limits[FP_ADMIT_CLASS_COUNT];
+};
+
+fp_admission *fp_admission_create(size_t worker_count, double ms_per_unit, const fp_admission_limits *limits) {
+    fp_admission *admission = calloc(1, sizeof(fp_admission));
+    if (!admission) {
+        return NULL;
+    }
+    pthread_mutex_init(&admission->mutex, NULL);
+    pthread_cond_init(&admission->idle, NULL);
+    admission->worker_count = worker_count > 0 ? worker_count : 1;
+    admission->ms_per_unit = ms_per_unit > 0.0 ? ms_per_unit : FP_ADMISSION_DEFAULT_MS_PER_UNIT;
+    admission->limits[FP_ADMIT_FREE] = (fp_admission_limits){FP_ADMISSION_FREE_MAX_JOBS, FP_ADMISSION_FREE_MAX_WAIT_MS};
+    admission->limits[FP_ADMIT_EXPERT] =
+        (fp_admission_limits){FP_ADMISSION_EXPERT_MAX_JOBS, FP_ADMISSION_EXPERT_MAX_WAIT_MS};
+    for (size_t i = 0; limits && i < FP_ADMIT_CLASS_COUNT; ++i) {
+        if (limits[i].max_jobs > 0) {
+            admission->limits[i].max_jobs = limits[i].max_jobs;
+        }
+        if (limits[i].max_wait_ms > 0) {
+            admission->limits[i].max_wait_ms = limits[i].max_wait_ms;
+        }
+    }
+    return admission;
+}
+
+void fp_admission_destroy(fp_admission *admission) {
+    if (!admission) {
+        return;
+    }
+    pthread_cond_destroy(&admission->idle);
+    pthread_mutex_destroy(&admission->mutex);
+    free(admission);
+}
+
+static double fp_admission_wait_locked(const fp_admission *admission) {
+    return admission->backlog_units * admission->ms_per_unit / (double)admission->worker_count;
+}
+
+static unsigned fp_admission_seconds(double ms) {
+    double seconds = ms / 1000.0 + 0.999;
+    if (seconds < 1.0) {
+        return 1;
+    }
+    if (seconds > FP_ADMISSION_MAX_RETRY_AFTER_S) {
+        return FP_ADMISSION_MAX_RETRY_AFTER_S;
+    }
+    return (unsigned)seconds;
+}
+
+int fp_admission_try_admit(fp_admission *admission, fp_admit_class cls, double work_units, unsigned *retry_after_s) {
+    if (retry_after_s) {
+        *retry_after_s = 0;
+    }
+    if (!admission || cls >= FP_ADMIT_CLASS_COUNT) {
+        return 0;
+    }
+    pthread_mutex_lock(&admission->mutex);
+    const fp_admission_limits *limits = &admission->limits[cls];
+    double wait_ms = fp_admission_wait_locked(admission);
+    double retry_ms = 0.0;
+    if (admission->jobs[cls] >= limits->max_jobs) {
+        // A slot opens once the average admitted job has run.
+        retry_ms = admission->backlog_units / (double)admission->backlog_jobs * admission->ms_per_unit /
+                   (double)admission->worker_count;
+    } else if (wait_ms > (double)limits->max_wait_ms) {
+        retry_ms = wait_ms - (double)limits->max_wait_ms;
+    } else {
+        admission->jobs[cls]++;
+        admission->backlog_jobs++;
+        admission->backlog_units += work_units;
+        pthread_mutex_unlock(&admission->mutex);
+        return 0;
+    }
+    pthread_mutex_unlock(&admission->mutex);
+    if (retry_after_s) {
+        *retry_after_s = fp_admission_seconds(retry_ms);
+    }
+    return -1;
+}
+
+void fp_admission_release(fp_admission *admission, fp_admit_class cls, double work_units, double service_ms) {
+    if (!admission || cls >= FP_ADMIT_CLASS_COUNT) {
+        return;
+    }
+    pthread_mutex_lock(&admission->mutex);
+    if (admission->jobs[cls] > 0) {
+        admission->jobs[cls]--;
+        admission->backlog_jobs--;
+    }
+    admission->backlog_units -= work_units;
+    if (admission->backlog_jobs == 0 || admission->backlog_units < 0.0) {
+        admission->backlog_units = 0.0; // drop accumulated rounding error
+    }
+    if (admission->backlog_jobs == 0) {
+        pthread_cond_broadcast(&admission->idle);
+    }
+    if (service_ms > 0.0 && work_units > 0.0) {
+        double sample = service_ms / work_units;
+        admission->ms_per_unit += FP_ADMISSION_COST_WEIGHT * (sample - admission->ms_per_unit);
+    }
+    pthread_mutex_unlock(&admission->mutex);
+}
+
+const fp_admission_limits *fp_admission_limits_for(const fp_admission *admission, fp_admit_class cls) {
+    return &admission->limits[cls < FP_ADMIT_CLASS_COUNT ? cls : FP_ADMIT_FREE];
+}
+
+uint64_t fp_admission_wait_ms(fp_admission *admission) {
+    if (!admission) {
+        return 0;
+    }
+    pthread_mutex_lock(&admission->mutex);
+    double wait_ms = fp_admission_wait_locked(admission);
+    pthread_mutex_unlock(&admission->mutex);
+    return (uint64_t)wait_ms;
+}
+
+size_t fp_admission_jobs(fp_admission *admission) {
+    if (!admission) {
+        return 0;
+    }
+    pthread_mutex_lock(&admission->mutex);
+    size_t jobs = admission->backlog_jobs;
+    pthread_mutex_unlock(&admission->mutex);
+    return jobs;
+}
+
+void fp_admission_wait_idle(fp_admission *admission) {
+    if (!admission) {
+        return;
+    }
+    pthread_mutex_lock(&admission->mutex);
+    while (admission->backlog_jobs > 0) {
+        pthread_cond_wait(&admission->idle, &admission->mutex);
+    }
+    pthread_mutex_unlock(&admission->mutex);
+}
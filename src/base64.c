@@ -0,0 +1,193 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "base64.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FP_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+static const char fp_base64_table[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+size_t fp_base64_encoded_len(size_t len) {
+    return 4 * ((len + 2) / 3);
+}
+
+// Encodes whole triples plus the padded tail; the SIMD kernels finish with it.
+static size_t fp_base64_encode_scalar(const uint8_t *data, size_t len, char *out) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i + 2 < len) {
+        uint32_t triple = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        out[j++] = fp_base64_table[(triple >> 18) & 0x3F];
+        out[j++] = fp_base64_table[(triple >> 12) & 0x3F];
+        out[j++] = fp_base64_table[(triple >> 6) & 0x3F];
+        out[j++] = fp_base64_table[triple & 0x3F];
+        i += 3;
+    }
+    size_t remaining = len - i;
+    if (remaining == 1) {
+        uint32_t triple = (uint32_t)data[i] << 16;
+        out[j++] = fp_base64_table[(triple >> 18) & 0x3F];
+        out[j++] = fp_base64_table[(triple >> 12) & 0x3F];
+        out[j++] = '=';
+        out[j++] = '=';
+    } else if (remaining == 2) {
+        uint32_t triple = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8);
+        out[j++] = fp_base64_table[(triple >> 18) & 0x3F];
+        out[j++] = fp_base64_table[(triple >> 12) & 0x3F];
+        out[j++] = fp_base64_table[(triple >> 6) & 0x3F];
+        out[j++] = '=';
+    }
+    return j;
+}
+
+#ifdef FP_BASE64_X86
+
+// The SSSE3 and AVX2 kernels follow Muła's scheme: a byte shuffle spreads each
+// 3-byte group over a 32-bit lane, two multiplies move the four 6-bit fields
+// into separate bytes, and a pshufb table turns field values into ASCII by
+// adding a per-range offset.
+
+__attribute__((target("ssse3"))) static __m128i fp_base64_split_ssse3(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3"))) static __m128i fp_base64_ascii_ssse3(__m128i indices) {
+    // 0..25 -> 13 ('A' range), 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12.
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+}
+
+__attribute__((target("ssse3"))) static size_t fp_base64_encode_ssse3(const uint8_t *data, size_t len, char *out) {
+    size_t i = 0;
+    size_t j = 0;
+    // 12 input bytes per step, but each load reads 16.
+    while (len - i >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(data + i));
+        _mm_storeu_si128((__m128i *)(out + j), fp_base64_ascii_ssse3(fp_base64_split_ssse3(in)));
+        i += 12;
+        j += 16;
+    }
+    return j + fp_base64_encode_scalar(data + i, len - i, out + j);
+}
+
+__attribute__((target("avx2"))) static size_t fp_base64_encode_avx2(const uint8_t *data, size_t len, char *out) {
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    size_t j = 0;
+    // 24 input bytes per step as two 12-byte lanes; the upper load reads up to byte 28.
+    while (len - i >= 28) {
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(data + i))),
+                                             _mm_loadu_si128((const __m128i *)(data + i + 12)),
+                                             1);
+        in = _mm256_shuffle_epi8(in, shuffle);
+        const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        const __m256i ascii = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices);
+        _mm256_storeu_si256((__m256i *)(out + j), ascii);
+        i += 24;
+        j += 32;
+    }
+    return j + fp_base64_encode_scalar(data + i, len - i, out + j);
+}
+
+// VBMI does the whole job in three instructions: a byte permute gathers each
+// 3-byte group into a 64-bit lane, multishift extracts the four 6-bit fields,
+// and a second permute maps them through the 64-entry table.
+__attribute__((target("avx512f,avx512bw,avx512vbmi"))) static size_t fp_base64_encode_avx512vbmi(const uint8_t *data,
+                                                                                                size_t len,
+                                                                                                char *out) {
+    const __m512i gather = _mm512_setr_epi32(0x01020001, 0x04050304, 0x07080607, 0x0a0b090a, 0x0d0e0c0d, 0x10110f10,
+                                             0x13141213, 0x16171516, 0x191a1819, 0x1c1d1b1c, 0x1f201e1f, 0x22232122,
+                                             0x25262425, 0x28292728, 0x2b2c2a2b, 0x2e2f2d2e);
+    const __m512i fields = _mm512_set1_epi64(0x3036242a1016040aLL);
+    const __m512i table = _mm512_loadu_si512((const void *)fp_base64_table);
+    size_t i = 0;
+    size_t j = 0;
+    // 48 input bytes per step; the masked load never reads past them.
+    while (len - i >= 48) {
+        __m512i in = _mm512_maskz_loadu_epi8(0x0000ffffffffffffULL, data + i);
+        in = _mm512_permutexvar_epi8(gather, in);
+        const __m512i indices = _mm512_multishift_epi64_epi8(fields, in);
+        _mm512_storeu_si512((void *)(out + j), _mm512_permutexvar_epi8(indices, table));
+        i += 48;
+        j += 64;
+    }
+    return j + fp_base64_encode_scalar(data + i, len - i, out + j);
+}
+
+#endif
+
+static fp_base64_kernel g_base64_kernel = {"scalar", fp_base64_encode_scalar};
+static pthread_once_t g_base64_once = PTHREAD_ONCE_INIT;
+
+static void fp_base64_select(void) {
+    fp_base64_kernel kernels[4];
+    if (fp_base64_kernels(kernels, 4) > 0) {
+        g_base64_kernel = kernels[0];
+    }
+}
+
+size_t fp_base64_kernels(fp_base64_kernel *out, size_t max) {
+    size_t count = 0;
+#ifdef FP_BASE64_X86
+    __builtin_cpu_init();
+    if (count < max && __builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw")) {
+        out[count++] = (fp_base64_kernel){"avx512vbmi", fp_base64_encode_avx512vbmi};
+    }
+    if (count < max && __builtin_cpu_supports("avx2")) {
+        out[count++] = (fp_base64_kernel){"avx2", fp_base64_encode_avx2};
+    }
+    if (count < max && __builtin_cpu_supports("ssse3")) {
+        out[count++] = (fp_base64_kernel){"ssse3", fp_base64_encode_ssse3};
+    }
+#endif
+    if (count < max) {
+        out[count++] = (fp_base64_kernel){"scalar", fp_base64_encode_scalar};
+    }
+    return count;
+}
+
+const char *fp_base64_kernel_name(void) {
+    pthread_once(&g_base64_once, fp_base64_select);
+    return g_base64_kernel.name;
+}
+
+size_t fp_base64_encode_into(const uint8_t *data, size_t len, char *out) {
+    pthread_once(&g_base64_once, fp_base64_select);
+    return g_base64_kernel.encode(data, len, out);
+}
+
+char *fp_base64_encode(const uint8_t *data, size_t len) {
+    size_t encoded_len = fp_base64_encoded_len(len);
+    char *out = malloc(encoded_len + 1);
+    if (!out) {
+        return NULL;
+    }
+    fp_base64_encode_into(data, len, out);
+    out[encoded_len] = '\0';
+    return out;
+}
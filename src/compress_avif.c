@@ -5,10 +5,14 @@
 
 fp_compress_code fp_compress_avif(const fp_rgba_image *image,
                                   int quality,
+                                  const fp_cancel_token *cancel,
                                   fp_encoded_image *output) {
     if (!image || !output || !image->pixels) {
         return FP_COMPRESS_ENCODE_ERROR;
     }
+    if (fp_cancel_token_check(cancel) != FP_CANCEL_NONE) {
+        return FP_COMPRESS_CANCELLED;
+    }
 
     avifImage *avif = avifImageCreate(image->width, image->height, 8, AVIF_PIXEL_FORMAT_YUV420);
     if (!avif) {
@@ -28,6 +32,13 @@ fp_compress_code fp_compress_avif(const fp_rgba_image *image,
         return FP_COMPRESS_ENCODE_ERROR;
     }
 
+    // avifEncoderWrite cannot be interrupted; check once more before the
+    // expensive part and drop the result if the job was abandoned meanwhile.
+    if (fp_cancel_token_check(cancel) != FP_CANCEL_NONE) {
+        avifImageDestroy(avif);
+        return FP_COMPRESS_CANCELLED;
+    }
+
     avifEncoder *encoder = avifEncoderCreate();
     if (!encoder) {
         avifImageDestroy(avif);
@@ -35,7 +46,7 @@ fp_compress_code fp_compress_avif(const fp_rgba_image *image,
     }
 
     encoder->speed = 6;
-    encoder->maxThreads = 4;
+    encoder->maxThreads = 1; // encodes already run one per core on the task pool
     encoder->minQuantizer = quality;
     encoder->maxQuantizer = quality + 8;
     if (encoder->maxQuantizer > 63) {
@@ -44,11 +55,11 @@ fp_compress_code fp_compress_avif(const fp_rgba_image *image,
 
     avifRWData output_data = AVIF_DATA_EMPTY;
     avifResult encode_res = avifEncoderWrite(encoder, avif, &output_data);
-    if (encode_res != AVIF_RESULT_OK) {
+    if (encode_res != AVIF_RESULT_OK || fp_cancel_token_check(cancel) != FP_CANCEL_NONE) {
         avifRWDataFree(&output_data);
         avifEncoderDestroy(encoder);
         avifImageDestroy(avif);
-        return FP_COMPRESS_ENCODE_ERROR;
+        return encode_res == AVIF_RESULT_OK ? FP_COMPRESS_CANCELLED : FP_COMPRESS_ENCODE_ERROR;
     }
 
     size_t encoded_size = output_data.size;
@@ -63,6 +63,35 @@ static void fp_png_read_mem(png_structp png_ptr, png_bytep out, png_size_t len)
     src->offset += len;
 }
 
+// Requests 8-bit RGBA output whatever the source format, then refreshes info_ptr.
+static void fp_png_set_rgba_transforms(png_structp png_ptr, png_infop info_ptr, png_uint_32 *width, png_uint_32 *height) {
+    int bit_depth = 0;
+    int color_type = 0;
+    png_get_IHDR(png_ptr, info_ptr, width, height, &bit_depth, &color_type, NULL, NULL, NULL);
+
+    if (bit_depth == 16) {
+        png_set_strip_16(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+        png_set_tRNS_to_alpha(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_RGB || color_type == PNG_COLOR_TYPE_GRAY ||
+        color_type == PNG_COLOR_TYPE_PALETTE) {
+        png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+        png_set_gray_to_rgb(png_ptr);
+    }
+
+    png_read_update_info(png_ptr, info_ptr);
+}
+
 fp_compress_code fp_decode_png(const uint8_t *input, size_t size, fp_rgba_image *out_image) {
     if (!input || !out_image || size == 0) {
         return FP_COMPRESS_DECODE_ERROR;
@@ -95,31 +124,7 @@ fp_compress_code fp_decode_png(const uint8_t *input, size_t size, fp_rgba_image
 
     png_uint_32 width = 0;
     png_uint_32 height = 0;
-    int bit_depth = 0;
-    int color_type = 0;
-    png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, NULL, NULL, NULL);
-
-    if (bit_depth == 16) {
-        png_set_strip_16(png_ptr);
-    }
-    if (color_type == PNG_COLOR_TYPE_PALETTE) {
-        png_set_palette_to_rgb(png_ptr);
-    }
-    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
-        png_set_expand_gray_1_2_4_to_8(png_ptr);
-    }
-    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
-        png_set_tRNS_to_alpha(png_ptr);
-    }
-    if (color_type == PNG_COLOR_TYPE_RGB || color_type == PNG_COLOR_TYPE_GRAY ||
-        color_type == PNG_COLOR_TYPE_PALETTE) {
-        png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
-    }
-    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
-        png_set_gray_to_rgb(png_ptr);
-    }
-
-    png_read_update_info(png_ptr, info_ptr);
+    fp_png_set_rgba_transforms(png_ptr, info_ptr, &width, &height);
 
     png_size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr);
     size_t stride = (size_t)rowbytes;
@@ -157,6 +162,106 @@ fp_compress_code fp_decode_png(const uint8_t *input, size_t size, fp_rgba_image
     return FP_COMPRESS_OK;
 }
 
+struct fp_png_stream {
+    png_structp png_ptr;
+    png_infop info_ptr;
+    uint8_t *pixels;
+    size_t stride;
+    png_uint_32 width;
+    png_uint_32 height;
+    bool failed;
+    bool finished;
+};
+
+static void fp_png_stream_info(png_structp png_ptr, png_infop info_ptr) {
+    fp_png_stream *stream = (fp_png_stream *)png_get_progressive_ptr(png_ptr);
+    if (png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE) {
+        png_set_interlace_handling(png_ptr);
+    }
+    fp_png_set_rgba_transforms(png_ptr, info_ptr, &stream->width, &stream->height);
+
+    stream->stride = (size_t)png_get_rowbytes(png_ptr, info_ptr);
+    size_t total = stream->stride * (size_t)stream->height;
+    if (stream->height != 0 && total / (size_t)stream->height != stream->stride) {
+        png_error(png_ptr, "image too large");
+    }
+    // Zeroed so rows an interlaced pass has not reached yet combine cleanly.
+    stream->pixels = calloc(1, total);
+    if (!stream->pixels) {
+        png_error(png_ptr, "memory allocation failure");
+    }
+}
+
+static void fp_png_stream_row(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num, int pass) {
+    (void)pass;
+    fp_png_stream *stream = (fp_png_stream *)png_get_progressive_ptr(png_ptr);
+    if (!new_row || row_num >= stream->height) {
+        return;
+    }
+    png_progressive_combine_row(png_ptr, stream->pixels + (size_t)row_num * stream->stride, new_row);
+}
+
+static void fp_png_stream_end(png_structp png_ptr, png_infop info_ptr) {
+    (void)info_ptr;
+    fp_png_stream *stream = (fp_png_stream *)png_get_progressive_ptr(png_ptr);
+    stream->finished = true;
+}
+
+fp_png_stream *fp_png_stream_create(void) {
+    fp_png_stream *stream = calloc(1, sizeof(fp_png_stream));
+    if (!stream) {
+        return NULL;
+    }
+    stream->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!stream->png_ptr) {
+        free(stream);
+        return NULL;
+    }
+    stream->info_ptr = png_create_info_struct(stream->png_ptr);
+    if (!stream->info_ptr) {
+        png_destroy_read_struct(&stream->png_ptr, NULL, NULL);
+        free(stream);
+        return NULL;
+    }
+    png_set_progressive_read_fn(stream->png_ptr, stream, fp_png_stream_info, fp_png_stream_row, fp_png_stream_end);
+    return stream;
+}
+
+fp_compress_code fp_png_stream_feed(fp_png_stream *stream, const uint8_t *data, size_t size) {
+    if (!stream || stream->failed) {
+        return FP_COMPRESS_DECODE_ERROR;
+    }
+    if (size == 0 || stream->finished) {
+        return FP_COMPRESS_OK; // trailing bytes after IEND are ignored, as fp_decode_png does
+    }
+    if (setjmp(png_jmpbuf(stream->png_ptr))) {
+        stream->failed = true;
+        return FP_COMPRESS_DECODE_ERROR;
+    }
+    png_process_data(stream->png_ptr, stream->info_ptr, (png_bytep)data, size);
+    return FP_COMPRESS_OK;
+}
+
+fp_compress_code fp_png_stream_finish(fp_png_stream *stream, fp_rgba_image *out_image) {
+    if (!stream || !out_image || stream->failed || !stream->finished || !stream->pixels) {
+        return FP_COMPRESS_DECODE_ERROR;
+    }
+    out_image->pixels = stream->pixels;
+    out_image->width = (unsigned)stream->width;
+    out_image->height = (unsigned)stream->height;
+    stream->pixels = NULL;
+    return FP_COMPRESS_OK;
+}
+
+void fp_png_stream_destroy(fp_png_stream *stream) {
+    if (!stream) {
+        return;
+    }
+    png_destroy_read_struct(&stream->png_ptr, &stream->info_ptr, NULL);
+    free(stream->pixels);
+    free(stream);
+}
+
 void fp_rgba_image_free(fp_rgba_image *image) {
     if (!image) {
         return;
@@ -4,32 +4,57 @@
 #include <stdio.h>
 #include "compress.h"
 
+static int fp_webp_progress(int percent, const WebPPicture *picture) {
+    (void)percent;
+    return fp_cancel_token_check(picture->user_data) == FP_CANCEL_NONE;
+}
+
 fp_compress_code fp_compress_webp(const fp_rgba_image *image,
                                   int quality,
+                                  const fp_cancel_token *cancel,
                                   fp_encoded_image *output) {
     if (!image || !output || !image->pixels) {
         return FP_COMPRESS_ENCODE_ERROR;
     }
 
-    uint8_t *encoded = NULL;
-    size_t webp_size = WebPEncodeRGBA(image->pixels,
-                                      (int)image->width,
-                                      (int)image->height,
-                                      (int)image->width * 4,
-                                      (float)quality,
-                                      &encoded);
-    if (!webp_size || !encoded) {
+    WebPConfig config;
+    WebPPicture picture;
+    if (!WebPConfigPreset(&config, WEBP_PRESET_DEFAULT, (float)quality) || !WebPPictureInit(&picture)) {
+        return FP_COMPRESS_ENCODE_ERROR;
+    }
+    picture.use_argb = 1;
+    picture.width = (int)image->width;
+    picture.height = (int)image->height;
+    if (!WebPPictureImportRGBA(&picture, image->pixels, (int)image->width * 4)) {
+        WebPPictureFree(&picture);
         return FP_COMPRESS_ENCODE_ERROR;
     }
 
+    // The hook runs between encoder passes, so a cancelled job stops early.
+    WebPMemoryWriter writer;
+    WebPMemoryWriterInit(&writer);
+    picture.writer = WebPMemoryWrite;
+    picture.custom_ptr = &writer;
+    picture.progress_hook = cancel ? fp_webp_progress : NULL;
+    picture.user_data = (void *)cancel;
+
+    int encoded = WebPEncode(&config, &picture);
+    WebPEncodingError error = picture.error_code;
+    WebPPictureFree(&picture);
+    if (!encoded || !writer.size) {
+        WebPMemoryWriterClear(&writer);
+        return error == VP8_ENC_ERROR_USER_ABORT ? FP_COMPRESS_CANCELLED : FP_COMPRESS_ENCODE_ERROR;
+    }
+
+    size_t webp_size = writer.size;
     uint8_t *buffer = malloc(webp_size);
     if (!buffer) {
-        WebPFree(encoded);
+        WebPMemoryWriterClear(&writer);
         return FP_COMPRESS_ENCODE_ERROR;
     }
 
-    memcpy(buffer, encoded, webp_size);
-    WebPFree(encoded);
+    memcpy(buffer, writer.mem, webp_size);
+    WebPMemoryWriterClear(&writer);
 
     output->data = buffer;
     output->size = webp_size;
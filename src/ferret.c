@@ -1,6 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "ferret.h"
+#include "output_store.h"
 #include "progress.h"
 
 void fp_free_result(fp_result *result) {
@@ -18,11 +23,72 @@ void fp_free_job(fp_job *job) {
     if (!job) {
         return;
     }
-    free(job->data);
+    if (job->data_owner) {
+        fp_blob_release(job->data_owner);
+        job->data_owner = NULL;
+    } else {
+        free(job->data);
+    }
     job->data = NULL;
     job->size = 0;
+    free(job->decoded.pixels);
+    job->decoded.pixels = NULL;
     if (job->progress) {
         fp_progress_release(job->progress);
         job->progress = NULL;
     }
+    fp_cancel_token_release(job->cancel);
+    job->cancel = NULL;
+}
+
+struct fp_cancel_token {
+    _Atomic unsigned refs;
+    atomic_bool cancelled;
+    uint64_t deadline_ms;
+};
+
+fp_cancel_token *fp_cancel_token_create(uint64_t deadline_ms) {
+    fp_cancel_token *token = malloc(sizeof(fp_cancel_token));
+    if (!token) {
+        return NULL;
+    }
+    atomic_init(&token->refs, 1);
+    atomic_init(&token->cancelled, false);
+    token->deadline_ms = deadline_ms;
+    return token;
+}
+
+void fp_cancel_token_retain(fp_cancel_token *token) {
+    if (token) {
+        atomic_fetch_add_explicit(&token->refs, 1, memory_order_relaxed);
+    }
+}
+
+void fp_cancel_token_release(fp_cancel_token *token) {
+    if (token && atomic_fetch_sub_explicit(&token->refs, 1, memory_order_acq_rel) == 1) {
+        free(token);
+    }
+}
+
+void fp_cancel_token_cancel(fp_cancel_token *token) {
+    if (token) {
+        atomic_store_explicit(&token->cancelled, true, memory_order_relaxed);
+    }
+}
+
+fp_cancel_reason fp_cancel_token_check(const fp_cancel_token *token) {
+    if (!token) {
+        return FP_CANCEL_NONE;
+    }
+    if (atomic_load_explicit(&token->cancelled, memory_order_relaxed)) {
+        return FP_CANCEL_ABANDONED;
+    }
+    if (token->deadline_ms > 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if ((uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL >= token->deadline_ms) {
+            return FP_CANCEL_DEADLINE;
+        }
+    }
+    return FP_CANCEL_NONE;
 }
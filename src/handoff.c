@@ -0,0 +1,192 @@
+#define _GNU_SOURCE // SCM_RIGHTS, CMSG_*, struct ucred
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "handoff.h"
+
+#define FP_HANDOFF_MAGIC 0x46504831u // "FPH1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+} fp_handoff_header;
+
+static int fp_handoff_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (!path || strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(addr->sun_path, path, strlen(path) + 1);
+    return 0;
+}
+
+int fp_handoff_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (fp_handoff_address(path, &addr) != 0) {
+        return -1;
+    }
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            errno = EEXIST;
+            return -1;
+        }
+        unlink(path);
+    }
+    int fd = (int)socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // Whoever connects is handed the listening sockets, so only our user may:
+    // the mode is narrowed before listen(), when nobody can connect yet.
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0 ||
+        bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0 || chmod(path, S_IRUSR | S_IWUSR) != 0 ||
+        listen(fd, 4) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+bool fp_handoff_peer_trusted(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || len != sizeof(cred)) {
+        return false;
+    }
+    if (cred.uid != geteuid()) {
+        errno = EPERM;
+        return false;
+    }
+    return true;
+}
+
+int fp_handoff_send_fds(int fd, const int *fds, size_t count) {
+    if (count > FP_HANDOFF_MAX_FDS) {
+        errno = EINVAL;
+        return -1;
+    }
+    fp_handoff_header header = {FP_HANDOFF_MAGIC, (uint32_t)count};
+    struct iovec iov = {.iov_base = &header, .iov_len = sizeof(header)};
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * FP_HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (count > 0) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+    }
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t)sizeof(header) ? 0 : -1;
+}
+
+int fp_handoff_recv_fds(int fd, int *fds, size_t max_fds, size_t *count) {
+    *count = 0;
+    fp_handoff_header header = {0};
+    struct iovec iov = {.iov_base = &header, .iov_len = sizeof(header)};
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * FP_HANDOFF_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    ssize_t received;
+    do {
+        received = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received < 0) {
+        return -1;
+    }
+    size_t got = 0;
+    int *all = NULL;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            all = (int *)CMSG_DATA(cmsg);
+            got = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            break;
+        }
+    }
+    // Descriptors we cannot keep must still be closed, or they leak.
+    for (size_t i = 0; i < got; ++i) {
+        int received_fd;
+        memcpy(&received_fd, all + i, sizeof(int));
+        if (i < max_fds) {
+            fds[i] = received_fd;
+        } else {
+            close(received_fd);
+        }
+    }
+    *count = got < max_fds ? got : max_fds;
+    if (received != (ssize_t)sizeof(header) || header.magic != FP_HANDOFF_MAGIC || got != header.count ||
+        (msg.msg_flags & MSG_CTRUNC)) {
+        for (size_t i = 0; i < *count; ++i) {
+            close(fds[i]);
+        }
+        *count = 0;
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+int fp_handoff_request(const char *path, int *fds, size_t max_fds, size_t *count) {
+    *count = 0;
+    struct sockaddr_un addr;
+    if (fp_handoff_address(path, &addr) != 0) {
+        return -1;
+    }
+    int fd = (int)socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct timeval timeout = {5, 0}; // the old process answers from its event loop
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0 || !fp_handoff_peer_trusted(fd) ||
+        fp_handoff_recv_fds(fd, fds, max_fds, count) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+void fp_handoff_ack(int control_fd) {
+    if (control_fd < 0) {
+        return;
+    }
+    char ready = 1;
+    ssize_t wrote;
+    do {
+        wrote = send(control_fd, &ready, 1, MSG_NOSIGNAL);
+    } while (wrote < 0 && errno == EINTR);
+    close(control_fd);
+}
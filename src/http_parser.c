@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <strings.h>
+
+#include "http_parser.h"
+
+enum {
+    FP_HTTP_STATE_METHOD = 0,
+    FP_HTTP_STATE_TARGET,
+    FP_HTTP_STATE_VERSION,
+    FP_HTTP_STATE_LINE_LF,
+    FP_HTTP_STATE_FIELD_START,
+    FP_HTTP_STATE_NAME,
+    FP_HTTP_STATE_VALUE_START,
+    FP_HTTP_STATE_VALUE,
+    FP_HTTP_STATE_HEAD_LF,
+    FP_HTTP_STATE_DONE,
+    FP_HTTP_STATE_MALFORMED,
+    FP_HTTP_STATE_TOO_LARGE,
+};
+
+// RFC 9110 token characters, used for the method and field names.
+static bool fp_http_is_tchar(unsigned char c) {
+    if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+        return true;
+    }
+    return c != '\0' && strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
+void fp_http_parser_init(fp_http_parser *parser, size_t max_len) {
+    memset(parser, 0, sizeof(*parser));
+    parser->state = FP_HTTP_STATE_METHOD;
+    parser->max_len = max_len;
+}
+
+static fp_http_parse_status fp_http_parser_status(const fp_http_parser *parser) {
+    switch (parser->state) {
+        case FP_HTTP_STATE_DONE:
+            return FP_HTTP_PARSE_DONE;
+        case FP_HTTP_STATE_MALFORMED:
+            return FP_HTTP_PARSE_MALFORMED;
+        case FP_HTTP_STATE_TOO_LARGE:
+            return FP_HTTP_PARSE_TOO_LARGE;
+        default:
+            return FP_HTTP_PARSE_INCOMPLETE;
+    }
+}
+
+// Handles one byte; returns the next state.
+static int fp_http_parser_step(fp_http_parser *parser, const char *buf, unsigned char c) {
+    size_t at = parser->cursor;
+    switch (parser->state) {
+        case FP_HTTP_STATE_METHOD:
+            if ((c == '\r' || c == '\n') && at == parser->mark) {
+                parser->mark = at + 1; // stray line break left over from the previous request
+                return FP_HTTP_STATE_METHOD;
+            }
+            if (c == ' ' && at > parser->mark) {
+                parser->method = (fp_http_span){parser->mark, at - parser->mark};
+                parser->mark = at + 1;
+                return FP_HTTP_STATE_TARGET;
+            }
+            return fp_http_is_tchar(c) ? FP_HTTP_STATE_METHOD : FP_HTTP_STATE_MALFORMED;
+        case FP_HTTP_STATE_TARGET:
+            if (c == ' ' && at > parser->mark) {
+                parser->target = (fp_http_span){parser->mark, at - parser->mark};
+                parser->mark = at + 1;
+                return FP_HTTP_STATE_VERSION;
+            }
+            return c > ' ' && c != 0x7f ? FP_HTTP_STATE_TARGET : FP_HTTP_STATE_MALFORMED;
+        case FP_HTTP_STATE_VERSION:
+            if (c == '\r') {
+                parser->version = (fp_http_span){parser->mark, at - parser->mark};
+                if (parser->version.len != 8 || strncmp(buf + parser->mark, "HTTP/1.", 7) != 0) {
+                    return FP_HTTP_STATE_MALFORMED;
+                }
+                return FP_HTTP_STATE_LINE_LF;
+            }
+            return at - parser->mark < 8 && c > ' ' ? FP_HTTP_STATE_VERSION : FP_HTTP_STATE_MALFORMED;
+        case FP_HTTP_STATE_LINE_LF:
+            return c == '\n' ? FP_HTTP_STATE_FIELD_START : FP_HTTP_STATE_MALFORMED;
+        case FP_HTTP_STATE_FIELD_START:
+            if (c == '\r') {
+                return FP_HTTP_STATE_HEAD_LF;
+            }
+            // Folded continuation lines (leading whitespace) are refused too.
+            if (!fp_http_is_tchar(c)) {
+                return FP_HTTP_STATE_MALFORMED;
+            }
+            parser->mark = at;
+            return FP_HTTP_STATE_NAME;
+        case FP_HTTP_STATE_NAME:
+            if (c == ':') {
+                if (parser->header_count == FP_HTTP_MAX_HEADERS) {
+                    return FP_HTTP_STATE_TOO_LARGE;
+                }
+                parser->headers[parser->header_count].name = (fp_http_span){parser->mark, at - parser->mark};
+                parser->mark = at + 1;
+                parser->value_end = at + 1;
+                return FP_HTTP_STATE_VALUE_START;
+            }
+            return fp_http_is_tchar(c) ? FP_HTTP_STATE_NAME : FP_HTTP_STATE_MALFORMED;
+        case FP_HTTP_STATE_VALUE_START:
+        case FP_HTTP_STATE_VALUE:
+            if (c == '\r') {
+                parser->headers[parser->header_count++].value =
+                    (fp_http_span){parser->mark, parser->value_end - parser->mark};
+                return FP_HTTP_STATE_LINE_LF;
+            }
+            if (c == ' ' || c == '\t') {
+                if (parser->state == FP_HTTP_STATE_VALUE_START) {
+                    parser->mark = at + 1;
+                    parser->value_end = at + 1;
+                }
+                return parser->state;
+            }
+            if (c < ' ' || c == 0x7f) {
+                return FP_HTTP_STATE_MALFORMED;
+            }
+            parser->value_end = at + 1;
+            return FP_HTTP_STATE_VALUE;
+        case FP_HTTP_STATE_HEAD_LF:
+            if (c != '\n') {
+                return FP_HTTP_STATE_MALFORMED;
+            }
+            parser->head_len = at + 1;
+            return FP_HTTP_STATE_DONE;
+        default:
+            return parser->state;
+    }
+}
+
+fp_http_parse_status fp_http_parser_feed(fp_http_parser *parser, const char *buf, size_t len) {
+    while (parser->cursor < len && parser->state < FP_HTTP_STATE_DONE) {
+        if (parser->cursor >= parser->max_len) {
+            parser->state = FP_HTTP_STATE_TOO_LARGE;
+            break;
+        }
+        parser->state = fp_http_parser_step(parser, buf, (unsigned char)buf[parser->cursor]);
+        parser->cursor++;
+    }
+    return fp_http_parser_status(parser);
+}
+
+bool fp_http_span_equals(const char *buf, fp_http_span span, const char *literal) {
+    return strlen(literal) == span.len && strncasecmp(buf + span.offset, literal, span.len) == 0;
+}
+
+void fp_http_span_copy(const char *buf, fp_http_span span, char *out, size_t out_len) {
+    if (!out || out_len == 0) {
+        return;
+    }
+    size_t len = span.len < out_len - 1 ? span.len : out_len - 1;
+    memcpy(out, buf + span.offset, len);
+    out[len] = '\0';
+}
+
+int fp_http_parser_content_length(const fp_http_parser *parser, const char *buf, size_t *length) {
+    bool seen = false;
+    size_t declared = 0;
+    for (size_t i = 0; i < parser->header_count; ++i) {
+        if (!fp_http_span_equals(buf, parser->headers[i].name, "content-length")) {
+            continue;
+        }
+        fp_http_span span = parser->headers[i].value;
+        const char *value = buf + span.offset;
+        if (span.len == 0 || span.len > 15) {
+            return -1;
+        }
+        size_t value_len = 0;
+        for (size_t j = 0; j < span.len; ++j) {
+            if (value[j] < '0' || value[j] > '9') {
+                return -1;
+            }
+            value_len = value_len * 10 + (size_t)(value[j] - '0');
+        }
+        if (seen && value_len != declared) {
+            return -1;
+        }
+        seen = true;
+        declared = value_len;
+    }
+    *length = declared;
+    return 0;
+}
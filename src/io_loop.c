@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "io_loop.h"
+#include "log.h"
+
+#define FP_IO_MAX_EVENTS 64
+
+struct fp_io_loop {
+    unsigned index;
+    int epoll_fd;
+    int wake_fd;
+    int tick_ms;
+    fp_io_tick_fn tick;
+    void *tick_ctx;
+    void *userdata;
+    uint64_t now_ms;
+    uint64_t last_tick_ms;
+    atomic_bool running;
+    bool started;
+    pthread_t thread;
+    pthread_mutex_t task_mutex;
+    fp_io_task *task_head;
+    fp_io_task *task_tail;
+};
+
+uint64_t fp_io_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+fp_io_loop *fp_io_loop_create(unsigned index, int tick_ms, fp_io_tick_fn tick, void *tick_ctx) {
+    fp_io_loop *loop = calloc(1, sizeof(fp_io_loop));
+    if (!loop) {
+        return NULL;
+    }
+    loop->index = index;
+    loop->tick_ms = tick_ms > 0 ? tick_ms : 50;
+    loop->tick = tick;
+    loop->tick_ctx = tick_ctx;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->epoll_fd < 0 || loop->wake_fd < 0) {
+        if (loop->epoll_fd >= 0) {
+            close(loop->epoll_fd);
+        }
+        if (loop->wake_fd >= 0) {
+            close(loop->wake_fd);
+        }
+        free(loop);
+        return NULL;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // NULL marks the wake eventfd
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) != 0) {
+        close(loop->epoll_fd);
+        close(loop->wake_fd);
+        free(loop);
+        return NULL;
+    }
+    pthread_mutex_init(&loop->task_mutex, NULL);
+    loop->now_ms = fp_io_monotonic_ms();
+    loop->last_tick_ms = loop->now_ms;
+    return loop;
+}
+
+static void fp_io_loop_run_tasks(fp_io_loop *loop) {
+    uint64_t counter = 0;
+    while (read(loop->wake_fd, &counter, sizeof(counter)) > 0) {
+    }
+    pthread_mutex_lock(&loop->task_mutex);
+    fp_io_task *task = loop->task_head;
+    loop->task_head = NULL;
+    loop->task_tail = NULL;
+    pthread_mutex_unlock(&loop->task_mutex);
+    while (task) {
+        fp_io_task *next = task->next;
+        bool owned = !task->embedded; // an embedded node may be freed by its task
+        task->fn(loop, task->arg);
+        if (owned) {
+            free(task);
+        }
+        task = next;
+    }
+}
+
+static void *fp_io_loop_thread(void *arg) {
+    fp_io_loop *loop = (fp_io_loop *)arg;
+    struct epoll_event events[FP_IO_MAX_EVENTS];
+    while (atomic_load_explicit(&loop->running, memory_order_acquire)) {
+        int ready = epoll_wait(loop->epoll_fd, events, FP_IO_MAX_EVENTS, loop->tick_ms);
+        if (ready < 0 && errno != EINTR) {
+            fp_log_error("💥 epoll_wait failed on I/O loop %u: %s", loop->index, strerror(errno));
+            break;
+        }
+        loop->now_ms = fp_io_monotonic_ms();
+        bool woken = false;
+        for (int i = 0; i < ready; ++i) {
+            fp_io_watch *watch = (fp_io_watch *)events[i].data.ptr;
+            if (!watch) {
+                woken = true;
+                continue;
+            }
+            watch->handler(loop, events[i].events, watch->ctx);
+        }
+        // Tasks run after the batch so they may tear down watches that still
+        // have events pending in it.
+        if (woken) {
+            fp_io_loop_run_tasks(loop);
+        }
+        if (loop->tick && loop->now_ms - loop->last_tick_ms >= (uint64_t)loop->tick_ms) {
+            loop->last_tick_ms = loop->now_ms;
+            loop->tick(loop, loop->now_ms, loop->tick_ctx);
+        }
+    }
+    fp_io_loop_run_tasks(loop);
+    return NULL;
+}
+
+int fp_io_loop_start(fp_io_loop *loop) {
+    if (!loop || loop->started) {
+        return -1;
+    }
+    atomic_store_explicit(&loop->running, true, memory_order_release);
+    if (pthread_create(&loop->thread, NULL, fp_io_loop_thread, loop) != 0) {
+        atomic_store_explicit(&loop->running, false, memory_order_release);
+        return -1;
+    }
+    loop->started = true;
+    return 0;
+}
+
+bool fp_io_loop_is_current(const fp_io_loop *loop) {
+    return loop && loop->started && pthread_equal(pthread_self(), loop->thread);
+}
+
+int fp_io_loop_pin(fp_io_loop *loop, unsigned cpu) {
+    if (!loop || !loop->started) {
+        return -1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(loop->thread, sizeof(set), &set);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    return 0;
+}
+
+static void fp_io_loop_wake(fp_io_loop *loop) {
+    uint64_t one = 1;
+    ssize_t wrote = write(loop->wake_fd, &one, sizeof(one));
+    (void)wrote; // EAGAIN means the counter is already non-zero
+}
+
+void fp_io_loop_stop(fp_io_loop *loop) {
+    if (!loop || !loop->started) {
+        return;
+    }
+    atomic_store_explicit(&loop->running, false, memory_order_release);
+    fp_io_loop_wake(loop);
+    pthread_join(loop->thread, NULL);
+    loop->started = false;
+}
+
+void fp_io_loop_destroy(fp_io_loop *loop) {
+    if (!loop) {
+        return;
+    }
+    fp_io_loop_stop(loop);
+    fp_io_task *task = loop->task_head;
+    while (task) {
+        fp_io_task *next = task->next;
+        if (!task->embedded) {
+            free(task);
+        }
+        task = next;
+    }
+    pthread_mutex_destroy(&loop->task_mutex);
+    close(loop->epoll_fd);
+    close(loop->wake_fd);
+    free(loop);
+}
+
+int fp_io_loop_add(fp_io_loop *loop, fp_io_watch *watch, uint32_t events) {
+    if (!loop || !watch || watch->fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = watch;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, watch->fd, &ev) != 0) {
+        return -1;
+    }
+    watch->events = events;
+    return 0;
+}
+
+int fp_io_loop_modify(fp_io_loop *loop, fp_io_watch *watch, uint32_t events) {
+    if (!loop || !watch || watch->fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (watch->events == events) {
+        return 0;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = watch;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, watch->fd, &ev) != 0) {
+        return -1;
+    }
+    watch->events = events;
+    return 0;
+}
+
+void fp_io_loop_remove(fp_io_loop *loop, fp_io_watch *watch) {
+    if (!loop || !watch || watch->fd < 0) {
+        return;
+    }
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL);
+    watch->events = 0;
+}
+
+static void fp_io_loop_enqueue(fp_io_loop *loop, fp_io_task *task) {
+    task->next = NULL;
+    pthread_mutex_lock(&loop->task_mutex);
+    bool was_empty = loop->task_head == NULL;
+    if (loop->task_tail) {
+        loop->task_tail->next = task;
+    } else {
+        loop->task_head = task;
+    }
+    loop->task_tail = task;
+    pthread_mutex_unlock(&loop->task_mutex);
+    if (was_empty) {
+        fp_io_loop_wake(loop);
+    }
+}
+
+int fp_io_loop_post(fp_io_loop *loop, fp_io_task_fn fn, void *arg) {
+    if (!loop || !fn) {
+        errno = EINVAL;
+        return -1;
+    }
+    fp_io_task *task = malloc(sizeof(fp_io_task));
+    if (!task) {
+        return -1;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    task->embedded = false;
+    fp_io_loop_enqueue(loop, task);
+    return 0;
+}
+
+void fp_io_loop_post_task(fp_io_loop *loop, fp_io_task *task, fp_io_task_fn fn, void *arg) {
+    task->fn = fn;
+    task->arg = arg;
+    task->embedded = true;
+    fp_io_loop_enqueue(loop, task);
+}
+
+unsigned fp_io_loop_index(const fp_io_loop *loop) {
+    return loop ? loop->index : 0;
+}
+
+uint64_t fp_io_loop_now_ms(const fp_io_loop *loop) {
+    return loop ? loop->now_ms : fp_io_monotonic_ms();
+}
+
+void fp_io_loop_set_userdata(fp_io_loop *loop, void *userdata) {
+    if (loop) {
+        loop->userdata = userdata;
+    }
+}
+
+void *fp_io_loop_userdata(const fp_io_loop *loop) {
+    return loop ? loop->userdata : NULL;
+}
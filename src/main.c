@@ -4,11 +4,13 @@
 #include <string.h>
 #include <ctype.h>
 
-#include "queue.h"
+#include "scheduler.h"
 #include "server.h"
 #include "worker.h"
 #include "progress.h"
 #include "auth.h"
+#include "output_store.h"
+#include "result_store.h"
 
 static void fp_load_env_file(const char *path) {
     if (!path) {
@@ -89,6 +91,26 @@ int main(void) {
     if (worker_count == 0) {
         worker_count = 1;
     }
+    size_t io_threads = fp_read_size_env("FERRET_IO_THREADS", 2);
+    size_t encode_threads = fp_read_size_env("FERRET_ENCODE_THREADS", 0);
+    int listen_backlog = fp_read_int_env("FERRET_LISTEN_BACKLOG", 1024);
+    bool reuseport = fp_read_int_env("FERRET_REUSEPORT", 1) != 0;
+    bool pin_io_threads = fp_read_int_env("FERRET_PIN_IO_THREADS", 1) != 0;
+    const char *unix_socket = getenv("FERRET_UNIX_SOCKET");
+    const char *handoff_socket = getenv("FERRET_HANDOFF_SOCKET");
+    size_t drain_timeout = fp_read_size_env("FERRET_DRAIN_TIMEOUT", 60);
+    int idle_timeout = fp_read_int_env("FERRET_KEEPALIVE_TIMEOUT", 15);
+    if (idle_timeout < 0) {
+        idle_timeout = 0;
+    }
+    int max_requests = fp_read_int_env("FERRET_KEEPALIVE_MAX_REQUESTS", 1000);
+    if (max_requests < 0) {
+        max_requests = 0;
+    }
+    bool static_cache = fp_read_int_env("FERRET_STATIC_CACHE", 1) != 0;
+    size_t output_ttl = fp_read_size_env("FERRET_OUTPUT_TTL", FP_OUTPUT_STORE_DEFAULT_TTL_MS / 1000);
+    size_t result_ttl = fp_read_size_env("FERRET_RESULT_TTL", FP_RESULT_STORE_DEFAULT_TTL_MS / 1000);
+    size_t result_max_jobs = fp_read_size_env("FERRET_RESULT_MAX_JOBS", FP_RESULT_STORE_DEFAULT_MAX_JOBS);
     size_t queue_size = fp_read_size_env("FERRET_QUEUE_SIZE", 128);
     if (queue_size < worker_count * 2) {
         queue_size = worker_count * 2;
@@ -100,12 +122,12 @@ int main(void) {
         return 1;
     }
 
-    fp_queue *job_queue = fp_queue_create(queue_size);
-    fp_queue *result_queue = fp_queue_create(queue_size);
-    if (!job_queue || !result_queue) {
-        fprintf(stderr, "Failed to allocate queues\n");
-        fp_queue_destroy(job_queue);
-        fp_queue_destroy(result_queue);
+    fp_scheduler *job_queue = fp_scheduler_create(queue_size,
+                                                  fp_read_size_env("FERRET_SCHED_AGING_MS", 0),
+                                                  fp_read_size_env("FERRET_SCHED_SPJF_WINDOW_MS", 0),
+                                                  worker_count);
+    if (!job_queue) {
+        fprintf(stderr, "Failed to allocate job queue\n");
         fp_auth_store_close(&auth_store);
         return 1;
     }
@@ -113,27 +135,84 @@ int main(void) {
     fp_progress_registry *progress_registry = fp_progress_registry_create(queue_size * 2);
     if (!progress_registry) {
         fprintf(stderr, "Failed to create progress registry\n");
-        fp_queue_destroy(job_queue);
-        fp_queue_destroy(result_queue);
+        fp_scheduler_destroy(job_queue);
+        fp_auth_store_close(&auth_store);
+        return 1;
+    }
+
+    fp_output_store *output_store = fp_output_store_create((uint64_t)output_ttl * 1000ULL, 0);
+    if (!output_store) {
+        fprintf(stderr, "Failed to create output store\n");
+        fp_scheduler_destroy(job_queue);
+        fp_progress_registry_destroy(progress_registry);
+        fp_auth_store_close(&auth_store);
+        return 1;
+    }
+
+    fp_result_store *result_store = fp_result_store_create(result_max_jobs, (uint64_t)result_ttl * 1000ULL, 0);
+    if (!result_store) {
+        fprintf(stderr, "Failed to create result store\n");
+        fp_output_store_destroy(output_store);
+        fp_scheduler_destroy(job_queue);
+        fp_progress_registry_destroy(progress_registry);
+        fp_auth_store_close(&auth_store);
+        return 1;
+    }
+
+    fp_task_pool *task_pool = fp_task_pool_create(encode_threads, worker_count);
+    if (!task_pool) {
+        fprintf(stderr, "Failed to start encode threads\n");
+        fp_result_store_destroy(result_store);
+        fp_output_store_destroy(output_store);
+        fp_scheduler_destroy(job_queue);
+        fp_progress_registry_destroy(progress_registry);
         fp_auth_store_close(&auth_store);
         return 1;
     }
 
-    fp_worker *workers = fp_workers_create(worker_count, job_queue, result_queue, progress_registry);
+    fp_worker *workers = fp_workers_create(worker_count, job_queue, progress_registry, task_pool);
     if (!workers) {
         fprintf(stderr, "Failed to start worker threads\n");
-        fp_queue_destroy(job_queue);
-        fp_queue_destroy(result_queue);
+        fp_task_pool_destroy(task_pool);
+        fp_result_store_destroy(result_store);
+        fp_output_store_destroy(output_store);
+        fp_scheduler_destroy(job_queue);
         fp_progress_registry_destroy(progress_registry);
         fp_auth_store_close(&auth_store);
         return 1;
     }
 
-    int rc = fp_server_run(host, port, worker_count, job_queue, result_queue, progress_registry, &auth_store);
+    fp_server_config server_config = {
+        .host = host,
+        .port = port,
+        .worker_count = worker_count,
+        .io_threads = io_threads,
+        .listen_backlog = listen_backlog,
+        .reuseport = reuseport,
+        .pin_io_threads = pin_io_threads,
+        .unix_socket = unix_socket,
+        .handoff_socket = handoff_socket,
+        .drain_timeout_ms = (uint64_t)drain_timeout * 1000ULL,
+        .idle_timeout_ms = (uint64_t)idle_timeout * 1000ULL,
+        .max_requests_per_conn = (unsigned)max_requests,
+        .static_cache = static_cache,
+        .admission =
+            {
+                [FP_ADMIT_FREE] = {fp_read_size_env("FERRET_FREE_MAX_JOBS", 0),
+                                   fp_read_size_env("FERRET_FREE_MAX_WAIT_MS", 0)},
+                [FP_ADMIT_EXPERT] = {fp_read_size_env("FERRET_EXPERT_MAX_JOBS", 0),
+                                     fp_read_size_env("FERRET_EXPERT_MAX_WAIT_MS", 0)},
+            },
+        .eta_ms_per_unit = fp_worker_eta_ms_per_unit(),
+    };
+    int rc = fp_server_run(&server_config, job_queue, progress_registry, output_store, result_store,
+                           &auth_store);
 
     fp_workers_destroy(workers, worker_count);
-    fp_queue_destroy(job_queue);
-    fp_queue_destroy(result_queue);
+    fp_task_pool_destroy(task_pool);
+    fp_result_store_destroy(result_store);
+    fp_output_store_destroy(output_store);
+    fp_scheduler_destroy(job_queue);
     fp_progress_registry_destroy(progress_registry);
     fp_auth_store_close(&auth_store);
     return rc == 0 ? 0 : 1;
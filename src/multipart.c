@@ -0,0 +1,251 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "multipart.h"
+
+enum {
+    FP_MULTIPART_PREAMBLE = 0,
+    FP_MULTIPART_AFTER_DELIMITER,
+    FP_MULTIPART_HEADERS,
+    FP_MULTIPART_DATA,
+    FP_MULTIPART_DONE,
+    FP_MULTIPART_ERROR,
+};
+
+int fp_multipart_boundary(const char *content_type, char *boundary, size_t boundary_len) {
+    if (!content_type || !boundary || boundary_len == 0) {
+        return -1;
+    }
+    const char *b = strstr(content_type, "boundary=");
+    if (!b) {
+        return -1;
+    }
+    b += 9;
+    while (*b == ' ' || *b == '\t') {
+        ++b;
+    }
+    size_t len = 0;
+    if (*b == '"') {
+        ++b;
+        while (b[len] && b[len] != '"' && len + 1 < boundary_len) {
+            boundary[len] = b[len];
+            ++len;
+        }
+    } else {
+        while (b[len] && b[len] != ';' && b[len] != ' ' && len + 1 < boundary_len) {
+            boundary[len] = b[len];
+            ++len;
+        }
+    }
+    boundary[len] = '\0';
+    return len > 0 ? 0 : -1;
+}
+
+int fp_multipart_init(fp_multipart_parser *parser, const char *boundary, fp_form_part *parts, size_t max_parts) {
+    if (!parser || !boundary || !parts) {
+        return -1;
+    }
+    size_t boundary_len = strlen(boundary);
+    if (boundary_len == 0 || boundary_len > FP_MULTIPART_BOUNDARY_MAX) {
+        return -1;
+    }
+    memset(parser, 0, sizeof(*parser));
+    memcpy(parser->delimiter, "\r\n--", 4);
+    memcpy(parser->delimiter + 4, boundary, boundary_len);
+    parser->delimiter_len = boundary_len + 4;
+    // Horspool shift: how far the window may move when its last byte is c.
+    for (size_t c = 0; c < 256; ++c) {
+        parser->skip[c] = parser->delimiter_len;
+    }
+    for (size_t i = 0; i + 1 < parser->delimiter_len; ++i) {
+        parser->skip[parser->delimiter[i]] = parser->delimiter_len - 1 - i;
+    }
+    parser->parts = parts;
+    parser->max_parts = max_parts;
+    return 0;
+}
+
+static const uint8_t *fp_multipart_search(const fp_multipart_parser *parser, const uint8_t *haystack, size_t len) {
+    size_t n = parser->delimiter_len;
+    if (len < n) {
+        return NULL;
+    }
+    const uint8_t last = parser->delimiter[n - 1];
+    const uint8_t *pos = haystack;
+    const uint8_t *stop = haystack + len - n;
+    while (pos <= stop) {
+        uint8_t c = pos[n - 1];
+        if (c == last && memcmp(pos, parser->delimiter, n - 1) == 0) {
+            return pos;
+        }
+        pos += parser->skip[c];
+    }
+    return NULL;
+}
+
+// Resumes a search that found nothing so far: a delimiter may straddle the
+// end of what has arrived, so its first n - 1 bytes get another look.
+static size_t fp_multipart_resume(const fp_multipart_parser *parser, size_t cursor, size_t len) {
+    size_t keep = parser->delimiter_len - 1;
+    return len > cursor + keep ? len - keep : cursor;
+}
+
+static void fp_multipart_copy_quoted(const char *line, const char *key, char *out, size_t out_len) {
+    const char *pos = strstr(line, key);
+    if (!pos) {
+        return;
+    }
+    pos += strlen(key);
+    const char *endq = strchr(pos, '"');
+    if (!endq) {
+        return;
+    }
+    size_t len = (size_t)(endq - pos);
+    if (len >= out_len) {
+        len = out_len - 1;
+    }
+    memcpy(out, pos, len);
+    out[len] = '\0';
+}
+
+// Reads the part headers in [start, end) one line at a time; only a bounded
+// copy of each line is made so it can be NUL-terminated.
+static void fp_multipart_parse_headers(const uint8_t *start, const uint8_t *end, fp_form_part *part) {
+    while (start < end) {
+        const uint8_t *eol = memchr(start, '\r', (size_t)(end - start));
+        if (!eol) {
+            eol = end;
+        }
+        char line[1024];
+        size_t len = (size_t)(eol - start);
+        if (len >= sizeof(line)) {
+            len = sizeof(line) - 1;
+        }
+        memcpy(line, start, len);
+        line[len] = '\0';
+        if (strncasecmp(line, "content-disposition", 19) == 0) {
+            // "filename=" is matched first so its tail is not taken for name=.
+            fp_multipart_copy_quoted(line, "filename=\"", part->filename, sizeof(part->filename));
+            char *filename_pos = strstr(line, "filename=\"");
+            if (filename_pos) {
+                *filename_pos = '\0';
+            }
+            fp_multipart_copy_quoted(line, "name=\"", part->name, sizeof(part->name));
+        } else if (strncasecmp(line, "content-type", 12) == 0) {
+            char *colon = strchr(line, ':');
+            if (colon) {
+                ++colon;
+                while (*colon == ' ' || *colon == '\t') {
+                    ++colon;
+                }
+                snprintf(part->content_type, sizeof(part->content_type), "%s", colon);
+            }
+        }
+        start = eol + (eol + 1 < end && eol[1] == '\n' ? 2 : 1);
+    }
+}
+
+static const uint8_t *fp_multipart_find_blank_line(const uint8_t *start, const uint8_t *end) {
+    while (start + 4 <= end) {
+        const uint8_t *cr = memchr(start, '\r', (size_t)(end - start) - 3);
+        if (!cr) {
+            return NULL;
+        }
+        if (memcmp(cr, "\r\n\r\n", 4) == 0) {
+            return cr;
+        }
+        start = cr + 1;
+    }
+    return NULL;
+}
+
+int fp_multipart_feed(fp_multipart_parser *parser, const uint8_t *body, size_t len) {
+    if (!parser || (!body && len > 0)) {
+        return -1;
+    }
+    while (parser->state != FP_MULTIPART_DONE && parser->state != FP_MULTIPART_ERROR) {
+        if (parser->state == FP_MULTIPART_PREAMBLE) {
+            // The opening delimiter may start the body without its CRLF.
+            size_t open_len = parser->delimiter_len - 2;
+            if (parser->cursor == 0 && len < open_len) {
+                return 0;
+            }
+            if (parser->cursor == 0 && memcmp(body, parser->delimiter + 2, open_len) == 0) {
+                parser->cursor = open_len;
+                parser->state = FP_MULTIPART_AFTER_DELIMITER;
+                continue;
+            }
+            const uint8_t *found = fp_multipart_search(parser, body + parser->cursor, len - parser->cursor);
+            if (!found) {
+                parser->cursor = fp_multipart_resume(parser, parser->cursor, len);
+                return 0;
+            }
+            parser->cursor = (size_t)(found - body) + parser->delimiter_len;
+            parser->state = FP_MULTIPART_AFTER_DELIMITER;
+        } else if (parser->state == FP_MULTIPART_AFTER_DELIMITER) {
+            if (len - parser->cursor < 2) {
+                return 0;
+            }
+            const uint8_t *marker = body + parser->cursor;
+            if (marker[0] == '-' && marker[1] == '-') {
+                parser->state = FP_MULTIPART_DONE;
+            } else if (marker[0] == '\r' && marker[1] == '\n') {
+                parser->cursor += 2;
+                parser->part_start = parser->cursor;
+                memset(&parser->current, 0, sizeof(parser->current));
+                parser->state = FP_MULTIPART_HEADERS;
+            } else {
+                parser->state = FP_MULTIPART_ERROR;
+            }
+        } else if (parser->state == FP_MULTIPART_HEADERS) {
+            const uint8_t *blank = fp_multipart_find_blank_line(body + parser->cursor, body + len);
+            if (!blank) {
+                if (len - parser->part_start > FP_MULTIPART_MAX_HEADER) {
+                    parser->state = FP_MULTIPART_ERROR;
+                    break;
+                }
+                parser->cursor = len > parser->part_start + 3 ? len - 3 : parser->part_start;
+                return 0;
+            }
+            fp_multipart_parse_headers(body + parser->part_start, blank, &parser->current);
+            parser->cursor = (size_t)(blank - body) + 4;
+            parser->part_start = parser->cursor;
+            parser->state = FP_MULTIPART_DATA;
+        } else {
+            const uint8_t *found = fp_multipart_search(parser, body + parser->cursor, len - parser->cursor);
+            if (!found) {
+                parser->cursor = fp_multipart_resume(parser, parser->cursor, len);
+                return 0;
+            }
+            parser->current.data = body + parser->part_start;
+            parser->current.size = (size_t)(found - parser->current.data);
+            if (parser->current.name[0] && parser->count < parser->max_parts) {
+                parser->parts[parser->count++] = parser->current;
+            }
+            parser->cursor = (size_t)(found - body) + parser->delimiter_len;
+            parser->state = FP_MULTIPART_AFTER_DELIMITER;
+        }
+    }
+    return parser->state == FP_MULTIPART_ERROR ? -1 : 0;
+}
+
+int fp_multipart_finish(const fp_multipart_parser *parser, size_t *out_count) {
+    if (!parser || parser->state != FP_MULTIPART_DONE) {
+        return -1;
+    }
+    if (out_count) {
+        *out_count = parser->count;
+    }
+    return 0;
+}
+
+int fp_multipart_parse(const uint8_t *body, size_t len, const char *boundary, fp_form_part *parts, size_t max_parts,
+                       size_t *out_count) {
+    fp_multipart_parser parser;
+    if (fp_multipart_init(&parser, boundary, parts, max_parts) != 0 || fp_multipart_feed(&parser, body, len) != 0) {
+        return -1;
+    }
+    return fp_multipart_finish(&parser, out_count);
+}
@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "output_store.h"
+
+#define FP_OUTPUT_STORE_BUCKETS 256
+
+struct fp_blob {
+    _Atomic unsigned refs;
+    uint8_t *data;
+    size_t size;
+};
+
+typedef struct fp_output_entry {
+    uint64_t job_id;
+    size_t index;
+    uint64_t expires_ms;
+    fp_output_meta meta;
+    fp_blob *blob;
+    struct fp_output_entry *next;
+} fp_output_entry;
+
+struct fp_output_store {
+    pthread_mutex_t mutex;
+    uint64_t ttl_ms;
+    size_t max_bytes;
+    size_t bytes;
+    fp_output_entry *buckets[FP_OUTPUT_STORE_BUCKETS];
+};
+
+static uint64_t fp_output_store_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+fp_blob *fp_blob_create(uint8_t *data, size_t size) {
+    fp_blob *blob = malloc(sizeof(fp_blob));
+    if (!blob) {
+        return NULL;
+    }
+    atomic_init(&blob->refs, 1);
+    blob->data = data;
+    blob->size = size;
+    return blob;
+}
+
+void fp_blob_retain(fp_blob *blob) {
+    if (blob) {
+        atomic_fetch_add_explicit(&blob->refs, 1, memory_order_relaxed);
+    }
+}
+
+void fp_blob_release(fp_blob *blob) {
+    if (blob && atomic_fetch_sub_explicit(&blob->refs, 1, memory_order_acq_rel) == 1) {
+        free(blob->data);
+        free(blob);
+    }
+}
+
+const uint8_t *fp_blob_data(const fp_blob *blob) {
+    return blob ? blob->data : NULL;
+}
+
+size_t fp_blob_size(const fp_blob *blob) {
+    return blob ? blob->size : 0;
+}
+
+fp_output_store *fp_output_store_create(uint64_t ttl_ms, size_t max_bytes) {
+    fp_output_store *store = calloc(1, sizeof(fp_output_store));
+    if (!store) {
+        return NULL;
+    }
+    pthread_mutex_init(&store->mutex, NULL);
+    store->ttl_ms = ttl_ms > 0 ? ttl_ms : FP_OUTPUT_STORE_DEFAULT_TTL_MS;
+    store->max_bytes = max_bytes > 0 ? max_bytes : FP_OUTPUT_STORE_MAX_BYTES;
+    return store;
+}
+
+static void fp_output_entry_free(fp_output_store *store, fp_output_entry *entry) {
+    store->bytes -= fp_blob_size(entry->blob);
+    fp_blob_release(entry->blob);
+    free(entry);
+}
+
+void fp_output_store_destroy(fp_output_store *store) {
+    if (!store) {
+        return;
+    }
+    for (size_t i = 0; i < FP_OUTPUT_STORE_BUCKETS; ++i) {
+        fp_output_entry *entry = store->buckets[i];
+        while (entry) {
+            fp_output_entry *next = entry->next;
+            fp_output_entry_free(store, entry);
+            entry = next;
+        }
+    }
+    pthread_mutex_destroy(&store->mutex);
+    free(store);
+}
+
+static size_t fp_output_store_bucket(uint64_t job_id) {
+    return (size_t)(job_id % FP_OUTPUT_STORE_BUCKETS);
+}
+
+int fp_output_store_put(fp_output_store *store, uint64_t job_id, size_t index, fp_encoded_image *output) {
+    if (!store || !output || !output->data) {
+        return -1;
+    }
+    fp_output_entry *entry = calloc(1, sizeof(fp_output_entry));
+    if (!entry) {
+        return -1;
+    }
+    entry->job_id = job_id;
+    entry->index = index;
+    entry->expires_ms = fp_output_store_now_ms() + store->ttl_ms;
+    memcpy(entry->meta.format, output->format, sizeof(entry->meta.format));
+    memcpy(entry->meta.label, output->label, sizeof(entry->meta.label));
+    memcpy(entry->meta.mime, output->mime, sizeof(entry->meta.mime));
+    memcpy(entry->meta.extension, output->extension, sizeof(entry->meta.extension));
+
+    pthread_mutex_lock(&store->mutex);
+    if (store->bytes + output->size > store->max_bytes) {
+        pthread_mutex_unlock(&store->mutex);
+        free(entry);
+        return -1;
+    }
+    entry->blob = fp_blob_create(output->data, output->size);
+    if (!entry->blob) {
+        pthread_mutex_unlock(&store->mutex);
+        free(entry);
+        return -1;
+    }
+    output->data = NULL;
+    store->bytes += output->size;
+    size_t bucket = fp_output_store_bucket(job_id);
+    entry->next = store->buckets[bucket];
+    store->buckets[bucket] = entry;
+    pthread_mutex_unlock(&store->mutex);
+    return 0;
+}
+
+fp_blob *fp_output_store_take(fp_output_store *store, uint64_t job_id, size_t index, fp_output_meta *meta) {
+    if (!store) {
+        return NULL;
+    }
+    fp_blob *blob = NULL;
+    uint64_t now_ms = fp_output_store_now_ms();
+    pthread_mutex_lock(&store->mutex);
+    fp_output_entry **link = &store->buckets[fp_output_store_bucket(job_id)];
+    while (*link) {
+        fp_output_entry *entry = *link;
+        if (entry->job_id == job_id && entry->index == index) {
+            *link = entry->next;
+            if (entry->expires_ms > now_ms) {
+                blob = entry->blob;
+                entry->blob = NULL;
+                store->bytes -= fp_blob_size(blob);
+                if (meta) {
+                    *meta = entry->meta;
+                }
+            } else {
+                store->bytes -= fp_blob_size(entry->blob);
+                fp_blob_release(entry->blob);
+            }
+            free(entry);
+            break;
+        }
+        link = &entry->next;
+    }
+    pthread_mutex_unlock(&store->mutex);
+    return blob;
+}
+
+void fp_output_store_drop_job(fp_output_store *store, uint64_t job_id) {
+    if (!store) {
+        return;
+    }
+    pthread_mutex_lock(&store->mutex);
+    fp_output_entry **link = &store->buckets[fp_output_store_bucket(job_id)];
+    while (*link) {
+        fp_output_entry *entry = *link;
+        if (entry->job_id == job_id) {
+            *link = entry->next;
+            fp_output_entry_free(store, entry);
+            continue;
+        }
+        link = &entry->next;
+    }
+    pthread_mutex_unlock(&store->mutex);
+}
+
+size_t fp_output_store_expire(fp_output_store *store) {
+    if (!store) {
+        return 0;
+    }
+    size_t expired = 0;
+    uint64_t now_ms = fp_output_store_now_ms();
+    pthread_mutex_lock(&store->mutex);
+    for (size_t i = 0; i < FP_OUTPUT_STORE_BUCKETS; ++i) {
+        fp_output_entry **link = &store->buckets[i];
+        while (*link) {
+            fp_output_entry *entry = *link;
+            if (entry->expires_ms <= now_ms) {
+                *link = entry->next;
+                fp_output_entry_free(store, entry);
+                expired++;
+                continue;
+            }
+            link = &entry->next;
+        }
+    }
+    pthread_mutex_unlock(&store->mutex);
+    return expired;
+}
@@ -0,0 +1,60 @@
+#define _GNU_SOURCE // syscall
+#include <errno.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "parker.h"
+
+void fp_parker_init(fp_parker *parker) {
+    atomic_init(&parker->seq, 0);
+    atomic_init(&parker->waiters, 0);
+}
+
+uint32_t fp_parker_prepare(fp_parker *parker) {
+    uint32_t key = atomic_load_explicit(&parker->seq, memory_order_acquire);
+    atomic_fetch_add_explicit(&parker->waiters, 1, memory_order_relaxed);
+    // Pairs with the fence in fp_parker_wake: either the consumer's re-check
+    // sees the producer's data or the producer sees the consumer waiting.
+    atomic_thread_fence(memory_order_seq_cst);
+    return key;
+}
+
+void fp_parker_cancel(fp_parker *parker) {
+    atomic_fetch_sub_explicit(&parker->waiters, 1, memory_order_relaxed);
+}
+
+int fp_parker_park(fp_parker *parker, uint32_t key, const struct timespec *deadline) {
+    // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout and returns
+    // EAGAIN at once if a wake bumped seq since the key was taken.
+    long rc = syscall(SYS_futex, &parker->seq, FUTEX_WAIT_BITSET_PRIVATE, key, deadline, NULL,
+                      FUTEX_BITSET_MATCH_ANY);
+    int saved = errno;
+    atomic_fetch_sub_explicit(&parker->waiters, 1, memory_order_relaxed);
+    if (rc != 0 && saved == ETIMEDOUT) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    return 0;
+}
+
+void fp_parker_wake(fp_parker *parker, int count) {
+    atomic_fetch_add_explicit(&parker->seq, 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&parker->waiters, memory_order_relaxed) > 0) {
+        syscall(SYS_futex, &parker->seq, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+    }
+}
+
+void fp_parker_deadline(struct timespec *deadline, int timeout_ms) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    if (timeout_ms <= 0) {
+        return;
+    }
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
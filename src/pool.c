@@ -0,0 +1,76 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+
+#include "pool.h"
+
+typedef struct fp_pool_free {
+    struct fp_pool_free *next;
+} fp_pool_free;
+
+struct fp_pool {
+    size_t object_size;
+    size_t max_cached;
+    size_t cached;
+    fp_pool_free *free_list;
+};
+
+fp_pool *fp_pool_create(size_t object_size, size_t max_cached) {
+    if (object_size == 0) {
+        return NULL;
+    }
+    fp_pool *pool = calloc(1, sizeof(fp_pool));
+    if (!pool) {
+        return NULL;
+    }
+    // Every object must be able to hold the free-list link.
+    pool->object_size = object_size < sizeof(fp_pool_free) ? sizeof(fp_pool_free) : object_size;
+    pool->max_cached = max_cached;
+    return pool;
+}
+
+void fp_pool_destroy(fp_pool *pool) {
+    if (!pool) {
+        return;
+    }
+    while (pool->free_list) {
+        fp_pool_free *next = pool->free_list->next;
+        free(pool->free_list);
+        pool->free_list = next;
+    }
+    free(pool);
+}
+
+void *fp_pool_get(fp_pool *pool) {
+    if (!pool) {
+        return NULL;
+    }
+    fp_pool_free *object = pool->free_list;
+    if (!object) {
+        return malloc(pool->object_size);
+    }
+    pool->free_list = object->next;
+    pool->cached--;
+    return object;
+}
+
+void fp_pool_put(fp_pool *pool, void *object) {
+    if (!object) {
+        return;
+    }
+    if (!pool || pool->cached >= pool->max_cached) {
+        free(object);
+        return;
+    }
+    fp_pool_free *entry = (fp_pool_free *)object;
+    entry->next = pool->free_list;
+    pool->free_list = entry;
+    pool->cached++;
+}
+
+size_t fp_pool_object_size(const fp_pool *pool) {
+    return pool ? pool->object_size : 0;
+}
+
+size_t fp_pool_cached(const fp_pool *pool) {
+    return pool ? pool->cached : 0;
+}
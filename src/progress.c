@@ -6,6 +6,7 @@
 #include <pthread.h>
 
 #include "progress.h"
+#include "base64.h"
 
 typedef struct fp_progress_entry {
     uint64_t job_id;
@@ -22,9 +23,13 @@ struct fp_progress_channel {
     uint64_t job_id;
     fp_progress_registry *registry;
     pthread_mutex_t mutex;
-    pthread_cond_t cond;
     fp_progress_event *head;
     fp_progress_event *tail;
+    fp_progress_listener listener;
+    void *listener_ctx;
+    size_t pending_events;
+    size_t pending_bytes;
+    size_t dropped;
     int ref_count;
     bool closed;
 };
@@ -44,6 +49,7 @@ static fp_progress_event *fp_progress_event_create(fp_progress_event_type type,
         strncpy(event->event_name, "status", sizeof(event->event_name) - 1);
     }
     event->payload = payload;
+    event->payload_len = payload ? strlen(payload) : 0;
     event->next = NULL;
     return event;
 }
@@ -127,7 +133,6 @@ static fp_progress_channel *fp_progress_channel_create(fp_progress_registry *reg
     channel->job_id = job_id;
     channel->registry = registry;
     pthread_mutex_init(&channel->mutex, NULL);
-    pthread_cond_init(&channel->cond, NULL);
     channel->ref_count = 1;
     channel->closed = false;
     channel->head = NULL;
@@ -146,7 +151,6 @@ static void fp_progress_channel_destroy(fp_progress_channel *channel) {
         node = next;
     }
     pthread_mutex_destroy(&channel->mutex);
-    pthread_cond_destroy(&channel->cond);
     free(channel);
 }
 
@@ -242,17 +246,40 @@ static void fp_progress_channel_push(fp_progress_channel *channel, fp_progress_e
         fp_progress_event_destroy(event);
         return;
     }
+    if (event->type == FP_PROGRESS_EVENT_OUTPUT &&
+        (channel->pending_events >= FP_PROGRESS_MAX_PENDING_EVENTS ||
+         (channel->pending_events > 0 &&
+          channel->pending_bytes + event->payload_len > FP_PROGRESS_MAX_PENDING_BYTES))) {
+        channel->dropped++;
+        pthread_mutex_unlock(&channel->mutex);
+        fp_progress_event_destroy(event);
+        return;
+    }
     if (channel->tail) {
         channel->tail->next = event;
     } else {
         channel->head = event;
     }
     channel->tail = event;
-    pthread_cond_broadcast(&channel->cond);
+    channel->pending_events++;
+    channel->pending_bytes += event->payload_len;
+    if (channel->listener) {
+        channel->listener(channel, channel->listener_ctx);
+    }
+    pthread_mutex_unlock(&channel->mutex);
+}
+
+void fp_progress_set_listener(fp_progress_channel *channel, fp_progress_listener listener, void *ctx) {
+    if (!channel) {
+        return;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    channel->listener = listener;
+    channel->listener_ctx = ctx;
     pthread_mutex_unlock(&channel->mutex);
 }
 
-fp_progress_event *fp_progress_next_event(fp_progress_channel *channel, bool *is_open) {
+fp_progress_event *fp_progress_poll_event(fp_progress_channel *channel, bool *is_open) {
     if (!channel) {
         if (is_open) {
             *is_open = false;
@@ -260,15 +287,15 @@ fp_progress_event *fp_progress_next_event(fp_progress_channel *channel, bool *is
         return NULL;
     }
     pthread_mutex_lock(&channel->mutex);
-    while (!channel->head && !channel->closed) {
-        pthread_cond_wait(&channel->cond, &channel->mutex);
-    }
     fp_progress_event *event = channel->head;
     if (event) {
         channel->head = event->next;
         if (!channel->head) {
             channel->tail = NULL;
         }
+        event->next = NULL;
+        channel->pending_events--;
+        channel->pending_bytes -= event->payload_len;
     }
     if (is_open) {
         *is_open = !channel->closed || channel->head != NULL;
@@ -277,6 +304,30 @@ fp_progress_event *fp_progress_next_event(fp_progress_channel *channel, bool *is
     return event;
 }
 
+size_t fp_progress_take_dropped(fp_progress_channel *channel) {
+    if (!channel) {
+        return 0;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    size_t dropped = channel->dropped;
+    channel->dropped = 0;
+    pthread_mutex_unlock(&channel->mutex);
+    return dropped;
+}
+
+// Cheap pre-check so a full backlog doesn't pay for base64 encoding an output
+// that would be dropped anyway.
+static bool fp_progress_backlog_full(fp_progress_channel *channel, size_t expected_bytes) {
+    pthread_mutex_lock(&channel->mutex);
+    bool full = channel->pending_events >= FP_PROGRESS_MAX_PENDING_EVENTS ||
+                (channel->pending_events > 0 && channel->pending_bytes + expected_bytes > FP_PROGRESS_MAX_PENDING_BYTES);
+    if (full && !channel->closed) {
+        channel->dropped++;
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    return full;
+}
+
 void fp_progress_event_free(fp_progress_event *event) {
     fp_progress_event_destroy(event);
 }
@@ -287,7 +338,9 @@ void fp_progress_close(fp_progress_channel *channel) {
     }
     pthread_mutex_lock(&channel->mutex);
     channel->closed = true;
-    pthread_cond_broadcast(&channel->cond);
+    if (channel->listener) {
+        channel->listener(channel, channel->listener_ctx);
+    }
     pthread_mutex_unlock(&channel->mutex);
 }
 
@@ -350,41 +403,6 @@ static char *fp_progress_json_escape(const char *value) {
     return out;
 }
 
-static char *fp_progress_base64_encode(const uint8_t *data, size_t len) {
-    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    size_t encoded_len = len ? (4 * ((len + 2) / 3)) : 0;
-    char *out = malloc(encoded_len + 1);
-    if (!out) {
-        return NULL;
-    }
-    size_t i = 0;
-    size_t j = 0;
-    while (i + 2 < len) {
-        uint32_t triple = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
-        out[j++] = table[(triple >> 18) & 0x3F];
-        out[j++] = table[(triple >> 12) & 0x3F];
-        out[j++] = table[(triple >> 6) & 0x3F];
-        out[j++] = table[triple & 0x3F];
-        i += 3;
-    }
-    size_t remaining = len - i;
-    if (remaining == 1) {
-        uint32_t triple = (uint32_t)data[i] << 16;
-        out[j++] = table[(triple >> 18) & 0x3F];
-        out[j++] = table[(triple >> 12) & 0x3F];
-        out[j++] = '=';
-        out[j++] = '=';
-    } else if (remaining == 2) {
-        uint32_t triple = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8);
-        out[j++] = table[(triple >> 18) & 0x3F];
-        out[j++] = table[(triple >> 12) & 0x3F];
-        out[j++] = table[(triple >> 6) & 0x3F];
-        out[j++] = '=';
-    }
-    out[encoded_len] = '\0';
-    return out;
-}
-
 static int fp_progress_emit(fp_progress_channel *channel,
                             fp_progress_event_type type,
                             const char *event_name,
@@ -399,92 +417,58 @@ static int fp_progress_emit(fp_progress_channel *channel,
 
 int fp_progress_emit_output(fp_progress_channel *channel,
                             const fp_encoded_image *output,
+                            const char *url,
                             size_t input_size,
                             double duration_ms,
                             double avg_duration_ms) {
-    if (!channel || !output || !output->data) {
+    if (!channel || !output || (!output->data && !url)) {
         return -1;
     }
+    size_t body_len = url ? strlen(url) : fp_base64_encoded_len(output->size);
+    if (fp_progress_backlog_full(channel, body_len)) {
+        return 0;
+    }
     char *format = fp_progress_json_escape(output->format);
     char *label = fp_progress_json_escape(output->label);
     char *mime = fp_progress_json_escape(output->mime);
     char *extension = fp_progress_json_escape(output->extension);
     char *tuning = fp_progress_json_escape(output->tuning);
-    char *data = fp_progress_base64_encode(output->data, output->size);
-    if (!format || !label || !mime || !extension || !data || !tuning) {
-        free(format);
-        free(label);
-        free(mime);
-        free(extension);
-        free(tuning);
-        free(data);
-        return -1;
-    }
-
-    const char *suffix_template = "\",\"inputBytes\":%zu,\"durationMs\":%.3f,\"avgDurationMs\":%.3f}";
-    int prefix_len = snprintf(NULL,
-                              0,
-                              "{\"jobId\":%llu,\"type\":\"result\",\"format\":%s,\"label\":%s,"
-                              "\"bytes\":%zu,\"mime\":%s,\"extension\":%s,\"tuning\":%s,\"data\":\"",
-                              (unsigned long long)channel->job_id,
-                              format,
-                              label,
-                              output->size,
-                              mime,
-                              extension,
-                              tuning);
-    if (prefix_len < 0) {
-        free(format);
-        free(label);
-        free(mime);
-        free(extension);
-        free(tuning);
-        free(data);
-        return -1;
-    }
-    int suffix_len = snprintf(NULL, 0, suffix_template, input_size, duration_ms, avg_duration_ms);
-    size_t total_len = (size_t)prefix_len + strlen(data) + (size_t)suffix_len;
-    char *payload = malloc(total_len + 1);
-    if (!payload) {
-        free(format);
-        free(label);
-        free(mime);
-        free(extension);
-        free(data);
-        return -1;
-    }
-    int written = snprintf(payload,
-                           total_len + 1,
-                           "{\"jobId\":%llu,\"type\":\"result\",\"format\":%s,\"label\":%s,"
-                           "\"bytes\":%zu,\"mime\":%s,\"extension\":%s,\"data\":\"",
-                           (unsigned long long)channel->job_id,
-                           format,
-                           label,
-                           output->size,
-                           mime,
-                           extension);
-    if (written < 0) {
-        free(payload);
-        free(format);
-        free(label);
-        free(mime);
-        free(extension);
-        free(tuning);
-        free(data);
-        return -1;
+    char *payload = NULL;
+    if (format && label && mime && extension && tuning) {
+        // The body is either base64 "data" or a download "url"; both go between
+        // the quote that ends the prefix and the one that starts the suffix.
+        const char *prefix_template = "{\"jobId\":%llu,\"type\":\"result\",\"format\":%s,\"label\":%s,"
+                                      "\"bytes\":%zu,\"mime\":%s,\"extension\":%s,\"tuning\":%s,\"%s\":\"";
+        const char *suffix_template = "\",\"inputBytes\":%zu,\"durationMs\":%.3f,\"avgDurationMs\":%.3f}";
+        const char *field = url ? "url" : "data";
+        int prefix_len = snprintf(NULL, 0, prefix_template, (unsigned long long)channel->job_id, format, label,
+                                  output->size, mime, extension, tuning, field);
+        int suffix_len = snprintf(NULL, 0, suffix_template, input_size, duration_ms, avg_duration_ms);
+        if (prefix_len >= 0 && suffix_len >= 0) {
+            payload = malloc((size_t)prefix_len + body_len + (size_t)suffix_len + 1);
+        }
+        if (payload) {
+            snprintf(payload, (size_t)prefix_len + 1, prefix_template, (unsigned long long)channel->job_id, format,
+                     label, output->size, mime, extension, tuning, field);
+            char *cursor = payload + prefix_len;
+            if (url) {
+                memcpy(cursor, url, body_len);
+            } else {
+                fp_base64_encode_into(output->data, output->size, cursor);
+            }
+            snprintf(cursor + body_len, (size_t)suffix_len + 1, suffix_template, input_size, duration_ms,
+                     avg_duration_ms);
+        }
     }
-    size_t offset = (size_t)written;
-    strcpy(payload + offset, data);
-    offset += strlen(data);
-    snprintf(payload + offset, (size_t)suffix_len + 1, suffix_template, input_size, duration_ms, avg_duration_ms);
 
     free(format);
     free(label);
     free(mime);
     free(extension);
     free(tuning);
-    free(data);
-
+    if (!payload) {
+        return -1;
+    }
     return fp_progress_emit(channel, FP_PROGRESS_EVENT_OUTPUT, "result", payload);
 }
 
@@ -1,17 +1,22 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
+#include <limits.h>
+#include <string.h>
 #include "queue.h"
 
+#define FP_QUEUE_SPIN 128 // pops tried before parking; a job usually arrives within a few
+
 fp_queue *fp_queue_create(size_t capacity) {
     if (capacity == 0) {
         capacity = 1;
     }
 
-    fp_queue *queue = calloc(1, sizeof(fp_queue));
+    fp_queue *queue = aligned_alloc(FP_QUEUE_CACHE_LINE, sizeof(fp_queue));
     if (!queue) {
         return NULL;
     }
+    memset(queue, 0, sizeof(fp_queue));
 
     queue->capacity = capacity;
     queue->slots = calloc(capacity, sizeof(fp_queue_slot));
@@ -26,6 +31,8 @@ fp_queue *fp_queue_create(size_t capacity) {
 
     atomic_init(&queue->head, 0);
     atomic_init(&queue->tail, 0);
+    fp_parker_init(&queue->parker);
+    atomic_init(&queue->closed, false);
     return queue;
 }
 
@@ -55,6 +62,7 @@ int fp_queue_push(fp_queue *queue, void *data) {
                                                       memory_order_relaxed, memory_order_relaxed)) {
                 slot->data = data;
                 atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                fp_parker_wake(&queue->parker, 1);
                 return 0;
             }
         } else if (diff < 0) {
@@ -95,3 +103,38 @@ void *fp_queue_pop(fp_queue *queue) {
     }
 }
 
+
+void *fp_queue_pop_wait(fp_queue *queue, int timeout_ms) {
+    if (!queue) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (int spin = 0; spin < FP_QUEUE_SPIN; ++spin) {
+        void *data = fp_queue_pop(queue);
+        if (data) {
+            return data;
+        }
+    }
+
+    struct timespec deadline;
+    fp_parker_deadline(&deadline, timeout_ms);
+    for (;;) {
+        uint32_t key = fp_parker_prepare(&queue->parker);
+        void *data = fp_queue_pop(queue);
+        if (data || atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+            fp_parker_cancel(&queue->parker);
+            return data;
+        }
+        if (fp_parker_park(&queue->parker, key, timeout_ms < 0 ? NULL : &deadline) != 0) {
+            return fp_queue_pop(queue); // timed out
+        }
+    }
+}
+
+void fp_queue_close(fp_queue *queue) {
+    if (!queue) {
+        return;
+    }
+    atomic_store_explicit(&queue->closed, true, memory_order_release);
+    fp_parker_wake(&queue->parker, INT_MAX);
+}
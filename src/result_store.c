@@ -0,0 +1,333 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "result_store.h"
+
+#define FP_RESULT_STORE_BUCKETS 256
+
+struct fp_stored_result {
+    _Atomic unsigned refs;
+    fp_result *result;
+    char filename[FP_FILENAME_MAX];
+};
+
+struct fp_result_watch {
+    uint64_t job_id;
+    fp_result_watch_fn fn;
+    void *ctx;
+    struct fp_result_watch *next;
+};
+
+typedef struct fp_result_entry {
+    uint64_t job_id;
+    fp_job_state state;
+    uint64_t expires_ms;
+    size_t bytes;
+    fp_stored_result *stored;
+    fp_result_watch *watches;
+    struct fp_result_entry *next;      // hash bucket chain
+    struct fp_result_entry *done_prev; // finished entries, oldest first
+    struct fp_result_entry *done_next;
+} fp_result_entry;
+
+struct fp_result_store {
+    pthread_mutex_t mutex;
+    uint64_t ttl_ms;
+    size_t max_jobs;
+    size_t max_bytes;
+    size_t job_count;
+    size_t bytes;
+    fp_result_entry *buckets[FP_RESULT_STORE_BUCKETS];
+    fp_result_entry *done_head;
+    fp_result_entry *done_tail;
+};
+
+static uint64_t fp_result_store_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+const fp_result *fp_stored_result_get(const fp_stored_result *stored) {
+    return stored ? stored->result : NULL;
+}
+
+const char *fp_stored_result_filename(const fp_stored_result *stored) {
+    return stored ? stored->filename : "";
+}
+
+void fp_stored_result_retain(fp_stored_result *stored) {
+    if (stored) {
+        atomic_fetch_add_explicit(&stored->refs, 1, memory_order_relaxed);
+    }
+}
+
+void fp_stored_result_release(fp_stored_result *stored) {
+    if (stored && atomic_fetch_sub_explicit(&stored->refs, 1, memory_order_acq_rel) == 1) {
+        if (stored->result) {
+            fp_free_result(stored->result);
+            free(stored->result);
+        }
+        free(stored);
+    }
+}
+
+fp_result_store *fp_result_store_create(size_t max_jobs, uint64_t ttl_ms, size_t max_bytes) {
+    fp_result_store *store = calloc(1, sizeof(fp_result_store));
+    if (!store) {
+        return NULL;
+    }
+    pthread_mutex_init(&store->mutex, NULL);
+    store->max_jobs = max_jobs > 0 ? max_jobs : FP_RESULT_STORE_DEFAULT_MAX_JOBS;
+    store->ttl_ms = ttl_ms > 0 ? ttl_ms : FP_RESULT_STORE_DEFAULT_TTL_MS;
+    store->max_bytes = max_bytes > 0 ? max_bytes : FP_RESULT_STORE_MAX_BYTES;
+    return store;
+}
+
+static fp_result_entry **fp_result_store_link(fp_result_store *store, uint64_t job_id) {
+    fp_result_entry **link = &store->buckets[job_id % FP_RESULT_STORE_BUCKETS];
+    while (*link && (*link)->job_id != job_id) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void fp_result_store_fire(fp_result_watch *watches) {
+    while (watches) {
+        fp_result_watch *next = watches->next;
+        watches->fn(watches->ctx);
+        free(watches);
+        watches = next;
+    }
+}
+
+// Unlinks and frees entry; any watches are handed back for firing once the
+// lock is dropped.
+static fp_result_watch *fp_result_store_remove(fp_result_store *store, fp_result_entry *entry) {
+    *fp_result_store_link(store, entry->job_id) = entry->next;
+    if (entry->state == FP_JOB_DONE) {
+        if (entry->done_prev) {
+            entry->done_prev->done_next = entry->done_next;
+        } else {
+            store->done_head = entry->done_next;
+        }
+        if (entry->done_next) {
+            entry->done_next->done_prev = entry->done_prev;
+        } else {
+            store->done_tail = entry->done_prev;
+        }
+    }
+    store->job_count--;
+    store->bytes -= entry->bytes;
+    fp_result_watch *watches = entry->watches;
+    fp_stored_result_release(entry->stored);
+    free(entry);
+    return watches;
+}
+
+void fp_result_store_destroy(fp_result_store *store) {
+    if (!store) {
+        return;
+    }
+    for (size_t i = 0; i < FP_RESULT_STORE_BUCKETS; ++i) {
+        while (store->buckets[i]) {
+            fp_result_watch *watches = fp_result_store_remove(store, store->buckets[i]);
+            while (watches) {
+                fp_result_watch *next = watches->next;
+                free(watches);
+                watches = next;
+            }
+        }
+    }
+    pthread_mutex_destroy(&store->mutex);
+    free(store);
+}
+
+static size_t fp_result_store_expire_locked(fp_result_store *store, uint64_t now_ms) {
+    size_t expired = 0;
+    // Every entry gets the same TTL, so the oldest finished ones expire first.
+    while (store->done_head && store->done_head->expires_ms <= now_ms) {
+        fp_result_store_remove(store, store->done_head);
+        expired++;
+    }
+    return expired;
+}
+
+int fp_result_store_reserve(fp_result_store *store, uint64_t job_id) {
+    if (!store || job_id == 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&store->mutex);
+    fp_result_entry **link = fp_result_store_link(store, job_id);
+    if (*link) {
+        pthread_mutex_unlock(&store->mutex);
+        return -1;
+    }
+    if (store->job_count >= store->max_jobs) {
+        fp_result_store_expire_locked(store, fp_result_store_now_ms());
+    }
+    while (store->job_count >= store->max_jobs && store->done_head) {
+        fp_result_store_remove(store, store->done_head);
+    }
+    fp_result_entry *entry = NULL;
+    if (store->job_count < store->max_jobs) {
+        entry = calloc(1, sizeof(fp_result_entry));
+    }
+    if (!entry) {
+        pthread_mutex_unlock(&store->mutex);
+        return -1;
+    }
+    entry->job_id = job_id;
+    entry->state = FP_JOB_PENDING;
+    link = fp_result_store_link(store, job_id); // evictions may have reshaped the chain
+    entry->next = *link;
+    *link = entry;
+    store->job_count++;
+    pthread_mutex_unlock(&store->mutex);
+    return 0;
+}
+
+void fp_result_store_cancel(fp_result_store *store, uint64_t job_id) {
+    if (!store) {
+        return;
+    }
+    fp_result_watch *watches = NULL;
+    pthread_mutex_lock(&store->mutex);
+    fp_result_entry *entry = *fp_result_store_link(store, job_id);
+    if (entry && entry->state == FP_JOB_PENDING) {
+        watches = fp_result_store_remove(store, entry);
+    }
+    pthread_mutex_unlock(&store->mutex);
+    fp_result_store_fire(watches);
+}
+
+static size_t fp_result_bytes(const fp_result *result) {
+    size_t bytes = sizeof(fp_result);
+    for (size_t i = 0; result && i < result->output_count; ++i) {
+        bytes += result->outputs[i].size;
+    }
+    return bytes;
+}
+
+void fp_result_store_complete(fp_result_store *store, uint64_t job_id, const char *filename, fp_result *result) {
+    fp_stored_result *stored = store ? calloc(1, sizeof(fp_stored_result)) : NULL;
+    if (!stored) {
+        if (result) {
+            fp_free_result(result);
+            free(result);
+        }
+        fp_result_store_cancel(store, job_id);
+        return;
+    }
+    atomic_init(&stored->refs, 1);
+    stored->result = result;
+    snprintf(stored->filename, sizeof(stored->filename), "%s", filename ? filename : "");
+
+    pthread_mutex_lock(&store->mutex);
+    fp_result_entry *entry = *fp_result_store_link(store, job_id);
+    if (!entry || entry->state != FP_JOB_PENDING) {
+        pthread_mutex_unlock(&store->mutex);
+        fp_stored_result_release(stored);
+        return;
+    }
+    fp_result_watch *watches = entry->watches;
+    entry->watches = NULL;
+    entry->state = FP_JOB_DONE;
+    entry->stored = stored;
+    entry->bytes = fp_result_bytes(result);
+    entry->expires_ms = fp_result_store_now_ms() + store->ttl_ms;
+    entry->done_prev = store->done_tail;
+    if (store->done_tail) {
+        store->done_tail->done_next = entry;
+    } else {
+        store->done_head = entry;
+    }
+    store->done_tail = entry;
+    store->bytes += entry->bytes;
+    while (store->bytes > store->max_bytes && store->done_head != entry) {
+        fp_result_store_remove(store, store->done_head);
+    }
+    pthread_mutex_unlock(&store->mutex);
+    fp_result_store_fire(watches);
+}
+
+fp_job_state fp_result_store_lookup(fp_result_store *store,
+                                    uint64_t job_id,
+                                    fp_stored_result **out,
+                                    fp_result_watch_fn fn,
+                                    void *ctx,
+                                    fp_result_watch **watch_out) {
+    if (out) {
+        *out = NULL;
+    }
+    if (watch_out) {
+        *watch_out = NULL;
+    }
+    if (!store) {
+        return FP_JOB_UNKNOWN;
+    }
+    pthread_mutex_lock(&store->mutex);
+    fp_result_entry *entry = *fp_result_store_link(store, job_id);
+    if (entry && entry->state == FP_JOB_DONE && entry->expires_ms <= fp_result_store_now_ms()) {
+        fp_result_store_remove(store, entry);
+        entry = NULL;
+    }
+    fp_job_state state = entry ? entry->state : FP_JOB_UNKNOWN;
+    if (state == FP_JOB_DONE && out) {
+        fp_stored_result_retain(entry->stored);
+        *out = entry->stored;
+    } else if (state == FP_JOB_PENDING && fn) {
+        fp_result_watch *watch = calloc(1, sizeof(fp_result_watch));
+        if (watch) {
+            watch->job_id = job_id;
+            watch->fn = fn;
+            watch->ctx = ctx;
+            watch->next = entry->watches;
+            entry->watches = watch;
+        }
+        if (watch_out) {
+            *watch_out = watch;
+        }
+    }
+    pthread_mutex_unlock(&store->mutex);
+    return state;
+}
+
+bool fp_result_store_unwatch(fp_result_store *store, fp_result_watch *watch) {
+    if (!store || !watch) {
+        return false;
+    }
+    bool found = false;
+    pthread_mutex_lock(&store->mutex);
+    // watch is only dereferenced once found, since a fired watch is freed.
+    for (size_t i = 0; i < FP_RESULT_STORE_BUCKETS && !found; ++i) {
+        for (fp_result_entry *entry = store->buckets[i]; entry && !found; entry = entry->next) {
+            for (fp_result_watch **link = &entry->watches; *link; link = &(*link)->next) {
+                if (*link == watch) {
+                    *link = watch->next;
+                    found = true;
+                    break;
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&store->mutex);
+    if (found) {
+        free(watch);
+    }
+    return found;
+}
+
+size_t fp_result_store_expire(fp_result_store *store) {
+    if (!store) {
+        return 0;
+    }
+    pthread_mutex_lock(&store->mutex);
+    size_t expired = fp_result_store_expire_locked(store, fp_result_store_now_ms());
+    pthread_mutex_unlock(&store->mutex);
+    return expired;
+}
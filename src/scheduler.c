@@ -0,0 +1,367 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scheduler.h"
+
+#define FP_SCHED_SPIN 128 // pops tried before parking
+#define FP_SCHED_CACHE_LINE 64
+#define FP_SCHED_ROUND                                                                                    \
+    (FP_SCHED_WEIGHT_INTERACTIVE + FP_SCHED_WEIGHT_EXPERT + FP_SCHED_WEIGHT_FREE + FP_SCHED_WEIGHT_BULK)
+
+// Tried in this order when the weighted pick has nothing queued.
+static const fp_job_class fp_sched_priority[FP_JOB_CLASS_COUNT] = {
+    FP_JOB_INTERACTIVE,
+    FP_JOB_EXPERT,
+    FP_JOB_FREE,
+    FP_JOB_BULK,
+};
+
+static const unsigned fp_sched_weights[FP_JOB_CLASS_COUNT] = {
+    [FP_JOB_FREE] = FP_SCHED_WEIGHT_FREE,
+    [FP_JOB_INTERACTIVE] = FP_SCHED_WEIGHT_INTERACTIVE,
+    [FP_JOB_EXPERT] = FP_SCHED_WEIGHT_EXPERT,
+    [FP_JOB_BULK] = FP_SCHED_WEIGHT_BULK,
+};
+
+// Jobs of one class ordered by virtual start time: the time the job was
+// queued plus its predicted cost, capped at spjf_window_ms. Cheap jobs thus
+// overtake expensive ones, but never one queued more than the window earlier.
+typedef struct {
+    double key;
+    uint64_t seq; // FIFO among equal keys
+    fp_job *job;
+} fp_sched_entry;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    fp_sched_entry *heap;
+    size_t count;
+    size_t capacity;
+    uint64_t next_seq;
+} fp_sched_class;
+
+// One worker's queued jobs, on cache lines of its own so workers serving
+// their own lanes do not bounce each other's locks and counters.
+typedef struct {
+    _Alignas(FP_SCHED_CACHE_LINE) fp_sched_class classes[FP_JOB_CLASS_COUNT];
+    atomic_size_t queued[FP_JOB_CLASS_COUNT]; // lets pop skip empty classes without locking
+    atomic_size_t ticket;
+} fp_sched_lane;
+
+struct fp_scheduler {
+    fp_sched_lane *lanes;
+    size_t lane_count;
+    _Alignas(FP_SCHED_CACHE_LINE) atomic_size_t next_lane; // bumped by every push
+    // Jobs per class over all lanes, so a pop can pick the class before
+    // looking for a lane that holds one.
+    _Alignas(FP_SCHED_CACHE_LINE) atomic_size_t queued[FP_JOB_CLASS_COUNT];
+    // When the class was last served from any lane or, if it was empty, got
+    // its next job; 0 while it is empty. Drives aging.
+    _Atomic uint64_t waiting_since_ms[FP_JOB_CLASS_COUNT];
+    uint64_t aging_ms;
+    double spjf_window_ms;
+    fp_job_class round[FP_SCHED_ROUND]; // interleaved weighted order
+    fp_parker parker;
+    atomic_bool closed;
+};
+
+static uint64_t fp_sched_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+// Smooth weighted round robin, precomputed: spreads each class's turns over
+// the round instead of serving them back to back.
+static void fp_sched_build_round(fp_job_class *round) {
+    int current[FP_JOB_CLASS_COUNT] = {0};
+    for (size_t slot = 0; slot < FP_SCHED_ROUND; ++slot) {
+        size_t best = 0;
+        for (size_t c = 0; c < FP_JOB_CLASS_COUNT; ++c) {
+            current[c] += (int)fp_sched_weights[c];
+            if (current[c] > current[best]) {
+                best = c;
+            }
+        }
+        current[best] -= FP_SCHED_ROUND;
+        round[slot] = (fp_job_class)best;
+    }
+}
+
+static bool fp_sched_before(const fp_sched_entry *a, const fp_sched_entry *b) {
+    return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+static void fp_sched_sift_up(fp_sched_entry *heap, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!fp_sched_before(&heap[i], &heap[parent])) {
+            break;
+        }
+        fp_sched_entry tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void fp_sched_sift_down(fp_sched_entry *heap, size_t count, size_t i) {
+    for (;;) {
+        size_t best = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && fp_sched_before(&heap[left], &heap[best])) {
+            best = left;
+        }
+        if (right < count && fp_sched_before(&heap[right], &heap[best])) {
+            best = right;
+        }
+        if (best == i) {
+            return;
+        }
+        fp_sched_entry tmp = heap[i];
+        heap[i] = heap[best];
+        heap[best] = tmp;
+        i = best;
+    }
+}
+
+fp_scheduler *fp_scheduler_create(size_t capacity, uint64_t aging_ms, uint64_t spjf_window_ms, size_t lanes) {
+    fp_scheduler *scheduler = calloc(1, sizeof(fp_scheduler));
+    if (!scheduler) {
+        return NULL;
+    }
+    lanes = lanes > 0 ? lanes : 1;
+    scheduler->lanes = aligned_alloc(FP_SCHED_CACHE_LINE, lanes * sizeof(fp_sched_lane));
+    if (!scheduler->lanes) {
+        free(scheduler);
+        return NULL;
+    }
+    memset(scheduler->lanes, 0, lanes * sizeof(fp_sched_lane));
+    scheduler->lane_count = lanes;
+    // A full lane passes jobs on to the next, so the lanes together hold at
+    // least capacity jobs of each class.
+    capacity = capacity > 0 ? (capacity + lanes - 1) / lanes : 1;
+    for (size_t l = 0; l < lanes; ++l) {
+        fp_sched_lane *lane = &scheduler->lanes[l];
+        atomic_init(&lane->ticket, 0);
+        for (size_t c = 0; c < FP_JOB_CLASS_COUNT; ++c) {
+            fp_sched_class *cls = &lane->classes[c];
+            pthread_mutex_init(&cls->mutex, NULL);
+            cls->capacity = capacity;
+            cls->heap = calloc(capacity, sizeof(fp_sched_entry));
+            atomic_init(&lane->queued[c], 0);
+            if (!cls->heap) {
+                fp_scheduler_destroy(scheduler);
+                return NULL;
+            }
+        }
+    }
+    atomic_init(&scheduler->next_lane, 0);
+    for (size_t c = 0; c < FP_JOB_CLASS_COUNT; ++c) {
+        atomic_init(&scheduler->queued[c], 0);
+        atomic_init(&scheduler->waiting_since_ms[c], 0);
+    }
+    atomic_init(&scheduler->closed, false);
+    scheduler->aging_ms = aging_ms > 0 ? aging_ms : FP_SCHED_DEFAULT_AGING_MS;
+    scheduler->spjf_window_ms = (double)(spjf_window_ms > 0 ? spjf_window_ms : FP_SCHED_DEFAULT_SPJF_WINDOW_MS);
+    fp_sched_build_round(scheduler->round);
+    fp_parker_init(&scheduler->parker);
+    return scheduler;
+}
+
+void fp_scheduler_destroy(fp_scheduler *scheduler) {
+    if (!scheduler) {
+        return;
+    }
+    for (size_t l = 0; l < scheduler->lane_count; ++l) {
+        for (size_t c = 0; c < FP_JOB_CLASS_COUNT; ++c) {
+            pthread_mutex_destroy(&scheduler->lanes[l].classes[c].mutex);
+            free(scheduler->lanes[l].classes[c].heap);
+        }
+    }
+    free(scheduler->lanes);
+    free(scheduler);
+}
+
+static int fp_sched_lane_push(fp_scheduler *scheduler,
+                              fp_sched_lane *lane,
+                              fp_job_class c,
+                              const fp_sched_entry *entry,
+                              uint64_t now_ms) {
+    fp_sched_class *cls = &lane->classes[c];
+    pthread_mutex_lock(&cls->mutex);
+    if (cls->count == cls->capacity) {
+        pthread_mutex_unlock(&cls->mutex);
+        return -1;
+    }
+    cls->heap[cls->count] = *entry;
+    cls->heap[cls->count].seq = cls->next_seq++;
+    fp_sched_sift_up(cls->heap, cls->count);
+    cls->count++;
+    atomic_store_explicit(&lane->queued[c], cls->count, memory_order_relaxed);
+    if (atomic_fetch_add_explicit(&scheduler->queued[c], 1, memory_order_relaxed) == 0) {
+        atomic_store_explicit(&scheduler->waiting_since_ms[c], now_ms, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&cls->mutex);
+    return 0;
+}
+
+int fp_scheduler_push(fp_scheduler *scheduler, fp_job *job) {
+    if (!scheduler || !job) {
+        errno = EINVAL;
+        return -1;
+    }
+    fp_job_class c = job->job_class < FP_JOB_CLASS_COUNT ? job->job_class : FP_JOB_FREE;
+    uint64_t now_ms = fp_sched_now_ms();
+    uint64_t queued_ms = now_ms;
+    if (job->enqueue_ts.tv_sec != 0 || job->enqueue_ts.tv_nsec != 0) {
+        // Stamped when the job was built, so a retried push keeps its place.
+        queued_ms = (uint64_t)job->enqueue_ts.tv_sec * 1000ULL + (uint64_t)job->enqueue_ts.tv_nsec / 1000000ULL;
+    }
+    double cost = job->predicted_ms > 0.0 ? job->predicted_ms : 0.0;
+    if (cost > scheduler->spjf_window_ms) {
+        cost = scheduler->spjf_window_ms;
+    }
+    fp_sched_entry entry = {.key = (double)queued_ms + cost, .job = job};
+
+    // Round robin over the lanes, moving on while the chosen one is full.
+    size_t first = atomic_fetch_add_explicit(&scheduler->next_lane, 1, memory_order_relaxed);
+    for (size_t n = 0; n < scheduler->lane_count; ++n) {
+        fp_sched_lane *lane = &scheduler->lanes[(first + n) % scheduler->lane_count];
+        if (fp_sched_lane_push(scheduler, lane, c, &entry, now_ms) == 0) {
+            fp_parker_wake(&scheduler->parker, 1);
+            return 0;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+static fp_job *fp_sched_lane_take(fp_scheduler *scheduler, fp_sched_lane *lane, fp_job_class c, uint64_t now_ms) {
+    if (atomic_load_explicit(&lane->queued[c], memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    fp_sched_class *cls = &lane->classes[c];
+    fp_job *job = NULL;
+    pthread_mutex_lock(&cls->mutex);
+    if (cls->count > 0) {
+        job = cls->heap[0].job;
+        cls->count--;
+        cls->heap[0] = cls->heap[cls->count];
+        fp_sched_sift_down(cls->heap, cls->count, 0);
+        atomic_store_explicit(&lane->queued[c], cls->count, memory_order_relaxed);
+        size_t left = atomic_fetch_sub_explicit(&scheduler->queued[c], 1, memory_order_relaxed) - 1;
+        atomic_store_explicit(&scheduler->waiting_since_ms[c], left > 0 ? now_ms : 0, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&cls->mutex);
+    return job;
+}
+
+// Takes a job of class c from lane, or from the other lanes nearest first.
+static fp_job *fp_sched_take_any(fp_scheduler *scheduler, size_t lane, fp_job_class c, uint64_t now_ms) {
+    if (atomic_load_explicit(&scheduler->queued[c], memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    fp_job *job = NULL;
+    for (size_t n = 0; !job && n < scheduler->lane_count; ++n) {
+        job = fp_sched_lane_take(scheduler, &scheduler->lanes[(lane + n) % scheduler->lane_count], c, now_ms);
+    }
+    return job;
+}
+
+fp_job *fp_scheduler_pop(fp_scheduler *scheduler, size_t lane) {
+    if (!scheduler) {
+        errno = EINVAL;
+        return NULL;
+    }
+    lane %= scheduler->lane_count;
+    uint64_t now_ms = fp_sched_now_ms();
+
+    // A class that has waited past aging_ms goes first, longest-waiting
+    // first; ties go to the lower priority, which is the one at risk of
+    // starving. Another thread may have stamped a later time than now_ms.
+    size_t aged = FP_JOB_CLASS_COUNT;
+    uint64_t aged_since = UINT64_MAX;
+    for (size_t i = FP_JOB_CLASS_COUNT; i-- > 0;) {
+        fp_job_class c = fp_sched_priority[i];
+        uint64_t since = atomic_load_explicit(&scheduler->waiting_since_ms[c], memory_order_relaxed);
+        if (since != 0 && since <= now_ms && now_ms - since >= scheduler->aging_ms && since < aged_since) {
+            aged = c;
+            aged_since = since;
+        }
+    }
+    fp_job *job = NULL;
+    if (aged < FP_JOB_CLASS_COUNT) {
+        job = fp_sched_take_any(scheduler, lane, (fp_job_class)aged, now_ms);
+        if (job) {
+            return job;
+        }
+    }
+
+    // The class is picked from the counts over all lanes, so a job's
+    // priority does not depend on the lane it landed in; the lane only
+    // decides which worker is likely to run it.
+    size_t queued = 0;
+    for (size_t c = 0; c < FP_JOB_CLASS_COUNT; ++c) {
+        queued += atomic_load_explicit(&scheduler->queued[c], memory_order_relaxed);
+    }
+    if (queued == 0) {
+        errno = EAGAIN;
+        return NULL; // leave the ticket alone so idle polling does not skew the round
+    }
+    fp_sched_lane *own = &scheduler->lanes[lane];
+    size_t ticket = atomic_fetch_add_explicit(&own->ticket, 1, memory_order_relaxed);
+    fp_job_class pick = scheduler->round[ticket % FP_SCHED_ROUND];
+    job = fp_sched_take_any(scheduler, lane, pick, now_ms);
+    for (size_t i = 0; !job && i < FP_JOB_CLASS_COUNT; ++i) {
+        if (fp_sched_priority[i] != pick) {
+            job = fp_sched_take_any(scheduler, lane, fp_sched_priority[i], now_ms);
+        }
+    }
+    if (!job) {
+        errno = EAGAIN;
+    }
+    return job;
+}
+
+fp_job *fp_scheduler_pop_wait(fp_scheduler *scheduler, size_t lane, int timeout_ms) {
+    if (!scheduler) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (int spin = 0; spin < FP_SCHED_SPIN; ++spin) {
+        fp_job *job = fp_scheduler_pop(scheduler, lane);
+        if (job) {
+            return job;
+        }
+    }
+
+    struct timespec deadline;
+    fp_parker_deadline(&deadline, timeout_ms);
+    for (;;) {
+        uint32_t key = fp_parker_prepare(&scheduler->parker);
+        fp_job *job = fp_scheduler_pop(scheduler, lane);
+        if (job || atomic_load_explicit(&scheduler->closed, memory_order_acquire)) {
+            fp_parker_cancel(&scheduler->parker);
+            return job;
+        }
+        if (fp_parker_park(&scheduler->parker, key, timeout_ms < 0 ? NULL : &deadline) != 0) {
+            return fp_scheduler_pop(scheduler, lane); // timed out
+        }
+    }
+}
+
+void fp_scheduler_close(fp_scheduler *scheduler) {
+    if (!scheduler) {
+        return;
+    }
+    atomic_store_explicit(&scheduler->closed, true, memory_order_release);
+    fp_parker_wake(&scheduler->parker, INT_MAX);
+}
@@ -1,9 +1,11 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // SO_REUSEPORT
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <pthread.h>
 #include <stdarg.h>
@@ -16,20 +18,38 @@
 #include <string.h>
 #include <strings.h>
 #include <time.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
+#include <linux/sockios.h>
 
 #include "server.h"
+#include "admission.h"
+#include "compress.h"
 #include "ferret.h"
+#include "io_loop.h"
 #include "log.h"
 #include "progress.h"
+#include "static_cache.h"
+#include "output_store.h"
+#include "result_store.h"
+#include "base64.h"
+#include "http_parser.h"
+#include "multipart.h"
+#include "pool.h"
+#include "handoff.h"
+#include "worker.h"
 
 #define FP_MAX_HEADER (64 * 1024)
 #define FP_MAX_UPLOAD (100 * 1024 * 1024)
 #define FP_MIN_BUFFER 4096
-#define FP_SLEEP_NS 2000000
+#define FP_UPLOAD_CHUNK (64 * 1024)
 #define FP_EXPERT_MAX_FILES 10
 #define FP_EXPERT_MAX_FILE (20 * 1024 * 1024)
 #define FP_EXPERT_MAX_TOTAL (100 * 1024 * 1024)
@@ -39,6 +59,21 @@
 #define FP_PRICE_ANNUAL_DEFAULT "price_expert_annual"
 #define FP_PERIOD_MONTH_SECONDS (30 * 24 * 60 * 60)
 #define FP_PERIOD_ANNUAL_SECONDS (365 * 24 * 60 * 60)
+// Per-loop recycling caps: idle connections, header buffers, upload receive
+// windows and queued output records kept for reuse instead of freed.
+#define FP_POOL_CONNS 256
+#define FP_POOL_HEAD_BUFFERS 256
+#define FP_POOL_UPLOAD_WINDOWS 16
+#define FP_POOL_OUT_CHUNKS 1024
+#define FP_ACCEPT_BATCH 64 // connections taken per listener wakeup before other events get a turn
+#define FP_IO_TICK_MS 50
+#define FP_IOV_BATCH 64
+#define FP_STREAM_WAIT_MS 10000
+#define FP_PIPELINE_OUTPUT_LIMIT (4 * 1024 * 1024)
+#define FP_SSE_OUTPUT_LIMIT (8 * 1024 * 1024)
+#define FP_SSE_HEARTBEAT_MS 15000
+#define FP_BODY_WINDOW (64 * 1024)
+#define FP_JOB_WAIT_MAX_MS 30000
 
 static const char *FP_PUBLIC_ROOT = "public";
 static _Atomic uint64_t g_job_counter = 1;
@@ -72,14 +107,6 @@ static bool fp_is_known_target(const char *format, const char *label) {
     return false;
 }
 
-typedef struct {
-    char name[64];
-    char filename[FP_FILENAME_MAX];
-    char content_type[128];
-    const uint8_t *data;
-    size_t size;
-} fp_form_part;
-
 typedef struct {
     int png_level;
     int png_quant_colors;
@@ -97,11 +124,20 @@ typedef struct {
     char filename[FP_FILENAME_MAX];
     char authorization[256];
     char cookies[512];
+    char accept[128];
+    char accept_encoding[128];
+    char if_none_match[256];
+    char if_modified_since[64];
     char tune_format[8];
     char tune_label[32];
     int tune_direction;
     size_t content_length;
     uint64_t client_job_id;
+    uint64_t deadline_ms; // X-Deadline-Ms: budget for the job once submitted, 0 = none
+    bool keep_alive;
+    bool expect_continue;
+    bool has_transfer_encoding;
+    bool reference_outputs; // X-Progress-Mode: reference
 } fp_http_request;
 
 typedef struct {
@@ -112,6 +148,186 @@ typedef struct {
 
 #define FP_APPEND_LITERAL(buffer, literal) fp_buffer_append((buffer), (literal), sizeof(literal) - 1)
 
+typedef struct fp_server fp_server;
+typedef struct fp_conn fp_conn;
+typedef struct fp_pending_job fp_pending_job;
+typedef struct fp_stream_waiter fp_stream_waiter;
+typedef struct fp_async_job fp_async_job;
+
+// Called on the connection's I/O thread once a submitted job has a result, or
+// with result == NULL and an HTTP status/error when it could not be queued.
+// The callback owns result and ctx.
+typedef void (*fp_job_done_fn)(fp_conn *conn, fp_result *result, int http_status, const char *error, void *ctx);
+
+// Writes up to window_len bytes of a streamed response body into window and
+// returns how many it wrote; 0 means the body is complete. FP_BODY_PENDING
+// means more is coming later: whoever adds it calls fp_conn_flush.
+typedef size_t (*fp_body_producer_fn)(void *ctx, char *window, size_t window_len);
+#define FP_BODY_PENDING ((size_t)-1)
+
+typedef struct fp_out_chunk {
+    struct fp_out_chunk *next;
+    const uint8_t *data;
+    int file_fd; // >= 0: sendfile() size bytes starting at file_offset instead of data
+    off_t file_offset;
+    size_t size;
+    size_t offset;
+    void (*release)(void *ctx);
+    void *release_ctx;
+} fp_out_chunk;
+
+typedef enum {
+    FP_CONN_READ_HEADER = 0,
+    FP_CONN_READ_BODY,
+    FP_CONN_DISPATCH,
+    FP_CONN_WAIT_JOB,
+    FP_CONN_STREAM_WAIT,
+    FP_CONN_STREAM,
+    FP_CONN_POLL_WAIT, // GET /api/jobs/{id}?wait= parked until the job finishes
+    FP_CONN_PRODUCE, // body comes from a producer as the socket drains
+    FP_CONN_FLUSH,
+} fp_conn_state;
+
+// A multipart body scanned as it arrives; parts point into conn->body.
+typedef struct {
+    fp_multipart_parser parser;
+    fp_form_part parts[FP_EXPERT_MAX_FILES + 4];
+    bool failed;
+} fp_upload_form;
+
+struct fp_conn {
+    fp_io_watch watch;
+    fp_server *server;
+    fp_io_loop *loop;
+    fp_conn_state state;
+    _Atomic int refs;
+    bool closed;
+    bool close_after_flush;
+    bool keep_alive;
+    bool in_read;
+    unsigned requests_served;
+    uint64_t last_active_ms;
+    int last_unsent;   // kernel send-queue depth at the last idle check; INT_MAX after a write
+    char *inbuf; // unparsed bytes: the next header block plus any pipelined requests
+    size_t inbuf_capacity;
+    size_t inbuf_len;
+    fp_http_parser head_parser; // resumes over inbuf as the next request head arrives
+    fp_http_request request;
+    uint8_t *body;
+    size_t body_received;
+    bool upload_streamed;       // PNG body is decoded as it arrives instead of buffered
+    fp_png_stream *png_stream;  // NULL once the streamed body failed to decode
+    fp_rgba_image upload_image;
+    fp_upload_form *upload_form;
+    fp_out_chunk *out_head;
+    fp_out_chunk *out_tail;
+    size_t out_bytes;
+    uint64_t stream_deadline_ms;
+    fp_stream_waiter *stream_waiter;
+    fp_progress_channel *stream_channel;
+    bool stream_chunked;
+    bool stream_backlogged;    // drain stopped at FP_SSE_OUTPUT_LIMIT; resume once output drains
+    uint64_t stream_last_send_ms;
+    atomic_bool stream_drain_posted; // stream_task is queued
+    fp_io_task stream_task;
+    fp_body_producer_fn producer;
+    void *producer_ctx;
+    void (*producer_free)(void *ctx);
+    bool producer_chunked;
+    bool producer_waiting; // last call returned FP_BODY_PENDING
+    fp_result_watch *result_watch;
+    fp_io_task poll_task; // posted once when result_watch fires
+    uint64_t poll_job_id;
+    uint64_t poll_deadline_ms;
+    unsigned retry_after_s; // sent as Retry-After with the next 503
+    fp_pending_job *jobs;   // submitted jobs not finished yet; cancelled on hangup
+    struct fp_conn *prev;
+    struct fp_conn *next;
+};
+
+struct fp_pending_job {
+    uint64_t job_id;
+    fp_conn *conn;
+    fp_job *job; // owned here until it is accepted by job_queue
+    fp_cancel_token *cancel;
+    fp_progress_channel *progress;
+    size_t content_length;
+    uint64_t enqueue_deadline_ms;
+    fp_admit_class admit_class;
+    double work_units;
+    fp_result *result;
+    fp_io_task complete_task; // hands result to conn's loop
+    fp_job_done_fn done;
+    void *ctx;
+    struct fp_pending_job *retry_next;
+    struct fp_pending_job *conn_next;
+};
+
+// An event-stream request that arrived before its job was submitted.
+struct fp_stream_waiter {
+    uint64_t job_id;
+    fp_conn *conn;
+    fp_progress_channel *channel;
+    fp_io_task ready_task;
+    struct fp_stream_waiter *next;
+};
+
+// An accept socket as one loop watches it. The sockets themselves belong to
+// the server, which closes them (or hands them to its successor).
+typedef struct {
+    fp_io_watch watch;
+    bool exclusive; // only this loop watches the socket (SO_REUSEPORT group member)
+    bool paused;    // out of descriptors; re-armed on the next tick
+} fp_listener;
+
+typedef struct {
+    fp_server *server;
+    fp_io_loop *loop;       // the loop that owns this shard's connections
+    fp_io_task stop_task;   // stop accepting after a handoff
+    fp_io_task close_task;  // close every connection at shutdown
+    fp_conn *conns;
+    fp_pending_job *retry_head;
+    // POST /api/jobs work accepted on this loop and not finished yet; the
+    // workers unlink it, so the list has a lock. Cancelled at shutdown.
+    pthread_mutex_t async_mutex;
+    fp_async_job *async_jobs;
+    fp_listener *listeners;
+    size_t listener_count;
+    bool accepting;         // cleared once the listeners were handed to a new process
+    atomic_bool idle;       // draining and no connection left on this loop
+    fp_pool *conn_pool;     // fp_conn
+    fp_pool *head_pool;     // FP_MIN_BUFFER inbufs
+    fp_pool *window_pool;   // FP_UPLOAD_CHUNK inbufs used while an upload streams in
+    fp_pool *chunk_pool;    // fp_out_chunk
+} fp_io_shard;
+
+struct fp_server {
+    fp_server_config config;
+    fp_scheduler *job_queue;
+    fp_progress_registry *progress_registry;
+    fp_auth_store *auth_store;
+    fp_static_cache *static_cache; // NULL when disabled; assets are then read from disk per request
+    fp_output_store *output_store;
+    fp_result_store *result_store; // jobs submitted through POST /api/jobs
+    fp_admission *admission;
+    fp_io_loop **loops;
+    fp_io_shard *shards;
+    size_t loop_count;
+    pthread_mutex_t waiters_mutex;
+    fp_stream_waiter *waiters;
+    pthread_mutex_t stop_mutex;
+    pthread_cond_t stop_cond;
+    bool stopping; // a listener failed for good, or draining finished; fp_server_run returns
+    int tcp_fds[FP_HANDOFF_MAX_FDS];
+    size_t tcp_fd_count;
+    int unix_fd;   // FERRET_UNIX_SOCKET listener, -1 when not configured
+    fp_io_watch handoff_watch; // FERRET_HANDOFF_SOCKET control listener on loop 0, fd -1 when off
+    fp_io_watch successor;     // control connection of a process taking over, fd -1 when none
+    atomic_bool draining;      // listeners handed over: finish what is open, then exit
+    bool handed_off;
+    uint64_t drain_deadline_ms;
+};
+
 static void fp_buffer_free(fp_buffer *buffer) {
     if (!buffer) {
         return;
@@ -232,6 +448,7 @@ static int fp_buffer_append_json_string(fp_buffer *buffer, const char *value) {
     return 0;
 }
 
+
 static int fp_base64url_decode(const char *input, uint8_t **out, size_t *out_len) {
     if (!input || !out || !out_len) {
         return -1;
@@ -295,35 +512,6 @@ static int fp_base64url_decode(const char *input, uint8_t **out, size_t *out_len
     return 0;
 }
 
-static int fp_parse_boundary(const char *content_type, char *boundary, size_t boundary_len) {
-    if (!content_type || !boundary || boundary_len == 0) {
-        return -1;
-    }
-    const char *b = strstr(content_type, "boundary=");
-    if (!b) {
-        return -1;
-    }
-    b += 9;
-    while (*b == ' ' || *b == '\t') {
-        ++b;
-    }
-    size_t len = 0;
-    if (*b == '"') {
-        ++b;
-        while (b[len] && b[len] != '"' && len + 1 < boundary_len) {
-            boundary[len] = b[len];
-            ++len;
-        }
-    } else {
-        while (b[len] && b[len] != ';' && b[len] != ' ' && len + 1 < boundary_len) {
-            boundary[len] = b[len];
-            ++len;
-        }
-    }
-    boundary[len] = '\0';
-    return len > 0 ? 0 : -1;
-}
-
 static int fp_extract_json_string(const char *json, const char *key, char *out, size_t out_len) {
     if (!json || !key || !out || out_len == 0) {
         return -1;
@@ -690,221 +878,75 @@ static int fp_track_expert_usage(uint64_t user_id, size_t file_count, size_t tot
     return rc;
 }
 
-static const uint8_t *fp_memsearch(const uint8_t *haystack, size_t haystack_len, const uint8_t *needle, size_t needle_len) {
-    if (!haystack || !needle || needle_len == 0 || haystack_len < needle_len) {
-        return NULL;
-    }
-    for (size_t i = 0; i + needle_len <= haystack_len; ++i) {
-        if (memcmp(haystack + i, needle, needle_len) == 0) {
-            return haystack + i;
-        }
+// Fills request from a head fp_http_parser has accepted; buf is the buffer it parsed.
+static int fp_parse_request(const char *buf, const fp_http_parser *parser, fp_http_request *request) {
+    memset(request, 0, sizeof(*request));
+    fp_http_span_copy(buf, parser->method, request->method, sizeof(request->method));
+    for (char *p = request->method; *p; ++p) {
+        *p = (char)toupper((unsigned char)*p);
     }
-    return NULL;
-}
-
-static int fp_parse_multipart(const uint8_t *body, size_t body_len, const char *boundary, fp_form_part *parts, size_t max_parts, size_t *out_count) {
-    if (!body || !boundary || !parts || max_parts == 0) {
+    if (parser->target.len >= sizeof(request->path)) {
         return -1;
     }
-    char boundary_line[128];
-    snprintf(boundary_line, sizeof(boundary_line), "--%s", boundary);
-    size_t boundary_line_len = strlen(boundary_line);
-    const uint8_t *cursor = body;
-    const uint8_t *end = body + body_len;
-    size_t count = 0;
-
-    while (true) {
-        const uint8_t *marker = fp_memsearch(cursor, (size_t)(end - cursor), (const uint8_t *)boundary_line, boundary_line_len);
-        if (!marker) {
-            break;
-        }
-        marker += boundary_line_len;
-        if (marker + 2 <= end && marker[0] == '-' && marker[1] == '-') {
-            break; // end marker
-        }
-        if (marker + 2 > end || marker[0] != '\r' || marker[1] != '\n') {
-            return -1;
-        }
-        const uint8_t *header_start = marker + 2;
-        const uint8_t *header_end = fp_memsearch(header_start, (size_t)(end - header_start), (const uint8_t *)"\r\n\r\n", 4);
-        if (!header_end) {
-            return -1;
-        }
-        size_t header_len = (size_t)(header_end - header_start);
-        char *header_copy = strndup((const char *)header_start, header_len);
-        if (!header_copy) {
-            return -1;
-        }
-
-        fp_form_part part = {0};
-        char *saveptr = NULL;
-        char *line = strtok_r(header_copy, "\r\n", &saveptr);
-        while (line) {
-            if (strncasecmp(line, "content-disposition", 19) == 0) {
-                char *name_pos = strstr(line, "name=\"");
-                if (name_pos) {
-                    name_pos += 6;
-                    char *endq = strchr(name_pos, '"');
-                    if (endq) {
-                        size_t len = (size_t)(endq - name_pos);
-                        if (len >= sizeof(part.name)) {
-                            len = sizeof(part.name) - 1;
-                        }
-                        memcpy(part.name, name_pos, len);
-                        part.name[len] = '\0';
-                    }
-                }
-                char *file_pos = strstr(line, "filename=\"");
-                if (file_pos) {
-                    file_pos += 10;
-                    char *endq = strchr(file_pos, '"');
-                    if (endq) {
-                        size_t len = (size_t)(endq - file_pos);
-                        if (len >= sizeof(part.filename)) {
-                            len = sizeof(part.filename) - 1;
-                        }
-                        memcpy(part.filename, file_pos, len);
-                        part.filename[len] = '\0';
-                    }
-                }
-            } else if (strncasecmp(line, "content-type", 12) == 0) {
-                char *colon = strchr(line, ':');
-                if (colon) {
-                    ++colon;
-                    while (*colon == ' ' || *colon == '\t') {
-                        ++colon;
-                    }
-                    strncpy(part.content_type, colon, sizeof(part.content_type) - 1);
-                }
-            }
-            line = strtok_r(NULL, "\r\n", &saveptr);
-        }
-        free(header_copy);
-
-        const uint8_t *data_start = header_end + 4;
-        const uint8_t *next_boundary = fp_memsearch(data_start, (size_t)(end - data_start), (const uint8_t *)boundary_line, boundary_line_len);
-        if (!next_boundary) {
-            return -1;
-        }
-        if (next_boundary < body + 2 || next_boundary[-2] != '\r' || next_boundary[-1] != '\n') {
-            return -1;
-        }
-        part.data = data_start;
-        part.size = (size_t)(next_boundary - data_start - 2); // strip trailing \r\n before boundary
-
-        if (part.name[0] && count < max_parts) {
-            parts[count++] = part;
-        }
-
-        cursor = next_boundary;
-    }
-
-    if (out_count) {
-        *out_count = count;
-    }
-    return 0;
-}
-
-static ssize_t fp_find_header_boundary(const char *buffer, size_t len) {
-    if (len < 4) {
+    fp_http_span_copy(buf, parser->target, request->path, sizeof(request->path));
+    request->keep_alive = strncmp(buf + parser->version.offset, "HTTP/1.1", 8) == 0;
+    if (fp_http_parser_content_length(parser, buf, &request->content_length) != 0) {
         return -1;
     }
-    for (size_t i = 3; i < len; ++i) {
-        if (buffer[i - 3] == '\r' && buffer[i - 2] == '\n' && buffer[i - 1] == '\r' && buffer[i] == '\n') {
-            return (ssize_t)(i + 1);
-        }
-    }
-    return -1;
-}
 
-static int fp_read_header_block(int fd, char **buffer_out, size_t *header_len_out, size_t *total_len_out) {
-    size_t capacity = FP_MIN_BUFFER;
-    char *buffer = malloc(capacity);
-    if (!buffer) {
-        return -1;
-    }
-    size_t len = 0;
-    while (len < FP_MAX_HEADER) {
-        if (capacity - len < FP_MIN_BUFFER) {
-            size_t next_capacity = capacity * 2;
-            char *tmp = realloc(buffer, next_capacity);
-            if (!tmp) {
-                free(buffer);
-                return -1;
+    for (size_t i = 0; i < parser->header_count; ++i) {
+        fp_http_span name = parser->headers[i].name;
+        fp_http_span value_span = parser->headers[i].value;
+        const char *value = buf + value_span.offset;
+        if (fp_http_span_equals(buf, name, "content-type")) {
+            fp_http_span_copy(buf, value_span, request->content_type, sizeof(request->content_type));
+        } else if (fp_http_span_equals(buf, name, "x-filename")) {
+            fp_http_span_copy(buf, value_span, request->filename, sizeof(request->filename));
+        } else if (fp_http_span_equals(buf, name, "authorization")) {
+            fp_http_span_copy(buf, value_span, request->authorization, sizeof(request->authorization));
+        } else if (fp_http_span_equals(buf, name, "cookie")) {
+            fp_http_span_copy(buf, value_span, request->cookies, sizeof(request->cookies));
+        } else if (fp_http_span_equals(buf, name, "accept")) {
+            fp_http_span_copy(buf, value_span, request->accept, sizeof(request->accept));
+        } else if (fp_http_span_equals(buf, name, "accept-encoding")) {
+            fp_http_span_copy(buf, value_span, request->accept_encoding, sizeof(request->accept_encoding));
+        } else if (fp_http_span_equals(buf, name, "if-none-match")) {
+            fp_http_span_copy(buf, value_span, request->if_none_match, sizeof(request->if_none_match));
+        } else if (fp_http_span_equals(buf, name, "if-modified-since")) {
+            fp_http_span_copy(buf, value_span, request->if_modified_since, sizeof(request->if_modified_since));
+        } else if (fp_http_span_equals(buf, name, "x-progress-mode")) {
+            request->reference_outputs = value_span.len >= 9 && strncasecmp(value, "reference", 9) == 0;
+        } else if (fp_http_span_equals(buf, name, "x-deadline-ms")) {
+            char deadline[24];
+            fp_http_span_copy(buf, value_span, deadline, sizeof(deadline));
+            request->deadline_ms = strtoull(deadline, NULL, 10);
+        } else if (fp_http_span_equals(buf, name, "x-job-id")) {
+            char id[24];
+            fp_http_span_copy(buf, value_span, id, sizeof(id));
+            request->client_job_id = strtoull(id, NULL, 10);
+        } else if (fp_http_span_equals(buf, name, "x-tune-format")) {
+            fp_http_span_copy(buf, value_span, request->tune_format, sizeof(request->tune_format));
+        } else if (fp_http_span_equals(buf, name, "x-tune-label")) {
+            fp_http_span_copy(buf, value_span, request->tune_label, sizeof(request->tune_label));
+        } else if (fp_http_span_equals(buf, name, "connection")) {
+            char connection[64];
+            fp_http_span_copy(buf, value_span, connection, sizeof(connection));
+            for (char *p = connection; *p; ++p) {
+                *p = (char)tolower((unsigned char)*p);
             }
-            capacity = next_capacity;
-            buffer = tmp;
-        }
-        ssize_t received = recv(fd, buffer + len, capacity - len, 0);
-        if (received <= 0) {
-            free(buffer);
-            return -1;
-        }
-        len += (size_t)received;
-        ssize_t boundary = fp_find_header_boundary(buffer, len);
-        if (boundary >= 0) {
-            *buffer_out = buffer;
-            *header_len_out = (size_t)boundary;
-            *total_len_out = len;
-            return 0;
-        }
-    }
-
-    free(buffer);
-    return -1;
-}
-
-static int fp_parse_request(char *header_block, fp_http_request *request) {
-    memset(request, 0, sizeof(*request));
-    char *saveptr = NULL;
-    char *line = strtok_r(header_block, "\r\n", &saveptr);
-    if (!line) {
-        return -1;
-    }
-    if (sscanf(line, "%7s %255s", request->method, request->path) != 2) {
-        return -1;
-    }
-    for (char *p = request->method; *p; ++p) {
-        *p = (char)toupper((unsigned char)*p);
-    }
-
-    while ((line = strtok_r(NULL, "\r\n", &saveptr))) {
-        if (*line == '\0') {
-            break;
-        }
-        char *colon = strchr(line, ':');
-        if (!colon) {
-            continue;
-        }
-        *colon = '\0';
-        char *name = line;
-        char *value = colon + 1;
-        while (*value == ' ' || *value == '\t') {
-            ++value;
-        }
-        for (char *p = name; *p; ++p) {
-            *p = (char)tolower((unsigned char)*p);
-        }
-        if (strcmp(name, "content-length") == 0) {
-            request->content_length = (size_t)strtoull(value, NULL, 10);
-        } else if (strcmp(name, "content-type") == 0) {
-            strncpy(request->content_type, value, sizeof(request->content_type) - 1);
-        } else if (strcmp(name, "x-filename") == 0) {
-            strncpy(request->filename, value, sizeof(request->filename) - 1);
-        } else if (strcmp(name, "authorization") == 0) {
-            strncpy(request->authorization, value, sizeof(request->authorization) - 1);
-        } else if (strcmp(name, "cookie") == 0) {
-            strncpy(request->cookies, value, sizeof(request->cookies) - 1);
-        } else if (strcmp(name, "x-job-id") == 0) {
-            request->client_job_id = strtoull(value, NULL, 10);
-        } else if (strcmp(name, "x-tune-format") == 0) {
-            strncpy(request->tune_format, value, sizeof(request->tune_format) - 1);
-        } else if (strcmp(name, "x-tune-label") == 0) {
-            strncpy(request->tune_label, value, sizeof(request->tune_label) - 1);
-        } else if (strcmp(name, "x-tune-intent") == 0) {
-            if (strncasecmp(value, "more", 4) == 0) {
+            if (strstr(connection, "close")) {
+                request->keep_alive = false;
+            } else if (strstr(connection, "keep-alive")) {
+                request->keep_alive = true;
+            }
+        } else if (fp_http_span_equals(buf, name, "expect")) {
+            request->expect_continue = value_span.len >= 12 && strncasecmp(value, "100-continue", 12) == 0;
+        } else if (fp_http_span_equals(buf, name, "transfer-encoding")) {
+            request->has_transfer_encoding = !fp_http_span_equals(buf, value_span, "identity");
+        } else if (fp_http_span_equals(buf, name, "x-tune-intent")) {
+            if (value_span.len >= 4 && strncasecmp(value, "more", 4) == 0) {
                 request->tune_direction = 1;
-            } else if (strncasecmp(value, "less", 4) == 0) {
+            } else if (value_span.len >= 4 && strncasecmp(value, "less", 4) == 0) {
                 request->tune_direction = -1;
             }
         }
@@ -1144,48 +1186,430 @@ static bool fp_parse_stream_path(const char *path, uint64_t *job_id_out) {
     return true;
 }
 
-static const char *fp_guess_mime(const char *path) {
-    const char *ext = strrchr(path, '.');
-    if (!ext) {
-        return "application/octet-stream";
+// Matches /api/jobs/{id}/outputs/{n}.
+static bool fp_parse_output_path(const char *path, uint64_t *job_id_out, size_t *index_out) {
+    if (!path || strncmp(path, "/api/jobs/", 10) != 0) {
+        return false;
+    }
+    char *endptr = NULL;
+    unsigned long long job_id = strtoull(path + 10, &endptr, 10);
+    if (!endptr || job_id == 0 || strncmp(endptr, "/outputs/", 9) != 0) {
+        return false;
     }
-    if (strcmp(ext, ".html") == 0) {
-        return "text/html; charset=utf-8";
+    const char *cursor = endptr + 9;
+    if (!isdigit((unsigned char)*cursor)) {
+        return false;
+    }
+    unsigned long index = strtoul(cursor, &endptr, 10);
+    if (*endptr != '\0' || index >= FP_MAX_OUTPUTS) {
+        return false;
     }
-    if (strcmp(ext, ".css") == 0) {
-        return "text/css; charset=utf-8";
+    *job_id_out = (uint64_t)job_id;
+    *index_out = (size_t)index;
+    return true;
+}
+
+// Matches /api/jobs/{id} with an optional ?wait={seconds} (capped at
+// FP_JOB_WAIT_MAX_MS).
+static bool fp_parse_job_path(const char *path, uint64_t *job_id_out, uint64_t *wait_ms_out) {
+    if (!path || strncmp(path, "/api/jobs/", 10) != 0) {
+        return false;
     }
-    if (strcmp(ext, ".js") == 0) {
-        return "application/javascript";
+    char *endptr = NULL;
+    unsigned long long job_id = strtoull(path + 10, &endptr, 10);
+    if (!endptr || job_id == 0) {
+        return false;
     }
-    if (strcmp(ext, ".png") == 0) {
-        return "image/png";
+    uint64_t wait_ms = 0;
+    if (strncmp(endptr, "?wait=", 6) == 0 && isdigit((unsigned char)endptr[6])) {
+        unsigned long long seconds = strtoull(endptr + 6, &endptr, 10);
+        wait_ms = seconds >= FP_JOB_WAIT_MAX_MS / 1000 ? FP_JOB_WAIT_MAX_MS : seconds * 1000ULL;
     }
-    if (strcmp(ext, ".svg") == 0) {
-        return "image/svg+xml";
+    if (*endptr != '\0') {
+        return false;
     }
-    return "application/octet-stream";
+    *job_id_out = (uint64_t)job_id;
+    *wait_ms_out = wait_ms;
+    return true;
 }
 
-static int fp_send_buffer(int fd, const void *data, size_t len) {
-    const uint8_t *bytes = (const uint8_t *)data;
-    size_t sent = 0;
-    while (sent < len) {
-#ifdef _WIN32
-        ssize_t wrote = send(fd, (const char *)(bytes + sent), (int)(len - sent), 0);
-#else
-        ssize_t wrote = send(fd, bytes + sent, len - sent, 0);
-#endif
-        if (wrote <= 0) {
-            return -1;
+static void fp_conn_retain(fp_conn *conn) {
+    atomic_fetch_add_explicit(&conn->refs, 1, memory_order_relaxed);
+}
+
+static void fp_conn_release(fp_conn *conn) {
+    if (atomic_fetch_sub_explicit(&conn->refs, 1, memory_order_acq_rel) == 1) {
+        // The pools belong to the loop; a last reference dropped elsewhere frees.
+        if (fp_io_loop_is_current(conn->loop)) {
+            fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+            fp_pool_put(shard->conn_pool, conn);
+        } else {
+            free(conn);
+        }
+    }
+}
+
+static void fp_out_chunk_free(fp_conn *conn, fp_out_chunk *chunk) {
+    if (chunk->file_fd >= 0) {
+        close(chunk->file_fd);
+    }
+    if (chunk->release) {
+        chunk->release(chunk->release_ctx);
+    }
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+    fp_pool_put(shard->chunk_pool, chunk);
+}
+
+// Hands inbuf back to the pool matching its size; grown buffers are freed.
+static void fp_conn_drop_inbuf(fp_conn *conn) {
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+    if (conn->inbuf_capacity == FP_MIN_BUFFER) {
+        fp_pool_put(shard->head_pool, conn->inbuf);
+    } else if (conn->inbuf_capacity == FP_UPLOAD_CHUNK) {
+        fp_pool_put(shard->window_pool, conn->inbuf);
+    } else {
+        free(conn->inbuf);
+    }
+    conn->inbuf = NULL;
+    conn->inbuf_capacity = 0;
+    conn->inbuf_len = 0;
+}
+
+static void fp_conn_stream_detach(fp_conn *conn);
+static void fp_conn_stream_notify(fp_progress_channel *channel, void *ctx);
+static void fp_conn_on_readable(fp_conn *conn);
+
+// Drops the connection's long-poll watch. Returns false when the job already
+// finished and a ready task is on its way.
+static bool fp_conn_poll_cancel(fp_conn *conn) {
+    fp_result_watch *watch = conn->result_watch;
+    if (!watch) {
+        return true;
+    }
+    if (!fp_result_store_unwatch(conn->server->result_store, watch)) {
+        return false;
+    }
+    conn->result_watch = NULL;
+    fp_conn_release(conn);
+    return true;
+}
+
+static void fp_conn_close(fp_conn *conn) {
+    if (!conn || conn->closed) {
+        return;
+    }
+    conn->closed = true;
+    for (fp_pending_job *pending = conn->jobs; pending; pending = pending->conn_next) {
+        fp_cancel_token_cancel(pending->cancel); // nobody is left to read the result
+    }
+    fp_io_loop_remove(conn->loop, &conn->watch);
+    close(conn->watch.fd);
+    fp_conn_stream_detach(conn);
+    fp_conn_poll_cancel(conn);
+    if (conn->producer_free) {
+        conn->producer_free(conn->producer_ctx);
+    }
+    conn->producer = NULL;
+    conn->producer_free = NULL;
+    conn->producer_ctx = NULL;
+    while (conn->out_head) {
+        fp_out_chunk *next = conn->out_head->next;
+        fp_out_chunk_free(conn, conn->out_head);
+        conn->out_head = next;
+    }
+    conn->out_tail = NULL;
+    conn->out_bytes = 0;
+    fp_conn_drop_inbuf(conn);
+    free(conn->body);
+    conn->body = NULL;
+    free(conn->upload_form);
+    conn->upload_form = NULL;
+    fp_png_stream_destroy(conn->png_stream);
+    conn->png_stream = NULL;
+    fp_rgba_image_free(&conn->upload_image);
+
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else if (shard->conns == conn) {
+        shard->conns = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    conn->prev = NULL;
+    conn->next = NULL;
+    fp_conn_release(conn);
+}
+
+static void fp_conn_update_interest(fp_conn *conn) {
+    if (conn->closed) {
+        return;
+    }
+    uint32_t events = 0;
+    switch (conn->state) {
+        case FP_CONN_READ_HEADER:
+        case FP_CONN_READ_BODY:
+            // Stop reading pipelined requests while their responses pile up unread.
+            events = conn->out_bytes < FP_PIPELINE_OUTPUT_LIMIT ? EPOLLIN : 0;
+            break;
+        case FP_CONN_WAIT_JOB:
+        case FP_CONN_STREAM_WAIT:
+        case FP_CONN_STREAM:
+        case FP_CONN_POLL_WAIT:
+        case FP_CONN_PRODUCE:
+            // Nothing more is read while a job runs; RDHUP reports a client that gave up.
+            events = EPOLLRDHUP;
+            break;
+        default:
+            break;
+    }
+    if (conn->out_head) {
+        events |= EPOLLOUT;
+    }
+    if (fp_io_loop_modify(conn->loop, &conn->watch, events) != 0) {
+        fp_log_warn("⚠️ Failed to update poll interest for fd %d: %s", conn->watch.fd, strerror(errno));
+        fp_conn_close(conn);
+    }
+}
+
+// Appends data to the connection's output queue. release(release_ctx) runs once
+// the bytes are written or dropped, so callers can hand over ownership without
+// copying. Chunks are released in queue order; a zero-length chunk with a
+// release hook marks the point where earlier borrowed buffers are done.
+// A chunk that cannot be queued leaves the response truncated, so the
+// connection is closed before release runs.
+static int fp_conn_queue(fp_conn *conn, const void *data, size_t len, void (*release)(void *), void *release_ctx) {
+    if (!conn || conn->closed) {
+        if (release) {
+            release(release_ctx);
+        }
+        return -1;
+    }
+    if (len == 0 && !release) {
+        return 0;
+    }
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+    fp_out_chunk *chunk = fp_pool_get(shard->chunk_pool);
+    if (!chunk) {
+        fp_conn_close(conn);
+        if (release) {
+            release(release_ctx);
         }
-        sent += (size_t)wrote;
+        return -1;
     }
+    chunk->next = NULL;
+    chunk->data = data ? (const uint8_t *)data : (const uint8_t *)"";
+    chunk->file_fd = -1;
+    chunk->file_offset = 0;
+    chunk->size = len;
+    chunk->offset = 0;
+    chunk->release = release;
+    chunk->release_ctx = release_ctx;
+    if (conn->out_tail) {
+        conn->out_tail->next = chunk;
+    } else {
+        conn->out_head = chunk;
+    }
+    conn->out_tail = chunk;
+    conn->out_bytes += len;
     return 0;
 }
 
-static int fp_send_http_with_headers(int fd, int status, const char *status_text, const char *content_type,
-                                     const char *extra_headers, const void *body, size_t body_len) {
+static int fp_conn_queue_copy(fp_conn *conn, const void *data, size_t len) {
+    if (!conn || conn->closed) {
+        return -1;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    uint8_t *copy = malloc(len);
+    if (!copy) {
+        fp_conn_close(conn);
+        return -1;
+    }
+    memcpy(copy, data, len);
+    return fp_conn_queue(conn, copy, len, free, copy);
+}
+
+// Moves the buffer's storage into the output queue and leaves the buffer empty.
+static int fp_conn_queue_buffer(fp_conn *conn, fp_buffer *buffer) {
+    char *data = buffer->data;
+    size_t size = buffer->size;
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+    if (!data) {
+        return conn && !conn->closed ? 0 : -1;
+    }
+    return fp_conn_queue(conn, data, size, free, data);
+}
+
+// Queues len bytes of an open file to be sent with sendfile(); the chunk owns
+// file_fd and closes it once sent or when the connection goes away.
+static int fp_conn_queue_file(fp_conn *conn, int file_fd, off_t offset, size_t len) {
+    if (!conn || conn->closed) {
+        close(file_fd);
+        return -1;
+    }
+    if (fp_conn_queue(conn, NULL, len, NULL, NULL) != 0 || !conn->out_tail) {
+        close(file_fd);
+        return -1;
+    }
+    conn->out_tail->file_fd = file_fd;
+    conn->out_tail->file_offset = offset;
+    return 0;
+}
+
+static void fp_conn_complete_response(fp_conn *conn);
+
+// Tops the output queue up to one window of freshly produced body bytes, so a
+// streamed response holds at most about two windows in memory. Once the
+// producer runs dry the body is terminated and the response completed.
+static void fp_conn_produce(fp_conn *conn) {
+    static const char last_chunk[] = "0\r\n\r\n";
+    enum { HEADER_ROOM = 8 }; // chunk-size line, at most "10000\r\n"
+    while (conn->producer && !conn->closed && conn->out_bytes < FP_BODY_WINDOW) {
+        char *window = malloc(HEADER_ROOM + FP_BODY_WINDOW + 2);
+        if (!window) {
+            fp_conn_close(conn);
+            return;
+        }
+        size_t len = conn->producer(conn->producer_ctx, window + HEADER_ROOM, FP_BODY_WINDOW);
+        conn->producer_waiting = len == FP_BODY_PENDING;
+        if (conn->producer_waiting) {
+            free(window);
+            return;
+        }
+        if (len == 0) {
+            free(window);
+            if (conn->producer_free) {
+                conn->producer_free(conn->producer_ctx);
+            }
+            conn->producer = NULL;
+            conn->producer_free = NULL;
+            conn->producer_ctx = NULL;
+            if (conn->producer_chunked) {
+                fp_conn_queue(conn, last_chunk, sizeof(last_chunk) - 1, NULL, NULL);
+            }
+            fp_conn_complete_response(conn);
+            return;
+        }
+        char *start = window + HEADER_ROOM;
+        size_t total = len;
+        if (conn->producer_chunked) {
+            char header[HEADER_ROOM + 1];
+            int header_len = snprintf(header, sizeof(header), "%zx\r\n", len);
+            start -= header_len;
+            memcpy(start, header, (size_t)header_len);
+            memcpy(window + HEADER_ROOM + len, "\r\n", 2);
+            total += (size_t)header_len + 2;
+        }
+        if (fp_conn_queue(conn, start, total, free, window) != 0) {
+            return;
+        }
+    }
+}
+
+static void fp_conn_flush(fp_conn *conn) {
+    if (!conn || conn->closed) {
+        return;
+    }
+    fp_conn_produce(conn);
+    while (conn->out_head) {
+        ssize_t wrote;
+        if (conn->out_head->file_fd >= 0) {
+            fp_out_chunk *chunk = conn->out_head;
+            off_t position = chunk->file_offset + (off_t)chunk->offset;
+            wrote = sendfile(conn->watch.fd, chunk->file_fd, &position, chunk->size - chunk->offset);
+            if (wrote == 0 && chunk->size > chunk->offset) {
+                fp_conn_close(conn); // file shrank underneath us; the declared length can't be met
+                return;
+            }
+        } else {
+            // Memory chunks up to the next file chunk go out in one writev.
+            struct iovec iov[FP_IOV_BATCH];
+            int count = 0;
+            for (fp_out_chunk *chunk = conn->out_head; chunk && chunk->file_fd < 0 && count < FP_IOV_BATCH;
+                 chunk = chunk->next) {
+                iov[count].iov_base = (void *)(chunk->data + chunk->offset);
+                iov[count].iov_len = chunk->size - chunk->offset;
+                ++count;
+            }
+            wrote = writev(conn->watch.fd, iov, count);
+        }
+        if (wrote < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                fp_conn_update_interest(conn);
+                return;
+            }
+            fp_conn_close(conn);
+            return;
+        }
+        size_t remaining = (size_t)wrote;
+        conn->out_bytes -= remaining;
+        conn->last_active_ms = fp_io_loop_now_ms(conn->loop);
+        conn->last_unsent = INT_MAX;
+        while (conn->out_head) {
+            fp_out_chunk *chunk = conn->out_head;
+            size_t left = chunk->size - chunk->offset;
+            if (remaining < left) {
+                chunk->offset += remaining;
+                break;
+            }
+            remaining -= left;
+            conn->out_head = chunk->next;
+            if (!conn->out_head) {
+                conn->out_tail = NULL;
+            }
+            fp_out_chunk_free(conn, chunk);
+        }
+        fp_conn_produce(conn);
+    }
+    if (conn->close_after_flush) {
+        fp_conn_close(conn);
+        return;
+    }
+    fp_conn_update_interest(conn);
+    if (!conn->closed && conn->state == FP_CONN_STREAM && conn->stream_backlogged &&
+        conn->out_bytes < FP_SSE_OUTPUT_LIMIT / 2) {
+        conn->stream_backlogged = false;
+        fp_conn_stream_notify(conn->stream_channel, conn);
+    }
+    if (!conn->closed && !conn->in_read && conn->state == FP_CONN_READ_HEADER && conn->inbuf_len > 0) {
+        fp_conn_on_readable(conn); // resume pipelined requests that were already buffered
+    }
+}
+
+static void fp_conn_complete_response(fp_conn *conn) {
+    conn->requests_served++;
+    conn->last_active_ms = fp_io_loop_now_ms(conn->loop);
+    if (!conn->keep_alive) {
+        conn->state = FP_CONN_FLUSH;
+        conn->close_after_flush = true;
+        return;
+    }
+    conn->state = FP_CONN_READ_HEADER;
+}
+
+// Marks the current response complete. Keep-alive connections go back to
+// reading the next request; others close once their output drains. A
+// streamed body completes the response itself once its producer runs dry.
+static void fp_conn_end_response(fp_conn *conn) {
+    if (!conn || conn->closed) {
+        return;
+    }
+    if (conn->state != FP_CONN_PRODUCE) {
+        fp_conn_complete_response(conn);
+    }
+    fp_conn_flush(conn);
+}
+
+static int fp_send_http_head(fp_conn *conn, int status, const char *status_text, const char *content_type,
+                             const char *extra_headers, size_t body_len) {
     if (!status_text) {
         status_text = "OK";
     }
@@ -1208,30 +1632,77 @@ static int fp_send_http_with_headers(int fd, int status, const char *status_text
             return -1;
         }
     }
-    if (FP_APPEND_LITERAL(&header, "Connection: close\r\n\r\n") != 0) {
+    if (status == 503 && conn->retry_after_s > 0 &&
+        fp_buffer_appendf(&header, "Retry-After: %u\r\n", conn->retry_after_s) != 0) {
+        fp_buffer_free(&header);
+        return -1;
+    }
+    int rc;
+    if (conn->keep_alive) {
+        rc = fp_buffer_appendf(&header,
+                               "Connection: keep-alive\r\nKeep-Alive: timeout=%d\r\n\r\n",
+                               (int)(conn->server->config.idle_timeout_ms / 1000));
+    } else {
+        rc = FP_APPEND_LITERAL(&header, "Connection: close\r\n\r\n");
+    }
+    if (rc != 0) {
         fp_buffer_free(&header);
         return -1;
     }
-    if (fp_send_buffer(fd, header.data, header.size) != 0) {
+    return fp_conn_queue_buffer(conn, &header);
+}
+
+// Starts a response whose body is pulled from producer as the socket drains:
+// chunked on keep-alive connections, otherwise ended by closing the
+// connection. Takes ownership of ctx, which free_ctx releases once the body
+// is complete or the connection goes away.
+static int fp_send_http_streamed(fp_conn *conn, int status, const char *status_text, const char *content_type,
+                                 fp_body_producer_fn producer, void *ctx, void (*free_ctx)(void *)) {
+    fp_buffer header = {0};
+    int rc = fp_buffer_appendf(&header,
+                               "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nAccess-Control-Allow-Origin: *\r\n",
+                               status,
+                               status_text ? status_text : "OK",
+                               content_type);
+    if (rc == 0 && conn->keep_alive) {
+        rc = fp_buffer_appendf(&header,
+                               "Transfer-Encoding: chunked\r\nConnection: keep-alive\r\nKeep-Alive: timeout=%d\r\n\r\n",
+                               (int)(conn->server->config.idle_timeout_ms / 1000));
+    } else if (rc == 0) {
+        rc = FP_APPEND_LITERAL(&header, "Connection: close\r\n\r\n");
+    }
+    if (rc != 0 || fp_conn_queue_buffer(conn, &header) != 0) {
         fp_buffer_free(&header);
+        free_ctx(ctx);
+        return -1;
+    }
+    conn->state = FP_CONN_PRODUCE;
+    conn->producer = producer;
+    conn->producer_ctx = ctx;
+    conn->producer_free = free_ctx;
+    conn->producer_chunked = conn->keep_alive;
+    conn->producer_waiting = false;
+    return 0;
+}
+
+static int fp_send_http_with_headers(fp_conn *conn, int status, const char *status_text, const char *content_type,
+                                     const char *extra_headers, const void *body, size_t body_len) {
+    if (fp_send_http_head(conn, status, status_text, content_type, extra_headers, body_len) != 0) {
         return -1;
     }
-    fp_buffer_free(&header);
     if (body && body_len > 0) {
-        if (fp_send_buffer(fd, body, body_len) != 0) {
-            return -1;
-        }
+        return fp_conn_queue_copy(conn, body, body_len);
     }
     return 0;
 }
 
-static int fp_send_http(int fd, int status, const char *status_text, const char *content_type, const void *body, size_t body_len) {
-    return fp_send_http_with_headers(fd, status, status_text, content_type, NULL, body, body_len);
+static int fp_send_http(fp_conn *conn, int status, const char *status_text, const char *content_type, const void *body, size_t body_len) {
+    return fp_send_http_with_headers(conn, status, status_text, content_type, NULL, body, body_len);
 }
 
-static int fp_send_text(int fd, int status, const char *status_text, const char *message) {
+static int fp_send_text(fp_conn *conn, int status, const char *status_text, const char *message) {
     const char *body = message ? message : "";
-    return fp_send_http(fd, status, status_text, "text/plain; charset=utf-8", body, strlen(body));
+    return fp_send_http(conn, status, status_text, "text/plain; charset=utf-8", body, strlen(body));
 }
 
 static int fp_build_filesystem_path(const char *request_path, char *out_path, size_t out_len) {
@@ -1258,48 +1729,96 @@ static int fp_build_filesystem_path(const char *request_path, char *out_path, si
     return 0;
 }
 
-static int fp_send_static_file(int fd, const char *request_path) {
+// Validators and revalidation policy shared by cached and disk-backed assets.
+// Assets are not fingerprinted, so clients must revalidate before reuse.
+static bool fp_static_not_modified(const fp_http_request *request, const char *etag, const char *last_modified) {
+    if (request->if_none_match[0] != '\0') {
+        return fp_static_etag_matches(request->if_none_match, etag);
+    }
+    return request->if_modified_since[0] != '\0' && last_modified[0] != '\0' &&
+           strcmp(request->if_modified_since, last_modified) == 0;
+}
+
+static int fp_send_static_head(fp_conn *conn, int status, const char *status_text, const char *mime, bool vary,
+                               const char *encoding, const char *etag, const char *last_modified, size_t body_len) {
+    char headers[384];
+    int written = snprintf(headers, sizeof(headers),
+                           "%s%s%sETag: %s\r\nLast-Modified: %s\r\nCache-Control: no-cache\r\n%s",
+                           encoding ? "Content-Encoding: " : "", encoding ? encoding : "", encoding ? "\r\n" : "",
+                           etag, last_modified, vary ? "Vary: Accept-Encoding\r\n" : "");
+    if (written < 0 || (size_t)written >= sizeof(headers)) {
+        // The 500 is the whole response: fail so the caller queues no body.
+        fp_send_text(conn, 500, "Error", "Header overflow");
+        return -1;
+    }
+    return fp_send_http_head(conn, status, status_text, mime, headers, body_len);
+}
+
+static int fp_send_cached_asset(fp_conn *conn, const fp_static_asset *asset) {
+    const fp_static_variant *variant = fp_static_pick_variant(asset, conn->request.accept_encoding);
+    bool vary = asset->gzip.size > 0 || asset->brotli.size > 0;
+    if (fp_static_not_modified(&conn->request, variant->etag, asset->last_modified)) {
+        return fp_send_static_head(conn, 304, "Not Modified", asset->mime, vary, variant->encoding, variant->etag,
+                                   asset->last_modified, variant->size);
+    }
+    if (fp_send_static_head(conn, 200, "OK", asset->mime, vary, variant->encoding, variant->etag, asset->last_modified,
+                            variant->size) != 0) {
+        return -1;
+    }
+    // The cache outlives every connection, so the body is queued without a copy.
+    return fp_conn_queue(conn, variant->data, variant->size, NULL, NULL);
+}
+
+static int fp_send_static_file(fp_conn *conn, const char *request_path) {
     char fs_path[1024];
     if (fp_build_filesystem_path(request_path, fs_path, sizeof(fs_path)) != 0) {
-        return fp_send_text(fd, 403, "Forbidden", "Forbidden");
+        return fp_send_text(conn, 403, "Forbidden", "Forbidden");
     }
 
-    int file_fd = open(fs_path, O_RDONLY);
+    const fp_static_asset *asset =
+        fp_static_cache_find(conn->server->static_cache, fs_path + strlen(FP_PUBLIC_ROOT) + 1);
+    if (asset) {
+        return fp_send_cached_asset(conn, asset);
+    }
+
+    // Not cached (too large, added after startup, or caching disabled).
+    int file_fd = open(fs_path, O_RDONLY | O_CLOEXEC);
     if (file_fd < 0) {
-        return fp_send_text(fd, 404, "Not Found", "Not Found");
+        return fp_send_text(conn, 404, "Not Found", "Not Found");
     }
 
     struct stat st;
     if (fstat(file_fd, &st) != 0) {
         close(file_fd);
-        return fp_send_text(fd, 500, "Error", "Failed to stat file");
+        return fp_send_text(conn, 500, "Error", "Failed to stat file");
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(file_fd);
+        return fp_send_text(conn, 404, "Not Found", "Not Found");
     }
 
     size_t size = (size_t)st.st_size;
-    char *buffer = malloc(size);
-    if (!buffer) {
+    char etag[48];
+    char last_modified[32];
+    snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)size, (unsigned long long)st.st_mtime);
+    fp_static_format_http_date(st.st_mtime, last_modified, sizeof(last_modified));
+    const char *mime = fp_static_mime_type(fs_path);
+    if (fp_static_not_modified(&conn->request, etag, last_modified)) {
         close(file_fd);
-        return fp_send_text(fd, 500, "Error", "Out of memory");
+        return fp_send_static_head(conn, 304, "Not Modified", mime, false, NULL, etag, last_modified, size);
     }
-
-    size_t read_total = 0;
-    while (read_total < size) {
-        ssize_t read_bytes = read(file_fd, buffer + read_total, size - read_total);
-        if (read_bytes <= 0) {
-            free(buffer);
-            close(file_fd);
-            return fp_send_text(fd, 500, "Error", "Failed to read file");
-        }
-        read_total += (size_t)read_bytes;
+    if (fp_send_static_head(conn, 200, "OK", mime, false, NULL, etag, last_modified, size) != 0) {
+        close(file_fd);
+        return -1;
     }
-
-    close(file_fd);
-    int rc = fp_send_http(fd, 200, "OK", fp_guess_mime(fs_path), buffer, size);
-    free(buffer);
-    return rc;
+    if (size == 0) {
+        close(file_fd);
+        return 0;
+    }
+    return fp_conn_queue_file(conn, file_fd, 0, size);
 }
 
-static int fp_send_env_js(int fd) {
+static int fp_send_env_js(fp_conn *conn) {
     const char *client_id = getenv("FP_GOOGLE_CLIENT_ID");
     if (!client_id) {
         client_id = "";
@@ -1309,9 +1828,9 @@ static int fp_send_env_js(int fd) {
         fp_buffer_append_json_string(&resp, client_id) != 0 ||
         FP_APPEND_LITERAL(&resp, ";\n") != 0) {
         fp_buffer_free(&resp);
-        return fp_send_text(fd, 500, "Error", "Failed to build env payload");
+        return fp_send_text(conn, 500, "Error", "Failed to build env payload");
     }
-    int rc = fp_send_http(fd, 200, "OK", "application/javascript; charset=utf-8", resp.data, resp.size);
+    int rc = fp_send_http(conn, 200, "OK", "application/javascript; charset=utf-8", resp.data, resp.size);
     fp_buffer_free(&resp);
     return rc;
 }
@@ -1342,48 +1861,6 @@ static void fp_sanitize_filename(char *dst, size_t dst_size, const char *src) {
     dst[idx] = '\0';
 }
 
-static char *fp_base64_encode(const uint8_t *data, size_t len) {
-    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    size_t encoded_len = len ? (4 * ((len + 2) / 3)) : 0;
-    if (encoded_len == 0) {
-        char *empty = malloc(1);
-        if (empty) {
-            empty[0] = '\0';
-        }
-        return empty;
-    }
-    char *out = malloc(encoded_len + 1);
-    if (!out) {
-        return NULL;
-    }
-    size_t i = 0;
-    size_t j = 0;
-    while (i + 2 < len) {
-        uint32_t triple = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
-        out[j++] = table[(triple >> 18) & 0x3F];
-        out[j++] = table[(triple >> 12) & 0x3F];
-        out[j++] = table[(triple >> 6) & 0x3F];
-        out[j++] = table[triple & 0x3F];
-        i += 3;
-    }
-    size_t remaining = len - i;
-    if (remaining == 1) {
-        uint32_t triple = (uint32_t)data[i] << 16;
-        out[j++] = table[(triple >> 18) & 0x3F];
-        out[j++] = table[(triple >> 12) & 0x3F];
-        out[j++] = '=';
-        out[j++] = '=';
-    } else if (remaining == 2) {
-        uint32_t triple = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8);
-        out[j++] = table[(triple >> 18) & 0x3F];
-        out[j++] = table[(triple >> 12) & 0x3F];
-        out[j++] = table[(triple >> 6) & 0x3F];
-        out[j++] = '=';
-    }
-    out[encoded_len] = '\0';
-    return out;
-}
-
 static double fp_duration_ms(const fp_result *result) {
     if (!result) {
         return 0.0;
@@ -1393,20 +1870,29 @@ static double fp_duration_ms(const fp_result *result) {
     return end - start;
 }
 
-static int fp_send_json_error(int fd, int status, const char *message) {
+// HTTP status for a job that ran but failed: workers stopped by an expired
+// X-Deadline-Ms report a gateway timeout rather than a server fault.
+static int fp_result_error_status(const fp_result *result) {
+    if (result->status == FP_RESULT_CANCELLED && strcmp(result->message, "deadline_exceeded") == 0) {
+        return 504;
+    }
+    return 500;
+}
+
+static int fp_send_json_error(fp_conn *conn, int status, const char *message) {
     fp_buffer buffer = {0};
     if (FP_APPEND_LITERAL(&buffer, "{\"status\":\"error\",\"message\":") != 0 ||
         fp_buffer_append_json_string(&buffer, message ? message : "unknown") != 0 ||
         FP_APPEND_LITERAL(&buffer, "}") != 0) {
         fp_buffer_free(&buffer);
-        return fp_send_text(fd, 500, "Error", "Internal error");
+        return fp_send_text(conn, 500, "Error", "Internal error");
     }
-    int rc = fp_send_http(fd, status, "Error", "application/json", buffer.data, buffer.size);
+    int rc = fp_send_http(conn, status, "Error", "application/json", buffer.data, buffer.size);
     fp_buffer_free(&buffer);
     return rc;
 }
 
-static int fp_send_json_with_cookies(int fd, int status, const char *status_text, const char *json_body,
+static int fp_send_json_with_cookies(fp_conn *conn, int status, const char *status_text, const char *json_body,
                                      const char **cookies, size_t cookie_count) {
     const char *body = json_body ? json_body : "{}";
     fp_buffer header_lines = {0};
@@ -1418,7 +1904,7 @@ static int fp_send_json_with_cookies(int fd, int status, const char *status_text
             }
         }
     }
-    int rc = fp_send_http_with_headers(fd,
+    int rc = fp_send_http_with_headers(conn,
                                        status,
                                        status_text ? status_text : "OK",
                                        "application/json",
@@ -1429,68 +1915,360 @@ static int fp_send_json_with_cookies(int fd, int status, const char *status_text
     return rc;
 }
 
-static int fp_send_result_payload(int fd, const fp_result *result, const char *filename) {
-    fp_buffer body = {0};
-    if (FP_APPEND_LITERAL(&body, "{\"status\":\"ok\",\"jobId\":") != 0 ||
-        fp_buffer_appendf(&body, "%llu", (unsigned long long)result->id) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"message\":") != 0 ||
-        fp_buffer_append_json_string(&body, result->message) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"inputBytes\":") != 0 ||
-        fp_buffer_appendf(&body, "%zu", result->input_size) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"durationMs\":") != 0 ||
-        fp_buffer_appendf(&body, "%.3f", fp_duration_ms(result)) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"filename\":") != 0 ||
-        fp_buffer_append_json_string(&body, filename) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"results\":[") != 0) {
-        fp_buffer_free(&body);
-        return fp_send_json_error(fd, 500, "Failed to build payload");
+static void fp_blob_release_cb(void *ctx) {
+    fp_blob_release((fp_blob *)ctx);
+}
+
+static void fp_stored_result_release_cb(void *ctx) {
+    fp_stored_result_release((fp_stored_result *)ctx);
+}
+
+// Outputs of a finished async job stay downloadable until the result expires;
+// the bytes are written straight from the stored result, which stays retained
+// until the write completes.
+static int fp_send_stored_output(fp_conn *conn, fp_stored_result *stored, size_t index) {
+    const fp_result *result = fp_stored_result_get(stored);
+    if (!result || index >= result->output_count || !result->outputs[index].data) {
+        fp_stored_result_release(stored);
+        return fp_send_json_error(conn, 404, "Output not found or expired");
+    }
+    const fp_encoded_image *output = &result->outputs[index];
+    if (fp_send_http_head(conn, 200, "OK", output->mime, "Cache-Control: no-store\r\n", output->size) != 0) {
+        fp_stored_result_release(stored);
+        return -1;
+    }
+    return fp_conn_queue(conn, output->data, output->size, fp_stored_result_release_cb, stored);
+}
+
+// Serves a parked output once: the entry leaves the store immediately and the
+// bytes are written straight from the blob, which is released after the write.
+static int fp_send_job_output(fp_conn *conn, uint64_t job_id, size_t index) {
+    fp_stored_result *stored = NULL;
+    if (fp_result_store_lookup(conn->server->result_store, job_id, &stored, NULL, NULL, NULL) == FP_JOB_DONE) {
+        return fp_send_stored_output(conn, stored, index);
+    }
+    fp_output_meta meta;
+    fp_blob *blob = fp_output_store_take(conn->server->output_store, job_id, index, &meta);
+    if (!blob) {
+        return fp_send_json_error(conn, 404, "Output not found or expired");
+    }
+    if (fp_send_http_head(conn, 200, "OK", meta.mime, "Cache-Control: no-store\r\n", fp_blob_size(blob)) != 0) {
+        fp_blob_release(blob);
+        return -1;
+    }
+    fp_log_info("📤 Job #%llu output %zu downloaded (%zu bytes)",
+                (unsigned long long)job_id,
+                index,
+                fp_blob_size(blob));
+    return fp_conn_queue(conn, fp_blob_data(blob), fp_blob_size(blob), fp_blob_release_cb, blob);
+}
+
+// A JSON document sent as a stream: the structural text is built up front
+// (a few KB), while "data" strings are base64-encoded from the result buffers
+// window by window as the socket drains, so the response never exists whole.
+typedef struct {
+    bool base64;
+    size_t offset; // text pieces: range start in text
+    size_t len;    // text bytes, or raw bytes for base64 pieces
+    const uint8_t *raw;
+} fp_json_piece;
+
+typedef struct {
+    fp_buffer text;
+    fp_json_piece *pieces;
+    size_t piece_count;
+    size_t piece_capacity;
+    size_t text_mark; // start of text not yet covered by a piece
+    size_t cursor_piece;
+    size_t cursor_offset;
+    fp_result *results[FP_EXPERT_MAX_FILES]; // owners of the raw buffers
+    size_t result_count;
+} fp_json_stream;
+
+static int fp_json_stream_push(fp_json_stream *json, fp_json_piece piece) {
+    if (json->piece_count == json->piece_capacity) {
+        size_t capacity = json->piece_capacity ? json->piece_capacity * 2 : 16;
+        fp_json_piece *next = realloc(json->pieces, capacity * sizeof(fp_json_piece));
+        if (!next) {
+            return -1;
+        }
+        json->pieces = next;
+        json->piece_capacity = capacity;
+    }
+    json->pieces[json->piece_count++] = piece;
+    return 0;
+}
+
+// Closes the text written since the last piece into a piece of its own.
+static int fp_json_stream_cut(fp_json_stream *json) {
+    if (json->text.size == json->text_mark) {
+        return 0;
+    }
+    fp_json_piece piece = {.offset = json->text_mark, .len = json->text.size - json->text_mark};
+    json->text_mark = json->text.size;
+    return fp_json_stream_push(json, piece);
+}
+
+// Appends data as a quoted base64 string; data must outlive the stream
+// (see fp_json_stream_adopt).
+static int fp_json_stream_append_base64(fp_json_stream *json, const uint8_t *data, size_t len) {
+    if (fp_buffer_append_char(&json->text, '"') != 0 || fp_json_stream_cut(json) != 0) {
+        return -1;
+    }
+    if (len > 0 && fp_json_stream_push(json, (fp_json_piece){.base64 = true, .len = len, .raw = data}) != 0) {
+        return -1;
+    }
+    return fp_buffer_append_char(&json->text, '"');
+}
+
+static void fp_json_stream_adopt(fp_json_stream *json, fp_result *result) {
+    json->results[json->result_count++] = result;
+}
+
+static void fp_json_stream_free(void *ctx) {
+    fp_json_stream *json = (fp_json_stream *)ctx;
+    if (!json) {
+        return;
+    }
+    for (size_t i = 0; i < json->result_count; ++i) {
+        fp_free_result(json->results[i]);
+        free(json->results[i]);
+    }
+    fp_buffer_free(&json->text);
+    free(json->pieces);
+    free(json);
+}
+
+static size_t fp_json_stream_produce(void *ctx, char *window, size_t window_len) {
+    fp_json_stream *json = (fp_json_stream *)ctx;
+    size_t used = 0;
+    while (json->cursor_piece < json->piece_count && used < window_len) {
+        const fp_json_piece *piece = &json->pieces[json->cursor_piece];
+        size_t left = piece->len - json->cursor_offset;
+        size_t take;
+        if (!piece->base64) {
+            take = left < window_len - used ? left : window_len - used;
+            memcpy(window + used, json->text.data + piece->offset + json->cursor_offset, take);
+            used += take;
+        } else {
+            // Whole triples only, except for the padded tail of the string.
+            size_t room = (window_len - used) / 4 * 3;
+            if (room == 0) {
+                break;
+            }
+            take = left <= room ? left : room;
+            used += fp_base64_encode_into(piece->raw + json->cursor_offset, take, window + used);
+        }
+        json->cursor_offset += take;
+        if (json->cursor_offset == piece->len) {
+            json->cursor_piece++;
+            json->cursor_offset = 0;
+        }
+    }
+    return used;
+}
+
+// Sends the finished document as a streamed 200 response. Always takes
+// ownership of json.
+static int fp_send_json_stream(fp_conn *conn, fp_json_stream *json) {
+    if (fp_json_stream_cut(json) != 0) {
+        fp_json_stream_free(json);
+        return fp_send_json_error(conn, 500, "Failed to build payload");
+    }
+    return fp_send_http_streamed(conn, 200, "OK", "application/json", fp_json_stream_produce, json,
+                                 fp_json_stream_free);
+}
+
+// How fp_append_result_json points each output at its bytes.
+typedef enum {
+    FP_RESULT_OUTPUTS_INLINE, // base64 "data", or a "url" when parked in the output store
+    FP_RESULT_OUTPUTS_PARTS,  // "part" naming the multipart section that holds them
+    FP_RESULT_OUTPUTS_URLS,   // "url" served from the result store (async jobs)
+} fp_result_outputs;
+
+// Appends the /api/compress JSON document, also used for finished async jobs.
+static int fp_append_result_json(fp_json_stream *json, const fp_result *result, const char *filename,
+                                 fp_result_outputs outputs) {
+    fp_buffer *body = &json->text;
+    if (FP_APPEND_LITERAL(body, "{\"status\":\"ok\",\"jobId\":") != 0 ||
+        fp_buffer_appendf(body, "%llu", (unsigned long long)result->id) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"message\":") != 0 ||
+        fp_buffer_append_json_string(body, result->message) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"inputBytes\":") != 0 ||
+        fp_buffer_appendf(body, "%zu", result->input_size) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"durationMs\":") != 0 ||
+        fp_buffer_appendf(body, "%.3f", fp_duration_ms(result)) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"filename\":") != 0 ||
+        fp_buffer_append_json_string(body, filename) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"results\":[") != 0) {
+        return -1;
     }
 
     for (size_t i = 0; i < result->output_count; ++i) {
         if (i > 0) {
-            if (fp_buffer_append(&body, ",", 1) != 0) {
-                fp_buffer_free(&body);
-                return fp_send_json_error(fd, 500, "Failed to build payload");
+            if (fp_buffer_append(body, ",", 1) != 0) {
+                return -1;
             }
         }
         fp_encoded_image output = result->outputs[i];
-        const uint8_t *raw = output.data ? output.data : (const uint8_t *)"";
-        size_t raw_size = output.data ? output.size : 0;
-        char *encoded = fp_base64_encode(raw, raw_size);
-        if (!encoded) {
-            fp_buffer_free(&body);
-            return fp_send_json_error(fd, 500, "Encoding error");
-        }
-        if (FP_APPEND_LITERAL(&body, "{\"format\":") != 0 ||
-            fp_buffer_append_json_string(&body, output.format) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"label\":") != 0 ||
-            fp_buffer_append_json_string(&body, output.label) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"bytes\":") != 0 ||
-            fp_buffer_appendf(&body, "%zu", output.size) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"mime\":") != 0 ||
-            fp_buffer_append_json_string(&body, output.mime) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"extension\":") != 0 ||
-            fp_buffer_append_json_string(&body, output.extension) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"tuning\":") != 0 ||
-            fp_buffer_append_json_string(&body, output.tuning) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"data\":") != 0 ||
-            fp_buffer_append_json_string(&body, encoded) != 0 ||
-            FP_APPEND_LITERAL(&body, "}") != 0) {
-            free(encoded);
-            fp_buffer_free(&body);
-            return fp_send_json_error(fd, 500, "Failed to build payload");
-        }
-        free(encoded);
-    }
-
-    if (FP_APPEND_LITERAL(&body, "]}") != 0) {
-        fp_buffer_free(&body);
-        return fp_send_json_error(fd, 500, "Failed to build payload");
-    }
-
-    int rc = fp_send_http(fd, 200, "OK", "application/json", body.data, body.size);
-    fp_buffer_free(&body);
-    return rc;
+        if (FP_APPEND_LITERAL(body, "{\"format\":") != 0 ||
+            fp_buffer_append_json_string(body, output.format) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"label\":") != 0 ||
+            fp_buffer_append_json_string(body, output.label) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"bytes\":") != 0 ||
+            fp_buffer_appendf(body, "%zu", output.size) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"mime\":") != 0 ||
+            fp_buffer_append_json_string(body, output.mime) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"extension\":") != 0 ||
+            fp_buffer_append_json_string(body, output.extension) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"tuning\":") != 0 ||
+            fp_buffer_append_json_string(body, output.tuning) != 0) {
+            return -1;
+        }
+        if (outputs == FP_RESULT_OUTPUTS_URLS || (outputs == FP_RESULT_OUTPUTS_INLINE && !output.data && output.size > 0)) {
+            if (fp_buffer_appendf(body,
+                                  ",\"url\":\"/api/jobs/%llu/outputs/%zu\"",
+                                  (unsigned long long)result->id,
+                                  i) != 0) {
+                return -1;
+            }
+        } else if (outputs == FP_RESULT_OUTPUTS_INLINE) {
+            if (FP_APPEND_LITERAL(body, ",\"data\":") != 0 ||
+                fp_json_stream_append_base64(json, output.data, output.data ? output.size : 0) != 0) {
+                return -1;
+            }
+        } else if (fp_buffer_appendf(body, ",\"part\":\"output-%zu\"", i) != 0) {
+            return -1;
+        }
+        if (FP_APPEND_LITERAL(body, "}") != 0) {
+            return -1;
+        }
+    }
+
+    return FP_APPEND_LITERAL(body, "]}");
+}
+
+// Always takes ownership of result, which lives until the body is sent.
+static int fp_send_result_payload(fp_conn *conn, fp_result *result, const char *filename) {
+    fp_json_stream *json = calloc(1, sizeof(fp_json_stream));
+    if (!json) {
+        fp_free_result(result);
+        free(result);
+        return fp_send_json_error(conn, 500, "Out of memory");
+    }
+    fp_json_stream_adopt(json, result);
+    if (fp_append_result_json(json, result, filename, FP_RESULT_OUTPUTS_INLINE) != 0) {
+        fp_json_stream_free(json);
+        return fp_send_json_error(conn, 500, "Failed to build payload");
+    }
+    return fp_send_json_stream(conn, json);
+}
+
+static bool fp_accepts_multipart(const fp_http_request *request) {
+    char accept[sizeof(request->accept)];
+    size_t i = 0;
+    for (; request->accept[i] && i + 1 < sizeof(accept); ++i) {
+        accept[i] = (char)tolower((unsigned char)request->accept[i]);
+    }
+    accept[i] = '\0';
+    return strstr(accept, "multipart/mixed") != NULL;
+}
+
+static void fp_result_release(void *ctx) {
+    fp_result *result = (fp_result *)ctx;
+    fp_free_result(result);
+    free(result);
+}
+
+// Sends the result as multipart/mixed: a JSON manifest part followed by one
+// raw part per output. Output bytes are queued straight from the result's
+// buffers; the result is freed once the last part has been written.
+// Always takes ownership of result.
+static int fp_send_result_multipart(fp_conn *conn, fp_result *result, const char *filename) {
+    char boundary[64];
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    snprintf(boundary,
+             sizeof(boundary),
+             "ferret-%llx-%lx",
+             (unsigned long long)result->id,
+             (unsigned long)now.tv_nsec);
+
+    char stem[FP_FILENAME_MAX];
+    snprintf(stem, sizeof(stem), "%s", filename);
+    char *dot = strrchr(stem, '.');
+    if (dot && dot != stem) {
+        *dot = '\0';
+    }
+
+    // parts[0] is the manifest with its part header; parts[i + 1] holds the
+    // delimiter and headers that precede output i; the last entry closes the body.
+    fp_buffer parts[FP_MAX_OUTPUTS + 2];
+    memset(parts, 0, sizeof(parts));
+    size_t part_count = result->output_count + 2;
+    int rc = fp_buffer_appendf(&parts[0],
+                               "--%s\r\nContent-Type: application/json\r\nContent-Disposition: inline; name=\"manifest\"\r\n\r\n",
+                               boundary);
+    if (rc == 0) {
+        fp_json_stream manifest = {0};
+        rc = fp_append_result_json(&manifest, result, filename, FP_RESULT_OUTPUTS_PARTS);
+        if (rc == 0) {
+            rc = fp_buffer_append(&parts[0], manifest.text.data, manifest.text.size);
+        }
+        fp_buffer_free(&manifest.text);
+        free(manifest.pieces);
+    }
+    for (size_t i = 0; rc == 0 && i < result->output_count; ++i) {
+        const fp_encoded_image *output = &result->outputs[i];
+        rc = fp_buffer_appendf(&parts[i + 1],
+                               "\r\n--%s\r\nContent-Type: %s\r\nContent-Disposition: attachment; name=\"output-%zu\"; filename=\"%s.%s\"\r\nContent-Length: %zu\r\n\r\n",
+                               boundary,
+                               output->mime[0] ? output->mime : "application/octet-stream",
+                               i,
+                               stem,
+                               output->extension,
+                               output->data ? output->size : 0);
+    }
+    if (rc == 0) {
+        rc = fp_buffer_appendf(&parts[part_count - 1], "\r\n--%s--\r\n", boundary);
+    }
+    if (rc != 0) {
+        for (size_t i = 0; i < part_count; ++i) {
+            fp_buffer_free(&parts[i]);
+        }
+        fp_result_release(result);
+        return fp_send_json_error(conn, 500, "Failed to build payload");
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < part_count; ++i) {
+        total += parts[i].size;
+    }
+    for (size_t i = 0; i < result->output_count; ++i) {
+        total += result->outputs[i].data ? result->outputs[i].size : 0;
+    }
+
+    char content_type[96];
+    snprintf(content_type, sizeof(content_type), "multipart/mixed; boundary=%s", boundary);
+    rc = fp_send_http_head(conn, 200, "OK", content_type, NULL, total);
+    for (size_t i = 0; i < part_count; ++i) {
+        if (rc == 0) {
+            rc = fp_conn_queue_buffer(conn, &parts[i]);
+        } else {
+            fp_buffer_free(&parts[i]);
+        }
+        if (rc == 0 && i > 0 && i <= result->output_count && result->outputs[i - 1].data) {
+            rc = fp_conn_queue(conn, result->outputs[i - 1].data, result->outputs[i - 1].size, NULL, NULL);
+        }
+    }
+    if (rc != 0) {
+        // Part of the response may already be queued; drop the connection
+        // (which discards chunks pointing into result) before freeing it.
+        fp_conn_close(conn);
+        fp_result_release(result);
+        return -1;
+    }
+    return fp_conn_queue(conn, NULL, 0, fp_result_release, result);
 }
 
 static int fp_append_params_used(fp_buffer *body, const fp_expert_options *opts, const fp_encoded_image *output) {
@@ -1555,262 +2333,399 @@ static int fp_append_params_used(fp_buffer *body, const fp_expert_options *opts,
     return FP_APPEND_LITERAL(body, "}") == 0 ? 0 : -1;
 }
 
-static int fp_send_expert_payload(int fd,
-                                  fp_result **results,
-                                  char filenames[][FP_FILENAME_MAX],
-                                  const fp_expert_options *opts,
-                                  size_t file_count,
-                                  double request_elapsed_ms) {
-    if (!results || file_count == 0) {
-        return fp_send_json_error(fd, 400, "No files processed");
-    }
-    fp_buffer body = {0};
-    if (FP_APPEND_LITERAL(&body, "{\"status\":\"ok\",\"message\":\"ok\",\"files\":[") != 0) {
-        fp_buffer_free(&body);
-        return fp_send_json_error(fd, 500, "Failed to build payload");
+// Appends one file entry of the expert document; its data strings point into
+// res, so the caller hands res to the stream. best_output_out receives the
+// smallest output (or the input size).
+static int fp_append_expert_file_json(fp_json_stream *json,
+                                      size_t index,
+                                      const char *filename,
+                                      const fp_expert_options *opts,
+                                      const fp_result *res,
+                                      size_t *best_output_out) {
+    fp_buffer *body = &json->text;
+    double duration = fp_duration_ms(res);
+    size_t best_output = res->input_size;
+    if (FP_APPEND_LITERAL(body, "{\"index\":") != 0 ||
+        fp_buffer_appendf(body, "%zu", index) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"status\":\"ok\",\"jobId\":") != 0 ||
+        fp_buffer_appendf(body, "%llu", (unsigned long long)res->id) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"filename\":") != 0 ||
+        fp_buffer_append_json_string(body, filename) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"inputBytes\":") != 0 ||
+        fp_buffer_appendf(body, "%zu", res->input_size) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"durationMs\":") != 0 ||
+        fp_buffer_appendf(body, "%.3f", duration) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"geometry\":{") != 0 ||
+        FP_APPEND_LITERAL(body, "\"inputWidth\":") != 0 ||
+        fp_buffer_appendf(body, "%u", res->input_width) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"inputHeight\":") != 0 ||
+        fp_buffer_appendf(body, "%u", res->input_height) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"outputWidth\":") != 0 ||
+        fp_buffer_appendf(body, "%u", res->output_width) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"outputHeight\":") != 0 ||
+        fp_buffer_appendf(body, "%u", res->output_height) != 0 ||
+        FP_APPEND_LITERAL(body, "}") != 0 ||
+        FP_APPEND_LITERAL(body, ",\"trimApplied\":") != 0 ||
+        fp_buffer_append(body,
+                         res->trim_applied ? "true" : "false",
+                         res->trim_applied ? 4 : 5) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"trims_applied\":") != 0 ||
+        fp_buffer_append(body,
+                         res->trim_applied ? "true" : "false",
+                         res->trim_applied ? 4 : 5) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"cropApplied\":") != 0 ||
+        fp_buffer_append(body,
+                         res->crop_applied ? "true" : "false",
+                         res->crop_applied ? 4 : 5) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"crops_applied\":") != 0 ||
+        fp_buffer_append(body,
+                         res->crop_applied ? "true" : "false",
+                         res->crop_applied ? 4 : 5) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"results\":[") != 0) {
+        return -1;
     }
-    size_t total_input = 0;
-    size_t total_output = 0;
-    for (size_t i = 0; i < file_count; ++i) {
-        fp_result *res = results[i];
-        if (!res) {
-            continue;
-        }
-        if (i > 0) {
-            if (fp_buffer_append(&body, ",", 1) != 0) {
-                fp_buffer_free(&body);
-                return fp_send_json_error(fd, 500, "Failed to build payload");
-            }
-        }
-        double duration = fp_duration_ms(res);
-        size_t best_output = res->input_size;
-        total_input += res->input_size;
-        if (FP_APPEND_LITERAL(&body, "{\"jobId\":") != 0 ||
-            fp_buffer_appendf(&body, "%llu", (unsigned long long)res->id) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"filename\":") != 0 ||
-            fp_buffer_append_json_string(&body, filenames[i]) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"inputBytes\":") != 0 ||
-            fp_buffer_appendf(&body, "%zu", res->input_size) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"durationMs\":") != 0 ||
-            fp_buffer_appendf(&body, "%.3f", duration) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"geometry\":{") != 0 ||
-            FP_APPEND_LITERAL(&body, "\"inputWidth\":") != 0 ||
-            fp_buffer_appendf(&body, "%u", res->input_width) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"inputHeight\":") != 0 ||
-            fp_buffer_appendf(&body, "%u", res->input_height) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"outputWidth\":") != 0 ||
-            fp_buffer_appendf(&body, "%u", res->output_width) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"outputHeight\":") != 0 ||
-            fp_buffer_appendf(&body, "%u", res->output_height) != 0 ||
-            FP_APPEND_LITERAL(&body, "}") != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"trimApplied\":") != 0 ||
-            fp_buffer_append(&body,
-                             res->trim_applied ? "true" : "false",
-                             res->trim_applied ? 4 : 5) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"trims_applied\":") != 0 ||
-            fp_buffer_append(&body,
-                             res->trim_applied ? "true" : "false",
-                             res->trim_applied ? 4 : 5) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"cropApplied\":") != 0 ||
-            fp_buffer_append(&body,
-                             res->crop_applied ? "true" : "false",
-                             res->crop_applied ? 4 : 5) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"crops_applied\":") != 0 ||
-            fp_buffer_append(&body,
-                             res->crop_applied ? "true" : "false",
-                             res->crop_applied ? 4 : 5) != 0 ||
-            FP_APPEND_LITERAL(&body, ",\"results\":[") != 0) {
-            fp_buffer_free(&body);
-            return fp_send_json_error(fd, 500, "Failed to build payload");
-        }
-
-        for (size_t j = 0; j < res->output_count; ++j) {
-            if (j > 0) {
-                if (fp_buffer_append(&body, ",", 1) != 0) {
-                    fp_buffer_free(&body);
-                    return fp_send_json_error(fd, 500, "Failed to build payload");
-                }
+
+    for (size_t j = 0; j < res->output_count; ++j) {
+        if (j > 0) {
+            if (fp_buffer_append(body, ",", 1) != 0) {
+                return -1;
             }
-            fp_encoded_image output = res->outputs[j];
-            const uint8_t *raw = output.data ? output.data : (const uint8_t *)"";
-            size_t raw_size = output.data ? output.size : 0;
-            if (output.size < best_output) {
-                best_output = output.size;
-            }
-            char *encoded = fp_base64_encode(raw, raw_size);
-            if (!encoded) {
-                fp_buffer_free(&body);
-                return fp_send_json_error(fd, 500, "Encoding error");
-            }
-            if (FP_APPEND_LITERAL(&body, "{\"format\":") != 0 ||
-                fp_buffer_append_json_string(&body, output.format) != 0 ||
-                FP_APPEND_LITERAL(&body, ",\"label\":") != 0 ||
-                fp_buffer_append_json_string(&body, output.label) != 0 ||
-                FP_APPEND_LITERAL(&body, ",\"size_bytes\":") != 0 ||
-                fp_buffer_appendf(&body, "%zu", output.size) != 0 ||
-                FP_APPEND_LITERAL(&body, ",\"mime\":") != 0 ||
-                fp_buffer_append_json_string(&body, output.mime) != 0 ||
-                FP_APPEND_LITERAL(&body, ",\"extension\":") != 0 ||
-                fp_buffer_append_json_string(&body, output.extension) != 0 ||
-                FP_APPEND_LITERAL(&body, ",\"tuning\":") != 0 ||
-                fp_buffer_append_json_string(&body, output.tuning) != 0 ||
-                FP_APPEND_LITERAL(&body, ",\"data\":") != 0 ||
-                fp_buffer_append_json_string(&body, encoded) != 0 ||
-                FP_APPEND_LITERAL(&body, ",") != 0 ||
-                fp_append_params_used(&body, opts ? &opts[i] : NULL, &output) != 0 ||
-                FP_APPEND_LITERAL(&body, "}") != 0) {
-                free(encoded);
-                fp_buffer_free(&body);
-                return fp_send_json_error(fd, 500, "Failed to build payload");
-            }
-            free(encoded);
-        }
-
-        size_t saved = res->input_size > best_output ? res->input_size - best_output : 0;
-        total_output += best_output;
-        if (FP_APPEND_LITERAL(&body, "],\"bytes_saved\":") != 0 ||
-            fp_buffer_appendf(&body, "%zu", saved) != 0 ||
-            FP_APPEND_LITERAL(&body, "}") != 0) {
-            fp_buffer_free(&body);
-            return fp_send_json_error(fd, 500, "Failed to build payload");
-        }
-    }
-
-    size_t aggregate_saved = total_input > total_output ? total_input - total_output : 0;
-    if (FP_APPEND_LITERAL(&body, "],\"bytes_saved\":") != 0 ||
-        fp_buffer_appendf(&body, "%zu", aggregate_saved) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"total_input_bytes\":") != 0 ||
-        fp_buffer_appendf(&body, "%zu", total_input) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"total_output_bytes\":") != 0 ||
-        fp_buffer_appendf(&body, "%zu", total_output) != 0 ||
-        FP_APPEND_LITERAL(&body, ",\"elapsed_ms\":") != 0 ||
-        fp_buffer_appendf(&body, "%.3f", request_elapsed_ms) != 0 ||
-        FP_APPEND_LITERAL(&body, "}") != 0) {
-        fp_buffer_free(&body);
-        return fp_send_json_error(fd, 500, "Failed to build payload");
-    }
-
-    int rc = fp_send_http(fd, 200, "OK", "application/json", body.data, body.size);
-    fp_buffer_free(&body);
-    return rc;
+        }
+        fp_encoded_image output = res->outputs[j];
+        if (output.size < best_output) {
+            best_output = output.size;
+        }
+        if (FP_APPEND_LITERAL(body, "{\"format\":") != 0 ||
+            fp_buffer_append_json_string(body, output.format) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"label\":") != 0 ||
+            fp_buffer_append_json_string(body, output.label) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"size_bytes\":") != 0 ||
+            fp_buffer_appendf(body, "%zu", output.size) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"mime\":") != 0 ||
+            fp_buffer_append_json_string(body, output.mime) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"extension\":") != 0 ||
+            fp_buffer_append_json_string(body, output.extension) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"tuning\":") != 0 ||
+            fp_buffer_append_json_string(body, output.tuning) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"data\":") != 0 ||
+            fp_json_stream_append_base64(json, output.data, output.data ? output.size : 0) != 0 ||
+            FP_APPEND_LITERAL(body, ",") != 0 ||
+            fp_append_params_used(body, opts, &output) != 0 ||
+            FP_APPEND_LITERAL(body, "}") != 0) {
+            return -1;
+        }
+    }
+
+    size_t saved = res->input_size > best_output ? res->input_size - best_output : 0;
+    if (FP_APPEND_LITERAL(body, "],\"bytes_saved\":") != 0 ||
+        fp_buffer_appendf(body, "%zu", saved) != 0 ||
+        FP_APPEND_LITERAL(body, "}") != 0) {
+        return -1;
+    }
+    *best_output_out = best_output;
+    return 0;
+}
+
+static int fp_append_expert_error_json(fp_json_stream *json, size_t index, const char *filename, const char *message) {
+    fp_buffer *body = &json->text;
+    if (FP_APPEND_LITERAL(body, "{\"index\":") != 0 ||
+        fp_buffer_appendf(body, "%zu", index) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"status\":\"error\",\"filename\":") != 0 ||
+        fp_buffer_append_json_string(body, filename) != 0 ||
+        FP_APPEND_LITERAL(body, ",\"message\":") != 0 ||
+        fp_buffer_append_json_string(body, message) != 0 ||
+        FP_APPEND_LITERAL(body, "}") != 0) {
+        return -1;
+    }
+    return 0;
 }
 
-static int fp_send_sse_headers(int fd) {
-    const char *headers =
+// Persistent connections frame the stream with chunked encoding so the
+// connection can carry further requests once the job finishes.
+static int fp_send_sse_headers(fp_conn *conn) {
+    static const char chunked_headers[] =
         "HTTP/1.1 200 OK\r\n"
         "Content-Type: text/event-stream\r\n"
         "Cache-Control: no-cache\r\n"
+        "Transfer-Encoding: chunked\r\n"
         "Connection: keep-alive\r\n"
         "\r\n";
-    size_t len = strlen(headers);
-    ssize_t sent = send(fd, headers, len, 0);
-    return sent == (ssize_t)len ? 0 : -1;
+    static const char close_headers[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+    conn->stream_chunked = conn->keep_alive;
+    if (conn->stream_chunked) {
+        return fp_conn_queue(conn, chunked_headers, sizeof(chunked_headers) - 1, NULL, NULL);
+    }
+    return fp_conn_queue(conn, close_headers, sizeof(close_headers) - 1, NULL, NULL);
 }
 
-static int fp_send_sse_event(int fd, const char *name, const char *payload) {
-    if (!payload) {
-        return 0;
-    }
+// Queues one SSE frame as prefix + borrowed payload + suffix so the whole
+// event, chunk framing included, leaves in a single writev without copying the
+// (often multi-megabyte) payload. release(release_ctx) runs once it is sent.
+static int fp_send_sse_frame(fp_conn *conn, const char *name, const char *payload, size_t payload_len,
+                             void (*release)(void *), void *release_ctx) {
+    static const char suffix_plain[] = "\n\n";
+    static const char suffix_chunked[] = "\n\n\r\n";
     if (!name || !*name) {
         name = "message";
     }
-    char header[64];
-    int header_len = snprintf(header, sizeof(header), "event: %s\n", name);
-    if (header_len < 0) {
-        return -1;
+    fp_buffer prefix = {0};
+    if (conn->stream_chunked) {
+        size_t chunk_len = strlen("event: ") + strlen(name) + strlen("\ndata: ") + payload_len + 2;
+        if (fp_buffer_appendf(&prefix, "%zx\r\n", chunk_len) != 0) {
+            fp_buffer_free(&prefix);
+            if (release) {
+                release(release_ctx);
+            }
+            return -1;
+        }
     }
-    ssize_t sent = send(fd, header, (size_t)header_len, 0);
-    if (sent != (ssize_t)header_len) {
+    if (fp_buffer_appendf(&prefix, "event: %s\ndata: ", name) != 0) {
+        fp_buffer_free(&prefix);
+        if (release) {
+            release(release_ctx);
+        }
         return -1;
     }
-    if (send(fd, "data: ", 6, 0) != 6) {
+    if (fp_conn_queue_buffer(conn, &prefix) != 0) {
+        if (release) {
+            release(release_ctx);
+        }
         return -1;
     }
-    size_t payload_len = strlen(payload);
-    if (send(fd, payload, payload_len, 0) != (ssize_t)payload_len) {
+    if (fp_conn_queue(conn, payload, payload_len, release, release_ctx) != 0) {
         return -1;
     }
-    if (send(fd, "\n\n", 2, 0) != 2) {
-        return -1;
+    conn->stream_last_send_ms = fp_io_loop_now_ms(conn->loop);
+    if (conn->stream_chunked) {
+        return fp_conn_queue(conn, suffix_chunked, sizeof(suffix_chunked) - 1, NULL, NULL);
     }
-    return 0;
+    return fp_conn_queue(conn, suffix_plain, sizeof(suffix_plain) - 1, NULL, NULL);
 }
 
-static void fp_handle_event_stream(int fd, uint64_t job_id, fp_progress_registry *registry) {
-    fp_progress_channel *channel = NULL;
-    for (int attempt = 0; attempt < 200 && !channel; ++attempt) {
-        channel = fp_progress_acquire(registry, job_id);
-        if (channel) {
-            break;
-        }
-        struct timespec ts = {0, 50000000}; // 50ms
-        nanosleep(&ts, NULL);
+static void fp_sse_event_release(void *ctx) {
+    fp_progress_event_free((fp_progress_event *)ctx);
+}
+
+static int fp_send_sse_event(fp_conn *conn, fp_progress_event *event) {
+    if (!event->payload) {
+        fp_progress_event_free(event);
+        return 0;
     }
-    if (!channel) {
-        fp_send_text(fd, 404, "Not Found", "Unknown job");
-        return;
+    return fp_send_sse_frame(conn, event->event_name, event->payload, event->payload_len, fp_sse_event_release, event);
+}
+
+// Comment lines are ignored by EventSource but keep proxies and NAT state from
+// timing out a stream that is waiting on a slow encoder.
+static int fp_send_sse_heartbeat(fp_conn *conn) {
+    static const char plain[] = ": ping\n\n";
+    static const char chunked[] = "8\r\n: ping\n\n\r\n";
+    conn->stream_last_send_ms = fp_io_loop_now_ms(conn->loop);
+    if (conn->stream_chunked) {
+        return fp_conn_queue(conn, chunked, sizeof(chunked) - 1, NULL, NULL);
     }
+    return fp_conn_queue(conn, plain, sizeof(plain) - 1, NULL, NULL);
+}
 
-    if (fp_send_sse_headers(fd) != 0) {
-        fp_progress_release(channel);
+static bool fp_conn_stream_cancel_wait(fp_conn *conn);
+
+static void fp_conn_stream_detach(fp_conn *conn) {
+    fp_conn_stream_cancel_wait(conn);
+    if (!conn->stream_channel) {
         return;
     }
+    fp_progress_set_listener(conn->stream_channel, NULL, NULL);
+    fp_progress_release(conn->stream_channel);
+    conn->stream_channel = NULL;
+}
 
+static void fp_conn_stream_drain(fp_conn *conn) {
+    if (conn->closed || conn->state != FP_CONN_STREAM || !conn->stream_channel) {
+        return;
+    }
+    size_t dropped = fp_progress_take_dropped(conn->stream_channel);
+    if (dropped > 0) {
+        fp_buffer notice = {0};
+        fp_log_warn("🐢 SSE reader fell behind; dropped %zu result event(s)", dropped);
+        if (fp_buffer_appendf(&notice, "{\"dropped\":%zu}", dropped) == 0) {
+            fp_send_sse_frame(conn, "lagged", notice.data, notice.size, free, notice.data);
+        } else {
+            fp_buffer_free(&notice);
+        }
+    }
     bool open = true;
-    while (true) {
-        fp_progress_event *event = fp_progress_next_event(channel, &open);
-        if (!event) {
-            if (!open) {
-                break;
-            }
-            continue;
+    fp_progress_event *event = NULL;
+    conn->stream_backlogged = false;
+    while (!conn->closed) {
+        if (conn->out_bytes >= FP_SSE_OUTPUT_LIMIT) {
+            // Leave the rest in the channel (where it is bounded) until the
+            // socket catches up; fp_conn_flush resumes the drain.
+            conn->stream_backlogged = true;
+            break;
         }
-        fp_send_sse_event(fd, event->event_name, event->payload);
-        fp_progress_event_free(event);
-        if (!open) {
+        event = fp_progress_poll_event(conn->stream_channel, &open);
+        if (!event) {
             break;
         }
+        fp_send_sse_event(conn, event);
+    }
+    if (conn->closed) {
+        return;
+    }
+    if (!open && !conn->stream_backlogged) {
+        fp_conn_stream_detach(conn);
+        if (conn->stream_chunked) {
+            static const char last_chunk[] = "0\r\n\r\n";
+            fp_conn_queue(conn, last_chunk, sizeof(last_chunk) - 1, NULL, NULL);
+        }
+        fp_conn_end_response(conn);
+        return;
     }
+    fp_conn_flush(conn);
+}
 
-    fp_progress_release(channel);
+static void fp_conn_stream_drain_task(fp_io_loop *loop, void *arg) {
+    (void)loop;
+    fp_conn *conn = (fp_conn *)arg;
+    atomic_store_explicit(&conn->stream_drain_posted, false, memory_order_release);
+    fp_conn_stream_drain(conn);
+    fp_conn_release(conn);
 }
 
-#define FP_RESULT_CACHE_MAX 16
-static fp_result *g_result_cache[FP_RESULT_CACHE_MAX];
-static pthread_mutex_t g_result_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Progress listener: runs on whichever thread published the event, with the
+// channel locked, so it only schedules a drain on the connection's own loop.
+static void fp_conn_stream_notify(fp_progress_channel *channel, void *ctx) {
+    (void)channel;
+    fp_conn *conn = (fp_conn *)ctx;
+    if (atomic_exchange_explicit(&conn->stream_drain_posted, true, memory_order_acq_rel)) {
+        return;
+    }
+    fp_conn_retain(conn);
+    fp_io_loop_post_task(conn->loop, &conn->stream_task, fp_conn_stream_drain_task, conn);
+}
+
+static void fp_conn_start_stream(fp_conn *conn, fp_progress_channel *channel) {
+    if (fp_send_sse_headers(conn) != 0) {
+        fp_progress_release(channel);
+        fp_conn_close(conn);
+        return;
+    }
+    conn->state = FP_CONN_STREAM;
+    conn->stream_channel = channel;
+    conn->stream_backlogged = false;
+    conn->stream_last_send_ms = fp_io_loop_now_ms(conn->loop);
+    fp_progress_set_listener(channel, fp_conn_stream_notify, conn);
+    fp_conn_stream_drain(conn);
+}
 
-static fp_result *fp_result_cache_take(uint64_t job_id) {
-    pthread_mutex_lock(&g_result_cache_mutex);
-    fp_result *match = NULL;
-    for (size_t i = 0; i < FP_RESULT_CACHE_MAX; ++i) {
-        fp_result *candidate = g_result_cache[i];
-        if (candidate && candidate->id == job_id) {
-            match = candidate;
-            g_result_cache[i] = NULL;
+static bool fp_stream_waiter_unlink(fp_server *server, fp_stream_waiter *waiter) {
+    bool found = false;
+    pthread_mutex_lock(&server->waiters_mutex);
+    for (fp_stream_waiter **link = &server->waiters; *link; link = &(*link)->next) {
+        if (*link == waiter) {
+            *link = waiter->next;
+            found = true;
             break;
         }
     }
-    pthread_mutex_unlock(&g_result_cache_mutex);
-    return match;
+    pthread_mutex_unlock(&server->waiters_mutex);
+    return found;
 }
 
-static void fp_result_cache_store(fp_result *result) {
-    if (!result) {
-        return;
+static void fp_stream_waiter_ready_task(fp_io_loop *loop, void *arg) {
+    (void)loop;
+    fp_stream_waiter *waiter = (fp_stream_waiter *)arg;
+    fp_conn *conn = waiter->conn;
+    if (conn->stream_waiter == waiter) {
+        conn->stream_waiter = NULL;
     }
-    pthread_mutex_lock(&g_result_cache_mutex);
-    for (size_t i = 0; i < FP_RESULT_CACHE_MAX; ++i) {
-        if (!g_result_cache[i]) {
-            g_result_cache[i] = result;
-            result = NULL;
-            break;
+    if (!conn->closed && conn->state == FP_CONN_STREAM_WAIT) {
+        fp_conn_start_stream(conn, waiter->channel);
+    } else {
+        fp_progress_release(waiter->channel);
+    }
+    fp_conn_release(conn);
+    free(waiter);
+}
+
+// Called right after a job's channel is registered: hands it to every stream
+// request already waiting for that job, on the waiter's own loop.
+static void fp_stream_waiters_notify(fp_server *server, uint64_t job_id, fp_progress_channel *channel) {
+    pthread_mutex_lock(&server->waiters_mutex);
+    fp_stream_waiter **link = &server->waiters;
+    while (*link) {
+        fp_stream_waiter *waiter = *link;
+        if (waiter->job_id == job_id) {
+            fp_progress_retain(channel);
+            waiter->channel = channel;
+            *link = waiter->next;
+            fp_io_loop_post_task(waiter->conn->loop, &waiter->ready_task, fp_stream_waiter_ready_task, waiter);
+            continue;
         }
+        link = &waiter->next;
     }
-    pthread_mutex_unlock(&g_result_cache_mutex);
-    if (result) {
-        fp_free_result(result);
-        free(result);
+    pthread_mutex_unlock(&server->waiters_mutex);
+}
+
+static void fp_handle_event_stream(fp_conn *conn, uint64_t job_id) {
+    fp_server *server = conn->server;
+    fp_stream_waiter *waiter = NULL;
+    // The lookup and the waiter registration happen under one lock so a job
+    // submitted in between is either found here or sees the waiter.
+    pthread_mutex_lock(&server->waiters_mutex);
+    fp_progress_channel *channel = fp_progress_acquire(server->progress_registry, job_id);
+    if (!channel) {
+        waiter = calloc(1, sizeof(fp_stream_waiter));
+        if (waiter) {
+            waiter->job_id = job_id;
+            waiter->conn = conn;
+            waiter->next = server->waiters;
+            server->waiters = waiter;
+            fp_conn_retain(conn);
+        }
+    }
+    pthread_mutex_unlock(&server->waiters_mutex);
+
+    if (channel) {
+        fp_conn_start_stream(conn, channel);
+        return;
+    }
+    if (!waiter) {
+        fp_send_text(conn, 500, "Error", "Out of memory");
+        return;
+    }
+    conn->stream_waiter = waiter;
+    conn->stream_deadline_ms = fp_io_loop_now_ms(conn->loop) + FP_STREAM_WAIT_MS;
+    conn->state = FP_CONN_STREAM_WAIT;
+    fp_conn_update_interest(conn);
+}
+
+// Drops the connection's pending stream registration. Returns false when the
+// channel was already handed over and a ready task is on its way.
+static bool fp_conn_stream_cancel_wait(fp_conn *conn) {
+    fp_stream_waiter *waiter = conn->stream_waiter;
+    if (!waiter) {
+        return true;
+    }
+    if (!fp_stream_waiter_unlink(conn->server, waiter)) {
+        return false;
+    }
+    conn->stream_waiter = NULL;
+    free(waiter);
+    fp_conn_release(conn);
+    return true;
+}
+
+static void fp_conn_stream_expire(fp_conn *conn, uint64_t now_ms) {
+    if (now_ms < conn->stream_deadline_ms || !fp_conn_stream_cancel_wait(conn)) {
+        return;
     }
+    fp_send_text(conn, 404, "Not Found", "Unknown job");
+    fp_conn_end_response(conn);
 }
 
 static int fp_clamp_int_server(int value, int min_val, int max_val) {
@@ -1867,131 +2782,226 @@ static void fp_populate_expert_outputs(fp_job *job, const fp_expert_options *opt
     }
 }
 
-static fp_result *fp_wait_for_result(fp_queue *result_queue, uint64_t job_id) {
-    fp_result *cached = fp_result_cache_take(job_id);
-    if (cached) {
-        return cached;
-    }
-    while (true) {
-        fp_result *result = (fp_result *)fp_queue_pop(result_queue);
-        if (result) {
-            if (result->id == job_id) {
-                return result;
-            }
-            fp_result_cache_store(result);
+static void fp_pending_finish(fp_pending_job *pending, fp_result *result, int http_status, const char *error) {
+    fp_conn *conn = pending->conn;
+    for (fp_pending_job **link = &conn->jobs; *link; link = &(*link)->conn_next) {
+        if (*link == pending) {
+            *link = pending->conn_next;
+            break;
         }
-        struct timespec ts = {0, FP_SLEEP_NS};
-        nanosleep(&ts, NULL);
     }
+    fp_cancel_token_release(pending->cancel);
+    if (result) {
+        const char *status_label = result->status == 0 ? "ok" : "error";
+        fp_progress_emit_status(pending->progress, status_label, result->message, fp_duration_ms(result), result->input_size);
+    } else {
+        const char *message = http_status == 503   ? "server_busy"
+                              : http_status == 504 ? "deadline_exceeded"
+                              : http_status == 499 ? "cancelled"
+                                                   : "no_result";
+        fp_progress_emit_status(pending->progress, "error", message, 0.0, pending->content_length);
+    }
+    fp_progress_close(pending->progress);
+    fp_progress_release(pending->progress);
+    pending->done(conn, result, http_status, error, pending->ctx);
+    fp_conn_release(conn);
+    free(pending);
 }
 
-static fp_result *fp_submit_job(fp_job *job,
-                                const char *response_filename,
-                                size_t content_length,
-                                fp_queue *job_queue,
-                                fp_queue *result_queue,
-                                fp_progress_registry *progress_registry,
-                                int *http_status,
-                                char *error_buf,
-                                size_t error_buf_len) {
-    if (!job || !job_queue || !result_queue || !progress_registry) {
-        if (http_status) {
-            *http_status = 400;
-        }
-        if (error_buf && error_buf_len) {
-            snprintf(error_buf, error_buf_len, "Invalid job");
-        }
-        return NULL;
+static void fp_pending_complete_task(fp_io_loop *loop, void *arg) {
+    (void)loop;
+    fp_pending_job *pending = (fp_pending_job *)arg;
+    if (!pending->result) {
+        fp_pending_finish(pending, NULL, 500, "No result");
+        return;
     }
+    fp_pending_finish(pending, pending->result, 200, NULL);
+}
 
-    fp_progress_channel *progress_channel = fp_progress_register(progress_registry, job->id);
-    if (!progress_channel) {
-        if (http_status) {
-            *http_status = 503;
+// Job completion hook, called on the worker thread: hands the result to the
+// loop that owns the waiting connection.
+static void fp_pending_on_complete(fp_result *result, void *ctx) {
+    fp_pending_job *pending = (fp_pending_job *)ctx;
+    // pending and result may be gone once posted, and the server once released.
+    fp_admission *admission = pending->conn->server->admission;
+    fp_admit_class admit_class = pending->admit_class;
+    double work_units = pending->work_units;
+    double service_ms = fp_duration_ms(result);
+    pending->result = result;
+    fp_io_loop_post_task(pending->conn->loop, &pending->complete_task, fp_pending_complete_task, pending);
+    fp_admission_release(admission, admit_class, work_units, service_ms);
+}
+
+// Walks jobs that found job_queue full, pushing them once there is room and
+// rejecting them with 503 once their class's admission wait has passed.
+// Cancelled jobs are dropped without ever reaching a worker.
+static void fp_shard_retry_submits(fp_io_shard *shard, uint64_t now_ms) {
+    fp_pending_job **link = &shard->retry_head;
+    while (*link) {
+        fp_pending_job *pending = *link;
+        fp_cancel_reason cancelled = fp_cancel_token_check(pending->cancel);
+        if (cancelled == FP_CANCEL_NONE && fp_scheduler_push(shard->server->job_queue, pending->job) == 0) {
+            pending->job = NULL;
+            *link = pending->retry_next;
+            pending->retry_next = NULL;
+            continue;
         }
-        if (error_buf && error_buf_len) {
-            snprintf(error_buf, error_buf_len, "Unable to track progress");
+        if (cancelled == FP_CANCEL_NONE && now_ms < pending->enqueue_deadline_ms) {
+            link = &pending->retry_next;
+            continue;
+        }
+        *link = pending->retry_next;
+        pending->retry_next = NULL;
+        fp_admission_release(shard->server->admission, pending->admit_class, pending->work_units, 0.0);
+        fp_free_job(pending->job);
+        free(pending->job);
+        pending->job = NULL;
+        if (cancelled == FP_CANCEL_DEADLINE) {
+            fp_log_warn("⏱️  Deadline passed before #%llu was queued", (unsigned long long)pending->job_id);
+            fp_pending_finish(pending, NULL, 504, "Deadline exceeded");
+        } else if (cancelled == FP_CANCEL_ABANDONED) {
+            fp_pending_finish(pending, NULL, 499, "Client closed request");
+        } else {
+            fp_log_warn("⏱️  Job queue full; rejecting #%llu", (unsigned long long)pending->job_id);
+            pending->conn->retry_after_s = 1;
+            fp_pending_finish(pending, NULL, 503, "Server busy");
         }
-        fp_free_job(job);
-        free(job);
-        return NULL;
     }
-    fp_progress_retain(progress_channel);
-    job->progress = progress_channel;
-
-    fp_log_info("🧾 Enqueued job #%llu (%s, %zu bytes)", (unsigned long long)job->id, response_filename, job->size);
+}
 
-    int pushed = 0;
-    for (int attempt = 0; attempt < 5000 && !pushed; ++attempt) {
-        if (fp_queue_push(job_queue, job) == 0) {
-            pushed = 1;
-            break;
-        }
-        struct timespec ts = {0, FP_SLEEP_NS};
-        nanosleep(&ts, NULL);
+// Megapixels the job will encode, the unit of the worker ETA table. Buffered
+// uploads are sized from the PNG IHDR chunk without decoding them.
+static double fp_job_work_units(const fp_job *job) {
+    double pixels = 0.0;
+    if (job->decoded.pixels) {
+        pixels = (double)job->decoded.width * job->decoded.height;
+    } else if (job->data && job->size >= 24 && memcmp(job->data, "\x89PNG\r\n\x1a\n", 8) == 0 &&
+               memcmp(job->data + 12, "IHDR", 4) == 0) {
+        const uint8_t *ihdr = job->data + 16;
+        uint32_t width = (uint32_t)ihdr[0] << 24 | (uint32_t)ihdr[1] << 16 | (uint32_t)ihdr[2] << 8 | ihdr[3];
+        uint32_t height = (uint32_t)ihdr[4] << 24 | (uint32_t)ihdr[5] << 16 | (uint32_t)ihdr[6] << 8 | ihdr[7];
+        pixels = (double)width * height;
+    } else {
+        pixels = (double)job->size; // not a PNG; it will fail fast, but assume a byte per pixel
     }
+    double units = pixels / 1000000.0;
+    return units > 0.1 ? units : 0.1;
+}
 
-    if (!pushed) {
-        fp_log_warn("⏱️  Job queue full; rejecting #%llu", (unsigned long long)job->id);
-        job->progress = NULL;
+// Queues job for the workers and returns immediately; done runs on conn's loop
+// with the result, or with an HTTP status when the job could not be queued.
+static void fp_submit_job(fp_conn *conn,
+                          fp_job *job,
+                          const char *response_filename,
+                          size_t content_length,
+                          fp_job_done_fn done,
+                          void *ctx) {
+    fp_server *server = conn->server;
+    conn->state = FP_CONN_WAIT_JOB;
+    if (!job) {
+        done(conn, NULL, 400, "Invalid job", ctx);
+        return;
+    }
+    fp_admit_class admit_class = job->is_expert ? FP_ADMIT_EXPERT : FP_ADMIT_FREE;
+    double work_units = fp_job_work_units(job);
+    job->predicted_ms = fp_worker_predict_ms(job, work_units);
+    if (fp_admission_try_admit(server->admission, admit_class, work_units, &conn->retry_after_s) != 0) {
+        fp_log_warn("🚦 Backlog too deep (~%llu ms); refusing #%llu, retry in %us",
+                    (unsigned long long)fp_admission_wait_ms(server->admission),
+                    (unsigned long long)job->id,
+                    conn->retry_after_s);
         fp_free_job(job);
         free(job);
-        fp_progress_emit_status(progress_channel, "error", "server_busy", 0.0, content_length);
-        fp_progress_close(progress_channel);
-        fp_progress_release(progress_channel);
-        if (http_status) {
-            *http_status = 503;
-        }
-        if (error_buf && error_buf_len) {
-            snprintf(error_buf, error_buf_len, "Server busy");
-        }
-        return NULL;
+        done(conn, NULL, 503, "Server busy", ctx);
+        return;
     }
 
-    fp_result *result = fp_wait_for_result(result_queue, job->id);
-    if (!result) {
-        fp_progress_emit_status(progress_channel, "error", "no_result", 0.0, content_length);
+    fp_progress_channel *progress_channel = fp_progress_register(server->progress_registry, job->id);
+    if (!progress_channel) {
+        fp_admission_release(server->admission, admit_class, work_units, 0.0);
+        fp_free_job(job);
+        free(job);
+        done(conn, NULL, 503, "Unable to track progress", ctx);
+        return;
+    }
+    fp_progress_retain(progress_channel);
+    job->progress = progress_channel;
+    fp_stream_waiters_notify(server, job->id, progress_channel);
+
+    uint64_t deadline_ms = conn->request.deadline_ms > 0 ? fp_io_monotonic_ms() + conn->request.deadline_ms : 0;
+    fp_pending_job *pending = calloc(1, sizeof(fp_pending_job));
+    fp_cancel_token *cancel = pending ? fp_cancel_token_create(deadline_ms) : NULL;
+    if (!cancel) {
+        free(pending);
+        fp_admission_release(server->admission, admit_class, work_units, 0.0);
+        fp_free_job(job);
+        free(job);
         fp_progress_close(progress_channel);
         fp_progress_release(progress_channel);
-        if (http_status) {
-            *http_status = 500;
-        }
-        if (error_buf && error_buf_len) {
-            snprintf(error_buf, error_buf_len, "No result");
-        }
-        return NULL;
+        done(conn, NULL, 500, "Out of memory", ctx);
+        return;
     }
-
-    const char *status_label = result->status == 0 ? "ok" : "error";
-    fp_progress_emit_status(progress_channel, status_label, result->message, fp_duration_ms(result), result->input_size);
-    fp_progress_close(progress_channel);
-    fp_progress_release(progress_channel);
-    return result;
+    pending->job_id = job->id;
+    pending->conn = conn;
+    pending->progress = progress_channel;
+    pending->content_length = content_length;
+    pending->admit_class = admit_class;
+    pending->work_units = work_units;
+    pending->done = done;
+    pending->ctx = ctx;
+    pending->cancel = cancel;
+    pending->conn_next = conn->jobs;
+    conn->jobs = pending;
+    fp_conn_retain(conn);
+
+    fp_cancel_token_retain(cancel);
+    job->cancel = cancel;
+
+    job->on_complete = fp_pending_on_complete;
+    job->complete_ctx = pending;
+
+    fp_log_info("🧾 Enqueued job #%llu (%s, %zu bytes, ~%.0f ms)",
+                (unsigned long long)job->id,
+                response_filename,
+                job->size,
+                job->predicted_ms);
+
+    if (fp_scheduler_push(server->job_queue, job) == 0) {
+        fp_conn_update_interest(conn);
+        return;
+    }
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+    pending->job = job;
+    pending->enqueue_deadline_ms =
+        fp_io_loop_now_ms(conn->loop) + fp_admission_limits_for(server->admission, admit_class)->max_wait_ms;
+    pending->retry_next = shard->retry_head;
+    shard->retry_head = pending;
+    fp_conn_update_interest(conn);
 }
 
-static int fp_handle_google_auth(int fd, const fp_http_request *request, const uint8_t *body, size_t body_len,
+static int fp_handle_google_auth(fp_conn *conn, const fp_http_request *request, const uint8_t *body, size_t body_len,
                                  fp_auth_store *auth_store) {
     (void)request;
     if (!auth_store) {
-        return fp_send_json_error(fd, 500, "Auth storage unavailable");
+        return fp_send_json_error(conn, 500, "Auth storage unavailable");
     }
     if (!body || body_len == 0) {
-        return fp_send_json_error(fd, 400, "Missing body");
+        return fp_send_json_error(conn, 400, "Missing body");
     }
     char *json = strndup((const char *)body, body_len);
     if (!json) {
-        return fp_send_json_error(fd, 500, "Out of memory");
+        return fp_send_json_error(conn, 500, "Out of memory");
     }
     char credential[4096];
     int found = fp_extract_json_string(json, "credential", credential, sizeof(credential));
     if (found <= 0) {
         free(json);
-        return fp_send_json_error(fd, 400, "Missing credential");
+        return fp_send_json_error(conn, 400, "Missing credential");
     }
     const char *client_id = getenv("FP_GOOGLE_CLIENT_ID");
     if (!client_id || strlen(client_id) < 8) {
         free(json);
-        return fp_send_json_error(fd, 500, "Server missing FP_GOOGLE_CLIENT_ID");
+        return fp_send_json_error(conn, 500, "Server missing FP_GOOGLE_CLIENT_ID");
     }
 
     char *token = credential;
@@ -1999,7 +3009,7 @@ static int fp_handle_google_auth(int fd, const fp_http_request *request, const u
     char *dot2 = dot1 ? strchr(dot1 + 1, '.') : NULL;
     if (!dot1 || !dot2) {
         free(json);
-        return fp_send_json_error(fd, 400, "Invalid token");
+        return fp_send_json_error(conn, 400, "Invalid token");
     }
     *dot2 = '\0';
     *dot1 = '\0';
@@ -2007,25 +3017,25 @@ static int fp_handle_google_auth(int fd, const fp_http_request *request, const u
     size_t payload_len = 0;
     if (fp_base64url_decode(dot1 + 1, &payload, &payload_len) != 0 || !payload) {
         free(json);
-        return fp_send_json_error(fd, 400, "Unable to decode token");
+        return fp_send_json_error(conn, 400, "Unable to decode token");
     }
     char *payload_json = strndup((const char *)payload, payload_len);
     free(payload);
     if (!payload_json) {
         free(json);
-        return fp_send_json_error(fd, 500, "Out of memory");
+        return fp_send_json_error(conn, 500, "Out of memory");
     }
 
     char aud[256] = {0};
     if (fp_extract_json_string(payload_json, "aud", aud, sizeof(aud)) <= 0) {
         free(payload_json);
         free(json);
-        return fp_send_json_error(fd, 400, "Token missing aud");
+        return fp_send_json_error(conn, 400, "Token missing aud");
     }
     if (strcmp(aud, client_id) != 0) {
         free(payload_json);
         free(json);
-        return fp_send_json_error(fd, 401, "Invalid audience");
+        return fp_send_json_error(conn, 401, "Invalid audience");
     }
 
     char issuer[256] = {0};
@@ -2035,7 +3045,7 @@ static int fp_handle_google_auth(int fd, const fp_http_request *request, const u
         strncasecmp(issuer, "accounts.google.com", 20) != 0) {
         free(payload_json);
         free(json);
-        return fp_send_json_error(fd, 401, "Invalid issuer");
+        return fp_send_json_error(conn, 401, "Invalid issuer");
     }
 
     char email[256] = {0};
@@ -2049,21 +3059,21 @@ static int fp_handle_google_auth(int fd, const fp_http_request *request, const u
     if (sub[0] == '\0') {
         free(payload_json);
         free(json);
-        return fp_send_json_error(fd, 400, "Token missing subject");
+        return fp_send_json_error(conn, 400, "Token missing subject");
     }
 
     fp_auth_user user = {0};
     if (fp_auth_upsert_user(auth_store, "google", sub, email, name, picture, payload_json, &user) != 0) {
         free(payload_json);
         free(json);
-        return fp_send_json_error(fd, 500, "Unable to persist user");
+        return fp_send_json_error(conn, 500, "Unable to persist user");
     }
 
     fp_auth_tokens tokens = {0};
     if (fp_auth_issue_tokens(auth_store, &user, &tokens) != 0) {
         free(payload_json);
         free(json);
-        return fp_send_json_error(fd, 500, "Unable to issue tokens");
+        return fp_send_json_error(conn, 500, "Unable to issue tokens");
     }
 
     fp_auth_record_audit(auth_store, user.id, "login_google", payload_json);
@@ -2092,7 +3102,7 @@ static int fp_handle_google_auth(int fd, const fp_http_request *request, const u
         fp_buffer_free(&resp);
         free(payload_json);
         free(json);
-        return fp_send_json_error(fd, 500, "Internal error");
+        return fp_send_json_error(conn, 500, "Internal error");
     }
 
     char access_cookie[1024];
@@ -2109,25 +3119,25 @@ static int fp_handle_google_auth(int fd, const fp_http_request *request, const u
              auth_store->refresh_ttl_seconds);
     const char *cookies[] = {access_cookie, refresh_cookie};
 
-    int rc = fp_send_json_with_cookies(fd, 200, "OK", resp.data, cookies, sizeof(cookies) / sizeof(cookies[0]));
+    int rc = fp_send_json_with_cookies(conn, 200, "OK", resp.data, cookies, sizeof(cookies) / sizeof(cookies[0]));
     fp_buffer_free(&resp);
     free(payload_json);
     free(json);
     return rc;
 }
 
-static int fp_handle_facebook_auth(int fd, const fp_http_request *request, const uint8_t *body, size_t body_len,
+static int fp_handle_facebook_auth(fp_conn *conn, const fp_http_request *request, const uint8_t *body, size_t body_len,
                                    fp_auth_store *auth_store) {
     (void)request;
     if (!auth_store) {
-        return fp_send_json_error(fd, 500, "Auth storage unavailable");
+        return fp_send_json_error(conn, 500, "Auth storage unavailable");
     }
     if (!body || body_len == 0) {
-        return fp_send_json_error(fd, 400, "Missing body");
+        return fp_send_json_error(conn, 400, "Missing body");
     }
     char *json = strndup((const char *)body, body_len);
     if (!json) {
-        return fp_send_json_error(fd, 500, "Out of memory");
+        return fp_send_json_error(conn, 500, "Out of memory");
     }
 
     char access_token[4096] = {0};
@@ -2144,32 +3154,32 @@ static int fp_handle_facebook_auth(int fd, const fp_http_request *request, const
 
     if (access_token[0] == '\0') {
         free(json);
-        return fp_send_json_error(fd, 400, "Missing accessToken");
+        return fp_send_json_error(conn, 400, "Missing accessToken");
     }
     if (user_id[0] == '\0') {
         free(json);
-        return fp_send_json_error(fd, 400, "Missing userID");
+        return fp_send_json_error(conn, 400, "Missing userID");
     }
     const char *app_id = getenv("FP_FACEBOOK_APP_ID");
     if (!app_id || strlen(app_id) < 3) {
         free(json);
-        return fp_send_json_error(fd, 500, "Server missing FP_FACEBOOK_APP_ID");
+        return fp_send_json_error(conn, 500, "Server missing FP_FACEBOOK_APP_ID");
     }
     if (!strstr(access_token, app_id)) {
         free(json);
-        return fp_send_json_error(fd, 401, "Invalid audience");
+        return fp_send_json_error(conn, 401, "Invalid audience");
     }
 
     fp_auth_user user = {0};
     if (fp_auth_upsert_user(auth_store, "facebook", user_id, email, name, picture, json, &user) != 0) {
         free(json);
-        return fp_send_json_error(fd, 500, "Unable to persist user");
+        return fp_send_json_error(conn, 500, "Unable to persist user");
     }
 
     fp_auth_tokens tokens = {0};
     if (fp_auth_issue_tokens(auth_store, &user, &tokens) != 0) {
         free(json);
-        return fp_send_json_error(fd, 500, "Unable to issue tokens");
+        return fp_send_json_error(conn, 500, "Unable to issue tokens");
     }
 
     fp_auth_record_audit(auth_store, user.id, "login_facebook", json);
@@ -2197,7 +3207,7 @@ static int fp_handle_facebook_auth(int fd, const fp_http_request *request, const
         FP_APPEND_LITERAL(&resp, "}") != 0) {
         fp_buffer_free(&resp);
         free(json);
-        return fp_send_json_error(fd, 500, "Internal error");
+        return fp_send_json_error(conn, 500, "Internal error");
     }
 
     char access_cookie[1024];
@@ -2214,21 +3224,21 @@ static int fp_handle_facebook_auth(int fd, const fp_http_request *request, const
              auth_store->refresh_ttl_seconds);
     const char *cookies[] = {access_cookie, refresh_cookie};
 
-    int rc = fp_send_json_with_cookies(fd, 200, "OK", resp.data, cookies, sizeof(cookies) / sizeof(cookies[0]));
+    int rc = fp_send_json_with_cookies(conn, 200, "OK", resp.data, cookies, sizeof(cookies) / sizeof(cookies[0]));
     fp_buffer_free(&resp);
     free(json);
     return rc;
 }
 
-static int fp_handle_api_key_issue(int fd, const fp_http_request *request, const uint8_t *body, size_t body_len,
+static int fp_handle_api_key_issue(fp_conn *conn, const fp_http_request *request, const uint8_t *body, size_t body_len,
                                    fp_auth_store *auth_store) {
     if (!auth_store) {
-        return fp_send_json_error(fd, 500, "Auth storage unavailable");
+        return fp_send_json_error(conn, 500, "Auth storage unavailable");
     }
     fp_auth_user user = {0};
     int auth_state = fp_authenticate_request(auth_store, request, &user);
     if (auth_state <= 0) {
-        return fp_send_json_error(fd, 401, "Missing or invalid access token");
+        return fp_send_json_error(conn, 401, "Missing or invalid access token");
     }
 
     char scope[64] = "expert";
@@ -2237,7 +3247,7 @@ static int fp_handle_api_key_issue(int fd, const fp_http_request *request, const
     if (body && body_len > 0) {
         json_body = strndup((const char *)body, body_len);
         if (!json_body) {
-            return fp_send_json_error(fd, 500, "Out of memory");
+            return fp_send_json_error(conn, 500, "Out of memory");
         }
         char tmp_scope[64] = {0};
         if (fp_extract_json_string(json_body, "scope", tmp_scope, sizeof(tmp_scope)) > 0) {
@@ -2254,7 +3264,7 @@ static int fp_handle_api_key_issue(int fd, const fp_http_request *request, const
     char api_key[256];
     if (fp_auth_generate_api_key(auth_store, user.id, scope, label, api_key, sizeof(api_key)) != 0) {
         free(json_body);
-        return fp_send_json_error(fd, 500, "Unable to issue API key");
+        return fp_send_json_error(conn, 500, "Unable to issue API key");
     }
 
     fp_buffer resp = {0};
@@ -2269,7 +3279,7 @@ static int fp_handle_api_key_issue(int fd, const fp_http_request *request, const
         FP_APPEND_LITERAL(&resp, "}") != 0) {
         fp_buffer_free(&resp);
         free(json_body);
-        return fp_send_json_error(fd, 500, "Internal error");
+        return fp_send_json_error(conn, 500, "Internal error");
     }
 
     fp_buffer audit_meta = {0};
@@ -2284,21 +3294,21 @@ static int fp_handle_api_key_issue(int fd, const fp_http_request *request, const
     }
     fp_buffer_free(&audit_meta);
 
-    int rc = fp_send_http(fd, 200, "OK", "application/json", resp.data, resp.size);
+    int rc = fp_send_http(conn, 200, "OK", "application/json", resp.data, resp.size);
     fp_buffer_free(&resp);
     free(json_body);
     return rc;
 }
 
-static int fp_handle_checkout_session(int fd, const fp_http_request *request, const uint8_t *body, size_t body_len,
+static int fp_handle_checkout_session(fp_conn *conn, const fp_http_request *request, const uint8_t *body, size_t body_len,
                                       fp_auth_store *auth_store) {
     if (!auth_store) {
-        return fp_send_json_error(fd, 500, "Billing unavailable");
+        return fp_send_json_error(conn, 500, "Billing unavailable");
     }
     fp_auth_user user = {0};
     int auth_state = fp_authenticate_request(auth_store, request, &user);
     if (auth_state != 1) {
-        return fp_send_json_error(fd, 401, "Authentication required for billing");
+        return fp_send_json_error(conn, 401, "Authentication required for billing");
     }
 
     char *json_body = NULL;
@@ -2306,7 +3316,7 @@ static int fp_handle_checkout_session(int fd, const fp_http_request *request, co
     if (body && body_len > 0) {
         json_body = strndup((const char *)body, body_len);
         if (!json_body) {
-            return fp_send_json_error(fd, 500, "Out of memory");
+            return fp_send_json_error(conn, 500, "Out of memory");
         }
         if (fp_extract_json_string(json_body, "priceId", price_requested, sizeof(price_requested)) <= 0) {
             fp_extract_json_string(json_body, "price", price_requested, sizeof(price_requested));
@@ -2380,10 +3390,10 @@ static int fp_handle_checkout_session(int fd, const fp_http_request *request, co
         if (json_body) {
             free(json_body);
         }
-        return fp_send_json_error(fd, 500, "Internal error");
+        return fp_send_json_error(conn, 500, "Internal error");
     }
 
-    int rc = fp_send_http(fd, 200, "OK", "application/json", resp.data, resp.size);
+    int rc = fp_send_http(conn, 200, "OK", "application/json", resp.data, resp.size);
     fp_buffer_free(&resp);
     if (json_body) {
         free(json_body);
@@ -2391,17 +3401,17 @@ static int fp_handle_checkout_session(int fd, const fp_http_request *request, co
     return rc;
 }
 
-static int fp_handle_billing_portal(int fd, const fp_http_request *request, fp_auth_store *auth_store) {
+static int fp_handle_billing_portal(fp_conn *conn, const fp_http_request *request, fp_auth_store *auth_store) {
     if (!auth_store) {
-        return fp_send_json_error(fd, 500, "Billing unavailable");
+        return fp_send_json_error(conn, 500, "Billing unavailable");
     }
     fp_auth_user user = {0};
     if (fp_authenticate_request(auth_store, request, &user) != 1) {
-        return fp_send_json_error(fd, 401, "Authentication required for billing");
+        return fp_send_json_error(conn, 401, "Authentication required for billing");
     }
     fp_auth_subscription sub;
     if (fp_auth_get_subscription(auth_store, user.id, &sub) != 0) {
-        return fp_send_json_error(fd, 404, "No subscription on file");
+        return fp_send_json_error(conn, 404, "No subscription on file");
     }
 
     char portal_url[256];
@@ -2438,26 +3448,26 @@ static int fp_handle_billing_portal(int fd, const fp_http_request *request, fp_a
         fp_buffer_appendf(&resp, "%lld", (long long)sub.current_period_end) != 0 ||
         FP_APPEND_LITERAL(&resp, "}") != 0) {
         fp_buffer_free(&resp);
-        return fp_send_json_error(fd, 500, "Internal error");
+        return fp_send_json_error(conn, 500, "Internal error");
     }
 
-    int rc = fp_send_http(fd, 200, "OK", "application/json", resp.data, resp.size);
+    int rc = fp_send_http(conn, 200, "OK", "application/json", resp.data, resp.size);
     fp_buffer_free(&resp);
     return rc;
 }
 
-static int fp_handle_stripe_webhook(int fd, const fp_http_request *request, const uint8_t *body, size_t body_len,
+static int fp_handle_stripe_webhook(fp_conn *conn, const fp_http_request *request, const uint8_t *body, size_t body_len,
                                     fp_auth_store *auth_store) {
     (void)request;
     if (!auth_store) {
-        return fp_send_json_error(fd, 500, "Billing unavailable");
+        return fp_send_json_error(conn, 500, "Billing unavailable");
     }
     if (!body || body_len == 0) {
-        return fp_send_json_error(fd, 400, "Missing body");
+        return fp_send_json_error(conn, 400, "Missing body");
     }
     char *json = strndup((const char *)body, body_len);
     if (!json) {
-        return fp_send_json_error(fd, 500, "Out of memory");
+        return fp_send_json_error(conn, 500, "Out of memory");
     }
     char event_type[128] = {0};
     char status[64] = {0};
@@ -2501,7 +3511,7 @@ static int fp_handle_stripe_webhook(int fd, const fp_http_request *request, cons
 
     if (user_id == 0) {
         free(json);
-        return fp_send_json_error(fd, 202, "No matching user for webhook");
+        return fp_send_json_error(conn, 202, "No matching user for webhook");
     }
 
     fp_auth_sync_subscription(auth_store, user_id, final_status, customer, subscription, period_end);
@@ -2527,24 +3537,60 @@ static int fp_handle_stripe_webhook(int fd, const fp_http_request *request, cons
 
     fp_buffer resp = {0};
     FP_APPEND_LITERAL(&resp, "{\"status\":\"ok\"}");
-    int rc = fp_send_http(fd, 200, "OK", "application/json", resp.data, resp.size);
+    int rc = fp_send_http(conn, 200, "OK", "application/json", resp.data, resp.size);
     fp_buffer_free(&resp);
     free(json);
     return rc;
 }
 
-static int fp_handle_compress(int fd, const fp_http_request *request, uint8_t *body,
-                              fp_queue *job_queue, fp_queue *result_queue,
-                              fp_progress_registry *progress_registry) {
-    if (!request || !body) {
+typedef struct {
+    uint64_t job_id;
+    bool multipart;
+    char response_filename[FP_FILENAME_MAX];
+} fp_compress_request;
+
+static void fp_compress_done(fp_conn *conn, fp_result *result, int http_status, const char *error, void *ctx) {
+    fp_compress_request *req = (fp_compress_request *)ctx;
+    if (!result) {
+        fp_send_json_error(conn, http_status, error && *error ? error : "Compression failed");
+    } else if (result->status != 0) {
+        fp_log_warn("❌ Job #%llu failed: %s", (unsigned long long)req->job_id, result->message);
+        fp_send_json_error(conn, fp_result_error_status(result), result->message);
+    } else {
+        fp_log_info("✅ Job #%llu completed in %.2f ms", (unsigned long long)req->job_id, fp_duration_ms(result));
+        if (req->multipart) {
+            fp_send_result_multipart(conn, result, req->response_filename);
+        } else {
+            fp_send_result_payload(conn, result, req->response_filename);
+        }
+        result = NULL;
+    }
+    if (result) {
+        fp_free_result(result);
+        free(result);
+    }
+    free(req);
+    fp_conn_end_response(conn);
+}
+
+// Builds the job for a single-image upload (POST /api/compress and
+// /api/jobs). Either body holds the raw upload or, for streamed uploads,
+// image holds the pixels decoded while it arrived (empty if the PNG was
+// invalid, so the worker reports decode_error exactly as for a buffered body).
+// On failure the upload is freed, an error response is sent and NULL returned.
+static fp_job *fp_build_upload_job(fp_conn *conn, const fp_http_request *request, uint8_t *body, fp_rgba_image *image) {
+    if (!request || (!body && !image)) {
         free(body);
-        return fp_send_json_error(fd, 400, "Invalid request");
+        fp_send_json_error(conn, 400, "Invalid request");
+        return NULL;
     }
 
     fp_job *job = calloc(1, sizeof(fp_job));
     if (!job) {
         free(body);
-        return fp_send_json_error(fd, 500, "Out of memory");
+        fp_rgba_image_free(image);
+        fp_send_json_error(conn, 500, "Out of memory");
+        return NULL;
     }
 
     uint64_t assigned_id = request->client_job_id ? request->client_job_id : atomic_fetch_add(&g_job_counter, 1);
@@ -2558,6 +3604,10 @@ static int fp_handle_compress(int fd, const fp_http_request *request, uint8_t *b
     clock_gettime(CLOCK_MONOTONIC, &job->enqueue_ts);
     job->size = request->content_length;
     job->data = body;
+    if (image) {
+        job->decoded = *image;
+        memset(image, 0, sizeof(*image));
+    }
 
     fp_sanitize_filename(job->filename, sizeof(job->filename), request->filename);
     if (job->filename[0] == '\0') {
@@ -2566,60 +3616,567 @@ static int fp_handle_compress(int fd, const fp_http_request *request, uint8_t *b
     snprintf(job->tune_format, sizeof(job->tune_format), "%s", request->tune_format);
     snprintf(job->tune_label, sizeof(job->tune_label), "%s", request->tune_label);
     job->tune_direction = request->tune_direction;
-    char response_filename[FP_FILENAME_MAX];
-    strncpy(response_filename, job->filename, sizeof(response_filename) - 1);
-    response_filename[sizeof(response_filename) - 1] = '\0';
-    uint64_t job_id = job->id;
 
     if (job->tune_direction != 0 && job->tune_format[0] != '\0') {
         if (!fp_is_known_target(job->tune_format, job->tune_label)) {
             fp_log_warn("🚫 Unknown tune target: %s / %s", job->tune_format, job->tune_label);
             fp_free_job(job);
             free(job);
-            return fp_send_json_error(fd, 400, "Unknown tune target");
+            fp_send_json_error(conn, 400, "Unknown tune target");
+            return NULL;
         }
         const char *intent = job->tune_direction > 0 ? "smaller" : "more_detail";
         fp_log_info("🎛️  Tuning request → %s (%s)", job->tune_format, intent);
     }
-    int status_code = 200;
-    char error_buf[128] = {0};
-    fp_result *result = fp_submit_job(job,
-                                      response_filename,
-                                      request->content_length,
-                                      job_queue,
-                                      result_queue,
-                                      progress_registry,
-                                      &status_code,
-                                      error_buf,
-                                      sizeof(error_buf));
-    if (!result) {
-        if (error_buf[0] == '\0') {
-            strncpy(error_buf, "Compression failed", sizeof(error_buf) - 1);
+    return job;
+}
+
+static int fp_handle_compress(fp_conn *conn, const fp_http_request *request, uint8_t *body, fp_rgba_image *image) {
+    fp_job *job = fp_build_upload_job(conn, request, body, image);
+    if (!job) {
+        return -1;
+    }
+    // A retune is one format re-encoded while the user watches the slider.
+    job->job_class = job->tune_direction != 0 && job->tune_format[0] ? FP_JOB_INTERACTIVE : FP_JOB_FREE;
+    fp_compress_request *req = calloc(1, sizeof(fp_compress_request));
+    if (!req) {
+        fp_free_job(job);
+        free(job);
+        return fp_send_json_error(conn, 500, "Out of memory");
+    }
+    req->job_id = job->id;
+    req->multipart = fp_accepts_multipart(request);
+    if (request->reference_outputs && conn->server->output_store) {
+        // Outputs are downloaded separately, so the response only lists URLs.
+        job->output_store = conn->server->output_store;
+        req->multipart = false;
+    }
+    snprintf(req->response_filename, sizeof(req->response_filename), "%s", job->filename);
+    fp_submit_job(conn, job, req->response_filename, request->content_length, fp_compress_done, req);
+    return 0;
+}
+
+// Completion state of a job submitted through POST /api/jobs. Nothing waits on
+// a connection, so the worker hands the result straight to the result store.
+struct fp_async_job {
+    fp_result_store *store;
+    fp_progress_channel *progress;
+    fp_admission *admission;
+    fp_io_shard *shard; // lists the job until it completes
+    fp_cancel_token *cancel;
+    double work_units;
+    uint64_t job_id;
+    size_t content_length;
+    char filename[FP_FILENAME_MAX];
+    struct fp_async_job *prev;
+    struct fp_async_job *next;
+};
+
+static void fp_async_job_link(fp_async_job *async) {
+    fp_io_shard *shard = async->shard;
+    pthread_mutex_lock(&shard->async_mutex);
+    async->prev = NULL;
+    async->next = shard->async_jobs;
+    if (shard->async_jobs) {
+        shard->async_jobs->prev = async;
+    }
+    shard->async_jobs = async;
+    pthread_mutex_unlock(&shard->async_mutex);
+}
+
+static void fp_async_job_unlink(fp_async_job *async) {
+    fp_io_shard *shard = async->shard;
+    pthread_mutex_lock(&shard->async_mutex);
+    if (async->prev) {
+        async->prev->next = async->next;
+    } else {
+        shard->async_jobs = async->next;
+    }
+    if (async->next) {
+        async->next->prev = async->prev;
+    }
+    pthread_mutex_unlock(&shard->async_mutex);
+    fp_cancel_token_release(async->cancel);
+}
+
+static void fp_async_job_on_complete(fp_result *result, void *ctx) {
+    fp_async_job *async = (fp_async_job *)ctx;
+    fp_async_job_unlink(async);
+    if (result) {
+        const char *status_label = result->status == 0 ? "ok" : "error";
+        fp_progress_emit_status(async->progress, status_label, result->message, fp_duration_ms(result), result->input_size);
+        if (result->status == 0) {
+            fp_log_info("✅ Job #%llu completed in %.2f ms", (unsigned long long)async->job_id, fp_duration_ms(result));
+        } else {
+            fp_log_warn("❌ Job #%llu failed: %s", (unsigned long long)async->job_id, result->message);
+        }
+    } else {
+        fp_progress_emit_status(async->progress, "error", "no_result", 0.0, async->content_length);
+    }
+    fp_progress_close(async->progress);
+    fp_progress_release(async->progress);
+    // Completing may wake pollers on the I/O loops, which only outlive the
+    // job until it is released.
+    double service_ms = fp_duration_ms(result);
+    fp_result_store_complete(async->store, async->job_id, async->filename, result);
+    fp_admission *admission = async->admission;
+    double work_units = async->work_units;
+    free(async);
+    fp_admission_release(admission, FP_ADMIT_FREE, work_units, service_ms);
+}
+
+// POST /api/jobs: queues the upload and answers 202 right away; the result is
+// fetched later from /api/jobs/{id}.
+static int fp_handle_job_submit(fp_conn *conn, const fp_http_request *request, uint8_t *body, fp_rgba_image *image) {
+    fp_server *server = conn->server;
+    fp_job *job = fp_build_upload_job(conn, request, body, image);
+    if (!job) {
+        return -1;
+    }
+    job->job_class = FP_JOB_BULK; // nobody waits on the connection
+    uint64_t job_id = job->id;
+    // Nothing waits on the connection, so only the deadline or a shutdown
+    // can cancel the job.
+    job->cancel = fp_cancel_token_create(request->deadline_ms > 0 ? fp_io_monotonic_ms() + request->deadline_ms : 0);
+    if (!job->cancel) {
+        fp_free_job(job);
+        free(job);
+        return fp_send_json_error(conn, 500, "Out of memory");
+    }
+    double work_units = fp_job_work_units(job);
+    job->predicted_ms = fp_worker_predict_ms(job, work_units);
+    if (fp_admission_try_admit(server->admission, FP_ADMIT_FREE, work_units, &conn->retry_after_s) != 0) {
+        fp_log_warn("🚦 Backlog too deep (~%llu ms); refusing async #%llu, retry in %us",
+                    (unsigned long long)fp_admission_wait_ms(server->admission),
+                    (unsigned long long)job_id,
+                    conn->retry_after_s);
+        fp_free_job(job);
+        free(job);
+        return fp_send_json_error(conn, 503, "Server busy");
+    }
+    if (fp_result_store_reserve(server->result_store, job_id) != 0) {
+        fp_admission_release(server->admission, FP_ADMIT_FREE, work_units, 0.0);
+        bool known = fp_result_store_lookup(server->result_store, job_id, NULL, NULL, NULL, NULL) != FP_JOB_UNKNOWN;
+        fp_free_job(job);
+        free(job);
+        if (known) {
+            return fp_send_json_error(conn, 409, "Job id already in use");
         }
-        return fp_send_json_error(fd, status_code, error_buf);
+        return fp_send_json_error(conn, 503, "Too many unfinished jobs");
     }
 
-    int rc;
-    if (result->status != 0) {
-        fp_log_warn("❌ Job #%llu failed: %s", (unsigned long long)job_id, result->message);
-        rc = fp_send_json_error(fd, 500, result->message);
+    fp_async_job *async = calloc(1, sizeof(fp_async_job));
+    fp_progress_channel *progress_channel = async ? fp_progress_register(server->progress_registry, job_id) : NULL;
+    if (!progress_channel) {
+        free(async);
+        fp_admission_release(server->admission, FP_ADMIT_FREE, work_units, 0.0);
+        fp_result_store_cancel(server->result_store, job_id);
+        fp_free_job(job);
+        free(job);
+        return fp_send_json_error(conn, 503, "Unable to track progress");
+    }
+    fp_progress_retain(progress_channel);
+    job->progress = progress_channel;
+    fp_stream_waiters_notify(server, job_id, progress_channel);
+
+    async->store = server->result_store;
+    async->admission = server->admission;
+    async->shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+    async->cancel = job->cancel;
+    fp_cancel_token_retain(async->cancel);
+    async->work_units = work_units;
+    async->progress = progress_channel;
+    async->job_id = job_id;
+    async->content_length = request->content_length;
+    snprintf(async->filename, sizeof(async->filename), "%s", job->filename);
+    job->on_complete = fp_async_job_on_complete;
+    job->complete_ctx = async;
+    fp_async_job_link(async); // before the push: a worker may complete it at once
+
+    if (fp_scheduler_push(server->job_queue, job) != 0) {
+        fp_log_warn("⏱️  Job queue full; rejecting #%llu", (unsigned long long)job_id);
+        fp_async_job_unlink(async);
+        fp_free_job(job);
+        free(job);
+        fp_progress_emit_status(progress_channel, "error", "server_busy", 0.0, request->content_length);
+        fp_progress_close(progress_channel);
+        fp_progress_release(progress_channel);
+        fp_result_store_cancel(server->result_store, job_id);
+        fp_admission_release(server->admission, FP_ADMIT_FREE, work_units, 0.0);
+        free(async);
+        conn->retry_after_s = 1;
+        return fp_send_json_error(conn, 503, "Server busy");
+    }
+    fp_log_info("🧾 Accepted async job #%llu (%s, %zu bytes)",
+                (unsigned long long)job_id,
+                async->filename,
+                request->content_length);
+
+    char location[64];
+    char body_json[160];
+    snprintf(location, sizeof(location), "Location: /api/jobs/%llu\r\n", (unsigned long long)job_id);
+    int body_len = snprintf(body_json,
+                            sizeof(body_json),
+                            "{\"status\":\"queued\",\"jobId\":%llu,\"statusUrl\":\"/api/jobs/%llu\","
+                            "\"eventsUrl\":\"/api/jobs/%llu/events\"}",
+                            (unsigned long long)job_id,
+                            (unsigned long long)job_id,
+                            (unsigned long long)job_id);
+    return fp_send_http_with_headers(conn, 202, "Accepted", "application/json", location, body_json, (size_t)body_len);
+}
+
+// Answers GET /api/jobs/{id} from the job's current state.
+static int fp_send_job_status(fp_conn *conn, uint64_t job_id, fp_job_state state, fp_stored_result *stored) {
+    if (state == FP_JOB_UNKNOWN) {
+        return fp_send_json_error(conn, 404, "Unknown or expired job");
+    }
+    if (state == FP_JOB_PENDING) {
+        char body_json[96];
+        int body_len = snprintf(body_json,
+                                sizeof(body_json),
+                                "{\"status\":\"pending\",\"jobId\":%llu}",
+                                (unsigned long long)job_id);
+        return fp_send_http_with_headers(conn, 202, "Accepted", "application/json", "Cache-Control: no-store\r\n",
+                                         body_json, (size_t)body_len);
+    }
+    const fp_result *result = fp_stored_result_get(stored);
+    if (!result || result->status != 0) {
+        fp_buffer buffer = {0};
+        int rc = -1;
+        if (FP_APPEND_LITERAL(&buffer, "{\"status\":\"error\",\"jobId\":") == 0 &&
+            fp_buffer_appendf(&buffer, "%llu", (unsigned long long)job_id) == 0 &&
+            FP_APPEND_LITERAL(&buffer, ",\"message\":") == 0 &&
+            fp_buffer_append_json_string(&buffer, result ? result->message : "No result") == 0 &&
+            FP_APPEND_LITERAL(&buffer, "}") == 0) {
+            rc = fp_send_http(conn, 200, "OK", "application/json", buffer.data, buffer.size);
+        } else {
+            rc = fp_send_json_error(conn, 500, "Failed to build payload");
+        }
+        fp_buffer_free(&buffer);
+        fp_stored_result_release(stored);
+        return rc;
+    }
+    // Outputs are listed by URL, so the document holds no reference into the
+    // stored result and it can be released right away.
+    fp_json_stream *json = calloc(1, sizeof(fp_json_stream));
+    if (!json || fp_append_result_json(json, result, fp_stored_result_filename(stored), FP_RESULT_OUTPUTS_URLS) != 0) {
+        fp_json_stream_free(json);
+        fp_stored_result_release(stored);
+        return fp_send_json_error(conn, 500, "Failed to build payload");
+    }
+    fp_stored_result_release(stored);
+    return fp_send_json_stream(conn, json);
+}
+
+static void fp_conn_poll_ready_task(fp_io_loop *loop, void *arg) {
+    (void)loop;
+    fp_conn *conn = (fp_conn *)arg;
+    conn->result_watch = NULL;
+    if (!conn->closed && conn->state == FP_CONN_POLL_WAIT) {
+        fp_stored_result *stored = NULL;
+        fp_job_state state = fp_result_store_lookup(conn->server->result_store, conn->poll_job_id, &stored, NULL, NULL, NULL);
+        conn->state = FP_CONN_DISPATCH;
+        fp_send_job_status(conn, conn->poll_job_id, state, stored);
+        fp_conn_end_response(conn);
+    }
+    fp_conn_release(conn);
+}
+
+// Result watch: runs on the thread that finished the job, so it only hands
+// the connection back to its own loop.
+static void fp_conn_poll_notify(void *ctx) {
+    fp_conn *conn = (fp_conn *)ctx;
+    fp_io_loop_post_task(conn->loop, &conn->poll_task, fp_conn_poll_ready_task, conn);
+}
+
+// GET /api/jobs/{id}: with wait_ms set, a pending job parks the connection
+// until it finishes or the wait runs out.
+static void fp_handle_job_status(fp_conn *conn, uint64_t job_id, uint64_t wait_ms) {
+    fp_stored_result *stored = NULL;
+    fp_result_watch *watch = NULL;
+    if (wait_ms > 0) {
+        fp_conn_retain(conn);
+    }
+    fp_job_state state = fp_result_store_lookup(conn->server->result_store,
+                                                job_id,
+                                                &stored,
+                                                wait_ms > 0 ? fp_conn_poll_notify : NULL,
+                                                conn,
+                                                &watch);
+    if (wait_ms > 0 && !watch) {
+        fp_conn_release(conn);
+    }
+    if (!watch) {
+        fp_send_job_status(conn, job_id, state, stored);
+        return;
+    }
+    conn->result_watch = watch;
+    conn->poll_job_id = job_id;
+    conn->poll_deadline_ms = fp_io_loop_now_ms(conn->loop) + wait_ms;
+    conn->state = FP_CONN_POLL_WAIT;
+    fp_conn_update_interest(conn);
+}
+
+static void fp_conn_poll_expire(fp_conn *conn, uint64_t now_ms) {
+    if (now_ms < conn->poll_deadline_ms || !fp_conn_poll_cancel(conn)) {
+        return;
+    }
+    conn->state = FP_CONN_DISPATCH;
+    fp_send_job_status(conn, conn->poll_job_id, FP_JOB_PENDING, NULL);
+    fp_conn_end_response(conn);
+}
+
+typedef struct fp_expert_request fp_expert_request;
+
+// Completion context of one file's job.
+typedef struct {
+    fp_expert_request *req;
+    size_t index;
+} fp_expert_slot;
+
+// Every file is queued up front. Completions append their entry to json in
+// the order they finish, and the response starts with the first successful
+// one, so files stream out while the rest are still being encoded.
+struct fp_expert_request {
+    fp_blob *body; // file slices below point into it; each job holds its own reference
+    size_t file_count;
+    size_t next_index; // files handed to fp_submit_job so far
+    size_t outstanding; // queued files whose completion has not arrived yet
+    size_t entry_count;
+    size_t ok_count;
+    int error_status; // HTTP status of the first failure
+    char error_message[128];
+    uint8_t *file_data[FP_EXPERT_MAX_FILES];
+    size_t file_sizes[FP_EXPERT_MAX_FILES];
+    char filenames[FP_EXPERT_MAX_FILES][FP_FILENAME_MAX];
+    char response_names[FP_EXPERT_MAX_FILES][FP_FILENAME_MAX];
+    fp_expert_options file_opts[FP_EXPERT_MAX_FILES];
+    fp_expert_slot slots[FP_EXPERT_MAX_FILES];
+    fp_json_stream *json;
+    bool producing; // the connection holds req as its body producer
+    bool finished;  // the closing text is in json; the body ends once it drains
+    size_t total_input_bytes;
+    size_t total_output_bytes;
+    struct timespec request_start;
+    fp_auth_user authed_user;
+    fp_auth_store *auth_store;
+};
+
+static void fp_expert_request_free(fp_expert_request *req) {
+    fp_json_stream_free(req->json);
+    fp_blob_release(req->body);
+    free(req);
+}
+
+static size_t fp_expert_produce(void *ctx, char *window, size_t window_len) {
+    fp_expert_request *req = (fp_expert_request *)ctx;
+    size_t used = fp_json_stream_produce(req->json, window, window_len);
+    if (used == 0 && !req->finished) {
+        return FP_BODY_PENDING;
+    }
+    return used;
+}
+
+// The connection is done with the body: it was sent in full, or the client
+// went away while files were still running (their completions free req).
+static void fp_expert_release_producer(void *ctx) {
+    fp_expert_request *req = (fp_expert_request *)ctx;
+    req->producing = false;
+    if (req->finished) {
+        fp_expert_request_free(req);
+    }
+}
+
+// Runs once the last file has completed.
+static void fp_expert_complete(fp_conn *conn, fp_expert_request *req) {
+    struct timespec request_end;
+    clock_gettime(CLOCK_MONOTONIC, &request_end);
+    double request_elapsed_ms = fp_elapsed_ms(&req->request_start, &request_end);
+    size_t total_input_bytes = req->total_input_bytes;
+    size_t total_output_bytes = req->total_output_bytes;
+    size_t total_saved_bytes = total_input_bytes > total_output_bytes ? total_input_bytes - total_output_bytes : 0;
+
+    atomic_fetch_add(&g_expert_request_count, 1);
+    atomic_fetch_add(&g_expert_request_files, req->file_count);
+    atomic_fetch_add(&g_expert_request_bytes, total_input_bytes);
+    fp_log_info("📊 Expert usage user=%llu files=%zu ok=%zu in=%zu out=%zu saved=%zu elapsed=%.2fms",
+                (unsigned long long)req->authed_user.id,
+                req->file_count,
+                req->ok_count,
+                total_input_bytes,
+                total_output_bytes,
+                total_saved_bytes,
+                request_elapsed_ms);
+    if (req->auth_store && req->authed_user.id) {
+        fp_buffer audit = {0};
+        if (FP_APPEND_LITERAL(&audit, "{") == 0 &&
+            fp_buffer_appendf(&audit, "\"files\":%zu,\"bytes_in\":%zu,\"bytes_out\":%zu,\"saved\":%zu,\"elapsed_ms\":%.3f",
+                              req->file_count,
+                              total_input_bytes,
+                              total_output_bytes,
+                              total_saved_bytes,
+                              request_elapsed_ms) == 0) {
+            FP_APPEND_LITERAL(&audit, "}");
+        }
+        fp_auth_record_audit(req->auth_store, req->authed_user.id, "expert_request", audit.data);
+        fp_buffer_free(&audit);
+    }
+
+    if (req->producing) {
+        // Aggregates close the document, after the per-file entries.
+        fp_buffer *body = &req->json->text;
+        bool ok = req->error_status == 0;
+        if (FP_APPEND_LITERAL(body, "],\"status\":") != 0 ||
+            fp_buffer_append_json_string(body, ok ? "ok" : "error") != 0 ||
+            FP_APPEND_LITERAL(body, ",\"message\":") != 0 ||
+            fp_buffer_append_json_string(body, ok ? "ok" : req->error_message) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"bytes_saved\":") != 0 ||
+            fp_buffer_appendf(body, "%zu", total_saved_bytes) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"total_input_bytes\":") != 0 ||
+            fp_buffer_appendf(body, "%zu", total_input_bytes) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"total_output_bytes\":") != 0 ||
+            fp_buffer_appendf(body, "%zu", total_output_bytes) != 0 ||
+            FP_APPEND_LITERAL(body, ",\"elapsed_ms\":") != 0 ||
+            fp_buffer_appendf(body, "%.3f", request_elapsed_ms) != 0 ||
+            FP_APPEND_LITERAL(body, "}") != 0 || fp_json_stream_cut(req->json) != 0) {
+            fp_conn_close(conn); // the body can't be finished; releases the producer
+            fp_expert_request_free(req);
+            return;
+        }
+        req->finished = true;
+        fp_conn_end_response(conn); // frees req once the body has drained
+        return;
+    }
+    if (!conn->closed) {
+        // Nothing succeeded, so the request fails as a whole.
+        fp_send_json_error(conn, req->error_status, req->error_message);
+        fp_conn_end_response(conn);
+    }
+    fp_expert_request_free(req);
+}
+
+// Separates entries in the "files" array.
+static int fp_expert_begin_entry(fp_expert_request *req) {
+    return req->entry_count++ > 0 ? fp_buffer_append(&req->json->text, ",", 1) : 0;
+}
+
+static void fp_expert_job_done(fp_conn *conn, fp_result *result, int http_status, const char *error, void *ctx) {
+    fp_expert_slot *slot = (fp_expert_slot *)ctx;
+    fp_expert_request *req = slot->req;
+    size_t i = slot->index;
+    req->outstanding--;
+
+    bool live = !conn->closed;
+    int rc = 0;
+    if (!result || result->status != 0) {
+        const char *message = result ? result->message : (error && *error ? error : "Compression failed");
+        if (result) {
+            fp_log_warn("❌ Expert job #%llu failed: %s", (unsigned long long)result->id, result->message);
+        }
+        if (req->error_status == 0) {
+            req->error_status = result ? fp_result_error_status(result) : http_status;
+            snprintf(req->error_message, sizeof(req->error_message), "%s", message);
+        }
+        if (live && (fp_expert_begin_entry(req) != 0 ||
+                     fp_append_expert_error_json(req->json, i, req->response_names[i], message) != 0 ||
+                     fp_json_stream_cut(req->json) != 0)) {
+            rc = -1;
+        }
+        if (result) {
+            fp_free_result(result);
+            free(result);
+        }
     } else {
-        fp_log_info("✅ Job #%llu completed in %.2f ms", (unsigned long long)job_id, fp_duration_ms(result));
-        rc = fp_send_result_payload(fd, result, response_filename);
+        size_t best_output = result->input_size;
+        if (live && (fp_expert_begin_entry(req) != 0 ||
+                     fp_append_expert_file_json(req->json, i, req->response_names[i], &req->file_opts[i], result,
+                                                &best_output) != 0 ||
+                     fp_json_stream_cut(req->json) != 0)) {
+            rc = -1;
+        }
+        req->ok_count++;
+        req->total_input_bytes += result->input_size;
+        req->total_output_bytes += best_output;
+        if (live) {
+            fp_json_stream_adopt(req->json, result); // its data strings may already be referenced
+        } else {
+            fp_free_result(result);
+            free(result);
+        }
+        if (live && rc == 0 && !req->producing) {
+            req->producing = true;
+            if (fp_send_http_streamed(conn, 200, "OK", "application/json", fp_expert_produce, req,
+                                      fp_expert_release_producer) != 0) {
+                rc = -1;
+            }
+        }
+    }
+    if (live && rc != 0) {
+        fp_conn_close(conn);
     }
 
-    fp_free_result(result);
-    free(result);
-    return rc;
+    if (req->outstanding == 0 && req->next_index == req->file_count) {
+        fp_expert_complete(conn, req);
+    } else if (req->producing) {
+        fp_conn_flush(conn);
+    }
+}
+
+static fp_job *fp_expert_build_job(fp_expert_request *req, size_t i) {
+    fp_job *job = calloc(1, sizeof(fp_job));
+    if (!job) {
+        return NULL;
+    }
+    // The job reads its file straight out of the request body.
+    job->data = req->file_data[i];
+    job->size = req->file_sizes[i];
+    job->data_owner = req->body;
+    fp_blob_retain(req->body);
+    uint64_t assigned_id = atomic_fetch_add(&g_job_counter, 1);
+    if (assigned_id == 0) {
+        assigned_id = atomic_fetch_add(&g_job_counter, 1);
+        if (assigned_id == 0) {
+            assigned_id = 1;
+        }
+    }
+    job->id = assigned_id;
+    clock_gettime(CLOCK_MONOTONIC, &job->enqueue_ts);
+    fp_sanitize_filename(job->filename, sizeof(job->filename), req->filenames[i]);
+    fp_populate_expert_outputs(job, &req->file_opts[i]);
+    job->job_class = FP_JOB_EXPERT; // the request passed fp_handle_expert_compress's API key check
+    return job;
+}
+
+// Queues every file at once so they spread over the worker pool. Failures
+// that happen while queueing complete their slot right away; the last
+// completion (possibly one of those) finishes the request.
+static void fp_expert_submit_all(fp_conn *conn, fp_expert_request *req) {
+    size_t file_count = req->file_count;
+    for (size_t i = 0; i < file_count; ++i) {
+        req->slots[i] = (fp_expert_slot){.req = req, .index = i};
+        fp_job *job = fp_expert_build_job(req, i);
+        snprintf(req->response_names[i], sizeof(req->response_names[i]), "%s", job ? job->filename : req->filenames[i]);
+        if (i + 1 == file_count) {
+            // From here on the jobs keep the body alive.
+            fp_blob_release(req->body);
+            req->body = NULL;
+        }
+        req->next_index = i + 1;
+        req->outstanding++;
+        if (!job) {
+            fp_expert_job_done(conn, NULL, 500, "Out of memory", &req->slots[i]);
+            continue;
+        }
+        // req may be gone once the last file is handed over.
+        fp_submit_job(conn, job, req->response_names[i], req->file_sizes[i], fp_expert_job_done, &req->slots[i]);
+    }
 }
 
-static int fp_handle_expert_compress(int fd, const fp_http_request *request, uint8_t *body,
-                                     fp_queue *job_queue, fp_queue *result_queue,
-                                     fp_progress_registry *progress_registry,
-                                     fp_auth_store *auth_store) {
+static int fp_handle_expert_compress(fp_conn *conn, const fp_http_request *request, uint8_t *body,
+                                     const fp_upload_form *form, fp_auth_store *auth_store) {
     if (!request || !body) {
         free(body);
-        return fp_send_json_error(fd, 400, "Invalid request");
+        return fp_send_json_error(conn, 400, "Invalid request");
     }
 
     struct timespec request_start;
@@ -2631,20 +4188,29 @@ static int fp_handle_expert_compress(int fd, const fp_http_request *request, uin
     if (!fp_is_expert_authorized(request, auth_store, &authed_user, auth_source, sizeof(auth_source), deny_reason, sizeof(deny_reason))) {
         fp_log_warn("🚫 Expert auth failed for %s (%s)", request->path, deny_reason[0] ? deny_reason : "unauthorized");
         free(body);
-        return fp_send_json_error(fd, 401, deny_reason[0] ? deny_reason : "Expert mode requires Authorization: ApiKey <token>");
-    }
-
-    char boundary[128];
-    if (fp_parse_boundary(request->content_type, boundary, sizeof(boundary)) != 0) {
-        free(body);
-        return fp_send_json_error(fd, 400, "Missing multipart boundary");
+        return fp_send_json_error(conn, 401, deny_reason[0] ? deny_reason : "Expert mode requires Authorization: ApiKey <token>");
     }
 
-    fp_form_part parts[FP_EXPERT_MAX_FILES + 4];
+    // The body was normally split while it arrived; otherwise it is parsed here.
+    fp_form_part local_parts[FP_EXPERT_MAX_FILES + 4];
+    const fp_form_part *parts = local_parts;
     size_t part_count = 0;
-    if (fp_parse_multipart(body, request->content_length, boundary, parts, sizeof(parts) / sizeof(parts[0]), &part_count) != 0) {
+    int parsed;
+    if (form) {
+        parts = form->parts;
+        parsed = form->failed ? -1 : fp_multipart_finish(&form->parser, &part_count);
+    } else {
+        char boundary[128];
+        if (fp_multipart_boundary(request->content_type, boundary, sizeof(boundary)) != 0) {
+            free(body);
+            return fp_send_json_error(conn, 400, "Missing multipart boundary");
+        }
+        parsed = fp_multipart_parse(body, request->content_length, boundary, local_parts,
+                                    sizeof(local_parts) / sizeof(local_parts[0]), &part_count);
+    }
+    if (parsed != 0) {
         free(body);
-        return fp_send_json_error(fd, 400, "Malformed multipart body");
+        return fp_send_json_error(conn, 400, "Malformed multipart body");
     }
 
     fp_expert_options opts;
@@ -2656,11 +4222,6 @@ static int fp_handle_expert_compress(int fd, const fp_http_request *request, uin
     char filenames[FP_EXPERT_MAX_FILES][FP_FILENAME_MAX];
     size_t file_count = 0;
     size_t total_bytes = 0;
-    size_t total_input_bytes = 0;
-    size_t total_output_bytes = 0;
-    size_t total_saved_bytes = 0;
-    double request_elapsed_ms = 0.0;
-
     for (size_t i = 0; i < part_count; ++i) {
         fp_form_part part = parts[i];
         int metadata_index = fp_metadata_index_from_part_name(part.name);
@@ -2677,19 +4238,19 @@ static int fp_handle_expert_compress(int fd, const fp_http_request *request, uin
         if (strncasecmp(part.name, "files", 5) == 0 || strncasecmp(part.name, "file", 4) == 0) {
             if (file_count >= FP_EXPERT_MAX_FILES) {
                 free(body);
-                return fp_send_json_error(fd, 400, "Too many files (max 10)");
+                return fp_send_json_error(conn, 400, "Too many files (max 10)");
             }
             if (part.size == 0) {
                 free(body);
-                return fp_send_json_error(fd, 400, "Empty file in upload");
+                return fp_send_json_error(conn, 400, "Empty file in upload");
             }
             if (part.size > FP_EXPERT_MAX_FILE) {
                 free(body);
-                return fp_send_json_error(fd, 413, "File too large for Expert mode (max 20MB)");
+                return fp_send_json_error(conn, 413, "File too large for Expert mode (max 20MB)");
             }
             if (total_bytes + part.size > FP_EXPERT_MAX_TOTAL) {
                 free(body);
-                return fp_send_json_error(fd, 413, "Total payload too large for Expert mode (max 100MB)");
+                return fp_send_json_error(conn, 413, "Total payload too large for Expert mode (max 100MB)");
             }
             fp_sanitize_filename(filenames[file_count], sizeof(filenames[file_count]), part.filename);
             if (filenames[file_count][0] == '\0') {
@@ -2709,7 +4270,7 @@ static int fp_handle_expert_compress(int fd, const fp_http_request *request, uin
 
     if (file_count == 0) {
         free(body);
-        return fp_send_json_error(fd, 400, "No files provided");
+        return fp_send_json_error(conn, 400, "No files provided");
     }
 
     for (size_t i = 0; i < file_count; ++i) {
@@ -2722,316 +4283,772 @@ static int fp_handle_expert_compress(int fd, const fp_http_request *request, uin
     char usage_err[128] = {0};
     if (fp_track_expert_usage(authed_user.id, file_count, total_bytes, usage_err, sizeof(usage_err)) != 0) {
         free(body);
-        return fp_send_json_error(fd, 429, usage_err[0] ? usage_err : "Daily limit reached");
+        return fp_send_json_error(conn, 429, usage_err[0] ? usage_err : "Daily limit reached");
     }
 
-    fp_result *results[FP_EXPERT_MAX_FILES] = {0};
-    char response_names[FP_EXPERT_MAX_FILES][FP_FILENAME_MAX];
-    int rc = 200;
-    for (size_t i = 0; i < file_count; ++i) {
-        const fp_form_part *part = file_parts[i];
-        fp_job *job = calloc(1, sizeof(fp_job));
-        if (!job) {
-            rc = fp_send_json_error(fd, 500, "Out of memory");
-            goto expert_cleanup;
-        }
-        job->size = part->size;
-        job->data = malloc(part->size);
-        if (!job->data) {
-            fp_free_job(job);
-            free(job);
-            rc = fp_send_json_error(fd, 500, "Out of memory");
-            goto expert_cleanup;
-        }
-        memcpy(job->data, part->data, part->size);
-        uint64_t assigned_id = atomic_fetch_add(&g_job_counter, 1);
-        if (assigned_id == 0) {
-            assigned_id = atomic_fetch_add(&g_job_counter, 1);
-            if (assigned_id == 0) {
-                assigned_id = 1;
-            }
-        }
-        job->id = assigned_id;
-        clock_gettime(CLOCK_MONOTONIC, &job->enqueue_ts);
-        fp_sanitize_filename(job->filename, sizeof(job->filename), filenames[i]);
-        snprintf(response_names[i], sizeof(response_names[i]), "%s", job->filename);
-
-        fp_populate_expert_outputs(job, &file_opts[i]);
-
-        int status_code = 200;
-        char error_buf[128] = {0};
-        fp_result *result = fp_submit_job(job,
-                                          response_names[i],
-                                          part->size,
-                                          job_queue,
-                                          result_queue,
-                                          progress_registry,
-                                          &status_code,
-                                          error_buf,
-                                          sizeof(error_buf));
-        if (!result) {
-            rc = fp_send_json_error(fd, status_code, error_buf[0] ? error_buf : "Compression failed");
-            goto expert_cleanup;
-        }
-        if (result->status != 0) {
-            fp_log_warn("❌ Expert job #%llu failed: %s", (unsigned long long)result->id, result->message);
-            rc = fp_send_json_error(fd, 500, result->message);
-            fp_free_result(result);
-            free(result);
-            goto expert_cleanup;
+    fp_expert_request *req = calloc(1, sizeof(fp_expert_request));
+    fp_json_stream *json = req ? calloc(1, sizeof(fp_json_stream)) : NULL;
+    fp_blob *shared_body = json ? fp_blob_create(body, request->content_length) : NULL;
+    if (!shared_body || FP_APPEND_LITERAL(&json->text, "{\"files\":[") != 0) {
+        if (shared_body) {
+            fp_blob_release(shared_body);
+        } else {
+            free(body);
         }
-        results[i] = result;
+        fp_json_stream_free(json);
+        free(req);
+        return fp_send_json_error(conn, 500, "Out of memory");
+    }
+    req->json = json;
+    req->body = shared_body;
+    req->file_count = file_count;
+    req->request_start = request_start;
+    req->authed_user = authed_user;
+    req->auth_store = auth_store;
+    for (size_t i = 0; i < file_count; ++i) {
+        req->file_data[i] = body + (file_parts[i]->data - body);
+        req->file_sizes[i] = file_parts[i]->size;
+        memcpy(req->filenames[i], filenames[i], sizeof(req->filenames[i]));
+        req->file_opts[i] = file_opts[i];
     }
+    fp_expert_submit_all(conn, req);
+    return 0;
+}
 
-    struct timespec request_end;
-    clock_gettime(CLOCK_MONOTONIC, &request_end);
-    request_elapsed_ms = fp_elapsed_ms(&request_start, &request_end);
-
-    total_input_bytes = 0;
-    total_output_bytes = 0;
-    for (size_t i = 0; i < file_count; ++i) {
-        fp_result *res = results[i];
-        if (!res) {
-            continue;
+static void fp_conn_dispatch(fp_conn *conn) {
+    fp_http_request *request = &conn->request;
+    fp_auth_store *auth_store = conn->server->auth_store;
+    uint8_t *body = conn->body;
+    conn->body = NULL;
+    fp_upload_form *upload_form = conn->upload_form;
+    conn->upload_form = NULL;
+    bool upload_streamed = conn->upload_streamed;
+    fp_rgba_image upload_image = conn->upload_image;
+    conn->upload_streamed = false;
+    memset(&conn->upload_image, 0, sizeof(conn->upload_image));
+    conn->state = FP_CONN_DISPATCH;
+
+    fp_log_info("📨 %s %s (%zu bytes)", request->method, request->path, request->content_length);
+
+    if (strcmp(request->method, "GET") == 0) {
+        uint64_t stream_job_id = 0;
+        size_t output_index = 0;
+        uint64_t wait_ms = 0;
+        free(body);
+        if (fp_parse_stream_path(request->path, &stream_job_id)) {
+            fp_log_info("📡 Streaming progress for job #%llu", (unsigned long long)stream_job_id);
+            fp_handle_event_stream(conn, stream_job_id);
+        } else if (fp_parse_output_path(request->path, &stream_job_id, &output_index)) {
+            fp_send_job_output(conn, stream_job_id, output_index);
+        } else if (fp_parse_job_path(request->path, &stream_job_id, &wait_ms)) {
+            fp_handle_job_status(conn, stream_job_id, wait_ms);
+        } else if (strcmp(request->path, "/env.js") == 0) {
+            fp_send_env_js(conn);
+        } else {
+            fp_send_static_file(conn, request->path);
         }
-        size_t best_output = res->input_size;
-        total_input_bytes += res->input_size;
-        for (size_t j = 0; j < res->output_count; ++j) {
-            if (res->outputs[j].size < best_output) {
-                best_output = res->outputs[j].size;
-            }
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/api/compress") == 0) {
+        if (upload_streamed) {
+            fp_handle_compress(conn, request, NULL, &upload_image);
+        } else if (!body || request->content_length == 0) {
+            fp_log_warn("🚫 POST /api/compress missing body");
+            free(body);
+            fp_send_json_error(conn, 400, "Missing body");
+        } else {
+            fp_handle_compress(conn, request, body, NULL);
         }
-        total_output_bytes += best_output;
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/api/jobs") == 0) {
+        if (upload_streamed) {
+            fp_handle_job_submit(conn, request, NULL, &upload_image);
+        } else {
+            fp_log_warn("🚫 POST /api/jobs missing body");
+            free(body);
+            fp_send_json_error(conn, 400, "Missing body");
+        }
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/api/expert/compress") == 0) {
+        if (!body || request->content_length == 0) {
+            fp_log_warn("🚫 POST /api/expert/compress missing body");
+            free(body);
+            fp_send_json_error(conn, 400, "Missing body");
+        } else {
+            fp_handle_expert_compress(conn, request, body, upload_form, auth_store);
+        }
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/api/stripe/checkout") == 0) {
+        fp_handle_checkout_session(conn, request, body, request->content_length, auth_store);
+        free(body);
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/api/stripe/portal") == 0) {
+        fp_handle_billing_portal(conn, request, auth_store);
+        free(body);
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/webhook/stripe") == 0) {
+        fp_handle_stripe_webhook(conn, request, body, request->content_length, auth_store);
+        free(body);
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/auth/google") == 0) {
+        fp_handle_google_auth(conn, request, body, request->content_length, auth_store);
+        free(body);
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/auth/facebook") == 0) {
+        fp_handle_facebook_auth(conn, request, body, request->content_length, auth_store);
+        free(body);
+    } else if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/api/keys") == 0) {
+        if (!body) {
+            fp_send_json_error(conn, 400, "Missing body");
+        } else {
+            fp_handle_api_key_issue(conn, request, body, request->content_length, auth_store);
+            free(body);
+        }
+    } else {
+        free(body);
+        fp_send_text(conn, 404, "Not Found", "Not Found");
+    }
+    free(upload_form);
+
+    // Handlers that submitted a job or opened a stream moved the connection
+    // to another state and finish the response from their callbacks.
+    if (conn->state == FP_CONN_DISPATCH) {
+        fp_conn_end_response(conn);
+    } else {
+        fp_conn_flush(conn);
     }
-    total_saved_bytes = total_input_bytes > total_output_bytes ? total_input_bytes - total_output_bytes : 0;
+}
 
-    rc = fp_send_expert_payload(fd, results, response_names, file_opts, file_count, request_elapsed_ms);
+// Answers a request whose framing could not be trusted and closes the connection.
+static void fp_conn_reject(fp_conn *conn, int status, const char *status_text, const char *message) {
+    conn->keep_alive = false;
+    fp_send_text(conn, status, status_text, message);
+    fp_conn_end_response(conn);
+}
 
-expert_cleanup:
-    for (size_t i = 0; i < file_count; ++i) {
-        if (results[i]) {
-            fp_free_result(results[i]);
-            free(results[i]);
-            results[i] = NULL;
-        }
+// Pushes streamed upload bytes through the progressive PNG decoder. After a
+// decode error the remaining body is still read off the socket but dropped.
+static void fp_conn_feed_upload(fp_conn *conn, const uint8_t *data, size_t len) {
+    if (!conn->png_stream || len == 0) {
+        return;
     }
-    free(body);
-    atomic_fetch_add(&g_expert_request_count, 1);
-    atomic_fetch_add(&g_expert_request_files, file_count);
-    atomic_fetch_add(&g_expert_request_bytes, total_input_bytes);
-    fp_log_info("📊 Expert usage user=%llu files=%zu in=%zu out=%zu saved=%zu elapsed=%.2fms",
-                (unsigned long long)authed_user.id,
-                file_count,
-                total_input_bytes,
-                total_output_bytes,
-                total_saved_bytes,
-                request_elapsed_ms);
-    if (auth_store && authed_user.id) {
-        fp_buffer audit = {0};
-        if (FP_APPEND_LITERAL(&audit, "{") == 0 &&
-            fp_buffer_appendf(&audit, "\"files\":%zu,\"bytes_in\":%zu,\"bytes_out\":%zu,\"saved\":%zu,\"elapsed_ms\":%.3f",
-                              file_count,
-                              total_input_bytes,
-                              total_output_bytes,
-                              total_saved_bytes,
-                              request_elapsed_ms) == 0) {
-            FP_APPEND_LITERAL(&audit, "}");
-        }
-        fp_auth_record_audit(auth_store, authed_user.id, "expert_request", audit.data);
-        fp_buffer_free(&audit);
+    if (fp_png_stream_feed(conn->png_stream, data, len) != FP_COMPRESS_OK) {
+        fp_log_warn("🧩 Streamed upload is not a valid PNG, draining body");
+        fp_png_stream_destroy(conn->png_stream);
+        conn->png_stream = NULL;
     }
-    return rc;
 }
 
-static void fp_handle_client(int client_fd, fp_queue *job_queue, fp_queue *result_queue,
-                             fp_progress_registry *progress_registry, fp_auth_store *auth_store) {
-    char *header_buffer = NULL;
-    size_t header_len = 0;
-    size_t total_len = 0;
-    if (fp_read_header_block(client_fd, &header_buffer, &header_len, &total_len) != 0) {
-        fp_send_text(client_fd, 400, "Bad Request", "Malformed request");
+static void fp_conn_finish_upload(fp_conn *conn) {
+    if (!conn->png_stream) {
         return;
     }
+    if (fp_png_stream_finish(conn->png_stream, &conn->upload_image) != FP_COMPRESS_OK) {
+        fp_log_warn("🧩 Streamed upload ended before the PNG was complete");
+    }
+    fp_png_stream_destroy(conn->png_stream);
+    conn->png_stream = NULL;
+}
 
-    char *header_copy = malloc(header_len + 1);
-    if (!header_copy) {
-        free(header_buffer);
-        fp_send_text(client_fd, 500, "Error", "Out of memory");
+// Expert uploads are split into parts while they are received, so dispatch
+// does not have to scan up to 100 MB of file data for boundaries again.
+static void fp_conn_begin_form(fp_conn *conn) {
+    char boundary[128];
+    if (strcmp(conn->request.method, "POST") != 0 || strcmp(conn->request.path, "/api/expert/compress") != 0 ||
+        fp_multipart_boundary(conn->request.content_type, boundary, sizeof(boundary)) != 0) {
         return;
     }
-    memcpy(header_copy, header_buffer, header_len);
-    header_copy[header_len] = '\0';
+    fp_upload_form *form = malloc(sizeof(fp_upload_form));
+    if (!form) {
+        return; // the handler parses the whole body instead
+    }
+    if (fp_multipart_init(&form->parser, boundary, form->parts, sizeof(form->parts) / sizeof(form->parts[0])) != 0) {
+        free(form);
+        return;
+    }
+    form->failed = false;
+    conn->upload_form = form;
+}
 
-    fp_http_request request;
-    if (fp_parse_request(header_copy, &request) != 0) {
+static void fp_conn_feed_form(fp_conn *conn) {
+    fp_upload_form *form = conn->upload_form;
+    if (form && !form->failed && fp_multipart_feed(&form->parser, conn->body, conn->body_received) != 0) {
+        form->failed = true;
+    }
+}
+
+// Parses the buffered header block once its terminating blank line has arrived.
+static void fp_conn_begin_request(fp_conn *conn, size_t header_len) {
+    if (fp_parse_request(conn->inbuf, &conn->head_parser, &conn->request) != 0) {
         fp_log_warn("📵 Unable to parse request");
-        free(header_copy);
-        free(header_buffer);
-        fp_send_text(client_fd, 400, "Bad Request", "Unable to parse request");
+        fp_conn_reject(conn, 400, "Bad Request", "Unable to parse request");
+        return;
+    }
+    if (conn->request.has_transfer_encoding) {
+        // Without chunked decoding the body boundary is unknown, so the rest
+        // of the stream cannot be trusted as further requests.
+        fp_conn_reject(conn, 501, "Not Implemented", "Transfer-Encoding not supported; send Content-Length");
         return;
     }
 
-    size_t body_in_buffer = total_len > header_len ? total_len - header_len : 0;
-    uint8_t *body = NULL;
-    if (request.content_length > 0) {
-        if (request.content_length > FP_MAX_UPLOAD) {
-            free(header_copy);
-            free(header_buffer);
-            fp_send_json_error(client_fd, 413, "File too large (max 100 MB)");
+    conn->retry_after_s = 0;
+    unsigned max_requests = conn->server->config.max_requests_per_conn;
+    conn->keep_alive = conn->request.keep_alive && (max_requests == 0 || conn->requests_served + 1 < max_requests);
+    if (atomic_load_explicit(&conn->server->draining, memory_order_acquire)) {
+        conn->keep_alive = false; // the next request goes to the successor
+    }
+
+    size_t content_length = conn->request.content_length;
+    if (content_length > FP_MAX_UPLOAD) {
+        conn->keep_alive = false;
+        fp_send_json_error(conn, 413, "File too large (max 100 MB)");
+        fp_conn_end_response(conn);
+        return;
+    }
+    size_t buffered = conn->inbuf_len - header_len;
+    size_t copy_len = buffered < content_length ? buffered : content_length;
+    conn->body_received = 0;
+    conn->upload_streamed = content_length > 0 && strcmp(conn->request.method, "POST") == 0 &&
+                            (strcmp(conn->request.path, "/api/compress") == 0 ||
+                             strcmp(conn->request.path, "/api/jobs") == 0);
+    if (conn->upload_streamed) {
+        conn->png_stream = fp_png_stream_create();
+        if (!conn->png_stream) {
+            conn->upload_streamed = false;
+            fp_conn_reject(conn, 500, "Error", "Out of memory");
             return;
         }
-        body = malloc(request.content_length);
-        if (!body) {
-            free(header_copy);
-            free(header_buffer);
-            fp_send_text(client_fd, 500, "Error", "Out of memory");
+        fp_conn_feed_upload(conn, (const uint8_t *)conn->inbuf + header_len, copy_len);
+        conn->body_received = copy_len;
+    } else if (content_length > 0) {
+        conn->body = malloc(content_length);
+        if (!conn->body) {
+            fp_conn_reject(conn, 500, "Error", "Out of memory");
             return;
         }
-        size_t copy_len = body_in_buffer;
-        if (copy_len > request.content_length) {
-            copy_len = request.content_length;
+        memcpy(conn->body, conn->inbuf + header_len, copy_len);
+        conn->body_received = copy_len;
+        fp_conn_begin_form(conn);
+        fp_conn_feed_form(conn);
+    }
+    size_t consumed = header_len + copy_len;
+    memmove(conn->inbuf, conn->inbuf + consumed, conn->inbuf_len - consumed);
+    conn->inbuf_len -= consumed;
+    fp_http_parser_init(&conn->head_parser, FP_MAX_HEADER);
+
+    if (conn->body_received < content_length) {
+        conn->state = FP_CONN_READ_BODY;
+        if (conn->request.expect_continue) {
+            static const char continue_line[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            fp_conn_queue(conn, continue_line, sizeof(continue_line) - 1, NULL, NULL);
+            fp_conn_flush(conn);
         }
-        memcpy(body, header_buffer + header_len, copy_len);
-        size_t offset = copy_len;
-        while (offset < request.content_length) {
-            ssize_t received = recv(client_fd, body + offset, request.content_length - offset, 0);
-            if (received <= 0) {
-                free(body);
-                free(header_copy);
-                free(header_buffer);
-                fp_send_text(client_fd, 400, "Bad Request", "Unexpected EOF");
-                return;
+        return;
+    }
+    fp_conn_finish_upload(conn);
+    fp_conn_dispatch(conn);
+}
+
+static void fp_conn_on_readable(fp_conn *conn) {
+    conn->in_read = true;
+    while (!conn->closed && (conn->state == FP_CONN_READ_HEADER || conn->state == FP_CONN_READ_BODY)) {
+        if (conn->out_bytes >= FP_PIPELINE_OUTPUT_LIMIT) {
+            break;
+        }
+        uint8_t *target;
+        size_t room;
+        if (conn->state == FP_CONN_READ_HEADER) {
+            // Only bytes that arrived since the last pass are examined.
+            fp_http_parse_status head = fp_http_parser_feed(&conn->head_parser, conn->inbuf, conn->inbuf_len);
+            if (head == FP_HTTP_PARSE_DONE) {
+                fp_conn_begin_request(conn, conn->head_parser.head_len);
+                continue;
             }
-            offset += (size_t)received;
+            if (head == FP_HTTP_PARSE_MALFORMED) {
+                fp_log_warn("📵 Malformed request head");
+                fp_conn_reject(conn, 400, "Bad Request", "Malformed request");
+                break;
+            }
+            if (head == FP_HTTP_PARSE_TOO_LARGE) {
+                fp_conn_reject(conn, 431, "Request Header Fields Too Large", "Request header too large");
+                break;
+            }
+            if (!conn->inbuf) {
+                fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+                conn->inbuf = fp_pool_get(shard->head_pool);
+                if (!conn->inbuf) {
+                    fp_conn_reject(conn, 500, "Error", "Out of memory");
+                    break;
+                }
+                conn->inbuf_capacity = FP_MIN_BUFFER;
+            } else if (conn->inbuf_capacity - conn->inbuf_len < FP_MIN_BUFFER) {
+                size_t next_capacity = conn->inbuf_capacity * 2;
+                char *tmp = realloc(conn->inbuf, next_capacity);
+                if (!tmp) {
+                    fp_conn_reject(conn, 500, "Error", "Out of memory");
+                    break;
+                }
+                conn->inbuf = tmp;
+                conn->inbuf_capacity = next_capacity;
+            }
+            target = (uint8_t *)conn->inbuf + conn->inbuf_len;
+            room = conn->inbuf_capacity - conn->inbuf_len;
+        } else if (conn->upload_streamed) {
+            // inbuf is empty while a body is pending, so it doubles as the
+            // receive window for bytes that go straight to the decoder.
+            if (conn->inbuf_capacity < FP_UPLOAD_CHUNK) {
+                fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(conn->loop);
+                char *window = fp_pool_get(shard->window_pool);
+                if (!window) {
+                    fp_conn_reject(conn, 500, "Error", "Out of memory");
+                    break;
+                }
+                fp_conn_drop_inbuf(conn);
+                conn->inbuf = window;
+                conn->inbuf_capacity = FP_UPLOAD_CHUNK;
+            }
+            target = (uint8_t *)conn->inbuf;
+            room = conn->request.content_length - conn->body_received;
+            if (room > conn->inbuf_capacity) {
+                room = conn->inbuf_capacity;
+            }
+        } else {
+            target = conn->body + conn->body_received;
+            room = conn->request.content_length - conn->body_received;
         }
-    }
 
-    free(header_copy);
-    free(header_buffer);
+        ssize_t received = recv(conn->watch.fd, target, room, 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fp_conn_close(conn);
+            }
+            break;
+        }
+        if (received == 0) {
+            if (conn->state == FP_CONN_READ_HEADER && conn->inbuf_len == 0 && conn->out_head) {
+                // Half-closed after pipelined requests: deliver what they produced.
+                conn->keep_alive = false;
+                conn->state = FP_CONN_FLUSH;
+                conn->close_after_flush = true;
+            } else {
+                fp_conn_close(conn);
+            }
+            break;
+        }
+        conn->last_active_ms = fp_io_loop_now_ms(conn->loop);
 
-    fp_log_info("📨 %s %s (%zu bytes)", request.method, request.path, request.content_length);
+        if (conn->state == FP_CONN_READ_HEADER) {
+            conn->inbuf_len += (size_t)received;
+        } else {
+            conn->body_received += (size_t)received;
+            if (conn->upload_streamed) {
+                fp_conn_feed_upload(conn, target, (size_t)received);
+            } else {
+                fp_conn_feed_form(conn);
+            }
+            if (conn->body_received == conn->request.content_length) {
+                fp_conn_finish_upload(conn);
+                fp_conn_dispatch(conn);
+            }
+        }
+    }
+    conn->in_read = false;
+    fp_conn_update_interest(conn);
+}
 
-    if (strcmp(request.method, "GET") == 0) {
-        uint64_t stream_job_id = 0;
-        if (fp_parse_stream_path(request.path, &stream_job_id)) {
-            fp_log_info("📡 Streaming progress for job #%llu", (unsigned long long)stream_job_id);
-            fp_handle_event_stream(client_fd, stream_job_id, progress_registry);
-            free(body);
-            return;
+static void fp_conn_on_event(fp_io_loop *loop, uint32_t events, void *ctx) {
+    (void)loop;
+    fp_conn *conn = (fp_conn *)ctx;
+    fp_conn_retain(conn);
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        fp_conn_close(conn);
+    } else {
+        if (events & EPOLLOUT) {
+            fp_conn_flush(conn);
         }
-        if (strcmp(request.path, "/env.js") == 0) {
-            fp_send_env_js(client_fd);
-            free(body);
-            return;
+        if (!conn->closed && (events & EPOLLIN)) {
+            fp_conn_on_readable(conn);
+        }
+        if (!conn->closed && (events & EPOLLRDHUP) &&
+            (conn->state == FP_CONN_WAIT_JOB || conn->state == FP_CONN_STREAM_WAIT || conn->state == FP_CONN_STREAM ||
+             conn->state == FP_CONN_POLL_WAIT || conn->state == FP_CONN_PRODUCE)) {
+            // A closed tab only sends a FIN, and nothing is written until the
+            // job ends, so treat it as gone: closing cancels its jobs.
+            fp_log_info("👋 Client on fd %d hung up", conn->watch.fd);
+            fp_conn_close(conn);
         }
-        fp_send_static_file(client_fd, request.path);
-        free(body);
-        return;
     }
+    fp_conn_release(conn);
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/api/compress") == 0) {
-        if (!body || request.content_length == 0) {
-            fp_log_warn("🚫 POST /api/compress missing body");
-            free(body);
-            fp_send_json_error(client_fd, 400, "Missing body");
-            return;
-        }
-        fp_handle_compress(client_fd, &request, body, job_queue, result_queue, progress_registry);
+// Serves a freshly accepted, non-blocking client_fd on shard's loop.
+static void fp_shard_attach_conn(fp_io_shard *shard, int client_fd) {
+    fp_io_loop *loop = shard->loop;
+    fp_conn *conn = fp_pool_get(shard->conn_pool);
+    if (!conn) {
+        fp_log_error("🔥 Out of memory for client connection");
+        close(client_fd);
+        return;
+    }
+    memset(conn, 0, sizeof(*conn));
+    conn->server = shard->server;
+    conn->loop = loop;
+    conn->state = FP_CONN_READ_HEADER;
+    conn->last_active_ms = fp_io_loop_now_ms(loop);
+    conn->last_unsent = INT_MAX;
+    fp_http_parser_init(&conn->head_parser, FP_MAX_HEADER);
+    atomic_init(&conn->refs, 1);
+    atomic_init(&conn->stream_drain_posted, false);
+    conn->watch.fd = client_fd;
+    conn->watch.handler = fp_conn_on_event;
+    conn->watch.ctx = conn;
+    if (fp_io_loop_add(loop, &conn->watch, EPOLLIN) != 0) {
+        fp_log_warn("⚠️ Failed to watch client fd %d: %s", client_fd, strerror(errno));
+        close(client_fd);
+        fp_pool_put(shard->conn_pool, conn);
         return;
     }
+    conn->next = shard->conns;
+    if (shard->conns) {
+        shard->conns->prev = conn;
+    }
+    shard->conns = conn;
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/api/expert/compress") == 0) {
-        if (!body || request.content_length == 0) {
-            fp_log_warn("🚫 POST /api/expert/compress missing body");
-            free(body);
-            fp_send_json_error(client_fd, 400, "Missing body");
+// A socket shared by all loops wakes only one of them per connection.
+static uint32_t fp_listen_events(const fp_listener *listener) {
+    return listener->exclusive ? EPOLLIN : EPOLLIN | EPOLLEXCLUSIVE;
+}
+
+static void fp_server_stop(fp_server *server) {
+    pthread_mutex_lock(&server->stop_mutex);
+    server->stopping = true;
+    pthread_cond_signal(&server->stop_cond);
+    pthread_mutex_unlock(&server->stop_mutex);
+}
+
+// Listener readiness: accepts everything pending and serves it on this loop,
+// so connections stay on the core the kernel picked for them.
+static void fp_shard_on_accept(fp_io_loop *loop, uint32_t events, void *ctx) {
+    (void)events;
+    fp_listener *listener = (fp_listener *)ctx;
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(loop);
+    for (unsigned accepted = 0; accepted < FP_ACCEPT_BATCH; ++accepted) {
+        int client_fd = accept(listener->watch.fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Level-triggered readiness would spin until a descriptor frees up.
+                fp_log_warn("⚠️ accept on I/O loop %u paused: %s", fp_io_loop_index(loop), strerror(errno));
+                listener->paused = true;
+                fp_io_loop_remove(loop, &listener->watch);
+                return;
+            }
+            fp_log_error("💥 accept failed: %s", strerror(errno));
+            fp_io_loop_remove(loop, &listener->watch);
+            fp_server_stop(shard->server);
             return;
         }
-        fp_handle_expert_compress(client_fd, &request, body, job_queue, result_queue, progress_registry, auth_store);
-        return;
+        int flags = fcntl(client_fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(client_fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+            fp_log_warn("⚠️ Unable to make client fd %d non-blocking", client_fd);
+            close(client_fd);
+            continue;
+        }
+        fp_shard_attach_conn(shard, client_fd);
     }
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/api/stripe/checkout") == 0) {
-        int rc = fp_handle_checkout_session(client_fd, &request, body, request.content_length, auth_store);
-        free(body);
-        (void)rc;
+// Runs on every loop once a successor accepts on the shared sockets.
+static void fp_shard_stop_accepting_task(fp_io_loop *loop, void *arg) {
+    (void)arg;
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(loop);
+    if (!shard->accepting) {
         return;
     }
+    shard->accepting = false;
+    for (size_t i = 0; i < shard->listener_count; ++i) {
+        if (!shard->listeners[i].paused) {
+            fp_io_loop_remove(loop, &shard->listeners[i].watch);
+        }
+        shard->listeners[i].paused = false;
+    }
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/api/stripe/portal") == 0) {
-        int rc = fp_handle_billing_portal(client_fd, &request, auth_store);
-        free(body);
-        (void)rc;
-        return;
+// Runs on every loop once the server stops: no new requests, and closing
+// the connections cancels the jobs they still wait on. POST /api/jobs work
+// is cancelled too, since its results would leave with this process.
+static void fp_shard_close_all_task(fp_io_loop *loop, void *arg) {
+    fp_shard_stop_accepting_task(loop, arg);
+    fp_io_shard *shard = (fp_io_shard *)fp_io_loop_userdata(loop);
+    while (shard->conns) {
+        fp_conn_close(shard->conns);
     }
+    pthread_mutex_lock(&shard->async_mutex);
+    for (fp_async_job *async = shard->async_jobs; async; async = async->next) {
+        fp_cancel_token_cancel(async->cancel);
+    }
+    pthread_mutex_unlock(&shard->async_mutex);
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/webhook/stripe") == 0) {
-        int rc = fp_handle_stripe_webhook(client_fd, &request, body, request.content_length, auth_store);
-        free(body);
-        (void)rc;
-        return;
+static void fp_server_begin_drain(fp_server *server, fp_io_loop *loop) {
+    server->handed_off = true;
+    server->drain_deadline_ms =
+        server->config.drain_timeout_ms > 0 ? fp_io_loop_now_ms(loop) + server->config.drain_timeout_ms : 0;
+    atomic_store_explicit(&server->draining, true, memory_order_release);
+    if (server->handoff_watch.fd >= 0) {
+        fp_io_loop_remove(loop, &server->handoff_watch);
+        close(server->handoff_watch.fd);
+        server->handoff_watch.fd = -1;
+    }
+    for (size_t i = 0; i < server->loop_count; ++i) {
+        fp_io_loop_post_task(server->loops[i], &server->shards[i].stop_task, fp_shard_stop_accepting_task, NULL);
     }
+    fp_log_info("🤝 Listeners handed over; draining %zu unfinished jobs", fp_admission_jobs(server->admission));
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/auth/google") == 0) {
-        int rc = fp_handle_google_auth(client_fd, &request, body, request.content_length, auth_store);
-        free(body);
-        (void)rc;
+// Called from loop 0's tick: once draining, the process exits when no job
+// is admitted and no connection is left, or when the drain timeout passes.
+static void fp_server_check_drained(fp_server *server, uint64_t now_ms) {
+    if (!atomic_load_explicit(&server->draining, memory_order_acquire) || server->drain_deadline_ms == UINT64_MAX) {
+        return;
+    }
+    size_t jobs = fp_admission_jobs(server->admission);
+    bool idle = jobs == 0;
+    for (size_t i = 0; idle && i < server->loop_count; ++i) {
+        idle = atomic_load_explicit(&server->shards[i].idle, memory_order_acquire);
+    }
+    if (idle) {
+        fp_log_info("👋 Drained; exiting");
+    } else if (server->drain_deadline_ms > 0 && now_ms >= server->drain_deadline_ms) {
+        fp_log_warn("⏱️  Drain timeout with %zu jobs unfinished; cancelling them", jobs);
+    } else {
         return;
     }
+    server->drain_deadline_ms = UINT64_MAX; // report once
+    fp_server_stop(server);
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/auth/facebook") == 0) {
-        int rc = fp_handle_facebook_auth(client_fd, &request, body, request.content_length, auth_store);
-        free(body);
-        (void)rc;
+// Readable control connection: the successor confirms it is accepting, or
+// hangs up because it failed to start.
+static void fp_server_on_successor(fp_io_loop *loop, uint32_t events, void *ctx) {
+    (void)events;
+    fp_server *server = (fp_server *)ctx;
+    char ready = 0;
+    ssize_t got = recv(server->successor.fd, &ready, 1, 0);
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
         return;
     }
+    fp_io_loop_remove(loop, &server->successor);
+    close(server->successor.fd);
+    server->successor.fd = -1;
+    if (got == 1 && ready == 1) {
+        fp_server_begin_drain(server, loop);
+    } else {
+        fp_log_warn("⚠️ Replacement process went away before taking over; still serving");
+    }
+}
 
-    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/api/keys") == 0) {
-        if (!body) {
-            fp_send_json_error(client_fd, 400, "Missing body");
-            return;
-        }
-        int rc = fp_handle_api_key_issue(client_fd, &request, body, request.content_length, auth_store);
-        free(body);
-        (void)rc;
+// A new process connected to FERRET_HANDOFF_SOCKET: give it every listening
+// socket and wait for its acknowledgement before draining.
+static void fp_server_on_handoff(fp_io_loop *loop, uint32_t events, void *ctx) {
+    (void)events;
+    fp_server *server = (fp_server *)ctx;
+    int fd = accept(server->handoff_watch.fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    if (server->successor.fd >= 0 || atomic_load_explicit(&server->draining, memory_order_acquire)) {
+        close(fd);
+        return;
+    }
+    if (!fp_handoff_peer_trusted(fd)) {
+        fp_log_warn("🚫 Refused listener handoff to a process of another user");
+        close(fd);
+        return;
+    }
+    int fds[FP_HANDOFF_MAX_FDS];
+    size_t count = 0;
+    for (size_t i = 0; i < server->tcp_fd_count; ++i) {
+        fds[count++] = server->tcp_fds[i];
+    }
+    if (server->unix_fd >= 0) {
+        fds[count++] = server->unix_fd;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (fp_handoff_send_fds(fd, fds, count) != 0 || flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        fp_log_warn("⚠️ Listener handoff failed: %s", strerror(errno));
+        close(fd);
+        return;
+    }
+    server->successor.fd = fd;
+    server->successor.handler = fp_server_on_successor;
+    server->successor.ctx = server;
+    if (fp_io_loop_add(loop, &server->successor, EPOLLIN | EPOLLRDHUP) != 0) {
+        close(fd);
+        server->successor.fd = -1;
         return;
     }
+    fp_log_info("🤝 Sent %zu listening sockets to a new process; waiting for it to accept", count);
+}
 
-    free(body);
-    fp_send_text(client_fd, 404, "Not Found", "Not Found");
+// A slow reader can take longer than the idle timeout to free enough send
+// buffer for EPOLLOUT to fire again, so a shrinking kernel queue counts as
+// activity too.
+static bool fp_conn_still_draining(fp_conn *conn) {
+    int unsent = 0;
+    if (conn->out_bytes == 0 || ioctl(conn->watch.fd, SIOCOUTQ, &unsent) != 0) {
+        return false;
+    }
+    bool draining = unsent < conn->last_unsent;
+    conn->last_unsent = unsent;
+    return draining;
 }
 
-typedef struct {
-    int fd;
-    fp_queue *job_queue;
-    fp_queue *result_queue;
-    fp_progress_registry *progress_registry;
-    fp_auth_store *auth_store;
-} fp_client_context;
+static void fp_shard_tick(fp_io_loop *loop, uint64_t now_ms, void *ctx) {
+    fp_io_shard *shard = (fp_io_shard *)ctx;
+    for (size_t i = 0; shard->accepting && i < shard->listener_count; ++i) {
+        fp_listener *listener = &shard->listeners[i];
+        if (listener->paused && fp_io_loop_add(loop, &listener->watch, fp_listen_events(listener)) == 0) {
+            listener->paused = false;
+        }
+    }
+    fp_shard_retry_submits(shard, now_ms);
+    if (shard == &shard->server->shards[0]) {
+        fp_output_store_expire(shard->server->output_store);
+        fp_result_store_expire(shard->server->result_store);
+        fp_server_check_drained(shard->server, now_ms);
+    }
+    bool draining = atomic_load_explicit(&shard->server->draining, memory_order_acquire);
+    uint64_t idle_timeout_ms = shard->server->config.idle_timeout_ms;
+    fp_conn *conn = shard->conns;
+    while (conn) {
+        fp_conn *next = conn->next;
+        if (conn->state == FP_CONN_STREAM_WAIT) {
+            fp_conn_retain(conn);
+            fp_conn_stream_expire(conn, now_ms);
+            next = conn->next;
+            fp_conn_release(conn);
+        } else if (conn->state == FP_CONN_POLL_WAIT) {
+            fp_conn_retain(conn);
+            fp_conn_poll_expire(conn, now_ms);
+            next = conn->next;
+            fp_conn_release(conn);
+        } else if ((conn->state == FP_CONN_READ_HEADER || conn->state == FP_CONN_READ_BODY ||
+                    conn->state == FP_CONN_FLUSH || (conn->state == FP_CONN_PRODUCE && !conn->producer_waiting) ||
+                    (conn->state == FP_CONN_STREAM && conn->out_bytes > 0)) &&
+                   idle_timeout_ms > 0 && now_ms - conn->last_active_ms >= idle_timeout_ms) {
+            // Idle keep-alive sockets, stalled uploads and readers that stopped draining.
+            if (fp_conn_still_draining(conn)) {
+                conn->last_active_ms = now_ms;
+            } else {
+                fp_conn_close(conn);
+            }
+        } else if (conn->state == FP_CONN_STREAM && now_ms - conn->stream_last_send_ms >= FP_SSE_HEARTBEAT_MS) {
+            fp_conn_retain(conn);
+            if (fp_send_sse_heartbeat(conn) == 0) {
+                fp_conn_flush(conn);
+            }
+            fp_conn_release(conn);
+        } else if (draining && conn->state == FP_CONN_READ_HEADER && conn->inbuf_len == 0 && !conn->out_head) {
+            fp_conn_close(conn); // keep-alive between requests: the successor serves the next one
+        }
+        conn = next;
+    }
+    if (draining) {
+        atomic_store_explicit(&shard->idle, shard->conns == NULL, memory_order_release);
+    }
+}
 
-static void *fp_client_thread(void *arg) {
-    fp_client_context *ctx = (fp_client_context *)arg;
-    if (!ctx) {
-        return NULL;
+static void fp_server_shutdown(fp_server *server) {
+    for (size_t i = 0; i < server->loop_count; ++i) {
+        fp_io_loop_destroy(server->loops[i]);
+    }
+    for (size_t i = 0; server->shards && i < server->loop_count; ++i) {
+        fp_io_shard *shard = &server->shards[i];
+        free(shard->listeners);
+        fp_pool_destroy(shard->conn_pool);
+        fp_pool_destroy(shard->head_pool);
+        fp_pool_destroy(shard->window_pool);
+        fp_pool_destroy(shard->chunk_pool);
+        pthread_mutex_destroy(&shard->async_mutex);
+    }
+    // After a handoff the sockets live on in the successor; only our
+    // descriptors are closed and the paths are left alone.
+    for (size_t i = 0; i < server->tcp_fd_count; ++i) {
+        close(server->tcp_fds[i]);
+    }
+    if (server->successor.fd >= 0) {
+        close(server->successor.fd);
+    }
+    if (server->handoff_watch.fd >= 0) {
+        close(server->handoff_watch.fd);
+        unlink(server->config.handoff_socket);
+    }
+    free(server->loops);
+    free(server->shards);
+    if (server->unix_fd >= 0) {
+        close(server->unix_fd);
+        if (!server->handed_off) {
+            unlink(server->config.unix_socket);
+        }
     }
-    fp_handle_client(ctx->fd, ctx->job_queue, ctx->result_queue, ctx->progress_registry, ctx->auth_store);
-    close(ctx->fd);
-    free(ctx);
-    return NULL;
+    fp_static_cache_destroy(server->static_cache);
+    fp_admission_destroy(server->admission);
+    pthread_mutex_destroy(&server->waiters_mutex);
+    pthread_cond_destroy(&server->stop_cond);
+    pthread_mutex_destroy(&server->stop_mutex);
 }
 
-int fp_server_run(const char *host, int port, size_t worker_count, fp_queue *job_queue,
-                  fp_queue *result_queue, fp_progress_registry *progress_registry,
-                  fp_auth_store *auth_store) {
-    (void)worker_count;
-    if (!job_queue || !result_queue || !progress_registry || !auth_store) {
+// Opens the AF_UNIX listener for co-located clients. A socket file left
+// behind by an earlier run is replaced; any other file at path is kept.
+static int fp_server_open_unix_listener(const char *path, int backlog) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Unix socket path too long: %s\n", path);
         return -1;
     }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
 
-#ifndef _WIN32
-    signal(SIGPIPE, SIG_IGN);
-#endif
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Refusing to replace %s: not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int listen_fd = (int)socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int flags = fcntl(listen_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        perror("fcntl");
+        close(listen_fd);
+        return -1;
+    }
+    if (bind(listen_fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        close(listen_fd);
+        return -1;
+    }
+    if (listen(listen_fd, backlog > 0 ? backlog : SOMAXCONN) != 0) {
+        perror("listen");
+        close(listen_fd);
+        unlink(path);
+        return -1;
+    }
+    return listen_fd;
+}
 
+// Opens a non-blocking listening socket. With reuseport, every loop binds its
+// own socket to the same address and the kernel spreads connections across
+// them; *reuseport is cleared when the kernel refuses the option.
+static int fp_server_open_listener(const struct sockaddr_in *addr, int backlog, bool *reuseport) {
     int listen_fd = (int)socket(AF_INET, SOCK_STREAM, 0);
     if (listen_fd < 0) {
         perror("socket");
@@ -3040,7 +5057,141 @@ int fp_server_run(const char *host, int port, size_t worker_count, fp_queue *job
 
     int opt = 1;
     setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt));
+    if (*reuseport && setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, (const char *)&opt, sizeof(opt)) != 0) {
+        fp_log_warn("⚠️ SO_REUSEPORT unavailable (%s); I/O loops will share one listener", strerror(errno));
+        *reuseport = false;
+    }
+    int flags = fcntl(listen_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        perror("fcntl");
+        close(listen_fd);
+        return -1;
+    }
+
+    if (bind(listen_fd, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+        perror("bind");
+        close(listen_fd);
+        return -1;
+    }
+
+    if (listen(listen_fd, backlog > 0 ? backlog : SOMAXCONN) != 0) {
+        perror("listen");
+        close(listen_fd);
+        return -1;
+    }
+    return listen_fd;
+}
 
+// Keeps the sockets inherited from the previous process that match this
+// configuration and closes the rest (e.g. FERRET_PORT changed in between).
+static void fp_server_adopt_listeners(fp_server *server, const struct sockaddr_in *addr, const int *fds,
+                                      size_t count) {
+    const char *unix_path = server->config.unix_socket;
+    for (size_t i = 0; i < count; ++i) {
+        struct sockaddr_storage local;
+        socklen_t len = sizeof(local);
+        bool keep = false;
+        bool named = getsockname(fds[i], (struct sockaddr *)&local, &len) == 0;
+        if (named && local.ss_family == AF_INET) {
+            const struct sockaddr_in *in = (const struct sockaddr_in *)&local;
+            keep = in->sin_port == addr->sin_port && in->sin_addr.s_addr == addr->sin_addr.s_addr &&
+                   server->tcp_fd_count < FP_HANDOFF_MAX_FDS - 1;
+            if (keep) {
+                server->tcp_fds[server->tcp_fd_count++] = fds[i];
+            }
+        } else if (named && local.ss_family == AF_UNIX && unix_path && *unix_path && server->unix_fd < 0) {
+            const struct sockaddr_un *un = (const struct sockaddr_un *)&local;
+            keep = strncmp(un->sun_path, unix_path, sizeof(un->sun_path)) == 0;
+            if (keep) {
+                server->unix_fd = fds[i];
+            }
+        }
+        if (!keep) {
+            close(fds[i]);
+        }
+    }
+}
+
+// Tops the TCP sockets up to one per loop (or a single shared one) and opens
+// the unix listener unless it was inherited. Inherited sockets without
+// SO_REUSEPORT cannot be joined, so the loops then share them.
+static int fp_server_open_listeners(fp_server *server, const struct sockaddr_in *addr, bool *reuseport) {
+    if (*reuseport && server->tcp_fd_count > 0) {
+        int enabled = 0;
+        socklen_t len = sizeof(enabled);
+        if (getsockopt(server->tcp_fds[0], SOL_SOCKET, SO_REUSEPORT, &enabled, &len) != 0 || !enabled) {
+            *reuseport = false;
+        }
+    }
+    size_t wanted = *reuseport ? server->loop_count : 1;
+    if (wanted > FP_HANDOFF_MAX_FDS - 1) {
+        wanted = FP_HANDOFF_MAX_FDS - 1; // one slot stays free for the unix socket
+    }
+    while (server->tcp_fd_count < wanted) {
+        bool fresh_reuseport = *reuseport;
+        int fd = fp_server_open_listener(addr, server->config.listen_backlog, &fresh_reuseport);
+        if (fd < 0 && server->tcp_fd_count == 0) {
+            return -1;
+        }
+        if (fd >= 0) {
+            server->tcp_fds[server->tcp_fd_count++] = fd;
+        }
+        if (fd < 0 || !fresh_reuseport) {
+            *reuseport = false;
+            break;
+        }
+    }
+    const char *unix_path = server->config.unix_socket;
+    if (unix_path && *unix_path && server->unix_fd < 0) {
+        server->unix_fd = fp_server_open_unix_listener(unix_path, server->config.listen_backlog);
+        if (server->unix_fd < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// With a socket per loop, loop i watches every tcp_fds[j] with j = i modulo
+// the loop count; otherwise all loops share all sockets.
+static int fp_shard_assign_listeners(fp_server *server, size_t index, bool reuseport) {
+    fp_io_shard *shard = &server->shards[index];
+    bool exclusive = reuseport && server->tcp_fd_count >= server->loop_count;
+    shard->listeners = calloc(server->tcp_fd_count + 1, sizeof(fp_listener));
+    if (!shard->listeners) {
+        return -1;
+    }
+    size_t count = 0;
+    for (size_t j = 0; j < server->tcp_fd_count; ++j) {
+        if (!exclusive || j % server->loop_count == index) {
+            shard->listeners[count].watch.fd = server->tcp_fds[j];
+            shard->listeners[count].exclusive = exclusive;
+            count++;
+        }
+    }
+    if (server->unix_fd >= 0) {
+        shard->listeners[count++].watch.fd = server->unix_fd;
+    }
+    for (size_t l = 0; l < count; ++l) {
+        shard->listeners[l].watch.handler = fp_shard_on_accept;
+        shard->listeners[l].watch.ctx = &shard->listeners[l];
+    }
+    shard->listener_count = count;
+    return 0;
+}
+
+int fp_server_run(const fp_server_config *config, fp_scheduler *job_queue,
+                  fp_progress_registry *progress_registry, fp_output_store *output_store,
+                  fp_result_store *result_store, fp_auth_store *auth_store) {
+    if (!config || !job_queue || !progress_registry || !result_store || !auth_store) {
+        return -1;
+    }
+
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    const char *host = config->host;
+    int port = config->port;
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -3049,64 +5200,166 @@ int fp_server_run(const char *host, int port, size_t worker_count, fp_queue *job
         addr.sin_addr.s_addr = INADDR_ANY;
     } else if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
         fprintf(stderr, "Invalid host %s\n", host);
-        close(listen_fd);
         return -1;
     }
 
-    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
-        perror("bind");
-        close(listen_fd);
+    fp_server server;
+    memset(&server, 0, sizeof(server));
+    server.config = *config;
+    server.unix_fd = -1;
+    server.handoff_watch.fd = -1;
+    server.successor.fd = -1;
+    server.job_queue = job_queue;
+    server.progress_registry = progress_registry;
+    server.output_store = output_store;
+    server.result_store = result_store;
+    server.auth_store = auth_store;
+    if (config->static_cache) {
+        server.static_cache = fp_static_cache_load(FP_PUBLIC_ROOT);
+        if (server.static_cache) {
+            fp_log_info("🗂️  Cached %zu static assets (%zu KB incl. gzip/br variants)",
+                        fp_static_cache_count(server.static_cache), fp_static_cache_bytes(server.static_cache) / 1024);
+        } else {
+            fp_log_warn("🗂️  Static asset cache unavailable; serving %s/ from disk", FP_PUBLIC_ROOT);
+        }
+    }
+    server.loop_count = config->io_threads > 0 ? config->io_threads : 1;
+    pthread_mutex_init(&server.waiters_mutex, NULL);
+    pthread_mutex_init(&server.stop_mutex, NULL);
+    pthread_cond_init(&server.stop_cond, NULL);
+    server.admission = fp_admission_create(config->worker_count, config->eta_ms_per_unit, config->admission);
+    server.loops = calloc(server.loop_count, sizeof(fp_io_loop *));
+    server.shards = calloc(server.loop_count, sizeof(fp_io_shard));
+    for (size_t i = 0; server.shards && i < server.loop_count; ++i) {
+        pthread_mutex_init(&server.shards[i].async_mutex, NULL);
+    }
+    if (!server.admission || !server.loops || !server.shards) {
+        fp_log_error("🔥 Out of memory for I/O loops");
+        fp_server_shutdown(&server);
         return -1;
     }
-
-    if (listen(listen_fd, 64) != 0) {
-        perror("listen");
-        close(listen_fd);
+    int control_fd = -1;
+    if (config->handoff_socket && *config->handoff_socket) {
+        int inherited[FP_HANDOFF_MAX_FDS];
+        size_t inherited_count = 0;
+        control_fd = fp_handoff_request(config->handoff_socket, inherited, FP_HANDOFF_MAX_FDS, &inherited_count);
+        if (control_fd >= 0) {
+            fp_log_info("🤝 Took over %zu listening sockets from the running process", inherited_count);
+            fp_server_adopt_listeners(&server, &addr, inherited, inherited_count);
+        } else if (errno != ENOENT && errno != ECONNREFUSED) {
+            fp_log_warn("⚠️ Listener handoff from %s failed (%s); binding fresh sockets", config->handoff_socket,
+                        strerror(errno));
+        }
+    }
+    bool reuseport = config->reuseport;
+    if (fp_server_open_listeners(&server, &addr, &reuseport) != 0) {
+        if (control_fd >= 0) {
+            close(control_fd); // the old process keeps serving
+        }
+        fp_server_shutdown(&server);
         return -1;
     }
 
+    for (size_t i = 0; i < server.loop_count; ++i) {
+        fp_io_shard *shard = &server.shards[i];
+        shard->server = &server;
+        shard->accepting = true;
+        shard->conn_pool = fp_pool_create(sizeof(fp_conn), FP_POOL_CONNS);
+        shard->head_pool = fp_pool_create(FP_MIN_BUFFER, FP_POOL_HEAD_BUFFERS);
+        shard->window_pool = fp_pool_create(FP_UPLOAD_CHUNK, FP_POOL_UPLOAD_WINDOWS);
+        shard->chunk_pool = fp_pool_create(sizeof(fp_out_chunk), FP_POOL_OUT_CHUNKS);
+        if (!shard->conn_pool || !shard->head_pool || !shard->window_pool || !shard->chunk_pool ||
+            fp_shard_assign_listeners(&server, i, reuseport) != 0) {
+            fp_log_error("🔥 Out of memory for I/O loop %zu", i);
+            server.loop_count = i + 1;
+            if (control_fd >= 0) {
+                close(control_fd);
+            }
+            fp_server_shutdown(&server);
+            return -1;
+        }
+        server.loops[i] = fp_io_loop_create((unsigned)i, FP_IO_TICK_MS, fp_shard_tick, shard);
+        if (!server.loops[i]) {
+            fp_log_error("💥 Failed to create I/O loop %zu", i);
+            server.loop_count = i + 1;
+            if (control_fd >= 0) {
+                close(control_fd);
+            }
+            fp_server_shutdown(&server);
+            return -1;
+        }
+        fp_io_loop_set_userdata(server.loops[i], shard);
+        shard->loop = server.loops[i];
+        bool watching = true;
+        for (size_t l = 0; watching && l < shard->listener_count; ++l) {
+            fp_listener *listener = &shard->listeners[l];
+            watching = fp_io_loop_add(server.loops[i], &listener->watch, fp_listen_events(listener)) == 0;
+        }
+        if (!watching || fp_io_loop_start(server.loops[i]) != 0) {
+            fp_log_error("💥 Failed to start I/O loop %zu", i);
+            server.loop_count = i + 1;
+            if (control_fd >= 0) {
+                close(control_fd);
+            }
+            fp_server_shutdown(&server);
+            return -1;
+        }
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (config->pin_io_threads && cpus > 0 && fp_io_loop_pin(server.loops[i], (unsigned)(i % (size_t)cpus)) != 0) {
+            fp_log_warn("⚠️ Could not pin I/O loop %zu: %s", i, strerror(errno));
+        }
+    }
+
+    // Every loop is accepting now, so the previous process may stop.
+    fp_handoff_ack(control_fd);
+    if (config->handoff_socket && *config->handoff_socket) {
+        server.handoff_watch.fd = fp_handoff_listen(config->handoff_socket);
+        server.handoff_watch.handler = fp_server_on_handoff;
+        server.handoff_watch.ctx = &server;
+        if (server.handoff_watch.fd < 0 ||
+            fp_io_loop_add(server.loops[0], &server.handoff_watch, EPOLLIN) != 0) {
+            fp_log_warn("⚠️ Handoff socket %s unavailable: %s", config->handoff_socket, strerror(errno));
+            if (server.handoff_watch.fd >= 0) {
+                close(server.handoff_watch.fd);
+                server.handoff_watch.fd = -1;
+            }
+        }
+    }
+
     const char *listen_host = host && *host ? host : "0.0.0.0";
-    fp_log_info("🚀 ferretptimize listening on %s:%d", listen_host, port);
+    fp_log_info("🚀 ferretptimize listening on %s:%d (%zu I/O threads, %s)", listen_host, port, server.loop_count,
+                reuseport ? "one SO_REUSEPORT listener each" : "shared listener");
+    if (server.unix_fd >= 0) {
+        fp_log_info("🧦 Also listening on unix:%s", config->unix_socket);
+    }
+    if (server.handoff_watch.fd >= 0) {
+        fp_log_info("🤝 Replacement processes can take over through %s", config->handoff_socket);
+    }
     if (strcmp(listen_host, "0.0.0.0") == 0) {
         fp_log_info("🌐 Open http://127.0.0.1:%d/ or http://wsl.localhost:%d/", port, port);
     } else {
         fp_log_info("🌐 Open http://%s:%d/ in your browser", listen_host, port);
     }
 
-    while (true) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
-        if (client_fd < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            fp_log_error("💥 accept failed: %s", strerror(errno));
-            break;
-        }
-        fp_client_context *ctx = calloc(1, sizeof(fp_client_context));
-        if (!ctx) {
-            fp_log_error("🔥 Out of memory for client context");
-            close(client_fd);
-            continue;
-        }
-        ctx->fd = client_fd;
-        ctx->job_queue = job_queue;
-        ctx->result_queue = result_queue;
-        ctx->progress_registry = progress_registry;
-        ctx->auth_store = auth_store;
-
-        pthread_t thread;
-        if (pthread_create(&thread, NULL, fp_client_thread, ctx) != 0) {
-            fp_log_warn("⚠️  Failed to spawn client thread; handling inline");
-            fp_handle_client(client_fd, job_queue, result_queue, progress_registry, auth_store);
-            close(client_fd);
-            free(ctx);
-        } else {
-            pthread_detach(thread);
-        }
+    // The loops accept on their own; this thread only waits for a fatal
+    // error or for draining to finish after a handoff.
+    pthread_mutex_lock(&server.stop_mutex);
+    while (!server.stopping) {
+        pthread_cond_wait(&server.stop_cond, &server.stop_mutex);
     }
+    pthread_mutex_unlock(&server.stop_mutex);
 
-    close(listen_fd);
+    // Completion callbacks post to the loops and release admission, so the
+    // server must outlive every admitted job. Every job still queued or
+    // running is cancelled, so this wait ends as soon as workers notice.
+    for (size_t i = 0; i < server.loop_count; ++i) {
+        fp_io_loop_post_task(server.loops[i], &server.shards[i].close_task, fp_shard_close_all_task, NULL);
+    }
+    size_t unfinished = fp_admission_jobs(server.admission);
+    if (unfinished > 0) {
+        fp_log_info("⏳ Waiting for %zu unfinished jobs to stop", unfinished);
+    }
+    fp_admission_wait_idle(server.admission);
+    fp_server_shutdown(&server);
     return 0;
 }
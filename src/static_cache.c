@@ -0,0 +1,368 @@
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <brotli/encode.h>
+
+#include "static_cache.h"
+#include "log.h"
+
+#define FP_STATIC_MAX_DEPTH 8
+
+struct fp_static_cache {
+    fp_static_asset *assets; // sorted by path
+    size_t count;
+    size_t capacity;
+    size_t bytes;
+};
+
+const char *fp_static_mime_type(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if (!ext) {
+        return "application/octet-stream";
+    }
+    if (strcmp(ext, ".html") == 0) {
+        return "text/html; charset=utf-8";
+    }
+    if (strcmp(ext, ".css") == 0) {
+        return "text/css; charset=utf-8";
+    }
+    if (strcmp(ext, ".js") == 0) {
+        return "application/javascript";
+    }
+    if (strcmp(ext, ".png") == 0) {
+        return "image/png";
+    }
+    if (strcmp(ext, ".svg") == 0) {
+        return "image/svg+xml";
+    }
+    if (strcmp(ext, ".txt") == 0) {
+        return "text/plain; charset=utf-8";
+    }
+    return "application/octet-stream";
+}
+
+void fp_static_format_http_date(time_t when, char *out, size_t out_len) {
+    struct tm tm_utc;
+    if (!gmtime_r(&when, &tm_utc) || strftime(out, out_len, "%a, %d %b %Y %H:%M:%S GMT", &tm_utc) == 0) {
+        if (out_len > 0) {
+            out[0] = '\0';
+        }
+    }
+}
+
+// Already-compressed formats (PNG, WebP, ...) only grow when encoded again.
+static bool fp_static_is_compressible(const char *mime) {
+    return strncmp(mime, "text/", 5) == 0 || strcmp(mime, "application/javascript") == 0 ||
+           strcmp(mime, "image/svg+xml") == 0;
+}
+
+static uint64_t fp_static_fnv1a(const uint8_t *data, size_t len) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int fp_static_gzip(const uint8_t *input, size_t len, fp_static_variant *out) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16 selects the gzip wrapper browsers expect for "gzip".
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    size_t bound = deflateBound(&zs, (uLong)len);
+    uint8_t *data = malloc(bound);
+    if (!data) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    zs.next_in = (Bytef *)input;
+    zs.avail_in = (uInt)len;
+    zs.next_out = data;
+    zs.avail_out = (uInt)bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t produced = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) {
+        free(data);
+        return -1;
+    }
+    out->encoding = "gzip";
+    out->data = data;
+    out->size = produced;
+    return 0;
+}
+
+static int fp_static_brotli(const uint8_t *input, size_t len, fp_static_variant *out) {
+    size_t capacity = BrotliEncoderMaxCompressedSize(len);
+    if (capacity == 0) {
+        return -1;
+    }
+    uint8_t *data = malloc(capacity);
+    if (!data) {
+        return -1;
+    }
+    size_t produced = capacity;
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len, input, &produced,
+                               data)) {
+        free(data);
+        return -1;
+    }
+    out->encoding = "br";
+    out->data = data;
+    out->size = produced;
+    return 0;
+}
+
+// Keeps a compressed variant only when it actually saves bytes.
+static void fp_static_keep_if_smaller(fp_static_variant *variant, size_t identity_size) {
+    if (variant->data && variant->size >= identity_size) {
+        free(variant->data);
+        memset(variant, 0, sizeof(*variant));
+    }
+}
+
+static int fp_static_read_file(const char *fs_path, size_t size, uint8_t **out) {
+    int fd = open(fs_path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if (!data) {
+        close(fd);
+        return -1;
+    }
+    size_t total = 0;
+    while (total < size) {
+        ssize_t got = read(fd, data + total, size - total);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            free(data);
+            close(fd);
+            return -1;
+        }
+        total += (size_t)got;
+    }
+    close(fd);
+    *out = data;
+    return 0;
+}
+
+static int fp_static_add_file(fp_static_cache *cache, const char *fs_path, const char *rel_path, const struct stat *st) {
+    if (strlen(rel_path) >= sizeof(((fp_static_asset *)0)->path)) {
+        return 0;
+    }
+    if (cache->count == cache->capacity) {
+        size_t next = cache->capacity ? cache->capacity * 2 : 16;
+        fp_static_asset *tmp = realloc(cache->assets, next * sizeof(fp_static_asset));
+        if (!tmp) {
+            return -1;
+        }
+        cache->assets = tmp;
+        cache->capacity = next;
+    }
+    fp_static_asset *asset = &cache->assets[cache->count];
+    memset(asset, 0, sizeof(*asset));
+    snprintf(asset->path, sizeof(asset->path), "%s", rel_path);
+    asset->mime = fp_static_mime_type(rel_path);
+    fp_static_format_http_date(st->st_mtime, asset->last_modified, sizeof(asset->last_modified));
+
+    size_t size = (size_t)st->st_size;
+    if (fp_static_read_file(fs_path, size, &asset->identity.data) != 0) {
+        fp_log_warn("📁 Unable to cache %s: %s", fs_path, strerror(errno));
+        return 0;
+    }
+    asset->identity.size = size;
+
+    unsigned long long hash = (unsigned long long)fp_static_fnv1a(asset->identity.data, size);
+    snprintf(asset->identity.etag, sizeof(asset->identity.etag), "\"%016llx\"", hash);
+    if (fp_static_is_compressible(asset->mime) && size > 0) {
+        if (fp_static_gzip(asset->identity.data, size, &asset->gzip) == 0) {
+            fp_static_keep_if_smaller(&asset->gzip, size);
+        }
+        if (fp_static_brotli(asset->identity.data, size, &asset->brotli) == 0) {
+            fp_static_keep_if_smaller(&asset->brotli, size);
+        }
+        // Each encoding is a distinct representation, so it gets its own tag.
+        snprintf(asset->gzip.etag, sizeof(asset->gzip.etag), "\"%016llx-gz\"", hash);
+        snprintf(asset->brotli.etag, sizeof(asset->brotli.etag), "\"%016llx-br\"", hash);
+    }
+    cache->bytes += asset->identity.size + asset->gzip.size + asset->brotli.size;
+    cache->count++;
+    return 0;
+}
+
+static int fp_static_walk(fp_static_cache *cache, const char *root, const char *rel_dir, int depth) {
+    if (depth > FP_STATIC_MAX_DEPTH) {
+        return 0;
+    }
+    char dir_path[1024];
+    int written = rel_dir[0] ? snprintf(dir_path, sizeof(dir_path), "%s/%s", root, rel_dir)
+                             : snprintf(dir_path, sizeof(dir_path), "%s", root);
+    if (written < 0 || (size_t)written >= sizeof(dir_path)) {
+        return 0;
+    }
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        return depth == 0 ? -1 : 0;
+    }
+    int rc = 0;
+    struct dirent *entry;
+    while (rc == 0 && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char rel_path[512];
+        char fs_path[1024];
+        int rel_len = rel_dir[0] ? snprintf(rel_path, sizeof(rel_path), "%s/%s", rel_dir, entry->d_name)
+                                 : snprintf(rel_path, sizeof(rel_path), "%s", entry->d_name);
+        int fs_len = snprintf(fs_path, sizeof(fs_path), "%s/%s", root, rel_path);
+        if (rel_len < 0 || (size_t)rel_len >= sizeof(rel_path) || fs_len < 0 || (size_t)fs_len >= sizeof(fs_path)) {
+            continue;
+        }
+        struct stat st;
+        if (stat(fs_path, &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            rc = fp_static_walk(cache, root, rel_path, depth + 1);
+        } else if (S_ISREG(st.st_mode) && st.st_size <= FP_STATIC_CACHE_MAX_FILE) {
+            rc = fp_static_add_file(cache, fs_path, rel_path, &st);
+        }
+    }
+    closedir(dir);
+    return rc;
+}
+
+static int fp_static_compare(const void *a, const void *b) {
+    return strcmp(((const fp_static_asset *)a)->path, ((const fp_static_asset *)b)->path);
+}
+
+fp_static_cache *fp_static_cache_load(const char *root) {
+    if (!root) {
+        return NULL;
+    }
+    fp_static_cache *cache = calloc(1, sizeof(fp_static_cache));
+    if (!cache) {
+        return NULL;
+    }
+    if (fp_static_walk(cache, root, "", 0) != 0) {
+        fp_static_cache_destroy(cache);
+        return NULL;
+    }
+    if (cache->count > 1) {
+        qsort(cache->assets, cache->count, sizeof(fp_static_asset), fp_static_compare);
+    }
+    return cache;
+}
+
+void fp_static_cache_destroy(fp_static_cache *cache) {
+    if (!cache) {
+        return;
+    }
+    for (size_t i = 0; i < cache->count; ++i) {
+        free(cache->assets[i].identity.data);
+        free(cache->assets[i].gzip.data);
+        free(cache->assets[i].brotli.data);
+    }
+    free(cache->assets);
+    free(cache);
+}
+
+const fp_static_asset *fp_static_cache_find(const fp_static_cache *cache, const char *path) {
+    if (!cache || !path || cache->count == 0) {
+        return NULL;
+    }
+    fp_static_asset key;
+    snprintf(key.path, sizeof(key.path), "%s", path);
+    return bsearch(&key, cache->assets, cache->count, sizeof(fp_static_asset), fp_static_compare);
+}
+
+size_t fp_static_cache_count(const fp_static_cache *cache) {
+    return cache ? cache->count : 0;
+}
+
+size_t fp_static_cache_bytes(const fp_static_cache *cache) {
+    return cache ? cache->bytes : 0;
+}
+
+// Looks for coding in a comma-separated Accept-Encoding list, honouring q=0.
+static bool fp_static_accepts(const char *accept_encoding, const char *coding) {
+    size_t coding_len = strlen(coding);
+    const char *p = accept_encoding;
+    while (p && *p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            ++p;
+        }
+        const char *token = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+            ++p;
+        }
+        size_t token_len = (size_t)(p - token);
+        const char *params = p;
+        while (*p && *p != ',') {
+            ++p;
+        }
+        if (token_len == coding_len && strncasecmp(token, coding, coding_len) == 0) {
+            const char *q = strstr(params, "q=");
+            if (q && q < p) {
+                return strtod(q + 2, NULL) > 0.0;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+const fp_static_variant *fp_static_pick_variant(const fp_static_asset *asset, const char *accept_encoding) {
+    const fp_static_variant *best = &asset->identity;
+    if (!accept_encoding || !*accept_encoding) {
+        return best;
+    }
+    if (asset->brotli.size > 0 && asset->brotli.size < best->size && fp_static_accepts(accept_encoding, "br")) {
+        best = &asset->brotli;
+    }
+    if (asset->gzip.size > 0 && asset->gzip.size < best->size && fp_static_accepts(accept_encoding, "gzip")) {
+        best = &asset->gzip;
+    }
+    return best;
+}
+
+bool fp_static_etag_matches(const char *if_none_match, const char *etag) {
+    if (!if_none_match || !*if_none_match || !etag || !*etag) {
+        return false;
+    }
+    size_t etag_len = strlen(etag);
+    const char *p = if_none_match;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            ++p;
+        }
+        if (*p == '*') {
+            return true;
+        }
+        if (strncmp(p, "W/", 2) == 0) {
+            p += 2;
+        }
+        const char *token = p;
+        while (*p && *p != ',' && *p != ' ' && *p != '\t') {
+            ++p;
+        }
+        if ((size_t)(p - token) == etag_len && strncmp(token, etag, etag_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
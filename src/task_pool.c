@@ -0,0 +1,213 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "task_pool.h"
+
+#define FP_TASK_DEQUE_CAP 16 // a job queues at most FP_MAX_OUTPUTS tasks at once
+
+// The owner pushes and pops at bottom, thieves take from top. Both indices
+// only grow; bottom - top is the number of queued tasks.
+typedef struct {
+    pthread_mutex_t mutex;
+    size_t top;
+    size_t bottom;
+    fp_task *items[FP_TASK_DEQUE_CAP];
+} fp_task_deque;
+
+struct fp_task_pool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work; // pool threads sleep here while nothing is queued
+    pthread_cond_t done; // submitters wait here for stolen tasks to finish
+    atomic_size_t queued;
+    atomic_size_t next_cursor; // first deque each pool thread steals from
+    bool stopping;
+    size_t submitter_count;
+    fp_task_deque *deques;
+    size_t thread_count;
+    pthread_t *threads;
+};
+
+static fp_task *fp_task_deque_pop(fp_task_pool *pool, fp_task_deque *deque) {
+    fp_task *task = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom != deque->top) {
+        deque->bottom--;
+        task = deque->items[deque->bottom % FP_TASK_DEQUE_CAP];
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    if (task) {
+        atomic_fetch_sub_explicit(&pool->queued, 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Takes the oldest task of the first non-empty deque, starting at *cursor so
+// the pool threads spread over the submitters.
+static fp_task *fp_task_pool_steal(fp_task_pool *pool, size_t *cursor) {
+    for (size_t n = 0; n < pool->submitter_count; ++n) {
+        size_t index = (*cursor + n) % pool->submitter_count;
+        fp_task_deque *deque = &pool->deques[index];
+        fp_task *task = NULL;
+        pthread_mutex_lock(&deque->mutex);
+        if (deque->bottom != deque->top) {
+            task = deque->items[deque->top % FP_TASK_DEQUE_CAP];
+            deque->top++;
+        }
+        pthread_mutex_unlock(&deque->mutex);
+        if (task) {
+            atomic_fetch_sub_explicit(&pool->queued, 1, memory_order_relaxed);
+            *cursor = index;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static void fp_task_run(fp_task_pool *pool, fp_task *task) {
+    fp_task_group *group = task->group; // task may be gone once the group is done
+    task->fn(task->arg);
+    if (atomic_fetch_sub_explicit(&group->pending, 1, memory_order_acq_rel) == 1) {
+        pthread_mutex_lock(&pool->mutex);
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+static void *fp_task_pool_thread(void *arg) {
+    fp_task_pool *pool = (fp_task_pool *)arg;
+    size_t cursor = atomic_fetch_add_explicit(&pool->next_cursor, 1, memory_order_relaxed) % pool->submitter_count;
+    for (;;) {
+        fp_task *task = fp_task_pool_steal(pool, &cursor);
+        if (task) {
+            fp_task_run(pool, task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->stopping && atomic_load_explicit(&pool->queued, memory_order_relaxed) == 0) {
+            pthread_cond_wait(&pool->work, &pool->mutex);
+        }
+        bool stopping = pool->stopping;
+        pthread_mutex_unlock(&pool->mutex);
+        if (stopping) {
+            return NULL;
+        }
+    }
+}
+
+fp_task_pool *fp_task_pool_create(size_t threads, size_t submitters) {
+    if (submitters == 0) {
+        return NULL;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    // Submitters encode their own tasks while they wait, so they take up
+    // cores of the encode budget too.
+    size_t budget = (size_t)cpus > submitters ? (size_t)cpus - submitters : 1;
+    if (threads == 0 || threads > budget) {
+        threads = budget;
+    }
+
+    fp_task_pool *pool = calloc(1, sizeof(fp_task_pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->deques = calloc(submitters, sizeof(fp_task_deque));
+    pool->threads = calloc(threads, sizeof(pthread_t));
+    if (!pool->deques || !pool->threads) {
+        free(pool->deques);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->next_cursor, 0);
+    pool->submitter_count = submitters;
+    for (size_t i = 0; i < submitters; ++i) {
+        pthread_mutex_init(&pool->deques[i].mutex, NULL);
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, fp_task_pool_thread, pool) != 0) {
+            break;
+        }
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        fp_task_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void fp_task_pool_destroy(fp_task_pool *pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 0; i < pool->thread_count; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (size_t i = 0; i < pool->submitter_count; ++i) {
+        pthread_mutex_destroy(&pool->deques[i].mutex);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+}
+
+size_t fp_task_pool_threads(const fp_task_pool *pool) {
+    return pool ? pool->thread_count : 0;
+}
+
+int fp_task_pool_submit(fp_task_pool *pool, size_t submitter, fp_task *task) {
+    if (!pool || submitter >= pool->submitter_count || !task || !task->fn || !task->group) {
+        return -1;
+    }
+    fp_task_deque *deque = &pool->deques[submitter];
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom - deque->top >= FP_TASK_DEQUE_CAP) {
+        pthread_mutex_unlock(&deque->mutex);
+        return -1;
+    }
+    // Counted before a thief can see it, so neither count drops below zero.
+    atomic_fetch_add_explicit(&task->group->pending, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->queued, 1, memory_order_relaxed);
+    deque->items[deque->bottom % FP_TASK_DEQUE_CAP] = task;
+    deque->bottom++;
+    pthread_mutex_unlock(&deque->mutex);
+
+    pthread_mutex_lock(&pool->mutex);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+void fp_task_pool_wait(fp_task_pool *pool, size_t submitter, fp_task_group *group) {
+    if (!pool || submitter >= pool->submitter_count || !group) {
+        return;
+    }
+    // Only this submitter pushes to its deque, so once it is empty every
+    // remaining task of the group is already running on a pool thread.
+    fp_task *task;
+    while ((task = fp_task_deque_pop(pool, &pool->deques[submitter])) != NULL) {
+        fp_task_run(pool, task);
+    }
+    pthread_mutex_lock(&pool->mutex);
+    while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -12,6 +12,8 @@
 #include "log.h"
 #include "progress.h"
 #include "image_ops.h"
+#include "output_store.h"
+#include "admission.h"
 
 static void fp_result_finish(fp_result *result) {
     if (result) {
@@ -82,21 +84,34 @@ static void worker_eta_make_key(char *dst, size_t dst_len, const char *base_key,
     snprintf(dst, dst_len, "%s_%02d", base_key, bucket);
 }
 
-typedef fp_compress_code (*fp_encode_fn)(const fp_rgba_image *, int, const char *, fp_encoded_image *);
+typedef fp_compress_code (*fp_encode_fn)(const fp_rgba_image *,
+                                         int,
+                                         const char *,
+                                         const fp_cancel_token *,
+                                         fp_encoded_image *);
 
 typedef struct {
     char key[32];
     double total_ms;
     double total_weight;
     uint32_t samples;
+    uint64_t last_used; // g_eta_clock at the latest sample, for eviction
 } fp_eta_entry;
 
+// One entry per encoder key and quarter-megapixel bucket; sized so the
+// default and expert keys across common image sizes stay resident.
+#define FP_ETA_ENTRIES 128
+
 typedef struct {
-    fp_eta_entry entries[8];
+    fp_eta_entry entries[FP_ETA_ENTRIES];
 } fp_eta_table;
 
 static fp_eta_table g_eta_table;
 static pthread_mutex_t g_eta_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Serialises appends to g_eta_store_path so they never hold g_eta_mutex,
+// which the event loops take to predict job costs.
+static pthread_mutex_t g_eta_file_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_eta_clock = 0;
 static pthread_once_t g_eta_load_once = PTHREAD_ONCE_INIT;
 static unsigned g_eta_dirty_counter = 0;
 static const char *g_eta_store_path = "ferret_eta.dat";
@@ -108,6 +123,7 @@ typedef struct {
     const char *log_name;
     const char *eta_key;
     fp_encoded_image *output;
+    size_t output_index;
     fp_encode_fn encode;
     struct timespec start_ts;
     struct timespec end_ts;
@@ -120,27 +136,49 @@ typedef struct {
     const char *format;
 } fp_encode_task;
 
-static fp_compress_code fp_worker_png_encode(const fp_rgba_image *image, int level, const char *label, fp_encoded_image *output) {
+static fp_compress_code fp_worker_png_encode(const fp_rgba_image *image,
+                                             int level,
+                                             const char *label,
+                                             const fp_cancel_token *cancel,
+                                             fp_encoded_image *output) {
+    (void)cancel;
     return fp_compress_png_level(image, level, label ? label : "variant", output);
 }
 
-static fp_compress_code fp_worker_png_quant(const fp_rgba_image *image, int palette_size, const char *label, fp_encoded_image *output) {
+static fp_compress_code fp_worker_png_quant(const fp_rgba_image *image,
+                                            int palette_size,
+                                            const char *label,
+                                            const fp_cancel_token *cancel,
+                                            fp_encoded_image *output) {
+    (void)cancel;
     if (palette_size <= 0) {
         palette_size = 128;
     }
     return fp_compress_png_quantized(image, palette_size, label, output);
 }
 
-static fp_compress_code fp_worker_webp_encode(const fp_rgba_image *image, int quality, const char *label, fp_encoded_image *output) {
+static fp_compress_code fp_worker_webp_encode(const fp_rgba_image *image,
+                                              int quality,
+                                              const char *label,
+                                              const fp_cancel_token *cancel,
+                                              fp_encoded_image *output) {
     (void)label;
-    return fp_compress_webp(image, quality, output);
+    return fp_compress_webp(image, quality, cancel, output);
 }
 
-static fp_compress_code fp_worker_png_more(const fp_rgba_image *image, int unused, const char *label, fp_encoded_image *output);
-
-static fp_compress_code fp_worker_avif_encode(const fp_rgba_image *image, int quality, const char *label, fp_encoded_image *output) {
+static fp_compress_code fp_worker_png_more(const fp_rgba_image *image,
+                                           int unused,
+                                           const char *label,
+                                           const fp_cancel_token *cancel,
+                                           fp_encoded_image *output);
+
+static fp_compress_code fp_worker_avif_encode(const fp_rgba_image *image,
+                                              int quality,
+                                              const char *label,
+                                              const fp_cancel_token *cancel,
+                                              fp_encoded_image *output) {
     (void)label;
-    return fp_compress_avif(image, quality, output);
+    return fp_compress_avif(image, quality, cancel, output);
 }
 
 static const char *fp_default_label(const fp_requested_output *req, const char *fallback) {
@@ -271,16 +309,27 @@ static void fp_worker_free_encoded(fp_encoded_image *img) {
     img->size = 0;
 }
 
-static fp_compress_code fp_worker_png_more(const fp_rgba_image *image, int unused, const char *label, fp_encoded_image *output) {
+static fp_compress_code fp_worker_png_more(const fp_rgba_image *image,
+                                           int unused,
+                                           const char *label,
+                                           const fp_cancel_token *cancel,
+                                           fp_encoded_image *output) {
     (void)unused;
     if (!output) {
         return FP_COMPRESS_ENCODE_ERROR;
     }
+    static const int levels[3] = {9, 7, 6};
     fp_encoded_image candidates[3] = {0};
     fp_compress_code codes[3];
-    codes[0] = fp_worker_png_encode(image, 9, label, &candidates[0]);
-    codes[1] = fp_worker_png_encode(image, 7, label, &candidates[1]);
-    codes[2] = fp_worker_png_encode(image, 6, label, &candidates[2]);
+    for (size_t i = 0; i < 3; ++i) {
+        if (fp_cancel_token_check(cancel) != FP_CANCEL_NONE) {
+            for (size_t j = 0; j < i; ++j) {
+                fp_worker_free_encoded(&candidates[j]);
+            }
+            return FP_COMPRESS_CANCELLED;
+        }
+        codes[i] = fp_worker_png_encode(image, levels[i], label, cancel, &candidates[i]);
+    }
 
     size_t best_idx = 0;
     size_t best_size = (size_t)-1;
@@ -315,8 +364,10 @@ static void worker_eta_save_sample(const char *key, double elapsed_ms, double un
     if (!key || !*key || elapsed_ms <= 0 || units <= 0) {
         return;
     }
+    pthread_mutex_lock(&g_eta_file_mutex);
     FILE *f = fopen(g_eta_store_path, "a");
     if (!f) {
+        pthread_mutex_unlock(&g_eta_file_mutex);
         return;
     }
     long pos = ftell(f);
@@ -326,6 +377,7 @@ static void worker_eta_save_sample(const char *key, double elapsed_ms, double un
     }
     fprintf(f, "%s %.6f %.6f\n", key, elapsed_ms, units);
     fclose(f);
+    pthread_mutex_unlock(&g_eta_file_mutex);
 }
 
 static void worker_eta_load(void) {
@@ -373,19 +425,27 @@ static void worker_eta_load(void) {
         if (slot && slot->samples == 0) {
             *slot = entry;
         }
+        if (slot) {
+            slot->last_used = ++g_eta_clock;
+        }
     }
     fclose(f);
 }
 
 static double worker_eta_update(const char *key, double elapsed_ms, double units);
 
-static void *fp_encode_task_run(void *arg) {
+static void fp_encode_task_run(void *arg) {
     fp_encode_task *task = (fp_encode_task *)arg;
     if (!task || !task->encode) {
-        return NULL;
+        return;
+    }
+    const fp_cancel_token *cancel = task->job ? task->job->cancel : NULL;
+    if (fp_cancel_token_check(cancel) != FP_CANCEL_NONE) {
+        task->code = FP_COMPRESS_CANCELLED;
+        return;
     }
     clock_gettime(CLOCK_MONOTONIC, &task->start_ts);
-    task->code = task->encode(task->image, task->quality, task->label, task->output);
+    task->code = task->encode(task->image, task->quality, task->label, cancel, task->output);
     clock_gettime(CLOCK_MONOTONIC, &task->end_ts);
     if (task->code == FP_COMPRESS_OK) {
         double elapsed = fp_timespec_diff_ms(&task->start_ts, &task->end_ts);
@@ -400,8 +460,19 @@ static void *fp_encode_task_run(void *arg) {
         } else {
             task->output->tuning[0] = '\0';
         }
+        char url[64];
+        const char *output_url = NULL;
+        if (task->job && task->job->output_store &&
+            fp_output_store_put(task->job->output_store, task->job->id, task->output_index, task->output) == 0) {
+            snprintf(url,
+                     sizeof(url),
+                     "/api/jobs/%llu/outputs/%zu",
+                     (unsigned long long)task->job->id,
+                     task->output_index);
+            output_url = url;
+        }
         if (task->job && task->job->progress) {
-            fp_progress_emit_output(task->job->progress, task->output, task->job->size, elapsed, avg);
+            fp_progress_emit_output(task->job->progress, task->output, output_url, task->job->size, elapsed, avg);
         }
         if (task->job) {
             fp_log_info("⏱️  Job #%llu %s finished in %.2f ms (avg %.2f ms)",
@@ -411,10 +482,29 @@ static void *fp_encode_task_run(void *arg) {
                         avg);
         }
     }
-    return NULL;
 }
 
-static fp_result *fp_worker_handle_job(fp_job *job) {
+// Finishes a job whose cancel token fired: partial outputs are dropped and
+// on_complete still runs so the submitter can release what it holds.
+static fp_result *fp_worker_cancel_job(fp_job *job, fp_result *result, fp_rgba_image *image, fp_cancel_reason reason) {
+    for (size_t i = 0; i < FP_MAX_OUTPUTS; ++i) {
+        fp_worker_free_encoded(&result->outputs[i]);
+    }
+    result->output_count = 0;
+    result->status = FP_RESULT_CANCELLED;
+    strncpy(result->message,
+            reason == FP_CANCEL_DEADLINE ? "deadline_exceeded" : "cancelled",
+            sizeof(result->message) - 1);
+    fp_output_store_drop_job(job->output_store, job->id);
+    fp_log_info("🛑 Job #%llu stopped: %s", (unsigned long long)job->id, result->message);
+    fp_rgba_image_free(image);
+    fp_free_job(job);
+    free(job);
+    fp_result_finish(result);
+    return result;
+}
+
+static fp_result *fp_worker_handle_job(fp_worker *worker, fp_job *job) {
     if (!job) {
         return NULL;
     }
@@ -433,7 +523,17 @@ static fp_result *fp_worker_handle_job(fp_job *job) {
     result->input_size = job->size;
 
     fp_rgba_image image = {0};
-    fp_compress_code code = fp_decode_png(job->data, job->size, &image);
+    fp_cancel_reason cancelled = fp_cancel_token_check(job->cancel);
+    if (cancelled != FP_CANCEL_NONE) {
+        return fp_worker_cancel_job(job, result, &image, cancelled);
+    }
+    fp_compress_code code = FP_COMPRESS_OK;
+    if (job->decoded.pixels) {
+        image = job->decoded;
+        memset(&job->decoded, 0, sizeof(job->decoded));
+    } else {
+        code = fp_decode_png(job->data, job->size, &image);
+    }
     if (code != FP_COMPRESS_OK) {
         result->status = -1;
         strncpy(result->message, "decode_error", sizeof(result->message) - 1);
@@ -465,6 +565,11 @@ static fp_result *fp_worker_handle_job(fp_job *job) {
         }
     }
 
+    cancelled = fp_cancel_token_check(job->cancel);
+    if (cancelled != FP_CANCEL_NONE) {
+        return fp_worker_cancel_job(job, result, &image, cancelled);
+    }
+
     result->input_width = ops_report.original_width;
     result->input_height = ops_report.original_height;
     result->output_width = image.width;
@@ -602,20 +707,30 @@ static fp_result *fp_worker_handle_job(fp_job *job) {
         return result;
     }
 
-    pthread_t threads[task_count];
-    bool started[FP_MAX_OUTPUTS];
-    memset(started, 0, sizeof(started));
     for (size_t i = 0; i < task_count; ++i) {
-        if (pthread_create(&threads[i], NULL, fp_encode_task_run, &tasks[i]) == 0) {
-            started[i] = true;
-        } else {
+        tasks[i].output_index = (size_t)(tasks[i].output - result->outputs);
+    }
+
+    // The pool threads steal the outputs while this worker encodes the rest.
+    fp_task_group group;
+    atomic_init(&group.pending, 0);
+    fp_task pool_tasks[FP_MAX_OUTPUTS];
+    for (size_t i = 0; i < task_count; ++i) {
+        pool_tasks[i] = (fp_task){.fn = fp_encode_task_run, .arg = &tasks[i], .group = &group};
+        if (fp_task_pool_submit(worker->task_pool, worker->index, &pool_tasks[i]) != 0) {
             fp_encode_task_run(&tasks[i]);
         }
     }
+    fp_task_pool_wait(worker->task_pool, worker->index, &group);
 
     for (size_t i = 0; i < task_count; ++i) {
-        if (started[i]) {
-            pthread_join(threads[i], NULL);
+        if (tasks[i].code == FP_COMPRESS_CANCELLED) {
+            cancelled = fp_cancel_token_check(job->cancel);
+            // The token may have been a deadline that was checked mid-encode.
+            if (cancelled == FP_CANCEL_NONE) {
+                cancelled = FP_CANCEL_ABANDONED;
+            }
+            return fp_worker_cancel_job(job, result, &image, cancelled);
         }
     }
 
@@ -636,6 +751,7 @@ static fp_result *fp_worker_handle_job(fp_job *job) {
         }
         fp_free_result(result);
         result->output_count = 0;
+        fp_output_store_drop_job(job->output_store, job->id);
         fp_log_warn("🧨 %s failed for job #%llu",
                     failure_message ? failure_message : "compression",
                     (unsigned long long)job->id);
@@ -666,29 +782,29 @@ static fp_result *fp_worker_handle_job(fp_job *job) {
 static void *fp_worker_thread(void *arg) {
     fp_worker *worker = (fp_worker *)arg;
     while (atomic_load_explicit(&worker->running, memory_order_acquire)) {
-        fp_job *job = (fp_job *)fp_queue_pop(worker->job_queue);
+        // Parks until a job is pushed; fp_workers_destroy closes the queue.
+        fp_job *job = fp_scheduler_pop_wait(worker->job_queue, worker->index, -1);
         if (!job) {
-            struct timespec ts = {0, 2000000};
-            nanosleep(&ts, NULL);
             continue;
         }
 
-        fp_result *result = fp_worker_handle_job(job);
-        if (!result) {
-            continue;
-        }
-
-        while (fp_queue_push(worker->result_queue, result) != 0) {
-            struct timespec ts = {0, 2000000};
-            nanosleep(&ts, NULL);
+        fp_job_complete_fn on_complete = job->on_complete;
+        void *complete_ctx = job->complete_ctx;
+        fp_result *result = fp_worker_handle_job(worker, job);
+        if (on_complete) {
+            on_complete(result, complete_ctx);
+        } else if (result) {
+            fp_free_result(result);
+            free(result);
         }
     }
 
     return NULL;
 }
 
-fp_worker *fp_workers_create(size_t count, fp_queue *job_queue, fp_queue *result_queue, fp_progress_registry *progress_registry) {
-    if (!job_queue || !result_queue || !progress_registry || count == 0) {
+fp_worker *fp_workers_create(size_t count, fp_scheduler *job_queue, fp_progress_registry *progress_registry,
+                             fp_task_pool *task_pool) {
+    if (!job_queue || !progress_registry || !task_pool || count == 0) {
         return NULL;
     }
 
@@ -699,13 +815,17 @@ fp_worker *fp_workers_create(size_t count, fp_queue *job_queue, fp_queue *result
 
     for (size_t i = 0; i < count; ++i) {
         workers[i].job_queue = job_queue;
-        workers[i].result_queue = result_queue;
         workers[i].progress_registry = progress_registry;
+        workers[i].task_pool = task_pool;
+        workers[i].index = i;
         atomic_store_explicit(&workers[i].running, true, memory_order_release);
         if (pthread_create(&workers[i].thread, NULL, fp_worker_thread, &workers[i]) != 0) {
             atomic_store_explicit(&workers[i].running, false, memory_order_release);
             for (size_t j = 0; j < i; ++j) {
                 atomic_store_explicit(&workers[j].running, false, memory_order_release);
+            }
+            fp_scheduler_close(job_queue);
+            for (size_t j = 0; j < i; ++j) {
                 pthread_join(workers[j].thread, NULL);
             }
             free(workers);
@@ -724,6 +844,7 @@ void fp_workers_destroy(fp_worker *workers, size_t count) {
     for (size_t i = 0; i < count; ++i) {
         atomic_store_explicit(&workers[i].running, false, memory_order_release);
     }
+    fp_scheduler_close(workers[0].job_queue);
 
     for (size_t i = 0; i < count; ++i) {
         if (workers[i].thread) {
@@ -733,6 +854,21 @@ void fp_workers_destroy(fp_worker *workers, size_t count) {
 
     free(workers);
 }
+double fp_worker_eta_ms_per_unit(void) {
+    pthread_once(&g_eta_load_once, worker_eta_load);
+    pthread_mutex_lock(&g_eta_mutex);
+    double slowest = 0.0;
+    size_t count = sizeof(g_eta_table.entries) / sizeof(g_eta_table.entries[0]);
+    for (size_t i = 0; i < count; ++i) {
+        const fp_eta_entry *entry = &g_eta_table.entries[i];
+        if (entry->samples > 0 && entry->total_weight > 0.0 && entry->total_ms / entry->total_weight > slowest) {
+            slowest = entry->total_ms / entry->total_weight;
+        }
+    }
+    pthread_mutex_unlock(&g_eta_mutex);
+    return slowest;
+}
+
 static double worker_eta_update(const char *key, double elapsed_ms, double units) {
     if (!key || !*key || elapsed_ms <= 0) {
         return elapsed_ms;
@@ -755,7 +891,15 @@ static double worker_eta_update(const char *key, double elapsed_ms, double units
         }
     }
     if (!slot) {
+        // Full: recycle the least recently sampled entry rather than mixing
+        // keys, so a new key does not evict itself on its next sample.
         slot = &g_eta_table.entries[0];
+        for (size_t i = 1; i < count; ++i) {
+            if (g_eta_table.entries[i].last_used < slot->last_used) {
+                slot = &g_eta_table.entries[i];
+            }
+        }
+        slot->samples = 0;
     }
     if (slot->samples == 0) {
         memset(slot, 0, sizeof(*slot));
@@ -765,10 +909,88 @@ static double worker_eta_update(const char *key, double elapsed_ms, double units
     slot->total_ms += elapsed_ms;
     slot->total_weight += units;
     slot->samples += 1;
+    slot->last_used = ++g_eta_clock;
     double avg_per_unit = slot->total_ms / slot->total_weight;
     double avg_for_job = avg_per_unit * units;
     g_eta_dirty_counter++;
-    worker_eta_save_sample(key, elapsed_ms, units);
     pthread_mutex_unlock(&g_eta_mutex);
+    worker_eta_save_sample(key, elapsed_ms, units);
     return avg_for_job;
 }
+
+// Learned cost per megapixel of the outputs whose ETA keys are base_key plus
+// a size bucket, over every bucket seen; 0 before any was measured.
+static double worker_eta_per_unit(const char *base_key) {
+    pthread_once(&g_eta_load_once, worker_eta_load);
+    size_t len = strlen(base_key);
+    double total_ms = 0.0;
+    double total_weight = 0.0;
+    pthread_mutex_lock(&g_eta_mutex);
+    for (size_t i = 0; i < FP_ETA_ENTRIES; ++i) {
+        const fp_eta_entry *entry = &g_eta_table.entries[i];
+        if (entry->samples > 0 && strncmp(entry->key, base_key, len) == 0 && entry->key[len] == '_' &&
+            entry->key[len + 1] >= '0' && entry->key[len + 1] <= '9') {
+            total_ms += entry->total_ms;
+            total_weight += entry->total_weight;
+        }
+    }
+    pthread_mutex_unlock(&g_eta_mutex);
+    return total_weight > 0.0 ? total_ms / total_weight : 0.0;
+}
+
+// The ETA base keys fp_worker_handle_job will use for job's outputs.
+static size_t worker_eta_job_keys(const fp_job *job, const char **keys) {
+    size_t count = 0;
+    if (job->is_expert && job->requested_output_count > 0) {
+        for (size_t i = 0; i < job->requested_output_count && i < FP_MAX_OUTPUTS; ++i) {
+            const fp_requested_output *req = &job->requested_outputs[i];
+            if (strcasecmp(req->format, "png") == 0) {
+                keys[count++] = "png_custom";
+            } else if (strcasecmp(req->format, "pngquant") == 0 || strcasecmp(req->label, "pngquant q80") == 0) {
+                keys[count++] = "png_quant_custom";
+            } else if (strcasecmp(req->format, "webp") == 0) {
+                keys[count++] = "webp_custom";
+            } else if (strcasecmp(req->format, "avif") == 0) {
+                keys[count++] = "avif_custom";
+            }
+        }
+        return count;
+    }
+    if (fp_should_run_task(job, "png", "lossless")) {
+        keys[count++] = "png_lossless";
+    }
+    if (fp_should_run_task(job, "png", "pngquant q80")) {
+        keys[count++] = "png_quant";
+    }
+    if (fp_should_run_task(job, "webp", "high")) {
+        keys[count++] = "webp_high";
+    }
+    if (fp_should_run_task(job, "avif", "medium")) {
+        keys[count++] = "avif_medium";
+    }
+    return count;
+}
+
+double fp_worker_predict_ms(const fp_job *job, double work_units) {
+    if (!job || work_units <= 0.0) {
+        return 0.0;
+    }
+    const char *keys[FP_MAX_OUTPUTS];
+    size_t count = worker_eta_job_keys(job, keys);
+    double fallback = 0.0;
+    double slowest = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        double per_unit = worker_eta_per_unit(keys[i]);
+        if (per_unit <= 0.0) {
+            if (fallback <= 0.0) {
+                fallback = fp_worker_eta_ms_per_unit();
+                fallback = fallback > 0.0 ? fallback : FP_ADMISSION_DEFAULT_MS_PER_UNIT;
+            }
+            per_unit = fallback; // never measured: assume the slowest format seen
+        }
+        if (per_unit > slowest) {
+            slowest = per_unit;
+        }
+    }
+    return slowest * work_units;
+}
@@ -62,7 +62,7 @@ with open(path, "wb") as f:
 PY
 
 TEST_PNG="$GENERATED_PNG"
-export HOST PORT TEST_PNG GENERATED_PNG
+export HOST PORT TEST_PNG GENERATED_PNG SERVER_LOG
 
 cleanup() {
   local status=$?
@@ -245,6 +245,10 @@ expected_opts = [
     {"crop": {"width": 40, "height": 32}, "png_level": 5, "png_colors": 96, "webp_quality": 70, "avif_quality": 30},
     {"crop": {"width": 24, "height": 20}, "png_level": 7, "png_colors": 128, "webp_quality": 85, "avif_quality": 26},
 ]
+# Files are listed in completion order; "index" maps each back to its upload slot.
+if sorted(item.get("index", -1) for item in files) != [0, 1]:
+    raise SystemExit(f"expert autotest: expected file indexes 0 and 1, got {[item.get('index') for item in files]}")
+files.sort(key=lambda item: item["index"])
 for idx, item in enumerate(files, 1):
     geom = item.get("geometry") or {}
     expected = expected_opts[idx - 1]
@@ -276,3 +280,34 @@ for idx, item in enumerate(files, 1):
 print_summary("autotest-expert", {"jobId": files[0].get("jobId"), "durationMs": files[0].get("durationMs", 0), "inputBytes": files[0].get("inputBytes", 0), "filename": files[0].get("filename"), "results": files[0].get("results")})
 print("✅ [autotest] Expert multipart path validated (auth + crop)")
 PY
+
+# Clients that hang up while their job waits or runs must have it stopped.
+python3 - <<'PY'
+import os, random, socket, struct, time, zlib
+w = h = 1024
+raw = b"".join(b"\x00" + random.randbytes(w * 4) for _ in range(h))
+def chunk(tag, payload):
+    return struct.pack(">I", len(payload)) + tag + payload + struct.pack(">I", zlib.crc32(tag + payload) & 0xffffffff)
+png = (b"\x89PNG\r\n\x1a\n" + chunk(b"IHDR", struct.pack(">IIBBBBB", w, h, 8, 6, 0, 0, 0)) +
+       chunk(b"IDAT", zlib.compress(raw, 1)) + chunk(b"IEND", b""))
+head = (f"POST /api/compress HTTP/1.1\r\nHost: {os.environ['HOST']}\r\n"
+        f"Content-Type: image/png\r\nContent-Length: {len(png)}\r\n\r\n").encode()
+# More jobs than workers, so some are still queued when their clients leave.
+clients = []
+for _ in range(12):
+    s = socket.create_connection((os.environ["HOST"], int(os.environ["PORT"])))
+    s.sendall(head + png)
+    clients.append(s)
+time.sleep(0.5)
+for s in clients:
+    s.close()
+deadline = time.time() + 30
+while time.time() < deadline:
+    with open(os.environ["SERVER_LOG"], encoding="utf-8", errors="replace") as f:
+        if "stopped: cancelled" in f.read():
+            break
+    time.sleep(0.2)
+else:
+    raise SystemExit("autotest: jobs of clients that hung up were not cancelled")
+print("✅ [autotest] Jobs of disconnected clients were cancelled")
+PY
@@ -0,0 +1,50 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "base64.h"
+
+// Encodes a buffer the size of a typical output with each kernel the CPU
+// supports and reports input throughput.
+
+#define BENCH_INPUT_BYTES (8u * 1024u * 1024u)
+#define BENCH_ROUNDS 40
+
+static double bench_now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+    uint8_t *data = malloc(BENCH_INPUT_BYTES);
+    char *out = malloc(fp_base64_encoded_len(BENCH_INPUT_BYTES));
+    if (!data || !out) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < BENCH_INPUT_BYTES; ++i) {
+        data[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+
+    fp_base64_kernel kernels[8];
+    size_t kernel_count = fp_base64_kernels(kernels, 8);
+    printf("base64: %u MB input, %d rounds, dispatch → %s\n",
+           BENCH_INPUT_BYTES / (1024u * 1024u),
+           BENCH_ROUNDS,
+           fp_base64_kernel_name());
+    for (size_t k = 0; k < kernel_count; ++k) {
+        kernels[k].encode(data, BENCH_INPUT_BYTES, out); // warm up
+        double start = bench_now_s();
+        for (int round = 0; round < BENCH_ROUNDS; ++round) {
+            kernels[k].encode(data, BENCH_INPUT_BYTES, out);
+        }
+        double elapsed = bench_now_s() - start;
+        double gbps = (double)BENCH_INPUT_BYTES * BENCH_ROUNDS / elapsed / 1e9;
+        printf("  %-11s %6.2f GB/s\n", kernels[k].name, gbps);
+    }
+
+    free(data);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include "admission.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static void test_wait_limit(void) {
+    // Two workers at 100 ms per megapixel; free jobs may queue for 1 s.
+    fp_admission_limits limits[FP_ADMIT_CLASS_COUNT] = {
+        [FP_ADMIT_FREE] = {.max_jobs = 100, .max_wait_ms = 1000},
+        [FP_ADMIT_EXPERT] = {.max_jobs = 100, .max_wait_ms = 5000},
+    };
+    fp_admission *admission = fp_admission_create(2, 100.0, limits);
+    TEST_ASSERT(admission != NULL);
+
+    unsigned retry_after = 0;
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_FREE, 10.0, &retry_after) == 0);
+    }
+    // 30 MP across two workers is 1.5 s of backlog.
+    TEST_ASSERT(fp_admission_wait_ms(admission) == 1500);
+    TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_FREE, 1.0, &retry_after) != 0);
+    TEST_ASSERT(retry_after == 1);
+    // Expert work tolerates a longer queue.
+    TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_EXPERT, 1.0, &retry_after) == 0);
+    TEST_ASSERT(retry_after == 0);
+
+    // Measured jobs ran twice as slow as assumed, so the estimate grows.
+    fp_admission_release(admission, FP_ADMIT_FREE, 10.0, 2000.0);
+    TEST_ASSERT(fp_admission_wait_ms(admission) > 1050);
+    fp_admission_release(admission, FP_ADMIT_FREE, 10.0, 0.0);
+    fp_admission_release(admission, FP_ADMIT_FREE, 10.0, 0.0);
+    fp_admission_release(admission, FP_ADMIT_EXPERT, 1.0, 0.0);
+    TEST_ASSERT(fp_admission_wait_ms(admission) == 0);
+    TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_FREE, 1.0, &retry_after) == 0);
+    fp_admission_destroy(admission);
+}
+
+static void test_job_limit(void) {
+    fp_admission_limits limits[FP_ADMIT_CLASS_COUNT] = {[FP_ADMIT_FREE] = {.max_jobs = 2}};
+    fp_admission *admission = fp_admission_create(1, 100.0, limits);
+    TEST_ASSERT(admission != NULL);
+    TEST_ASSERT(fp_admission_limits_for(admission, FP_ADMIT_FREE)->max_wait_ms == FP_ADMISSION_FREE_MAX_WAIT_MS);
+
+    unsigned retry_after = 0;
+    TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_FREE, 0.1, &retry_after) == 0);
+    TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_FREE, 0.1, &retry_after) == 0);
+    TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_FREE, 0.1, &retry_after) != 0);
+    TEST_ASSERT(fp_admission_jobs(admission) == 2);
+    TEST_ASSERT(retry_after >= 1 && retry_after <= FP_ADMISSION_MAX_RETRY_AFTER_S);
+    fp_admission_release(admission, FP_ADMIT_FREE, 0.1, 10.0);
+    TEST_ASSERT(fp_admission_try_admit(admission, FP_ADMIT_FREE, 0.1, &retry_after) == 0);
+    fp_admission_destroy(admission);
+}
+
+void run_admission_tests(void) {
+    printf("\n🧪 [admission] Refusing work past the estimated wait\n");
+    test_wait_limit();
+    printf("✅ [admission] Backlog estimate tracked admits, releases and measured cost\n");
+
+    printf("\n🧪 [admission] Capping unfinished jobs per class\n");
+    test_job_limit();
+    printf("✅ [admission] The job cap refused and then readmitted with a Retry-After hint\n");
+}
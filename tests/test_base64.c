@@ -0,0 +1,64 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "base64.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static void test_known_vectors(void) {
+    static const char *inputs[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+    static const char *expected[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        char *encoded = fp_base64_encode((const uint8_t *)inputs[i], strlen(inputs[i]));
+        TEST_ASSERT(encoded != NULL);
+        TEST_ASSERT(strcmp(encoded, expected[i]) == 0);
+        free(encoded);
+    }
+}
+
+// Every kernel must match the scalar one for all lengths around the SIMD
+// block sizes (12, 24, 48) and their tails, and must not write past the end.
+static void test_kernels_agree(void) {
+    fp_base64_kernel kernels[8];
+    size_t kernel_count = fp_base64_kernels(kernels, 8);
+    TEST_ASSERT(kernel_count > 0);
+    TEST_ASSERT(strcmp(kernels[kernel_count - 1].name, "scalar") == 0);
+    fp_base64_kernel scalar = kernels[kernel_count - 1];
+
+    enum { MAX_LEN = 400 };
+    uint8_t data[MAX_LEN];
+    unsigned seed = 12345;
+    for (size_t i = 0; i < MAX_LEN; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+    char expected[4 * MAX_LEN / 3 + 8];
+    char actual[4 * MAX_LEN / 3 + 8];
+    for (size_t len = 0; len <= MAX_LEN; ++len) {
+        size_t encoded_len = fp_base64_encoded_len(len);
+        TEST_ASSERT(scalar.encode(data, len, expected) == encoded_len);
+        for (size_t k = 0; k < kernel_count; ++k) {
+            memset(actual, '#', sizeof(actual));
+            TEST_ASSERT(kernels[k].encode(data, len, actual) == encoded_len);
+            TEST_ASSERT(memcmp(actual, expected, encoded_len) == 0);
+            TEST_ASSERT(actual[encoded_len] == '#');
+        }
+    }
+}
+
+void run_base64_tests(void) {
+    printf("\n🧪 [base64] Encoding RFC 4648 vectors (%s kernel)\n", fp_base64_kernel_name());
+    test_known_vectors();
+    printf("✅ [base64] Known vectors matched\n");
+
+    printf("\n🧪 [base64] Comparing every available kernel against scalar\n");
+    test_kernels_agree();
+    printf("✅ [base64] All kernels produced identical output\n");
+}
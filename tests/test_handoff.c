@@ -0,0 +1,132 @@
+#define _GNU_SOURCE // SCM_RIGHTS, CMSG_*
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "handoff.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static void test_pass_descriptors(void) {
+    int pair[2];
+    int first[2];
+    int second[2];
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    TEST_ASSERT(pipe(first) == 0 && pipe(second) == 0);
+
+    int outgoing[2] = {first[1], second[1]};
+    TEST_ASSERT(fp_handoff_send_fds(pair[0], outgoing, 2) == 0);
+    int incoming[2] = {-1, -1};
+    size_t count = 0;
+    TEST_ASSERT(fp_handoff_recv_fds(pair[1], incoming, 2, &count) == 0);
+    TEST_ASSERT(count == 2);
+    TEST_ASSERT(incoming[0] != first[1] && incoming[1] != second[1]);
+
+    // The received descriptors reach the same pipes, in order, after the
+    // sender has closed its own copies.
+    close(first[1]);
+    close(second[1]);
+    char c = 0;
+    TEST_ASSERT(write(incoming[0], "a", 1) == 1 && read(first[0], &c, 1) == 1 && c == 'a');
+    TEST_ASSERT(write(incoming[1], "b", 1) == 1 && read(second[0], &c, 1) == 1 && c == 'b');
+
+    // An empty handover is still a valid message.
+    TEST_ASSERT(fp_handoff_send_fds(pair[0], NULL, 0) == 0);
+    TEST_ASSERT(fp_handoff_recv_fds(pair[1], incoming, 2, &count) == 0 && count == 0);
+
+    // Garbage is refused.
+    TEST_ASSERT(write(pair[0], "notahandoff!", 8) == 8);
+    TEST_ASSERT(fp_handoff_recv_fds(pair[1], incoming, 2, &count) != 0 && count == 0);
+
+    close(incoming[0]);
+    close(incoming[1]);
+    close(first[0]);
+    close(second[0]);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+// Descriptors that ride along with a bad header are closed, not leaked.
+static void test_bad_header_closes_descriptors(void) {
+    int pair[2];
+    int pipe_fds[2];
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    TEST_ASSERT(pipe(pipe_fds) == 0);
+
+    char junk[8] = "notFPH1!";
+    struct iovec iov = {.iov_base = junk, .iov_len = sizeof(junk)};
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &pipe_fds[1], sizeof(int));
+    TEST_ASSERT(sendmsg(pair[0], &msg, 0) == (ssize_t)sizeof(junk));
+    close(pipe_fds[1]);
+
+    int incoming[2] = {-1, -1};
+    size_t count = 7;
+    TEST_ASSERT(fp_handoff_recv_fds(pair[1], incoming, 2, &count) != 0 && count == 0);
+    // With the received copy closed too, no write end is left.
+    char c = 0;
+    TEST_ASSERT(read(pipe_fds[0], &c, 1) == 0);
+
+    close(pipe_fds[0]);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+static void test_control_socket_private(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/ferret-handoff-test-%ld.sock", (long)getpid());
+    int listen_fd = fp_handoff_listen(path);
+    TEST_ASSERT(listen_fd >= 0);
+    struct stat st;
+    TEST_ASSERT(stat(path, &st) == 0);
+    TEST_ASSERT((st.st_mode & 0777) == 0600);
+    close(listen_fd);
+    unlink(path);
+
+    int pair[2];
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    TEST_ASSERT(fp_handoff_peer_trusted(pair[0]));
+    TEST_ASSERT(fp_handoff_peer_trusted(pair[1]));
+    close(pair[0]);
+    close(pair[1]);
+}
+
+static void test_nobody_listening(void) {
+    int fds[4];
+    size_t count = 7;
+    TEST_ASSERT(fp_handoff_request("/nonexistent/ferret-handoff.sock", fds, 4, &count) < 0);
+    TEST_ASSERT(count == 0);
+}
+
+void run_handoff_tests(void) {
+    printf("\n🧪 [handoff] Passing listening descriptors over SCM_RIGHTS\n");
+    test_pass_descriptors();
+    test_bad_header_closes_descriptors();
+    test_nobody_listening();
+    printf("✅ [handoff] Descriptors arrived in order and bad messages were refused without leaking\n");
+
+    printf("\n🧪 [handoff] Restricting the control socket to our user\n");
+    test_control_socket_private();
+    printf("✅ [handoff] Socket file is 0600 and same-user peers are trusted\n");
+}
@@ -0,0 +1,116 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "http_parser.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static const char *sample_head =
+    "\r\n"
+    "POST /api/compress HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Content-Length:  42 \r\n"
+    "X-Empty:\r\n"
+    "\r\n"
+    "body";
+
+static void check_sample(const fp_http_parser *parser) {
+    const char *buf = sample_head;
+    char text[64];
+    TEST_ASSERT(fp_http_span_equals(buf, parser->method, "post"));
+    fp_http_span_copy(buf, parser->target, text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "/api/compress") == 0);
+    TEST_ASSERT(parser->header_count == 3);
+    TEST_ASSERT(fp_http_span_equals(buf, parser->headers[1].name, "content-length"));
+    fp_http_span_copy(buf, parser->headers[1].value, text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "42") == 0);
+    TEST_ASSERT(parser->headers[2].value.len == 0);
+    TEST_ASSERT(parser->head_len == strlen(sample_head) - 4);
+}
+
+static void test_whole_and_bytewise(void) {
+    fp_http_parser parser;
+    fp_http_parser_init(&parser, 1024);
+    TEST_ASSERT(fp_http_parser_feed(&parser, sample_head, strlen(sample_head)) == FP_HTTP_PARSE_DONE);
+    check_sample(&parser);
+
+    fp_http_parser_init(&parser, 1024);
+    size_t head_len = strlen(sample_head) - 4;
+    for (size_t i = 0; i < head_len; ++i) {
+        TEST_ASSERT(fp_http_parser_feed(&parser, sample_head, i) == FP_HTTP_PARSE_INCOMPLETE);
+    }
+    TEST_ASSERT(fp_http_parser_feed(&parser, sample_head, head_len) == FP_HTTP_PARSE_DONE);
+    check_sample(&parser);
+}
+
+static fp_http_parse_status parse_once(const char *head, size_t max_len) {
+    fp_http_parser parser;
+    fp_http_parser_init(&parser, max_len);
+    return fp_http_parser_feed(&parser, head, strlen(head));
+}
+
+static void test_rejections(void) {
+    TEST_ASSERT(parse_once("GE(T / HTTP/1.1\r\n\r\n", 1024) == FP_HTTP_PARSE_MALFORMED);
+    TEST_ASSERT(parse_once("GET  / HTTP/1.1\r\n\r\n", 1024) == FP_HTTP_PARSE_MALFORMED);
+    TEST_ASSERT(parse_once("GET / HTTP/2.0\r\n\r\n", 1024) == FP_HTTP_PARSE_MALFORMED);
+    TEST_ASSERT(parse_once("GET / HTTP/1.1\nHost: x\n\n", 1024) == FP_HTTP_PARSE_MALFORMED);
+    TEST_ASSERT(parse_once("GET / HTTP/1.1\r\nNo colon here\r\n\r\n", 1024) == FP_HTTP_PARSE_MALFORMED);
+    TEST_ASSERT(parse_once("GET / HTTP/1.1\r\nA: b\r\n folded\r\n\r\n", 1024) == FP_HTTP_PARSE_MALFORMED);
+    // Rejected as soon as the limit is crossed, before the head is complete.
+    TEST_ASSERT(parse_once("GET /aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 16) == FP_HTTP_PARSE_TOO_LARGE);
+
+    char many[FP_HTTP_MAX_HEADERS * 8 + 64];
+    size_t len = (size_t)snprintf(many, sizeof(many), "GET / HTTP/1.1\r\n");
+    for (size_t i = 0; i <= FP_HTTP_MAX_HEADERS; ++i) {
+        len += (size_t)snprintf(many + len, sizeof(many) - len, "A: b\r\n");
+    }
+    TEST_ASSERT(parse_once(many, sizeof(many)) == FP_HTTP_PARSE_TOO_LARGE);
+}
+
+// -2 when the head itself does not parse.
+static int content_length_of(const char *head, size_t *length) {
+    fp_http_parser parser;
+    fp_http_parser_init(&parser, 1024);
+    if (fp_http_parser_feed(&parser, head, strlen(head)) != FP_HTTP_PARSE_DONE) {
+        return -2;
+    }
+    return fp_http_parser_content_length(&parser, head, length);
+}
+
+static void test_content_length(void) {
+    size_t length = 99;
+    TEST_ASSERT(content_length_of("GET / HTTP/1.1\r\nHost: x\r\n\r\n", &length) == 0);
+    TEST_ASSERT(length == 0);
+    TEST_ASSERT(content_length_of(sample_head, &length) == 0);
+    TEST_ASSERT(length == 42);
+    TEST_ASSERT(content_length_of("POST / HTTP/1.1\r\nContent-Length: 5\r\ncontent-length: 5\r\n\r\n", &length) == 0);
+    TEST_ASSERT(length == 5);
+    // Conflicting or non-numeric lengths would let a pipelined request hide in the body.
+    TEST_ASSERT(content_length_of("POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 50\r\n\r\n", &length) == -1);
+    TEST_ASSERT(content_length_of("POST / HTTP/1.1\r\nContent-Length: 0\r\nContent-Length: 7\r\n\r\n", &length) == -1);
+    TEST_ASSERT(content_length_of("POST / HTTP/1.1\r\nContent-Length: 5, 5\r\n\r\n", &length) == -1);
+    TEST_ASSERT(content_length_of("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n", &length) == -1);
+    TEST_ASSERT(content_length_of("POST / HTTP/1.1\r\nContent-Length:\r\n\r\n", &length) == -1);
+    TEST_ASSERT(content_length_of("POST / HTTP/1.1\r\nContent-Length: 1234567890123456\r\n\r\n", &length) == -1);
+}
+
+void run_http_parser_tests(void) {
+    printf("\n🧪 [http-parser] Parsing a request head whole and byte by byte\n");
+    test_whole_and_bytewise();
+    printf("✅ [http-parser] Both passes recorded the same spans\n");
+
+    printf("\n🧪 [http-parser] Rejecting malformed and oversized heads\n");
+    test_rejections();
+    printf("✅ [http-parser] Bad input was refused before the head completed\n");
+
+    printf("\n🧪 [http-parser] Reading Content-Length\n");
+    test_content_length();
+    printf("✅ [http-parser] Repeated equal lengths accepted, conflicting or malformed ones refused\n");
+}
@@ -0,0 +1,105 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "multipart.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static const char *sample_body =
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"options\"\r\n"
+    "\r\n"
+    "{\"webp\":true}\r\n"
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"files\"; filename=\"a.png\"\r\n"
+    "Content-Type: image/png\r\n"
+    "\r\n"
+    "\x89PNG\r\n--XyQ--XyZ\r\n"
+    "--XyZ\r\n"
+    "Content-Disposition: form-data; name=\"files\"; filename=\"b.png\"\r\n"
+    "\r\n"
+    "\r\n"
+    "--XyZ--\r\n";
+
+static void check_sample_parts(const uint8_t *body, const fp_form_part *parts, size_t count) {
+    TEST_ASSERT(count == 3);
+    TEST_ASSERT(strcmp(parts[0].name, "options") == 0 && parts[0].filename[0] == '\0');
+    TEST_ASSERT(parts[0].size == 13 && memcmp(parts[0].data, "{\"webp\":true}", 13) == 0);
+    TEST_ASSERT(strcmp(parts[1].name, "files") == 0 && strcmp(parts[1].filename, "a.png") == 0);
+    TEST_ASSERT(strcmp(parts[1].content_type, "image/png") == 0);
+    // Near-misses of the delimiter inside file data stay part of the data.
+    TEST_ASSERT(parts[1].size == 16 && memcmp(parts[1].data, "\x89PNG\r\n--XyQ--XyZ", 16) == 0);
+    TEST_ASSERT(strcmp(parts[2].filename, "b.png") == 0 && parts[2].size == 0);
+    // Parts are slices of the body, not copies.
+    TEST_ASSERT(parts[1].data > body && parts[1].data < body + strlen((const char *)body));
+}
+
+static void test_one_shot_and_incremental(void) {
+    char boundary[FP_MULTIPART_BOUNDARY_MAX + 1];
+    TEST_ASSERT(fp_multipart_boundary("multipart/form-data; boundary=XyZ", boundary, sizeof(boundary)) == 0);
+    TEST_ASSERT(strcmp(boundary, "XyZ") == 0);
+    TEST_ASSERT(fp_multipart_boundary("multipart/form-data; boundary=\"XyZ\"; x=1", boundary, sizeof(boundary)) == 0);
+    TEST_ASSERT(strcmp(boundary, "XyZ") == 0);
+    TEST_ASSERT(fp_multipart_boundary("multipart/form-data", boundary, sizeof(boundary)) != 0);
+
+    const uint8_t *body = (const uint8_t *)sample_body;
+    size_t len = strlen(sample_body);
+    fp_form_part parts[4];
+    size_t count = 0;
+    TEST_ASSERT(fp_multipart_parse(body, len, "XyZ", parts, 4, &count) == 0);
+    check_sample_parts(body, parts, count);
+
+    // Feeding one more byte at a time must find exactly the same parts.
+    fp_form_part fed[4];
+    fp_multipart_parser parser;
+    TEST_ASSERT(fp_multipart_init(&parser, "XyZ", fed, 4) == 0);
+    for (size_t i = 0; i <= len; ++i) {
+        TEST_ASSERT(fp_multipart_feed(&parser, body, i) == 0);
+        if (i < len - 2) {
+            TEST_ASSERT(fp_multipart_finish(&parser, &count) != 0);
+        }
+    }
+    TEST_ASSERT(fp_multipart_finish(&parser, &count) == 0);
+    check_sample_parts(body, fed, count);
+
+    // Extra parts are dropped rather than overflowing the caller's array.
+    TEST_ASSERT(fp_multipart_parse(body, len, "XyZ", parts, 2, &count) == 0);
+    TEST_ASSERT(count == 2);
+}
+
+static void test_malformed_bodies(void) {
+    fp_form_part parts[4];
+    size_t count = 0;
+    const char *truncated = "--XyZ\r\nContent-Disposition: form-data; name=\"files\"\r\n\r\nabc";
+    TEST_ASSERT(fp_multipart_parse((const uint8_t *)truncated, strlen(truncated), "XyZ", parts, 4, &count) != 0);
+    const char *garbage = "--XyZ??\r\n";
+    TEST_ASSERT(fp_multipart_parse((const uint8_t *)garbage, strlen(garbage), "XyZ", parts, 4, &count) != 0);
+    TEST_ASSERT(fp_multipart_parse((const uint8_t *)"", 0, "XyZ", parts, 4, &count) != 0);
+
+    size_t huge_len = FP_MULTIPART_MAX_HEADER + 64;
+    uint8_t *huge = malloc(huge_len);
+    TEST_ASSERT(huge != NULL);
+    memcpy(huge, "--XyZ\r\n", 7);
+    memset(huge + 7, 'h', huge_len - 7);
+    fp_multipart_parser parser;
+    TEST_ASSERT(fp_multipart_init(&parser, "XyZ", parts, 4) == 0);
+    TEST_ASSERT(fp_multipart_feed(&parser, huge, huge_len) != 0);
+    free(huge);
+}
+
+void run_multipart_tests(void) {
+    printf("\n🧪 [multipart] Parsing a form in one shot and byte by byte\n");
+    test_one_shot_and_incremental();
+    printf("✅ [multipart] Both passes returned the same zero-copy parts\n");
+
+    printf("\n🧪 [multipart] Rejecting malformed bodies\n");
+    test_malformed_bodies();
+    printf("✅ [multipart] Truncated, garbled and oversized bodies were refused\n");
+}
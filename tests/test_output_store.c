@@ -0,0 +1,77 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "output_store.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static void make_output(fp_encoded_image *output, size_t size) {
+    memset(output, 0, sizeof(*output));
+    snprintf(output->format, sizeof(output->format), "png");
+    snprintf(output->mime, sizeof(output->mime), "image/png");
+    output->data = malloc(size);
+    TEST_ASSERT(output->data != NULL);
+    memset(output->data, 0xab, size);
+    output->size = size;
+}
+
+static void test_put_take_once(void) {
+    fp_output_store *store = fp_output_store_create(60000, 0);
+    TEST_ASSERT(store != NULL);
+
+    fp_encoded_image output;
+    make_output(&output, 1000);
+    TEST_ASSERT(fp_output_store_put(store, 7, 2, &output) == 0);
+    TEST_ASSERT(output.data == NULL && output.size == 1000);
+
+    fp_output_meta meta;
+    TEST_ASSERT(fp_output_store_take(store, 7, 1, &meta) == NULL);
+    fp_blob *blob = fp_output_store_take(store, 7, 2, &meta);
+    TEST_ASSERT(blob != NULL);
+    TEST_ASSERT(fp_blob_size(blob) == 1000 && fp_blob_data(blob)[999] == 0xab);
+    TEST_ASSERT(strcmp(meta.mime, "image/png") == 0);
+    TEST_ASSERT(fp_output_store_take(store, 7, 2, &meta) == NULL);
+
+    // The blob outlives the store while a reader still holds it.
+    fp_output_store_destroy(store);
+    TEST_ASSERT(fp_blob_data(blob)[0] == 0xab);
+    fp_blob_release(blob);
+}
+
+static void test_budget_and_expiry(void) {
+    fp_output_store *store = fp_output_store_create(20, 1500);
+    TEST_ASSERT(store != NULL);
+
+    fp_encoded_image first;
+    fp_encoded_image second;
+    make_output(&first, 1000);
+    make_output(&second, 1000);
+    TEST_ASSERT(fp_output_store_put(store, 1, 0, &first) == 0);
+    TEST_ASSERT(fp_output_store_put(store, 1, 1, &second) != 0);
+    TEST_ASSERT(second.data != NULL);
+    free(second.data);
+
+    struct timespec ts = {0, 40 * 1000000L};
+    nanosleep(&ts, NULL);
+    TEST_ASSERT(fp_output_store_expire(store) == 1);
+    TEST_ASSERT(fp_output_store_take(store, 1, 0, NULL) == NULL);
+    fp_output_store_destroy(store);
+}
+
+void run_output_store_tests(void) {
+    printf("\n🧪 [output-store] Parking and downloading an output\n");
+    test_put_take_once();
+    printf("✅ [output-store] Outputs are served once and blobs outlive their entry\n");
+
+    printf("\n🧪 [output-store] Enforcing the byte budget and TTL\n");
+    test_budget_and_expiry();
+    printf("✅ [output-store] Over-budget puts were refused and stale entries expired\n");
+}
@@ -0,0 +1,87 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static void encode_gradient(fp_encoded_image *png) {
+    fp_rgba_image img = {0};
+    img.width = 37;
+    img.height = 23;
+    img.pixels = malloc((size_t)img.width * img.height * 4);
+    TEST_ASSERT(img.pixels != NULL);
+    for (size_t i = 0; i < (size_t)img.width * img.height * 4; ++i) {
+        img.pixels[i] = (unsigned char)(i * 7);
+    }
+    memset(png, 0, sizeof(*png));
+    TEST_ASSERT(fp_compress_png_level(&img, 6, "test", png) == FP_COMPRESS_OK);
+    free(img.pixels);
+}
+
+static void test_stream_matches_buffered_decode(void) {
+    fp_encoded_image png;
+    encode_gradient(&png);
+
+    fp_rgba_image expected = {0};
+    TEST_ASSERT(fp_decode_png(png.data, png.size, &expected) == FP_COMPRESS_OK);
+
+    // Odd piece sizes split the signature, chunk headers and IDAT data.
+    fp_png_stream *stream = fp_png_stream_create();
+    TEST_ASSERT(stream != NULL);
+    size_t offset = 0;
+    size_t piece = 1;
+    while (offset < png.size) {
+        size_t len = png.size - offset < piece ? png.size - offset : piece;
+        TEST_ASSERT(fp_png_stream_feed(stream, png.data + offset, len) == FP_COMPRESS_OK);
+        offset += len;
+        piece = piece * 3 + 1;
+    }
+    fp_rgba_image streamed = {0};
+    TEST_ASSERT(fp_png_stream_finish(stream, &streamed) == FP_COMPRESS_OK);
+    fp_png_stream_destroy(stream);
+
+    TEST_ASSERT(streamed.width == expected.width && streamed.height == expected.height);
+    TEST_ASSERT(memcmp(streamed.pixels, expected.pixels, (size_t)expected.width * expected.height * 4) == 0);
+    fp_rgba_image_free(&streamed);
+    fp_rgba_image_free(&expected);
+    free(png.data);
+}
+
+static void test_stream_rejects_truncated_input(void) {
+    fp_encoded_image png;
+    encode_gradient(&png);
+
+    fp_png_stream *stream = fp_png_stream_create();
+    TEST_ASSERT(stream != NULL);
+    TEST_ASSERT(fp_png_stream_feed(stream, png.data, png.size / 2) == FP_COMPRESS_OK);
+    fp_rgba_image out = {0};
+    TEST_ASSERT(fp_png_stream_finish(stream, &out) == FP_COMPRESS_DECODE_ERROR);
+    TEST_ASSERT(out.pixels == NULL);
+    fp_png_stream_destroy(stream);
+
+    static const unsigned char garbage[] = "not a png at all";
+    stream = fp_png_stream_create();
+    TEST_ASSERT(stream != NULL);
+    TEST_ASSERT(fp_png_stream_feed(stream, garbage, sizeof(garbage)) == FP_COMPRESS_DECODE_ERROR);
+    TEST_ASSERT(fp_png_stream_feed(stream, png.data, png.size) == FP_COMPRESS_DECODE_ERROR);
+    fp_png_stream_destroy(stream);
+    free(png.data);
+}
+
+void run_png_stream_tests(void) {
+    printf("\n🧪 [png-stream] Feeding a PNG in uneven pieces\n");
+    test_stream_matches_buffered_decode();
+    printf("✅ [png-stream] Progressive decode matched the buffered decoder\n");
+
+    printf("\n🧪 [png-stream] Feeding truncated and invalid input\n");
+    test_stream_rejects_truncated_input();
+    printf("✅ [png-stream] Incomplete uploads reported decode errors\n");
+}
@@ -0,0 +1,55 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static void test_recycling(void) {
+    fp_pool *pool = fp_pool_create(4096, 2);
+    TEST_ASSERT(pool != NULL);
+    TEST_ASSERT(fp_pool_object_size(pool) == 4096);
+
+    char *a = fp_pool_get(pool);
+    char *b = fp_pool_get(pool);
+    char *c = fp_pool_get(pool);
+    TEST_ASSERT(a && b && c);
+    memset(a, 'a', 4096);
+    memset(c, 'c', 4096);
+    fp_pool_put(pool, a);
+    fp_pool_put(pool, b);
+    fp_pool_put(pool, c); // over the cap: back to the allocator
+    TEST_ASSERT(fp_pool_cached(pool) == 2);
+
+    // Most recently freed first, so the warmest memory is reused.
+    TEST_ASSERT(fp_pool_get(pool) == b);
+    TEST_ASSERT(fp_pool_get(pool) == a);
+    TEST_ASSERT(fp_pool_cached(pool) == 0);
+    fp_pool_put(pool, a);
+    fp_pool_put(pool, b);
+    fp_pool_put(pool, NULL);
+    TEST_ASSERT(fp_pool_cached(pool) == 2);
+    fp_pool_destroy(pool);
+
+    // Tiny objects still fit the free-list link.
+    pool = fp_pool_create(1, 4);
+    TEST_ASSERT(fp_pool_object_size(pool) >= sizeof(void *));
+    void *tiny = fp_pool_get(pool);
+    fp_pool_put(pool, tiny);
+    TEST_ASSERT(fp_pool_get(pool) == tiny);
+    fp_pool_put(pool, tiny);
+    fp_pool_destroy(pool);
+}
+
+void run_pool_tests(void) {
+    printf("\n🧪 [pool] Recycling fixed-size objects\n");
+    test_recycling();
+    printf("✅ [pool] Freed objects were handed out again up to the cache limit\n");
+}
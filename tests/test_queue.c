@@ -13,6 +13,18 @@
 
 #define TEST_EXTERN(name) void name(void)
 TEST_EXTERN(run_image_ops_tests);
+TEST_EXTERN(run_png_stream_tests);
+TEST_EXTERN(run_output_store_tests);
+TEST_EXTERN(run_base64_tests);
+TEST_EXTERN(run_result_store_tests);
+TEST_EXTERN(run_multipart_tests);
+TEST_EXTERN(run_http_parser_tests);
+TEST_EXTERN(run_admission_tests);
+TEST_EXTERN(run_pool_tests);
+TEST_EXTERN(run_handoff_tests);
+TEST_EXTERN(run_task_pool_tests);
+TEST_EXTERN(run_scheduler_tests);
+TEST_EXTERN(run_static_cache_tests);
 
 #define PRODUCER_COUNT 4
 #define CONSUMER_COUNT 4
@@ -238,12 +250,79 @@ static void test_queue_wraparound_ordering(void) {
     printf("✅ [queue-wrap] Wrap-around path preserved FIFO ordering\n");
 }
 
+typedef struct {
+    fp_queue *queue;
+    void *result;
+} blocking_consumer_args;
+
+static void *blocking_consumer_thread(void *arg) {
+    blocking_consumer_args *args = (blocking_consumer_args *)arg;
+    args->result = fp_queue_pop_wait(args->queue, -1);
+    return NULL;
+}
+
+static bool queue_has_waiter(fp_queue *queue) {
+    for (int i = 0; i < 2000; ++i) {
+        if (atomic_load(&queue->parker.waiters) > 0) {
+            return true;
+        }
+        struct timespec ts = {0, 1000000};
+        nanosleep(&ts, NULL);
+    }
+    return false;
+}
+
+static void test_queue_blocking_pop(void) {
+    printf("\n🧪 [queue-wait] Parking consumers until a push or close\n");
+    fp_queue *queue = fp_queue_create(4);
+    TEST_ASSERT(queue != NULL);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    TEST_ASSERT(fp_queue_pop_wait(queue, 20) == NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double waited_ms = (double)(end.tv_sec - start.tv_sec) * 1000.0 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+    TEST_ASSERT(waited_ms >= 19.0);
+
+    int value = 42;
+    blocking_consumer_args args = {.queue = queue};
+    pthread_t thread;
+    TEST_ASSERT(pthread_create(&thread, NULL, blocking_consumer_thread, &args) == 0);
+    TEST_ASSERT(queue_has_waiter(queue));
+    TEST_ASSERT(fp_queue_push(queue, &value) == 0);
+    pthread_join(thread, NULL);
+    TEST_ASSERT(args.result == &value);
+
+    args.result = &value;
+    TEST_ASSERT(pthread_create(&thread, NULL, blocking_consumer_thread, &args) == 0);
+    TEST_ASSERT(queue_has_waiter(queue));
+    fp_queue_close(queue);
+    pthread_join(thread, NULL);
+    TEST_ASSERT(args.result == NULL);
+    TEST_ASSERT(fp_queue_pop_wait(queue, -1) == NULL);
+    fp_queue_destroy(queue);
+    printf("✅ [queue-wait] Push woke the parked consumer, close released it, timeout returned NULL\n");
+}
+
 int main(void) {
     test_queue_mpmc();
     test_queue_fifo_order();
     test_queue_capacity_backpressure();
     test_queue_wraparound_ordering();
+    test_queue_blocking_pop();
     run_image_ops_tests();
+    run_png_stream_tests();
+    run_output_store_tests();
+    run_base64_tests();
+    run_result_store_tests();
+    run_multipart_tests();
+    run_http_parser_tests();
+    run_admission_tests();
+    run_pool_tests();
+    run_handoff_tests();
+    run_task_pool_tests();
+    run_scheduler_tests();
+    run_static_cache_tests();
     printf("[tests] queue suite passed\n");
     return 0;
 }
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "result_store.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static fp_result *make_result(size_t size) {
+    fp_result *result = calloc(1, sizeof(fp_result));
+    TEST_ASSERT(result != NULL);
+    result->output_count = 1;
+    result->outputs[0].data = malloc(size);
+    TEST_ASSERT(result->outputs[0].data != NULL);
+    memset(result->outputs[0].data, 0xcd, size);
+    result->outputs[0].size = size;
+    return result;
+}
+
+static void count_fired(void *ctx) {
+    (*(int *)ctx)++;
+}
+
+static void test_reserve_complete_lookup(void) {
+    fp_result_store *store = fp_result_store_create(8, 60000, 0);
+    TEST_ASSERT(store != NULL);
+
+    fp_stored_result *stored = NULL;
+    TEST_ASSERT(fp_result_store_lookup(store, 5, &stored, NULL, NULL, NULL) == FP_JOB_UNKNOWN);
+    TEST_ASSERT(fp_result_store_reserve(store, 5) == 0);
+    TEST_ASSERT(fp_result_store_reserve(store, 5) != 0);
+
+    int fired = 0;
+    int dropped = 0;
+    fp_result_watch *watch = NULL;
+    fp_result_watch *unwanted = NULL;
+    TEST_ASSERT(fp_result_store_lookup(store, 5, &stored, count_fired, &fired, &watch) == FP_JOB_PENDING);
+    TEST_ASSERT(stored == NULL && watch != NULL);
+    TEST_ASSERT(fp_result_store_lookup(store, 5, NULL, count_fired, &dropped, &unwanted) == FP_JOB_PENDING);
+    TEST_ASSERT(fp_result_store_unwatch(store, unwanted));
+
+    fp_result_store_complete(store, 5, "photo.png", make_result(300));
+    TEST_ASSERT(fired == 1 && dropped == 0);
+    TEST_ASSERT(!fp_result_store_unwatch(store, watch));
+
+    TEST_ASSERT(fp_result_store_lookup(store, 5, &stored, NULL, NULL, NULL) == FP_JOB_DONE);
+    TEST_ASSERT(stored != NULL);
+    // Results are readable more than once and outlive the store while held.
+    fp_stored_result *again = NULL;
+    TEST_ASSERT(fp_result_store_lookup(store, 5, &again, NULL, NULL, NULL) == FP_JOB_DONE);
+    fp_stored_result_release(again);
+    fp_result_store_destroy(store);
+    const fp_result *result = fp_stored_result_get(stored);
+    TEST_ASSERT(result && result->outputs[0].size == 300 && result->outputs[0].data[299] == 0xcd);
+    TEST_ASSERT(strcmp(fp_stored_result_filename(stored), "photo.png") == 0);
+    fp_stored_result_release(stored);
+}
+
+static void test_bounds_and_expiry(void) {
+    fp_result_store *store = fp_result_store_create(2, 20, 0);
+    TEST_ASSERT(store != NULL);
+
+    TEST_ASSERT(fp_result_store_reserve(store, 1) == 0);
+    TEST_ASSERT(fp_result_store_reserve(store, 2) == 0);
+    // Both slots are pending, so nothing can be evicted.
+    TEST_ASSERT(fp_result_store_reserve(store, 3) != 0);
+
+    fp_result_store_complete(store, 1, "a.png", make_result(10));
+    TEST_ASSERT(fp_result_store_reserve(store, 3) == 0);
+    TEST_ASSERT(fp_result_store_lookup(store, 1, NULL, NULL, NULL, NULL) == FP_JOB_UNKNOWN);
+
+    int fired = 0;
+    fp_result_watch *watch = NULL;
+    TEST_ASSERT(fp_result_store_lookup(store, 3, NULL, count_fired, &fired, &watch) == FP_JOB_PENDING);
+    fp_result_store_cancel(store, 3);
+    TEST_ASSERT(fired == 1);
+    TEST_ASSERT(fp_result_store_lookup(store, 3, NULL, NULL, NULL, NULL) == FP_JOB_UNKNOWN);
+
+    fp_result_store_complete(store, 2, NULL, NULL);
+    fp_stored_result *stored = NULL;
+    TEST_ASSERT(fp_result_store_lookup(store, 2, &stored, NULL, NULL, NULL) == FP_JOB_DONE);
+    TEST_ASSERT(fp_stored_result_get(stored) == NULL);
+    fp_stored_result_release(stored);
+
+    struct timespec ts = {0, 40 * 1000000L};
+    nanosleep(&ts, NULL);
+    TEST_ASSERT(fp_result_store_expire(store) == 1);
+    TEST_ASSERT(fp_result_store_lookup(store, 2, NULL, NULL, NULL, NULL) == FP_JOB_UNKNOWN);
+    fp_result_store_destroy(store);
+}
+
+void run_result_store_tests(void) {
+    printf("\n🧪 [result-store] Reserving, completing and watching a job\n");
+    test_reserve_complete_lookup();
+    printf("✅ [result-store] Watches fired once and results stayed readable\n");
+
+    printf("\n🧪 [result-store] Enforcing the job bound and TTL\n");
+    test_bounds_and_expiry();
+    printf("✅ [result-store] Finished jobs were evicted before pending ones and expired on time\n");
+}
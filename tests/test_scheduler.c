@@ -0,0 +1,218 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "scheduler.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+#define SCHED_JOBS_PER_CLASS 32
+
+static void test_weighted_shares(void) {
+    fp_scheduler *scheduler = fp_scheduler_create(SCHED_JOBS_PER_CLASS, 60000, 0, 1);
+    TEST_ASSERT(scheduler != NULL);
+    fp_job jobs[FP_JOB_CLASS_COUNT][SCHED_JOBS_PER_CLASS] = {0};
+    for (size_t c = 0; c < FP_JOB_CLASS_COUNT; ++c) {
+        for (size_t i = 0; i < SCHED_JOBS_PER_CLASS; ++i) {
+            jobs[c][i].id = i;
+            jobs[c][i].job_class = (fp_job_class)c;
+            TEST_ASSERT(fp_scheduler_push(scheduler, &jobs[c][i]) == 0);
+        }
+    }
+    fp_job overflow = {.job_class = FP_JOB_BULK};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &overflow) != 0);
+
+    // Two full rounds while every class has work.
+    size_t served[FP_JOB_CLASS_COUNT] = {0};
+    for (int i = 0; i < 30; ++i) {
+        fp_job *job = fp_scheduler_pop(scheduler, 0);
+        TEST_ASSERT(job != NULL);
+        TEST_ASSERT(job->id == served[job->job_class]); // FIFO within a class
+        served[job->job_class]++;
+    }
+    TEST_ASSERT(served[FP_JOB_INTERACTIVE] == 2 * FP_SCHED_WEIGHT_INTERACTIVE);
+    TEST_ASSERT(served[FP_JOB_EXPERT] == 2 * FP_SCHED_WEIGHT_EXPERT);
+    TEST_ASSERT(served[FP_JOB_FREE] == 2 * FP_SCHED_WEIGHT_FREE);
+    TEST_ASSERT(served[FP_JOB_BULK] == 2 * FP_SCHED_WEIGHT_BULK);
+
+    // Work-conserving: the rest drains even though the weights favour others.
+    size_t remaining = 0;
+    while (fp_scheduler_pop(scheduler, 0)) {
+        remaining++;
+    }
+    TEST_ASSERT(remaining == FP_JOB_CLASS_COUNT * SCHED_JOBS_PER_CLASS - 30);
+    fp_scheduler_destroy(scheduler);
+}
+
+static void test_aging(void) {
+    fp_scheduler *scheduler = fp_scheduler_create(64, 20, 0, 1);
+    TEST_ASSERT(scheduler != NULL);
+    fp_job interactive[40] = {0};
+    fp_job bulk = {.id = 99, .job_class = FP_JOB_BULK};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &bulk) == 0);
+    for (size_t i = 0; i < 40; ++i) {
+        interactive[i].job_class = FP_JOB_INTERACTIVE;
+        TEST_ASSERT(fp_scheduler_push(scheduler, &interactive[i]) == 0);
+    }
+    // Use up bulk's one turn of the round so only aging can serve it next.
+    while (1) {
+        fp_job *job = fp_scheduler_pop(scheduler, 0);
+        TEST_ASSERT(job != NULL);
+        if (job->job_class == FP_JOB_BULK) {
+            TEST_ASSERT(fp_scheduler_push(scheduler, job) == 0);
+            break;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT(fp_scheduler_pop(scheduler, 0)->job_class == FP_JOB_INTERACTIVE);
+    }
+    struct timespec ts = {0, 30 * 1000000L};
+    nanosleep(&ts, NULL);
+    fp_job *job = fp_scheduler_pop(scheduler, 0);
+    TEST_ASSERT(job == &bulk);
+    fp_scheduler_destroy(scheduler);
+}
+
+static void test_shortest_first(void) {
+    fp_scheduler *scheduler = fp_scheduler_create(8, 60000, 1000, 1);
+    TEST_ASSERT(scheduler != NULL);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fp_job big = {.id = 1, .job_class = FP_JOB_FREE, .predicted_ms = 900.0, .enqueue_ts = now};
+    fp_job medium = {.id = 2, .job_class = FP_JOB_FREE, .predicted_ms = 300.0, .enqueue_ts = now};
+    fp_job small = {.id = 3, .job_class = FP_JOB_FREE, .predicted_ms = 20.0, .enqueue_ts = now};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &big) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &medium) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &small) == 0);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &small);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &medium);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &big);
+
+    // A job queued more than the window earlier is not overtaken, however cheap the newcomer.
+    fp_job old = {.id = 4, .job_class = FP_JOB_FREE, .predicted_ms = 60000.0, .enqueue_ts = now};
+    old.enqueue_ts.tv_sec -= 2;
+    fp_job fresh = {.id = 5, .job_class = FP_JOB_FREE, .predicted_ms = 1.0, .enqueue_ts = now};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &fresh) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &old) == 0);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &old);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &fresh);
+    fp_scheduler_destroy(scheduler);
+}
+
+static void test_lanes(void) {
+    fp_scheduler *scheduler = fp_scheduler_create(8, 60000, 0, 4);
+    TEST_ASSERT(scheduler != NULL);
+    fp_job jobs[8] = {0};
+    for (size_t i = 0; i < 8; ++i) {
+        jobs[i].id = i;
+        jobs[i].job_class = FP_JOB_FREE;
+        TEST_ASSERT(fp_scheduler_push(scheduler, &jobs[i]) == 0);
+    }
+    // Two jobs per lane, so no lane can take a third free job.
+    fp_job overflow = {.job_class = FP_JOB_FREE};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &overflow) != 0);
+    // Pushes went round robin; each worker gets the next job of its own lane.
+    for (size_t lane = 0; lane < 4; ++lane) {
+        TEST_ASSERT(fp_scheduler_pop(scheduler, lane) == &jobs[lane]);
+    }
+    // Lane 3 runs dry and steals from lane 0 onwards.
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 3) == &jobs[7]);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 3) == &jobs[4]);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 3) == &jobs[5]);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 3) == &jobs[6]);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 3) == NULL);
+    fp_scheduler_destroy(scheduler);
+}
+
+// A class is served by priority over all lanes, not just the worker's own.
+static void test_lane_priority(void) {
+    fp_scheduler *scheduler = fp_scheduler_create(8, 60000, 0, 4);
+    TEST_ASSERT(scheduler != NULL);
+    fp_job local_bulk = {.id = 1, .job_class = FP_JOB_BULK};
+    fp_job other_bulk = {.id = 2, .job_class = FP_JOB_BULK};
+    fp_job interactive = {.id = 3, .job_class = FP_JOB_INTERACTIVE};
+    fp_job expert = {.id = 4, .job_class = FP_JOB_EXPERT};
+    // Round robin puts one job in each lane, bulk in lane 0.
+    TEST_ASSERT(fp_scheduler_push(scheduler, &local_bulk) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &other_bulk) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &interactive) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &expert) == 0);
+    // Worker 0 fetches the interactive and expert jobs from lanes 2 and 3
+    // before its own bulk job, then prefers its own lane within bulk.
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &interactive);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &expert);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &local_bulk);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &other_bulk);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == NULL);
+    fp_scheduler_destroy(scheduler);
+}
+
+// Serving a class from one lane resets its aging in every lane.
+static void test_lane_aging(void) {
+    fp_scheduler *scheduler = fp_scheduler_create(8, 20, 0, 2);
+    TEST_ASSERT(scheduler != NULL);
+    fp_job first_bulk = {.id = 1, .job_class = FP_JOB_BULK};
+    fp_job second_bulk = {.id = 2, .job_class = FP_JOB_BULK};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &first_bulk) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &second_bulk) == 0);
+    struct timespec ts = {0, 30 * 1000000L};
+    nanosleep(&ts, NULL);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &first_bulk);
+
+    // Bulk was just served, so the job left in lane 1 has not aged.
+    fp_job interactive[2] = {{.id = 3, .job_class = FP_JOB_INTERACTIVE}, {.id = 4, .job_class = FP_JOB_INTERACTIVE}};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &interactive[0]) == 0);
+    TEST_ASSERT(fp_scheduler_push(scheduler, &interactive[1]) == 0);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &interactive[0]);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &interactive[1]);
+    TEST_ASSERT(fp_scheduler_pop(scheduler, 0) == &second_bulk);
+    fp_scheduler_destroy(scheduler);
+}
+
+static void test_close(void) {
+    fp_scheduler *scheduler = fp_scheduler_create(4, 0, 0, 1);
+    TEST_ASSERT(scheduler != NULL);
+    TEST_ASSERT(fp_scheduler_pop_wait(scheduler, 0, 10) == NULL);
+    fp_job job = {.job_class = FP_JOB_EXPERT};
+    TEST_ASSERT(fp_scheduler_push(scheduler, &job) == 0);
+    TEST_ASSERT(fp_scheduler_pop_wait(scheduler, 0, -1) == &job);
+    fp_scheduler_close(scheduler);
+    TEST_ASSERT(fp_scheduler_pop_wait(scheduler, 0, -1) == NULL);
+    fp_scheduler_destroy(scheduler);
+}
+
+void run_scheduler_tests(void) {
+    printf("\n🧪 [scheduler] Serving classes by weight\n");
+    test_weighted_shares();
+    printf("✅ [scheduler] Each class got its weighted share, FIFO within the class\n");
+
+    printf("\n🧪 [scheduler] Aging a starved class\n");
+    test_aging();
+    printf("✅ [scheduler] Bulk work jumped ahead once it waited past the aging bound\n");
+
+    printf("\n🧪 [scheduler] Shortest predicted job first\n");
+    test_shortest_first();
+    printf("✅ [scheduler] Cheap jobs went first, but not past a job older than the window\n");
+
+    printf("\n🧪 [scheduler] Per-worker lanes\n");
+    test_lanes();
+    printf("✅ [scheduler] Workers served their own lane first and stole once it was empty\n");
+
+    printf("\n🧪 [scheduler] Class priority across lanes\n");
+    test_lane_priority();
+    printf("✅ [scheduler] Interactive work in another lane went before local bulk work\n");
+
+    printf("\n🧪 [scheduler] Aging across lanes\n");
+    test_lane_aging();
+    printf("✅ [scheduler] A class served from one lane stopped aging in the others\n");
+
+    printf("\n🧪 [scheduler] Waiting and closing\n");
+    test_close();
+    printf("✅ [scheduler] pop_wait timed out, returned queued work and released on close\n");
+}
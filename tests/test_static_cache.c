@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "static_cache.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+static void test_etag_matches(void) {
+    const char *etag = "\"5d8c-1a2b\"";
+    TEST_ASSERT(fp_static_etag_matches("\"5d8c-1a2b\"", etag));
+    TEST_ASSERT(fp_static_etag_matches("W/\"5d8c-1a2b\"", etag));
+    TEST_ASSERT(fp_static_etag_matches("*", etag));
+    TEST_ASSERT(fp_static_etag_matches("\"old\", W/\"5d8c-1a2b\"", etag));
+    TEST_ASSERT(fp_static_etag_matches("\"old\",\t\"5d8c-1a2b\"", etag));
+    TEST_ASSERT(!fp_static_etag_matches("\"old\", \"older\"", etag));
+    TEST_ASSERT(!fp_static_etag_matches("\"5d8c-1a2\"", etag)); // prefix only
+    TEST_ASSERT(!fp_static_etag_matches("\"5d8c-1a2b\"x", etag));
+    TEST_ASSERT(!fp_static_etag_matches("", etag));
+    TEST_ASSERT(!fp_static_etag_matches(NULL, etag));
+    TEST_ASSERT(!fp_static_etag_matches("*", ""));
+}
+
+static void test_pick_variant(void) {
+    fp_static_asset asset;
+    memset(&asset, 0, sizeof(asset));
+    asset.identity.size = 1000;
+    asset.gzip.encoding = "gzip";
+    asset.gzip.size = 400;
+    asset.brotli.encoding = "br";
+    asset.brotli.size = 300;
+
+    TEST_ASSERT(fp_static_pick_variant(&asset, NULL) == &asset.identity);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "") == &asset.identity);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "identity") == &asset.identity);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "gzip, deflate, br") == &asset.brotli);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "GZIP") == &asset.gzip);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "br;q=0, gzip") == &asset.gzip);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "br; q=0.5, gzip;q=0") == &asset.brotli);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "gzip;q=0") == &asset.identity);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "brotli, xgzip") == &asset.identity);
+
+    // The smallest acceptable variant wins, whatever the client listed first.
+    asset.brotli.size = 450;
+    TEST_ASSERT(fp_static_pick_variant(&asset, "br, gzip") == &asset.gzip);
+    // A variant that was not worth storing is never picked.
+    asset.gzip.size = 0;
+    TEST_ASSERT(fp_static_pick_variant(&asset, "gzip") == &asset.identity);
+    TEST_ASSERT(fp_static_pick_variant(&asset, "gzip, br") == &asset.brotli);
+}
+
+static void test_mime_type(void) {
+    TEST_ASSERT(strcmp(fp_static_mime_type("index.html"), "text/html; charset=utf-8") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("assets/app.css"), "text/css; charset=utf-8") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("assets/app.js"), "application/javascript") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("assets/logo.png"), "image/png") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("icon.svg"), "image/svg+xml") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("robots.txt"), "text/plain; charset=utf-8") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("archive.tar.gz"), "application/octet-stream") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("LICENSE"), "application/octet-stream") == 0);
+    TEST_ASSERT(strcmp(fp_static_mime_type("page.HTML"), "application/octet-stream") == 0);
+
+    char date[32];
+    fp_static_format_http_date(0, date, sizeof(date));
+    TEST_ASSERT(strcmp(date, "Thu, 01 Jan 1970 00:00:00 GMT") == 0);
+}
+
+void run_static_cache_tests(void) {
+    printf("\n🧪 [static_cache] Matching If-None-Match\n");
+    test_etag_matches();
+    printf("✅ [static_cache] Strong, weak, listed and wildcard tags matched; near misses did not\n");
+
+    printf("\n🧪 [static_cache] Negotiating Content-Encoding\n");
+    test_pick_variant();
+    printf("✅ [static_cache] Smallest accepted variant served, q=0 honoured\n");
+
+    printf("\n🧪 [static_cache] Content types and dates\n");
+    test_mime_type();
+    printf("✅ [static_cache] Extensions mapped and HTTP dates formatted\n");
+}
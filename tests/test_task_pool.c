@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "task_pool.h"
+
+#define TEST_ASSERT(cond)                                                                         \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__);         \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+#define TASK_POOL_SUBMITTERS 4
+#define TASK_POOL_ROUNDS 200
+#define TASK_POOL_BATCH 24 // more than a deque holds, so some run inline
+
+typedef struct {
+    atomic_size_t *counter;
+    int done;
+} counted_task;
+
+static void count_task(void *arg) {
+    counted_task *task = (counted_task *)arg;
+    task->done++;
+    atomic_fetch_add_explicit(task->counter, 1, memory_order_relaxed);
+}
+
+typedef struct {
+    fp_task_pool *pool;
+    size_t index;
+    atomic_size_t *counter;
+    int failures;
+} submitter_ctx;
+
+static void *submitter_thread(void *arg) {
+    submitter_ctx *ctx = (submitter_ctx *)arg;
+    for (int round = 0; round < TASK_POOL_ROUNDS; ++round) {
+        counted_task work[TASK_POOL_BATCH];
+        fp_task tasks[TASK_POOL_BATCH];
+        fp_task_group group;
+        atomic_init(&group.pending, 0);
+        for (size_t i = 0; i < TASK_POOL_BATCH; ++i) {
+            work[i] = (counted_task){.counter = ctx->counter};
+            tasks[i] = (fp_task){.fn = count_task, .arg = &work[i], .group = &group};
+            if (fp_task_pool_submit(ctx->pool, ctx->index, &tasks[i]) != 0) {
+                count_task(&work[i]);
+            }
+        }
+        fp_task_pool_wait(ctx->pool, ctx->index, &group);
+        for (size_t i = 0; i < TASK_POOL_BATCH; ++i) {
+            if (work[i].done != 1) {
+                ctx->failures++;
+            }
+        }
+        if (atomic_load(&group.pending) != 0) {
+            ctx->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_submitters(void) {
+    fp_task_pool *pool = fp_task_pool_create(2, TASK_POOL_SUBMITTERS);
+    TEST_ASSERT(pool != NULL);
+    atomic_size_t counter;
+    atomic_init(&counter, 0);
+
+    pthread_t threads[TASK_POOL_SUBMITTERS];
+    submitter_ctx ctx[TASK_POOL_SUBMITTERS];
+    for (size_t i = 0; i < TASK_POOL_SUBMITTERS; ++i) {
+        ctx[i] = (submitter_ctx){.pool = pool, .index = i, .counter = &counter};
+        TEST_ASSERT(pthread_create(&threads[i], NULL, submitter_thread, &ctx[i]) == 0);
+    }
+    for (size_t i = 0; i < TASK_POOL_SUBMITTERS; ++i) {
+        pthread_join(threads[i], NULL);
+        TEST_ASSERT(ctx[i].failures == 0);
+    }
+    TEST_ASSERT(atomic_load(&counter) == (size_t)TASK_POOL_SUBMITTERS * TASK_POOL_ROUNDS * TASK_POOL_BATCH);
+    fp_task_pool_destroy(pool);
+}
+
+static void test_thread_cap(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    fp_task_pool *pool = fp_task_pool_create(100000, 1);
+    TEST_ASSERT(pool != NULL);
+    TEST_ASSERT(fp_task_pool_threads(pool) >= 1);
+    // The submitter encodes too, so it takes one CPU of the budget.
+    TEST_ASSERT(cpus <= 1 || fp_task_pool_threads(pool) <= (size_t)cpus - 1);
+    fp_task_pool_destroy(pool);
+
+    // More submitters than CPUs still leave one pool thread.
+    size_t submitters = cpus > 0 ? (size_t)cpus + 4 : 4;
+    pool = fp_task_pool_create(0, submitters);
+    TEST_ASSERT(pool != NULL);
+    TEST_ASSERT(fp_task_pool_threads(pool) == 1);
+    fp_task_pool_destroy(pool);
+
+    pool = fp_task_pool_create(0, 1);
+    TEST_ASSERT(pool != NULL);
+
+    fp_task_group group;
+    atomic_init(&group.pending, 0);
+    counted_task work = {0};
+    fp_task task = {.fn = count_task, .arg = &work, .group = &group};
+    TEST_ASSERT(fp_task_pool_submit(pool, 1, &task) != 0); // no such submitter
+    fp_task_pool_destroy(pool);
+}
+
+void run_task_pool_tests(void) {
+    printf("\n🧪 [task_pool] Submitters sharing the encode threads\n");
+    test_concurrent_submitters();
+    printf("✅ [task_pool] Every task ran exactly once and every wait saw its group finish\n");
+
+    printf("\n🧪 [task_pool] Bounding the pool to the CPUs\n");
+    test_thread_cap();
+    printf("✅ [task_pool] Pool threads plus submitters capped at the online CPUs\n");
+}